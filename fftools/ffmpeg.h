@@ -353,6 +353,9 @@ enum DecoderFlags {
     DECODER_FLAG_SEND_END_TS      = (1 << 4),
     // force bitexact decoding
     DECODER_FLAG_BITEXACT         = (1 << 5),
+    // frames before DecoderOpts.start_time are discarded downstream, so
+    // non-reference frames among them need not be reconstructed
+    DECODER_FLAG_SKIP_TRIMMED     = (1 << 6),
 };
 
 typedef struct DecoderOpts {
@@ -375,6 +378,10 @@ typedef struct DecoderOpts {
     // Either forced (when DECODER_FLAG_FRAMERATE_FORCED is set) or
     // estimated (otherwise) video framerate.
     AVRational                  framerate;
+
+    // with DECODER_FLAG_SKIP_TRIMMED, start of the output range in
+    // AV_TIME_BASE units
+    int64_t                     start_time;
 } DecoderOpts;
 
 typedef struct Decoder {
@@ -50,6 +50,11 @@ typedef struct DecoderPriv {
     int                 flags;
     int                 apply_cropping;
 
+    // see DECODER_FLAG_SKIP_TRIMMED
+    int64_t             start_time;
+    // skip_frame as set by the user
+    enum AVDiscard      skip_frame;
+
     enum AVPixelFormat  hwaccel_pix_fmt;
     enum HWAccelID      hwaccel_id;
     enum AVHWDeviceType hwaccel_device_type;
@@ -684,6 +689,17 @@ static int packet_decode(DecoderPriv *dp, AVPacket *pkt, AVFrame *frame)
         fd->wallclock[LATENCY_PROBE_DEC_PRE] = av_gettime_relative();
     }
 
+    // frames from packets before the seek target only serve as references
+    // for later ones, so do not bother reconstructing the rest of them
+    if (dp->flags & DECODER_FLAG_SKIP_TRIMMED) {
+        int trimmed = pkt && pkt->pts != AV_NOPTS_VALUE &&
+                      av_compare_ts(pkt->pts, dec->pkt_timebase,
+                                    dp->start_time, AV_TIME_BASE_Q) < 0;
+
+        dec->skip_frame = trimmed ? FFMAX(dp->skip_frame, AVDISCARD_NONREF) :
+                                    dp->skip_frame;
+    }
+
     ret = avcodec_send_packet(dec, pkt);
     if (ret < 0 && !(ret == AVERROR_EOF && !pkt)) {
         // In particular, we don't expect AVERROR(EAGAIN), because we read all
@@ -1154,6 +1170,11 @@ static int dec_open(DecoderPriv *dp, AVDictionary **dec_opts,
 
     dp->flags      = o->flags;
     dp->log_parent = o->log_parent;
+    dp->start_time = o->start_time;
+
+    // output timestamps do not follow packet timestamps in these cases
+    if (dp->flags & (DECODER_FLAG_FRAMERATE_FORCED | DECODER_FLAG_TS_UNRELIABLE))
+        dp->flags &= ~DECODER_FLAG_SKIP_TRIMMED;
 
     dp->dec.type                = codec->type;
     dp->framerate_in            = o->framerate;
@@ -1231,6 +1252,8 @@ static int dec_open(DecoderPriv *dp, AVDictionary **dec_opts,
         return ret;
     }
 
+    dp->skip_frame = dp->dec_ctx->skip_frame;
+
     if (dp->dec_ctx->hw_device_ctx) {
         // Update decoder extra_hw_frames option to account for the
         // frames held in queues inside the ffmpeg utility.  This is
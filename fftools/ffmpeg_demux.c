@@ -873,6 +873,24 @@ void ifile_close(InputFile **pf)
     av_freep(pf);
 }
 
+// timestamp before which decoded frames are trimmed away when seeking
+// accurately, AV_NOPTS_VALUE otherwise
+static int64_t trim_start(const Demuxer *d)
+{
+    int64_t tsoffset = 0;
+
+    if ((d->f.start_time == AV_NOPTS_VALUE) || !d->accurate_seek)
+        return AV_NOPTS_VALUE;
+
+    if (copy_ts) {
+        tsoffset = d->f.start_time == AV_NOPTS_VALUE ? 0 : d->f.start_time;
+        if (!start_at_zero && d->f.ctx->start_time != AV_NOPTS_VALUE)
+            tsoffset += d->f.ctx->start_time;
+    }
+
+    return tsoffset;
+}
+
 static int ist_use(InputStream *ist, int decoding_needed)
 {
     Demuxer      *d = demuxer_from_ifile(ist->file);
@@ -919,6 +937,12 @@ static int ist_use(InputStream *ist, int decoding_needed)
 #endif
                              ;
 
+        if (ist->par->codec_type == AVMEDIA_TYPE_VIDEO) {
+            ds->dec_opts.start_time = trim_start(d);
+            if (ds->dec_opts.start_time != AV_NOPTS_VALUE)
+                ds->dec_opts.flags |= DECODER_FLAG_SKIP_TRIMMED;
+        }
+
         if (ist->framerate.num) {
             ds->dec_opts.flags     |= DECODER_FLAG_FRAMERATE_FORCED;
             ds->dec_opts.framerate  = ist->framerate;
@@ -986,7 +1010,6 @@ int ist_filter_add(InputStream *ist, InputFilter *ifilter, int is_simple,
 {
     Demuxer      *d = demuxer_from_ifile(ist->file);
     DemuxStream *ds = ds_from_ist(ist);
-    int64_t tsoffset = 0;
     int ret;
 
     ret = ist_use(ist, is_simple ? DECODING_FOR_OST : DECODING_FOR_FILTER);
@@ -1045,13 +1068,7 @@ int ist_filter_add(InputStream *ist, InputFilter *ifilter, int is_simple,
     if (ret < 0)
         return ret;
 
-    if (copy_ts) {
-        tsoffset = d->f.start_time == AV_NOPTS_VALUE ? 0 : d->f.start_time;
-        if (!start_at_zero && d->f.ctx->start_time != AV_NOPTS_VALUE)
-            tsoffset += d->f.ctx->start_time;
-    }
-    opts->trim_start_us = ((d->f.start_time == AV_NOPTS_VALUE) || !d->accurate_seek) ?
-                          AV_NOPTS_VALUE : tsoffset;
+    opts->trim_start_us = trim_start(d);
     opts->trim_end_us   = d->recording_time;
 
     opts->name = av_strdup(ds->dec_name);
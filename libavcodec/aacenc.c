@@ -472,8 +472,8 @@ static void (*const apply_window[4])(AVFloatDSPContext *fdsp,
     [LONG_STOP_SEQUENCE]   = apply_long_stop_window
 };
 
-static void apply_window_and_mdct(AACEncContext *s, SingleChannelElement *sce,
-                                  float *audio)
+static void apply_window_and_mdct(AACEncContext *s, AACEncThreadContext *td,
+                                  SingleChannelElement *sce, float *audio)
 {
     int i;
     float *output = sce->ret_buf;
@@ -481,10 +481,10 @@ static void apply_window_and_mdct(AACEncContext *s, SingleChannelElement *sce,
     apply_window[sce->ics.window_sequence[0]](s->fdsp, sce, audio);
 
     if (sce->ics.window_sequence[0] != EIGHT_SHORT_SEQUENCE)
-        s->mdct1024_fn(s->mdct1024, sce->coeffs, output, sizeof(float));
+        td->mdct1024_fn(td->mdct1024, sce->coeffs, output, sizeof(float));
     else
         for (i = 0; i < 1024; i += 128)
-            s->mdct128_fn(s->mdct128, &sce->coeffs[i], output + i*2, sizeof(float));
+            td->mdct128_fn(td->mdct128, &sce->coeffs[i], output + i*2, sizeof(float));
     memcpy(audio, audio + 1024, sizeof(audio[0]) * 1024);
     memcpy(sce->pcoeffs, sce->coeffs, sizeof(sce->pcoeffs));
 }
@@ -828,19 +828,135 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+typedef struct AACEncAnalysisArgs {
+    FFPsyWindowInfo *windows;
+    int have_lookahead;
+} AACEncAnalysisArgs;
+
+/**
+ * Choose the window sequence of one channel and transform it.
+ * Channels only touch their own psy and element state here, so this runs
+ * as one slice thread job per channel.
+ */
+static int analyze_channel(AVCodecContext *avctx, void *arg, int channel, int threadnr)
+{
+    AACEncContext *s = avctx->priv_data;
+    const AACEncAnalysisArgs *args = arg;
+    AACEncThreadContext *td = &s->thread[threadnr];
+    FFPsyWindowInfo *wi = &args->windows[channel];
+    SingleChannelElement *sce;
+    IndividualChannelStream *ics;
+    float *overlap, *samples2, *la;
+    float clip_avoidance_factor;
+    int i, w, k, tag, chans, ch = channel;
+
+    for (i = 0; i < s->chan_map[0]; i++) {
+        tag   = s->chan_map[i+1];
+        chans = tag == TYPE_CPE ? 2 : 1;
+        if (ch < chans)
+            break;
+        ch -= chans;
+    }
+    sce = &s->cpe[i].ch[ch];
+    ics = &sce->ics;
+
+    overlap  = &s->planar_samples[channel][0];
+    samples2 = overlap + 1024;
+    la       = samples2 + (448+64);
+    if (!args->have_lookahead)
+        la = NULL;
+    if (tag == TYPE_LFE) {
+        wi->window_type[0] = wi->window_type[1] = ONLY_LONG_SEQUENCE;
+        wi->window_shape   = 0;
+        wi->num_windows    = 1;
+        wi->grouping[0]    = 1;
+        wi->clipping[0]    = 0;
+
+        /* Only the lowest 12 coefficients are used in a LFE channel.
+         * The expression below results in only the bottom 8 coefficients
+         * being used for 11.025kHz to 16kHz sample rates.
+         */
+        ics->num_swb = s->samplerate_index >= 8 ? 1 : 3;
+    } else {
+        *wi = s->psy.model->window(&s->psy, samples2, la, channel,
+                                   ics->window_sequence[0]);
+    }
+    ics->window_sequence[1] = ics->window_sequence[0];
+    ics->window_sequence[0] = wi->window_type[0];
+    ics->use_kb_window[1]   = ics->use_kb_window[0];
+    ics->use_kb_window[0]   = wi->window_shape;
+    ics->num_windows        = wi->num_windows;
+    ics->swb_sizes          = s->psy.bands    [ics->num_windows == 8];
+    ics->num_swb            = tag == TYPE_LFE ? ics->num_swb : s->psy.num_bands[ics->num_windows == 8];
+    ics->max_sfb            = FFMIN(ics->max_sfb, ics->num_swb);
+    ics->swb_offset         = wi->window_type[0] == EIGHT_SHORT_SEQUENCE ?
+                                ff_swb_offset_128 [s->samplerate_index]:
+                                ff_swb_offset_1024[s->samplerate_index];
+    ics->tns_max_bands      = wi->window_type[0] == EIGHT_SHORT_SEQUENCE ?
+                                ff_tns_max_bands_128 [s->samplerate_index]:
+                                ff_tns_max_bands_1024[s->samplerate_index];
+
+    for (w = 0; w < ics->num_windows; w++)
+        ics->group_len[w] = wi->grouping[w];
+
+    /* Calculate input sample maximums and evaluate clipping risk */
+    clip_avoidance_factor = 0.0f;
+    for (w = 0; w < ics->num_windows; w++) {
+        const float *wbuf = overlap + w * 128;
+        const int wlen = 2048 / ics->num_windows;
+        float max = 0;
+        int j;
+        /* mdct input is 2 * output */
+        for (j = 0; j < wlen; j++)
+            max = FFMAX(max, fabsf(wbuf[j]));
+        wi->clipping[w] = max;
+    }
+    for (w = 0; w < ics->num_windows; w++) {
+        if (wi->clipping[w] > CLIP_AVOIDANCE_FACTOR) {
+            ics->window_clipping[w] = 1;
+            clip_avoidance_factor = FFMAX(clip_avoidance_factor, wi->clipping[w]);
+        } else {
+            ics->window_clipping[w] = 0;
+        }
+    }
+    if (clip_avoidance_factor > CLIP_AVOIDANCE_FACTOR) {
+        ics->clip_avoidance_factor = CLIP_AVOIDANCE_FACTOR / clip_avoidance_factor;
+    } else {
+        ics->clip_avoidance_factor = 1.0f;
+    }
+
+    apply_window_and_mdct(s, td, sce, overlap);
+
+    if (s->options.ltp && s->coder->update_ltp) {
+        s->coder->update_ltp(s, sce, channel);
+        apply_window[sce->ics.window_sequence[0]](s->fdsp, sce, &sce->ltp_state[0]);
+        td->mdct1024_fn(td->mdct1024, sce->lcoeffs, sce->ret_buf, sizeof(float));
+    }
+
+    for (k = 0; k < 1024; k++) {
+        if (!(fabs(sce->coeffs[k]) < 1E16)) { // Ensure headroom for energy calculation
+            av_log(avctx, AV_LOG_ERROR, "Input contains (near) NaN/+-Inf\n");
+            return AVERROR(EINVAL);
+        }
+    }
+    avoid_clipping(s, sce);
+
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
     AACEncContext *s = avctx->priv_data;
-    float **samples = s->planar_samples, *samples2, *la, *overlap;
     ChannelElement *cpe;
     SingleChannelElement *sce;
-    IndividualChannelStream *ics;
     int i, its, ch, w, chans, tag, start_ch, ret, frame_bits;
     int target_bits, rate_bits, too_many_bits, too_few_bits;
     int ms_mode = 0, is_mode = 0, tns_mode = 0, pred_mode = 0;
     int chan_el_counter[4];
+    int channel_ret[AAC_MAX_CHANNELS];
     FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
+    AACEncAnalysisArgs args;
 
     /* add current frame to queue */
     if (frame) {
@@ -858,101 +974,13 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
     if (!avctx->frame_num)
         return 0;
 
-    start_ch = 0;
-    for (i = 0; i < s->chan_map[0]; i++) {
-        FFPsyWindowInfo* wi = windows + start_ch;
-        tag      = s->chan_map[i+1];
-        chans    = tag == TYPE_CPE ? 2 : 1;
-        cpe      = &s->cpe[i];
-        for (ch = 0; ch < chans; ch++) {
-            int k;
-            float clip_avoidance_factor;
-            sce = &cpe->ch[ch];
-            ics = &sce->ics;
-            s->cur_channel = start_ch + ch;
-            overlap  = &samples[s->cur_channel][0];
-            samples2 = overlap + 1024;
-            la       = samples2 + (448+64);
-            if (!frame)
-                la = NULL;
-            if (tag == TYPE_LFE) {
-                wi[ch].window_type[0] = wi[ch].window_type[1] = ONLY_LONG_SEQUENCE;
-                wi[ch].window_shape   = 0;
-                wi[ch].num_windows    = 1;
-                wi[ch].grouping[0]    = 1;
-                wi[ch].clipping[0]    = 0;
-
-                /* Only the lowest 12 coefficients are used in a LFE channel.
-                 * The expression below results in only the bottom 8 coefficients
-                 * being used for 11.025kHz to 16kHz sample rates.
-                 */
-                ics->num_swb = s->samplerate_index >= 8 ? 1 : 3;
-            } else {
-                wi[ch] = s->psy.model->window(&s->psy, samples2, la, s->cur_channel,
-                                              ics->window_sequence[0]);
-            }
-            ics->window_sequence[1] = ics->window_sequence[0];
-            ics->window_sequence[0] = wi[ch].window_type[0];
-            ics->use_kb_window[1]   = ics->use_kb_window[0];
-            ics->use_kb_window[0]   = wi[ch].window_shape;
-            ics->num_windows        = wi[ch].num_windows;
-            ics->swb_sizes          = s->psy.bands    [ics->num_windows == 8];
-            ics->num_swb            = tag == TYPE_LFE ? ics->num_swb : s->psy.num_bands[ics->num_windows == 8];
-            ics->max_sfb            = FFMIN(ics->max_sfb, ics->num_swb);
-            ics->swb_offset         = wi[ch].window_type[0] == EIGHT_SHORT_SEQUENCE ?
-                                        ff_swb_offset_128 [s->samplerate_index]:
-                                        ff_swb_offset_1024[s->samplerate_index];
-            ics->tns_max_bands      = wi[ch].window_type[0] == EIGHT_SHORT_SEQUENCE ?
-                                        ff_tns_max_bands_128 [s->samplerate_index]:
-                                        ff_tns_max_bands_1024[s->samplerate_index];
-
-            for (w = 0; w < ics->num_windows; w++)
-                ics->group_len[w] = wi[ch].grouping[w];
-
-            /* Calculate input sample maximums and evaluate clipping risk */
-            clip_avoidance_factor = 0.0f;
-            for (w = 0; w < ics->num_windows; w++) {
-                const float *wbuf = overlap + w * 128;
-                const int wlen = 2048 / ics->num_windows;
-                float max = 0;
-                int j;
-                /* mdct input is 2 * output */
-                for (j = 0; j < wlen; j++)
-                    max = FFMAX(max, fabsf(wbuf[j]));
-                wi[ch].clipping[w] = max;
-            }
-            for (w = 0; w < ics->num_windows; w++) {
-                if (wi[ch].clipping[w] > CLIP_AVOIDANCE_FACTOR) {
-                    ics->window_clipping[w] = 1;
-                    clip_avoidance_factor = FFMAX(clip_avoidance_factor, wi[ch].clipping[w]);
-                } else {
-                    ics->window_clipping[w] = 0;
-                }
-            }
-            if (clip_avoidance_factor > CLIP_AVOIDANCE_FACTOR) {
-                ics->clip_avoidance_factor = CLIP_AVOIDANCE_FACTOR / clip_avoidance_factor;
-            } else {
-                ics->clip_avoidance_factor = 1.0f;
-            }
-
-            apply_window_and_mdct(s, sce, overlap);
+    args.windows        = windows;
+    args.have_lookahead = !!frame;
+    avctx->execute2(avctx, analyze_channel, &args, channel_ret, s->channels);
+    for (ch = 0; ch < s->channels; ch++)
+        if (channel_ret[ch] < 0)
+            return channel_ret[ch];
 
-            if (s->options.ltp && s->coder->update_ltp) {
-                s->coder->update_ltp(s, sce);
-                apply_window[sce->ics.window_sequence[0]](s->fdsp, sce, &sce->ltp_state[0]);
-                s->mdct1024_fn(s->mdct1024, sce->lcoeffs, sce->ret_buf, sizeof(float));
-            }
-
-            for (k = 0; k < 1024; k++) {
-                if (!(fabs(cpe->ch[ch].coeffs[k]) < 1E16)) { // Ensure headroom for energy calculation
-                    av_log(avctx, AV_LOG_ERROR, "Input contains (near) NaN/+-Inf\n");
-                    return AVERROR(EINVAL);
-                }
-            }
-            avoid_clipping(s, sce);
-        }
-        start_ch += chans;
-    }
     if ((ret = ff_alloc_packet(avctx, avpkt, 8192 * s->channels)) < 0)
         return ret;
     frame_bits = its = 0;
@@ -1186,11 +1214,15 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 static av_cold int aac_encode_end(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
+    int i;
 
     av_log(avctx, AV_LOG_INFO, "Qavg: %.3f\n", s->lambda_count ? s->lambda_sum / s->lambda_count : NAN);
 
-    av_tx_uninit(&s->mdct1024);
-    av_tx_uninit(&s->mdct128);
+    for (i = 0; i < s->nb_threads; i++) {
+        av_tx_uninit(&s->thread[i].mdct1024);
+        av_tx_uninit(&s->thread[i].mdct128);
+    }
+    av_freep(&s->thread);
     ff_psy_end(&s->psy);
     ff_lpc_end(&s->lpc);
     if (s->psypp)
@@ -1204,19 +1236,30 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
 
 static av_cold int dsp_init(AVCodecContext *avctx, AACEncContext *s)
 {
-    int ret = 0;
+    int i, nb_threads, ret = 0;
     float scale = 32768.0f;
 
     s->fdsp = avpriv_float_dsp_alloc(avctx->flags & AV_CODEC_FLAG_BITEXACT);
     if (!s->fdsp)
         return AVERROR(ENOMEM);
 
-    if ((ret = av_tx_init(&s->mdct1024, &s->mdct1024_fn, AV_TX_FLOAT_MDCT, 0,
-                          1024, &scale, 0)) < 0)
-        return ret;
-    if ((ret = av_tx_init(&s->mdct128, &s->mdct128_fn,   AV_TX_FLOAT_MDCT, 0,
-                          128, &scale, 0)) < 0)
-        return ret;
+    /* av_tx contexts may not be used concurrently, give each thread its own */
+    nb_threads = avctx->active_thread_type & FF_THREAD_SLICE ?
+                 FFMAX(avctx->thread_count, 1) : 1;
+    s->thread = av_calloc(nb_threads, sizeof(*s->thread));
+    if (!s->thread)
+        return AVERROR(ENOMEM);
+    s->nb_threads = nb_threads;
+
+    for (i = 0; i < s->nb_threads; i++) {
+        AACEncThreadContext *td = &s->thread[i];
+        if ((ret = av_tx_init(&td->mdct1024, &td->mdct1024_fn, AV_TX_FLOAT_MDCT, 0,
+                              1024, &scale, 0)) < 0)
+            return ret;
+        if ((ret = av_tx_init(&td->mdct128, &td->mdct128_fn,   AV_TX_FLOAT_MDCT, 0,
+                              128, &scale, 0)) < 0)
+            return ret;
+    }
 
     return 0;
 }
@@ -1424,7 +1467,7 @@ const FFCodec ff_aac_encoder = {
     .p.type         = AVMEDIA_TYPE_AUDIO,
     .p.id           = AV_CODEC_ID_AAC,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
-                      AV_CODEC_CAP_SMALL_LAST_FRAME,
+                      AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(AACEncContext),
     .init           = aac_encode_init,
     FF_CODEC_ENCODE_CB(aac_encode_frame),
@@ -160,7 +160,7 @@ typedef struct AACCoefficientsEncoder {
     void (*adjust_common_ltp)(struct AACEncContext *s, ChannelElement *cpe);
     void (*apply_main_pred)(struct AACEncContext *s, SingleChannelElement *sce);
     void (*apply_tns_filt)(struct AACEncContext *s, SingleChannelElement *sce);
-    void (*update_ltp)(struct AACEncContext *s, SingleChannelElement *sce);
+    void (*update_ltp)(struct AACEncContext *s, SingleChannelElement *sce, int channel);
     void (*ltp_insert_new_frame)(struct AACEncContext *s);
     void (*set_special_band_scalefactors)(struct AACEncContext *s, SingleChannelElement *sce);
     void (*search_for_pns)(struct AACEncContext *s, AVCodecContext *avctx, SingleChannelElement *sce);
@@ -192,6 +192,16 @@ typedef struct AACPCEInfo {
     uint8_t reorder_map[16];                     ///< maps channels from lavc to aac order
 } AACPCEInfo;
 
+/**
+ * Per-thread state of the channel-parallel windowing and MDCT stage
+ */
+typedef struct AACEncThreadContext {
+    AVTXContext *mdct1024;                       ///< long (1024 samples) frame transform context
+    av_tx_fn mdct1024_fn;
+    AVTXContext *mdct128;                        ///< short (128 samples) frame transform context
+    av_tx_fn mdct128_fn;
+} AACEncThreadContext;
+
 /**
  * AAC encoder context
  */
@@ -199,10 +209,8 @@ typedef struct AACEncContext {
     AVClass *av_class;
     AACEncOptions options;                       ///< encoding options
     PutBitContext pb;
-    AVTXContext *mdct1024;                       ///< long (1024 samples) frame transform context
-    av_tx_fn mdct1024_fn;
-    AVTXContext *mdct128;                        ///< short (128 samples) frame transform context
-    av_tx_fn mdct128_fn;
+    AACEncThreadContext *thread;                 ///< per-thread transform contexts
+    int nb_threads;                              ///< number of entries in thread
     AVFloatDSPContext *fdsp;
     AACPCEInfo pce;                              ///< PCE data, if needed
     float *planar_samples[16];                   ///< saved preprocessed input
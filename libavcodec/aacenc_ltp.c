@@ -114,10 +114,10 @@ static void generate_samples(float *buf, LongTermPrediction *ltp)
  * Process LTP parameters
  * @see Patent WO2006070265A1
  */
-void ff_aac_update_ltp(AACEncContext *s, SingleChannelElement *sce)
+void ff_aac_update_ltp(AACEncContext *s, SingleChannelElement *sce, int channel)
 {
     float *pred_signal = &sce->ltp_state[0];
-    const float *samples = &s->planar_samples[s->cur_channel][1024];
+    const float *samples = &s->planar_samples[channel][1024];
 
     if (s->profile != AV_PROFILE_AAC_LTP)
         return;
@@ -37,6 +37,7 @@
 #include "decode.h"
 #include "internal.h"
 #include "mlz.h"
+#include "thread.h"
 #include "libavutil/mem.h"
 #include "libavutil/samplefmt.h"
 #include "libavutil/crc.h"
@@ -1803,7 +1804,7 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *frame,
     ALSSpecificConfig *sconf = &ctx->sconf;
     const uint8_t *buffer    = avpkt->data;
     int buffer_size          = avpkt->size;
-    int invalid_frame, ret;
+    int invalid_frame, ret, crc_check, next_ra, early_next;
     int channels = avctx->ch_layout.nb_channels;
     unsigned int c, sample, ra_frame, bytes_read, shift;
 
@@ -1823,6 +1824,24 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *frame,
     else
         ctx->cur_frame_length = sconf->frame_length;
 
+    // With frame threading, the next frame can start right away if it is a
+    // random access frame and no running CRC has to be passed on to it.
+    // Otherwise it needs the carryover samples of this frame and setup is
+    // only finished once decoding is done.
+    crc_check  = sconf->crc_enabled && (avctx->err_recognition & (AV_EF_CRCCHECK|AV_EF_CAREFUL));
+    next_ra    = sconf->ra_distance && !((ctx->frame_id + 1) % sconf->ra_distance);
+    early_next = next_ra && !crc_check;
+
+    /* get output buffer, this has to happen before setup is finished */
+    frame->nb_samples = ctx->cur_frame_length;
+    if ((ret = ff_thread_get_buffer(avctx, frame, 0)) < 0)
+        return ret;
+
+    if (early_next) {
+        ctx->frame_id++;
+        ff_thread_finish_setup(avctx);
+    }
+
     ctx->highest_decoded_channel = -1;
     // decode the frame data
     if ((invalid_frame = read_frame_data(ctx, ra_frame)) < 0)
@@ -1835,12 +1854,8 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *frame,
         return AVERROR_INVALIDDATA;
     }
 
-    ctx->frame_id++;
-
-    /* get output buffer */
-    frame->nb_samples = ctx->cur_frame_length;
-    if ((ret = ff_get_buffer(avctx, frame, 0)) < 0)
-        return ret;
+    if (!early_next)
+        ctx->frame_id++;
 
     // transform decoded frame into output format
     #define INTERLEAVE_OUTPUT(bps)                                                   \
@@ -1867,7 +1882,7 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *frame,
     }
 
     // update CRC
-    if (sconf->crc_enabled && (avctx->err_recognition & (AV_EF_CRCCHECK|AV_EF_CAREFUL))) {
+    if (crc_check) {
         int swap = HAVE_BIGENDIAN != sconf->msb_first;
 
         if (ctx->avctx->bits_per_raw_sample == 24) {
@@ -2170,6 +2185,48 @@ static av_cold int decode_init(AVCodecContext *avctx)
 }
 
 
+#if HAVE_THREADS
+/** Pass the inter-frame state on to the thread decoding the next frame.
+ */
+static int update_thread_context(AVCodecContext *dst, const AVCodecContext *src)
+{
+    ALSDecContext *d = dst->priv_data;
+    const ALSDecContext *s = src->priv_data;
+    const ALSSpecificConfig *sconf = &s->sconf;
+    int channels = dst->ch_layout.nb_channels;
+
+    if (dst == src)
+        return 0;
+
+    d->frame_id = s->frame_id;
+    d->crc      = s->crc;
+
+    // random access frames do not use anything from the previous frame
+    if (sconf->ra_distance && !(s->frame_id % sconf->ra_distance))
+        return 0;
+
+    for (int c = 0; c < channels; c++)
+        memcpy(d->raw_samples[c] - sconf->max_order,
+               s->raw_samples[c] - sconf->max_order,
+               sizeof(*d->raw_samples[c]) * sconf->max_order);
+
+    if (sconf->floating) {
+        MLZDict *dict = d->mlz->dict;
+
+        memcpy(d->last_acf_mantissa, s->last_acf_mantissa,
+               channels * sizeof(*d->last_acf_mantissa));
+        memcpy(d->last_shift_value, s->last_shift_value,
+               channels * sizeof(*d->last_shift_value));
+        *d->mlz         = *s->mlz;
+        d->mlz->dict    = dict;
+        d->mlz->context = dst;
+        memcpy(d->mlz->dict, s->mlz->dict, TABLE_SIZE * sizeof(*d->mlz->dict));
+    }
+
+    return 0;
+}
+#endif
+
 /** Flush (reset) the frame ID after seeking.
  */
 static av_cold void flush(AVCodecContext *avctx)
@@ -2189,11 +2246,13 @@ const FFCodec ff_als_decoder = {
     .init           = decode_init,
     .close          = decode_end,
     FF_CODEC_DECODE_CB(decode_frame),
+    UPDATE_THREAD_CONTEXT(update_thread_context),
     .flush          = flush,
     .p.capabilities =
 #if FF_API_SUBFRAMES
                       AV_CODEC_CAP_SUBFRAMES |
 #endif
-                      AV_CODEC_CAP_DR1 | AV_CODEC_CAP_CHANNEL_CONF,
+                      AV_CODEC_CAP_DR1 | AV_CODEC_CAP_CHANNEL_CONF |
+                      AV_CODEC_CAP_FRAME_THREADS,
     .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
 };
@@ -34,6 +34,7 @@
 #include "codec_internal.h"
 #include "decode.h"
 #include "get_bits.h"
+#include "thread.h"
 #include "unary.h"
 
 /**
@@ -1619,7 +1620,9 @@ static int ape_decode_frame(AVCodecContext *avctx, AVFrame *frame,
     blockstodecode = FFMIN(s->blocks_per_loop, s->samples);
     // for old files coefficients were not interleaved,
     // so we need to decode all of them at once
-    if (s->fileversion < 3930)
+    // frames are independent, with frame threading each packet
+    // has to be decoded by a single call as well
+    if (s->fileversion < 3930 || avctx->active_thread_type & FF_THREAD_FRAME)
         blockstodecode = s->samples;
 
     /* reallocate decoded sample buffer if needed */
@@ -1628,7 +1631,7 @@ static int ape_decode_frame(AVCodecContext *avctx, AVFrame *frame,
 
     /* get output buffer */
     frame->nb_samples = blockstodecode;
-    if ((ret = ff_get_buffer(avctx, frame, 0)) < 0) {
+    if ((ret = ff_thread_get_buffer(avctx, frame, 0)) < 0) {
         s->samples=0;
         return ret;
     }
@@ -1764,7 +1767,8 @@ const FFCodec ff_ape_decoder = {
                       AV_CODEC_CAP_SUBFRAMES |
 #endif
                       AV_CODEC_CAP_DELAY |
-                      AV_CODEC_CAP_DR1,
+                      AV_CODEC_CAP_DR1 |
+                      AV_CODEC_CAP_FRAME_THREADS,
     .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
     .flush          = ape_flush,
     .p.sample_fmts  = (const enum AVSampleFormat[]) { AV_SAMPLE_FMT_U8P,
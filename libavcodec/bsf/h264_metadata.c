@@ -542,6 +542,17 @@ static int h264_metadata_update_fragment(AVBSFContext *bsf, AVPacket *pkt,
     return 0;
 }
 
+static const CodedBitstreamUnitType h264_metadata_sps_types[] = {
+    H264_NAL_SPS,
+};
+
+static const CodedBitstreamUnitType h264_metadata_slice_types[] = {
+    H264_NAL_SPS,
+    H264_NAL_PPS,
+    H264_NAL_SLICE,
+    H264_NAL_IDR_SLICE,
+};
+
 static const CBSBSFType h264_metadata_type = {
     .codec_id        = AV_CODEC_ID_H264,
     .fragment_name   = "access unit",
@@ -586,12 +597,29 @@ static int h264_metadata_init(AVBSFContext *bsf)
         }
     }
 
+    // SEI messages can depend on the active SPS, which is only known
+    // after reading the slices, so all units are decomposed in that case.
+    if (!ctx->sei_user_data && !ctx->delete_filler &&
+        ctx->display_orientation == BSF_ELEMENT_PASS) {
+        if (ctx->aud == BSF_ELEMENT_INSERT) {
+            ctx->common.decompose_unit_types    = h264_metadata_slice_types;
+            ctx->common.nb_decompose_unit_types =
+                FF_ARRAY_ELEMS(h264_metadata_slice_types);
+        } else {
+            ctx->common.decompose_unit_types    = h264_metadata_sps_types;
+            ctx->common.nb_decompose_unit_types =
+                FF_ARRAY_ELEMS(h264_metadata_sps_types);
+        }
+    }
+
     return ff_cbs_bsf_generic_init(bsf, &h264_metadata_type);
 }
 
 #define OFFSET(x) offsetof(H264MetadataContext, x)
 #define FLAGS (AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_BSF_PARAM)
 static const AVOption h264_metadata_options[] = {
+    CBS_BSF_DECOMPOSE_ALL_OPTION(FLAGS),
+
     BSF_ELEMENT_OPTIONS_PIR("aud", "Access Unit Delimiter NAL units",
                             aud, FLAGS),
 
@@ -397,14 +397,31 @@ static const CBSBSFType h265_metadata_type = {
     .update_fragment = &h265_metadata_update_fragment,
 };
 
+static const CodedBitstreamUnitType h265_metadata_ps_types[] = {
+    HEVC_NAL_VPS,
+    HEVC_NAL_SPS,
+    HEVC_NAL_PPS,
+};
+
 static int h265_metadata_init(AVBSFContext *bsf)
 {
+    H265MetadataContext *ctx = bsf->priv_data;
+
+    // The AUD is derived from the headers of all the NAL units.
+    if (ctx->aud != BSF_ELEMENT_INSERT) {
+        ctx->common.decompose_unit_types    = h265_metadata_ps_types;
+        ctx->common.nb_decompose_unit_types =
+            FF_ARRAY_ELEMS(h265_metadata_ps_types);
+    }
+
     return ff_cbs_bsf_generic_init(bsf, &h265_metadata_type);
 }
 
 #define OFFSET(x) offsetof(H265MetadataContext, x)
 #define FLAGS (AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_BSF_PARAM)
 static const AVOption h265_metadata_options[] = {
+    CBS_BSF_DECOMPOSE_ALL_OPTION(FLAGS),
+
     BSF_ELEMENT_OPTIONS_PIR("aud", "Access Unit Delimiter NAL units",
                             aud, FLAGS),
 
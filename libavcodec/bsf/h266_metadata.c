@@ -114,14 +114,27 @@ static const CBSBSFType h266_metadata_type = {
     .update_fragment = &h266_metadata_update_fragment,
 };
 
+// Empty list, so that no NAL units are decomposed.
+static const CodedBitstreamUnitType h266_metadata_no_types[1];
+
 static int h266_metadata_init(AVBSFContext *bsf)
 {
+    H266MetadataContext *ctx = bsf->priv_data;
+
+    // Only the AUD insertion looks at the content of the NAL units.
+    if (ctx->aud != BSF_ELEMENT_INSERT) {
+        ctx->common.decompose_unit_types    = h266_metadata_no_types;
+        ctx->common.nb_decompose_unit_types = 0;
+    }
+
     return ff_cbs_bsf_generic_init(bsf, &h266_metadata_type);
 }
 
 #define OFFSET(x) offsetof(H266MetadataContext, x)
 #define FLAGS (AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_BSF_PARAM)
 static const AVOption h266_metadata_options[] = {
+    CBS_BSF_DECOMPOSE_ALL_OPTION(FLAGS),
+
     BSF_ELEMENT_OPTIONS_PIR("aud", "Access Unit Delimiter NAL units",
                             aud, FLAGS),
 
@@ -175,6 +175,11 @@ static const CBSBSFType mpeg2_metadata_type = {
     .update_fragment = &mpeg2_metadata_update_fragment,
 };
 
+static const CodedBitstreamUnitType mpeg2_metadata_decompose_types[] = {
+    MPEG2_START_SEQUENCE_HEADER,
+    MPEG2_START_EXTENSION,
+};
+
 static int mpeg2_metadata_init(AVBSFContext *bsf)
 {
     MPEG2MetadataContext *ctx = bsf->priv_data;
@@ -191,12 +196,18 @@ static int mpeg2_metadata_init(AVBSFContext *bsf)
     VALIDITY_CHECK(matrix_coefficients);
 #undef VALIDITY_CHECK
 
+    ctx->common.decompose_unit_types    = mpeg2_metadata_decompose_types;
+    ctx->common.nb_decompose_unit_types =
+        FF_ARRAY_ELEMS(mpeg2_metadata_decompose_types);
+
     return ff_cbs_bsf_generic_init(bsf, &mpeg2_metadata_type);
 }
 
 #define OFFSET(x) offsetof(MPEG2MetadataContext, x)
 #define FLAGS (AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_BSF_PARAM)
 static const AVOption mpeg2_metadata_options[] = {
+    CBS_BSF_DECOMPOSE_ALL_OPTION(FLAGS),
+
     { "display_aspect_ratio", "Set display aspect ratio (table 6-3)",
         OFFSET(display_aspect_ratio), AV_OPT_TYPE_RATIONAL,
         { .dbl = 0.0 }, 0, 65535, FLAGS },
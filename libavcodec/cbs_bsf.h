@@ -57,6 +57,16 @@ typedef struct CBSBSFContext {
     CodedBitstreamContext *input;
     CodedBitstreamContext *output;
     CodedBitstreamFragment fragment;
+
+    // Unit types which update_fragment() needs in decomposed form, to be
+    // set before calling ff_cbs_bsf_generic_init().  Units of other types
+    // are passed through in bitstream form without being decomposed and
+    // rewritten.  If NULL, all units are decomposed.
+    const CodedBitstreamUnitType *decompose_unit_types;
+    int nb_decompose_unit_types;
+
+    // Option: decompose all units anyway, see CBS_BSF_DECOMPOSE_ALL_OPTION.
+    int decompose_all;
 } CBSBSFContext;
 
 /**
@@ -109,6 +119,14 @@ enum {
     BSF_ELEMENT_EXTRACT,
 };
 
+// Option to decompose and rewrite all units, even those which the filter
+// does not need to look at.  With no other options set, the filter is then
+// a full read/write round trip through CBS.
+#define CBS_BSF_DECOMPOSE_ALL_OPTION(opt_flags) \
+    { "decompose_all", "Decompose and rewrite all units", \
+        OFFSET(common.decompose_all), AV_OPT_TYPE_BOOL, \
+        { .i64 = 0 }, 0, 1, opt_flags }
+
 #define BSF_ELEMENT_OPTIONS_PIR(name, help, field, opt_flags) \
     { name, help, OFFSET(field), AV_OPT_TYPE_INT, \
         { .i64 = BSF_ELEMENT_PASS }, \
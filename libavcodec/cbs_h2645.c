@@ -1825,6 +1825,18 @@ static int cbs_h2645_assemble_fragment(CodedBitstreamContext *ctx,
 
         zero_run = 0;
         for (sp = 0; sp < unit->data_size; sp++) {
+            if (!zero_run) {
+                // Nothing to escape up to the next zero byte.
+                const uint8_t *zero = memchr(unit->data + sp, 0,
+                                             unit->data_size - sp);
+                size_t run = zero ? zero - (unit->data + sp)
+                                  : unit->data_size - sp;
+                memcpy(data + dp, unit->data + sp, run);
+                dp += run;
+                sp += run;
+                if (!zero)
+                    break;
+            }
             if (zero_run < 2) {
                 if (unit->data[sp] == 0)
                     ++zero_run;
@@ -33,6 +33,7 @@
 #include "codec_internal.h"
 #include "decode.h"
 #define  UNCHECKED_BITSTREAM_READER 1
+#define CACHED_BITSTREAM_READER !ARCH_X86_32
 #include "get_bits.h"
 #include "dnxhddata.h"
 #include "idctdsp.h"
@@ -368,7 +369,7 @@ static av_always_inline int dnxhd_decode_dct_block(const DNXHDContext *ctx,
     int16_t *block = row->blocks[n];
     const int eob_index     = ctx->cid_table->eob_index;
     int ret = 0;
-    OPEN_READER(bs, &row->gb);
+    GetBitContext gb = row->gb;
 
     ctx->bdsp.clear_block(block);
 
@@ -393,46 +394,32 @@ static av_always_inline int dnxhd_decode_dct_block(const DNXHDContext *ctx,
         }
     }
 
-    UPDATE_CACHE(bs, &row->gb);
-    GET_VLC(len, bs, &row->gb, ctx->dc_vlc.table, DNXHD_DC_VLC_BITS, 1);
+    len = get_vlc2(&gb, ctx->dc_vlc.table, DNXHD_DC_VLC_BITS, 1);
     if (len < 0) {
         ret = len;
         goto error;
     }
     if (len) {
-        level = GET_CACHE(bs, &row->gb);
-        LAST_SKIP_BITS(bs, &row->gb, len);
-        sign  = ~level >> 31;
-        level = (NEG_USR32(sign ^ level, len) ^ sign) - sign;
+        level = get_xbits(&gb, len);
         row->last_dc[component] += level * (1 << dc_shift);
     }
     block[0] = row->last_dc[component];
 
     i = 0;
 
-    UPDATE_CACHE(bs, &row->gb);
-    GET_VLC(index1, bs, &row->gb, ctx->ac_vlc.table,
-            DNXHD_VLC_BITS, 2);
+    index1 = get_vlc2(&gb, ctx->ac_vlc.table, DNXHD_VLC_BITS, 2);
 
     while (index1 != eob_index) {
         level = ac_info[2*index1+0];
         flags = ac_info[2*index1+1];
 
-        sign = SHOW_SBITS(bs, &row->gb, 1);
-        SKIP_BITS(bs, &row->gb, 1);
+        sign = -get_bits1(&gb);
 
-        if (flags & 1) {
-            level += SHOW_UBITS(bs, &row->gb, index_bits) << 7;
-            SKIP_BITS(bs, &row->gb, index_bits);
-        }
+        if (flags & 1)
+            level += get_bits(&gb, index_bits) << 7;
 
-        if (flags & 2) {
-            int run;
-            UPDATE_CACHE(bs, &row->gb);
-            GET_VLC(run, bs, &row->gb, ctx->run_vlc.table,
-                    DNXHD_VLC_BITS, 2);
-            i += run;
-        }
+        if (flags & 2)
+            i += get_vlc2(&gb, ctx->run_vlc.table, DNXHD_VLC_BITS, 2);
 
         if (++i > 63) {
             av_log(ctx->avctx, AV_LOG_ERROR, "ac tex damaged %d, %d\n", n, i);
@@ -449,12 +436,10 @@ static av_always_inline int dnxhd_decode_dct_block(const DNXHDContext *ctx,
 
         block[j] = (level ^ sign) - sign;
 
-        UPDATE_CACHE(bs, &row->gb);
-        GET_VLC(index1, bs, &row->gb, ctx->ac_vlc.table,
-                DNXHD_VLC_BITS, 2);
+        index1 = get_vlc2(&gb, ctx->ac_vlc.table, DNXHD_VLC_BITS, 2);
     }
 error:
-    CLOSE_READER(bs, &row->gb);
+    row->gb = gb;
     return ret;
 }
 
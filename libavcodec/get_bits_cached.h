@@ -0,0 +1,70 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Local cached bitstream readers for the hot loops of decoders whose
+ * GetBitContext is embedded in a context shared by many files, e.g.
+ * MpegEncContext or H264SliceContext. Building just one of those files with
+ * CACHED_BITSTREAM_READER would change the layout of the shared context, so
+ * instead the hot loops continue reading the GetBitContext with a local
+ * big-endian BitstreamContext and hand the position back afterwards.
+ */
+
+#ifndef AVCODEC_GET_BITS_CACHED_H
+#define AVCODEC_GET_BITS_CACHED_H
+
+#include "get_bits.h"
+
+#if CACHED_BITSTREAM_READER
+#error "get_bits_cached.h is only needed with the GetBitContext reader"
+#endif
+
+#define BITSTREAM_BE
+#include "bitstream.h"
+#undef BITSTREAM_BE
+
+/**
+ * Initialize bc to continue reading at the current position of gb.
+ */
+static av_always_inline void bits_init_from_gb(BitstreamContextBE *bc,
+                                               const GetBitContext *gb)
+{
+    int index = get_bits_count(gb);
+
+    bits_init_be(bc, gb->buffer + (index >> 3),
+                 FFMAX(gb->size_in_bits - (index & ~7), 0));
+    bits_skip_be(bc, index & 7);
+}
+
+/**
+ * Move gb to the current position of bc, which must have been initialized
+ * with bits_init_from_gb() on the same gb.
+ */
+static av_always_inline void bits_update_gb(GetBitContext *gb,
+                                            const BitstreamContextBE *bc)
+{
+    int index = (bc->buffer - gb->buffer) * 8 + bits_tell_be(bc);
+
+#if !UNCHECKED_BITSTREAM_READER
+    index = FFMIN(index, gb->size_in_bits_plus8);
+#endif
+    gb->index = index;
+}
+
+#endif /* AVCODEC_GET_BITS_CACHED_H */
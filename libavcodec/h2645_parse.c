@@ -22,68 +22,47 @@
 
 #include "config.h"
 
+#include "libavutil/attributes.h"
 #include "libavutil/intmath.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mem.h"
+#include "libavutil/thread.h"
 
 #include "bytestream.h"
 #include "hevc.h"
 #include "h264.h"
 #include "h2645_parse.h"
+#include "startcode.h"
 #include "vvc.h"
 
+static StartcodeDSPContext startcode_dsp;
+static AVOnce startcode_dsp_once = AV_ONCE_INIT;
+
+static av_cold void init_startcode_dsp(void)
+{
+    ff_startcode_dsp_init(&startcode_dsp);
+}
+
 int ff_h2645_extract_rbsp(const uint8_t *src, int length,
                           H2645RBSP *rbsp, H2645NAL *nal, int small_padding)
 {
     int i, si, di;
     uint8_t *dst;
 
+    ff_thread_once(&startcode_dsp_once, init_startcode_dsp);
+
     nal->skipped_bytes = 0;
-#define STARTCODE_TEST                                                  \
-        if (i + 2 < length && src[i + 1] == 0 &&                        \
-           (src[i + 2] == 3 || src[i + 2] == 1)) {                      \
-            if (src[i + 2] == 1) {                                      \
-                /* startcode, so we must be past the end */             \
-                length = i;                                             \
-            }                                                           \
-            break;                                                      \
-        }
-#if HAVE_FAST_UNALIGNED
-#define FIND_FIRST_ZERO                                                 \
-        if (i > 0 && !src[i])                                           \
-            i--;                                                        \
-        while (src[i])                                                  \
-            i++
-#if HAVE_FAST_64BIT
-    for (i = 0; i + 1 < length; i += 9) {
-        if (!((~AV_RN64(src + i) &
-               (AV_RN64(src + i) - 0x0100010001000101ULL)) &
-              0x8000800080008080ULL))
-            continue;
-        FIND_FIRST_ZERO;
-        STARTCODE_TEST;
-        i -= 7;
-    }
-#else
-    for (i = 0; i + 1 < length; i += 5) {
-        if (!((~AV_RN32(src + i) &
-               (AV_RN32(src + i) - 0x01000101U)) &
-              0x80008080U))
-            continue;
-        FIND_FIRST_ZERO;
-        STARTCODE_TEST;
-        i -= 3;
+
+    /* find the first escape or start code, 0x000002 is not special here */
+    for (i = 0;; i++) {
+        i += startcode_dsp.find_escape(src + i, length - i);
+        if (i >= length || src[i + 2] != 2)
+            break;
     }
-#endif /* HAVE_FAST_64BIT */
-#else
-    for (i = 0; i + 1 < length; i += 2) {
-        if (src[i])
-            continue;
-        if (i > 0 && src[i - 1] == 0)
-            i--;
-        STARTCODE_TEST;
+    if (i < length && src[i + 2] == 1) {
+        /* startcode, so we must be past the end */
+        length = i;
     }
-#endif /* HAVE_FAST_UNALIGNED */
 
     if (i >= length - 1 && small_padding) { // no escaped 0
         nal->data     =
@@ -99,38 +78,37 @@ int ff_h2645_extract_rbsp(const uint8_t *src, int length,
     memcpy(dst, src, i);
     si = di = i;
     while (si + 2 < length) {
-        // remove escapes (very rare 1:2^22)
-        if (src[si + 2] > 3) {
-            dst[di++] = src[si++];
-            dst[di++] = src[si++];
-        } else if (src[si] == 0 && src[si + 1] == 0 && src[si + 2] != 0) {
-            if (src[si + 2] == 3) { // escape
-                dst[di++] = 0;
-                dst[di++] = 0;
-                si       += 3;
-
-                if (nal->skipped_bytes_pos) {
-                    nal->skipped_bytes++;
-                    if (nal->skipped_bytes_pos_size < nal->skipped_bytes) {
-                        nal->skipped_bytes_pos_size *= 2;
-                        av_assert0(nal->skipped_bytes_pos_size >= nal->skipped_bytes);
-                        av_reallocp_array(&nal->skipped_bytes_pos,
-                                nal->skipped_bytes_pos_size,
-                                sizeof(*nal->skipped_bytes_pos));
-                        if (!nal->skipped_bytes_pos) {
-                            nal->skipped_bytes_pos_size = 0;
-                            return AVERROR(ENOMEM);
-                        }
-                    }
-                    if (nal->skipped_bytes_pos)
-                        nal->skipped_bytes_pos[nal->skipped_bytes-1] = di - 1;
+        // copy everything up to the next escape (very rare 1:2^22)
+        int n = startcode_dsp.find_escape(src + si, length - si);
+
+        memcpy(dst + di, src + si, n);
+        si += n;
+        di += n;
+        if (si + 2 >= length)
+            break;
+        if (src[si + 2] != 3) // next start code
+            goto nsc;
+
+        dst[di++] = 0;
+        dst[di++] = 0;
+        si       += 3;
+
+        if (nal->skipped_bytes_pos) {
+            nal->skipped_bytes++;
+            if (nal->skipped_bytes_pos_size < nal->skipped_bytes) {
+                nal->skipped_bytes_pos_size *= 2;
+                av_assert0(nal->skipped_bytes_pos_size >= nal->skipped_bytes);
+                av_reallocp_array(&nal->skipped_bytes_pos,
+                        nal->skipped_bytes_pos_size,
+                        sizeof(*nal->skipped_bytes_pos));
+                if (!nal->skipped_bytes_pos) {
+                    nal->skipped_bytes_pos_size = 0;
+                    return AVERROR(ENOMEM);
                 }
-                continue;
-            } else // next start code
-                goto nsc;
+            }
+            if (nal->skipped_bytes_pos)
+                nal->skipped_bytes_pos[nal->skipped_bytes-1] = di - 1;
         }
-
-        dst[di++] = src[si++];
     }
     while (si < length)
         dst[di++] = src[si++];
@@ -401,17 +379,19 @@ static int h264_parse_nal_header(H2645NAL *nal, void *logctx)
 
 static int find_next_start_code(const uint8_t *buf, const uint8_t *next_avc)
 {
+    int size = next_avc - buf;
     int i = 0;
 
-    if (buf + 3 >= next_avc)
-        return next_avc - buf;
+    if (size <= 3)
+        return size;
 
-    while (buf + i + 3 < next_avc) {
-        if (buf[i] == 0 && buf[i + 1] == 0 && buf[i + 2] == 1)
+    /* the start code must be followed by at least one byte */
+    for (;; i++) {
+        i += startcode_dsp.find_escape(buf + i, size - 1 - i);
+        if (i + 3 >= size || buf[i + 2] == 1)
             break;
-        i++;
     }
-    return i + 3;
+    return FFMIN(i + 3, size);
 }
 
 static void alloc_rbsp_buffer(H2645RBSP *rbsp, unsigned int size, int use_ref)
@@ -470,6 +450,8 @@ int ff_h2645_packet_split(H2645Packet *pkt, const uint8_t *buf, int length,
     int next_avc = is_nalff ? 0 : length;
     int64_t padding = small_padding ? 0 : MAX_MBPAIR_SIZE;
 
+    ff_thread_once(&startcode_dsp_once, init_startcode_dsp);
+
     bytestream2_init(&bc, buf, length);
     alloc_rbsp_buffer(&pkt->rbsp, length + padding, use_ref);
 
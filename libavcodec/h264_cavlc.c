@@ -31,6 +31,7 @@
 #include "h264dec.h"
 #include "h264_mvpred.h"
 #include "h264data.h"
+#include "get_bits_cached.h"
 #include "golomb.h"
 #include "mpegutils.h"
 #include "libavutil/avassert.h"
@@ -379,18 +380,15 @@ av_cold void ff_h264_decode_init_vlc(void)
     init_cavlc_level_tab();
 }
 
-static inline int get_level_prefix(GetBitContext *gb){
+static inline int get_level_prefix(BitstreamContext *bc){
     unsigned int buf;
     int log;
 
-    OPEN_READER(re, gb);
-    UPDATE_CACHE(re, gb);
-    buf=GET_CACHE(re, gb);
+    buf = bits_peek(bc, 32);
 
     log= 32 - av_log2(buf);
 
-    LAST_SKIP_BITS(re, gb, log);
-    CLOSE_READER(re, gb);
+    bits_skip(bc, log);
 
     return log-1;
 }
@@ -407,33 +405,39 @@ static int decode_residual(const H264Context *h, H264SliceContext *sl,
                            const uint8_t *scantable, const uint32_t *qmul,
                            int max_coeff)
 {
+    BitstreamContext bc;
     int level[16];
     int zeros_left, coeff_token, total_coeff, i, trailing_ones, run_before;
 
     //FIXME put trailing_onex into the context
 
+    bits_init_from_gb(&bc, gb);
+
     if(max_coeff <= 8){
         if (max_coeff == 4)
-            coeff_token = get_vlc2(gb, chroma_dc_coeff_token_vlc_table,
-                                   CHROMA_DC_COEFF_TOKEN_VLC_BITS, 1);
+            coeff_token = bits_read_vlc(&bc, chroma_dc_coeff_token_vlc_table,
+                                        CHROMA_DC_COEFF_TOKEN_VLC_BITS, 1);
         else
-            coeff_token = get_vlc2(gb, chroma422_dc_coeff_token_vlc_table,
-                                   CHROMA422_DC_COEFF_TOKEN_VLC_BITS, 1);
+            coeff_token = bits_read_vlc(&bc, chroma422_dc_coeff_token_vlc_table,
+                                        CHROMA422_DC_COEFF_TOKEN_VLC_BITS, 1);
     }else{
         total_coeff = pred_non_zero_count(h, sl, n >= LUMA_DC_BLOCK_INDEX ?
                                                  (n - LUMA_DC_BLOCK_INDEX) * 16 : n);
-        coeff_token = get_vlc2(gb, coeff_token_vlc[total_coeff],
-                               COEFF_TOKEN_VLC_BITS, 2);
+        coeff_token = bits_read_vlc(&bc, coeff_token_vlc[total_coeff],
+                                    COEFF_TOKEN_VLC_BITS, 2);
     }
     total_coeff = coeff_token >> 2;
     sl->non_zero_count_cache[scan8[n]] = total_coeff;
 
     //FIXME set last_non_zero?
 
-    if(total_coeff==0)
+    if(total_coeff==0) {
+        bits_update_gb(gb, &bc);
         return 0;
+    }
     if(total_coeff > (unsigned)max_coeff) {
         av_log(h->avctx, AV_LOG_ERROR, "corrupted macroblock %d %d (total_coeff=%d)\n", sl->mb_x, sl->mb_y, total_coeff);
+        bits_update_gb(gb, &bc);
         return -1;
     }
 
@@ -441,8 +445,8 @@ static int decode_residual(const H264Context *h, H264SliceContext *sl,
     ff_tlog(h->avctx, "trailing:%d, total:%d\n", trailing_ones, total_coeff);
     av_assert2(total_coeff<=16);
 
-    i = show_bits(gb, 3);
-    skip_bits(gb, trailing_ones);
+    i = bits_peek(&bc, 3);
+    bits_skip(&bc, trailing_ones);
     level[0] = 1-((i&4)>>1);
     level[1] = 1-((i&2)   );
     level[2] = 1-((i&1)<<1);
@@ -450,36 +454,37 @@ static int decode_residual(const H264Context *h, H264SliceContext *sl,
     if(trailing_ones<total_coeff) {
         int mask, prefix;
         int suffix_length = total_coeff > 10 & trailing_ones < 3;
-        int bitsi= show_bits(gb, LEVEL_TAB_BITS);
+        int bitsi= bits_peek(&bc, LEVEL_TAB_BITS);
         int level_code= cavlc_level_tab[suffix_length][bitsi][0];
 
-        skip_bits(gb, cavlc_level_tab[suffix_length][bitsi][1]);
+        bits_skip(&bc, cavlc_level_tab[suffix_length][bitsi][1]);
         if(level_code >= 100){
             prefix= level_code - 100;
             if(prefix == LEVEL_TAB_BITS)
-                prefix += get_level_prefix(gb);
+                prefix += get_level_prefix(&bc);
 
             //first coefficient has suffix_length equal to 0 or 1
             if(prefix<14){ //FIXME try to build a large unified VLC table for all this
                 if(suffix_length)
-                    level_code= (prefix<<1) + get_bits1(gb); //part
+                    level_code= (prefix<<1) + bits_read_bit(&bc); //part
                 else
                     level_code= prefix; //part
             }else if(prefix==14){
                 if(suffix_length)
-                    level_code= (prefix<<1) + get_bits1(gb); //part
+                    level_code= (prefix<<1) + bits_read_bit(&bc); //part
                 else
-                    level_code= prefix + get_bits(gb, 4); //part
+                    level_code= prefix + bits_read(&bc, 4); //part
             }else{
                 level_code= 30;
                 if(prefix>=16){
                     if(prefix > 25+3){
                         av_log(h->avctx, AV_LOG_ERROR, "Invalid level prefix\n");
+                        bits_update_gb(gb, &bc);
                         return -1;
                     }
                     level_code += (1<<(prefix-3))-4096;
                 }
-                level_code += get_bits(gb, prefix-3); //part
+                level_code += bits_read(&bc, prefix-3); //part
             }
 
             if(trailing_ones < 3) level_code += 2;
@@ -497,27 +502,28 @@ static int decode_residual(const H264Context *h, H264SliceContext *sl,
         //remaining coefficients have suffix_length > 0
         for(i=trailing_ones+1;i<total_coeff;i++) {
             static const unsigned int suffix_limit[7] = {0,3,6,12,24,48,INT_MAX };
-            int bitsi= show_bits(gb, LEVEL_TAB_BITS);
+            int bitsi= bits_peek(&bc, LEVEL_TAB_BITS);
             level_code= cavlc_level_tab[suffix_length][bitsi][0];
 
-            skip_bits(gb, cavlc_level_tab[suffix_length][bitsi][1]);
+            bits_skip(&bc, cavlc_level_tab[suffix_length][bitsi][1]);
             if(level_code >= 100){
                 prefix= level_code - 100;
                 if(prefix == LEVEL_TAB_BITS){
-                    prefix += get_level_prefix(gb);
+                    prefix += get_level_prefix(&bc);
                 }
                 if(prefix<15){
-                    level_code = (prefix<<suffix_length) + get_bits(gb, suffix_length);
+                    level_code = (prefix<<suffix_length) + bits_read(&bc, suffix_length);
                 }else{
                     level_code = 15<<suffix_length;
                     if (prefix>=16) {
                         if(prefix > 25+3){
                             av_log(h->avctx, AV_LOG_ERROR, "Invalid level prefix\n");
+                            bits_update_gb(gb, &bc);
                             return AVERROR_INVALIDDATA;
                         }
                         level_code += (1<<(prefix-3))-4096;
                     }
-                    level_code += get_bits(gb, prefix-3);
+                    level_code += bits_read(&bc, prefix-3);
                 }
                 mask= -(level_code&1);
                 level_code= (((2+level_code)>>1) ^ mask) - mask;
@@ -532,14 +538,14 @@ static int decode_residual(const H264Context *h, H264SliceContext *sl,
     else{
         if (max_coeff <= 8) {
             if (max_coeff == 4)
-                zeros_left = get_vlc2(gb, chroma_dc_total_zeros_vlc[total_coeff],
-                                      CHROMA_DC_TOTAL_ZEROS_VLC_BITS, 1);
+                zeros_left = bits_read_vlc(&bc, chroma_dc_total_zeros_vlc[total_coeff],
+                                           CHROMA_DC_TOTAL_ZEROS_VLC_BITS, 1);
             else
-                zeros_left = get_vlc2(gb, chroma422_dc_total_zeros_vlc[total_coeff],
-                                      CHROMA422_DC_TOTAL_ZEROS_VLC_BITS, 1);
+                zeros_left = bits_read_vlc(&bc, chroma422_dc_total_zeros_vlc[total_coeff],
+                                           CHROMA422_DC_TOTAL_ZEROS_VLC_BITS, 1);
         } else {
-            zeros_left = get_vlc2(gb, total_zeros_vlc[total_coeff],
-                                  TOTAL_ZEROS_VLC_BITS, 1);
+            zeros_left = bits_read_vlc(&bc, total_zeros_vlc[total_coeff],
+                                       TOTAL_ZEROS_VLC_BITS, 1);
         }
     }
 
@@ -549,9 +555,9 @@ static int decode_residual(const H264Context *h, H264SliceContext *sl,
         ((type*)block)[*scantable] = level[0]; \
         for(i=1;i<total_coeff && zeros_left > 0;i++) { \
             if(zeros_left < 7) \
-                run_before = get_vlc2(gb, run_vlc[zeros_left], RUN_VLC_BITS, 1); \
+                run_before = bits_read_vlc(&bc, run_vlc[zeros_left], RUN_VLC_BITS, 1); \
             else \
-                run_before = get_vlc2(gb, run7_vlc_table, RUN7_VLC_BITS, 2); \
+                run_before = bits_read_vlc(&bc, run7_vlc_table, RUN7_VLC_BITS, 2); \
             zeros_left -= run_before; \
             scantable -= 1 + run_before; \
             ((type*)block)[*scantable]= level[i]; \
@@ -564,9 +570,9 @@ static int decode_residual(const H264Context *h, H264SliceContext *sl,
         ((type*)block)[*scantable] = ((int)(level[0] * qmul[*scantable] + 32))>>6; \
         for(i=1;i<total_coeff && zeros_left > 0;i++) { \
             if(zeros_left < 7) \
-                run_before = get_vlc2(gb, run_vlc[zeros_left], RUN_VLC_BITS, 1); \
+                run_before = bits_read_vlc(&bc, run_vlc[zeros_left], RUN_VLC_BITS, 1); \
             else \
-                run_before = get_vlc2(gb, run7_vlc_table, RUN7_VLC_BITS, 2); \
+                run_before = bits_read_vlc(&bc, run7_vlc_table, RUN7_VLC_BITS, 2); \
             zeros_left -= run_before; \
             scantable -= 1 + run_before; \
             ((type*)block)[*scantable]= ((int)(level[i] * qmul[*scantable] + 32))>>6; \
@@ -585,9 +591,12 @@ static int decode_residual(const H264Context *h, H264SliceContext *sl,
 
     if(zeros_left<0){
         av_log(h->avctx, AV_LOG_ERROR, "negative number of zero coeffs at %d %d\n", sl->mb_x, sl->mb_y);
+        bits_update_gb(gb, &bc);
         return -1;
     }
 
+    bits_update_gb(gb, &bc);
+
     return 0;
 }
 
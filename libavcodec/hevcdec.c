@@ -3222,9 +3222,13 @@ static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
     for (i = 0; i < s->pkt.nb_nals; i++) {
         H2645NAL *nal = &s->pkt.nals[i];
 
+        // sub-layer non-reference pictures may still be referenced by
+        // pictures in higher temporal sub-layers
         if (s->avctx->skip_frame >= AVDISCARD_ALL ||
             (s->avctx->skip_frame >= AVDISCARD_NONREF
-            && ff_hevc_nal_is_nonref(nal->type)) || nal->nuh_layer_id > 0)
+            && ff_hevc_nal_is_nonref(nal->type) && s->ps.sps &&
+            nal->temporal_id == s->ps.sps->max_sub_layers - 1) ||
+            nal->nuh_layer_id > 0)
             continue;
 
         ret = decode_nal_unit(s, nal);
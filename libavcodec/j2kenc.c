@@ -109,6 +109,12 @@ typedef struct {
    double *layer_rates;
 } Jpeg2000Tile;
 
+/** a row of code-blocks of one band, the unit of tier-1 slice threading */
+typedef struct {
+    int compno, reslevelno, bandno;
+    int cblky;
+} Jpeg2000CblkRow;
+
 typedef struct {
     AVClass *class;
     AVCodecContext *avctx;
@@ -144,6 +150,10 @@ typedef struct {
     int prog;
     int nlayers;
     char *lr_str;
+
+    Jpeg2000T1Context *t1;        ///< one tier-1 context per slice thread
+    Jpeg2000CblkRow *cblk_rows;   ///< code-block rows of the current tile
+    unsigned int cblk_rows_size;
 } Jpeg2000EncoderContext;
 
 
@@ -1401,85 +1411,120 @@ static void truncpasses(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile)
     }
 }
 
+static int encode_dwt(AVCodecContext *avctx, void *arg, int compno, int threadnr)
+{
+    Jpeg2000Component *comp = ((Jpeg2000Tile *)arg)->comp + compno;
+
+    return ff_dwt_encode(&comp->dwt, comp->i_data);
+}
+
+static int encode_cblk_row(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    Jpeg2000EncoderContext *s = avctx->priv_data;
+    Jpeg2000Tile *tile = arg;
+    Jpeg2000T1Context *t1 = s->t1 + threadnr;
+    Jpeg2000CodingStyle *codsty = &s->codsty;
+    const Jpeg2000CblkRow *row = s->cblk_rows + jobnr;
+    Jpeg2000Component *comp = tile->comp + row->compno;
+    Jpeg2000ResLevel *reslevel = comp->reslevel + row->reslevelno;
+    Jpeg2000Band *band = reslevel->band + row->bandno;
+    Jpeg2000Prec *prec = band->prec; // we support only 1 precinct per band ATM in the encoder
+    int bandpos = row->bandno + (row->reslevelno > 0);
+    int cblkx, cblkno = row->cblky * prec->nb_codeblocks_width;
+    int xx0, x0, xx1, y0, yy0, yy1, start;
+
+    y0 = row->bandno == 0 ? 0 : comp->reslevel[row->reslevelno-1].coord[1][1] - comp->reslevel[row->reslevelno-1].coord[1][0];
+    start = ((band->coord[1][0] >> band->log2_cblk_height) + row->cblky) << band->log2_cblk_height;
+    yy0 = FFMAX(start, band->coord[1][0]) - band->coord[1][0] + y0;
+    yy1 = FFMIN(start + (1 << band->log2_cblk_height), band->coord[1][1]) - band->coord[1][0] + y0;
+
+    if (row->reslevelno == 0 || row->bandno == 1)
+        xx0 = 0;
+    else
+        xx0 = comp->reslevel[row->reslevelno-1].coord[0][1] - comp->reslevel[row->reslevelno-1].coord[0][0];
+    x0 = xx0;
+    xx1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[0][0] + 1, band->log2_cblk_width) << band->log2_cblk_width,
+                band->coord[0][1]) - band->coord[0][0] + xx0;
+
+    for (cblkx = 0; cblkx < prec->nb_codeblocks_width; cblkx++, cblkno++){
+        int y, x;
+        if (codsty->transform == FF_DWT53){
+            for (y = yy0; y < yy1; y++){
+                int *ptr = t1->data + (y-yy0)*t1->stride;
+                for (x = xx0; x < xx1; x++){
+                    *ptr++ = comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] * (1 << NMSEDEC_FRACBITS);
+                }
+            }
+        } else{
+            for (y = yy0; y < yy1; y++){
+                int *ptr = t1->data + (y-yy0)*t1->stride;
+                for (x = xx0; x < xx1; x++){
+                    *ptr = (comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x]);
+                    *ptr = (int64_t)*ptr * (int64_t)(16384 * 65536 / band->i_stepsize) >> 15 - NMSEDEC_FRACBITS;
+                    ptr++;
+                }
+            }
+        }
+        encode_cblk(s, t1, prec->cblk + cblkno, tile, xx1 - xx0, yy1 - yy0,
+                    bandpos, codsty->nreslevels - row->reslevelno - 1);
+        xx0 = xx1;
+        xx1 = FFMIN(xx1 + (1 << band->log2_cblk_width), band->coord[0][1] - band->coord[0][0] + x0);
+    }
+    return 0;
+}
+
 static int encode_tile(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile, int tileno)
 {
-    int compno, reslevelno, bandno, ret;
-    Jpeg2000T1Context t1;
+    int compno, reslevelno, bandno, ret, nb_rows = 0;
     Jpeg2000CodingStyle *codsty = &s->codsty;
-    for (compno = 0; compno < s->ncomponents; compno++){
-        Jpeg2000Component *comp = s->tile[tileno].comp + compno;
+    int dwt_ret[4];
 
-        t1.stride = (1<<codsty->log2_cblk_width) + 2;
+    av_log(s->avctx, AV_LOG_DEBUG,"dwt\n");
+    s->avctx->execute2(s->avctx, encode_dwt, tile, dwt_ret, s->ncomponents);
+    for (compno = 0; compno < s->ncomponents; compno++)
+        if (dwt_ret[compno] < 0)
+            return dwt_ret[compno];
+    av_log(s->avctx, AV_LOG_DEBUG,"after dwt -> tier1\n");
 
-        av_log(s->avctx, AV_LOG_DEBUG,"dwt\n");
-        if ((ret = ff_dwt_encode(&comp->dwt, comp->i_data)) < 0)
-            return ret;
-        av_log(s->avctx, AV_LOG_DEBUG,"after dwt -> tier1\n");
+    // allocate the code-blocks and collect the rows to be coded in parallel
+    for (compno = 0; compno < s->ncomponents; compno++){
+        Jpeg2000Component *comp = tile->comp + compno;
 
         for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
             Jpeg2000ResLevel *reslevel = comp->reslevel + reslevelno;
 
             for (bandno = 0; bandno < reslevel->nbands ; bandno++){
                 Jpeg2000Band *band = reslevel->band + bandno;
-                Jpeg2000Prec *prec = band->prec; // we support only 1 precinct per band ATM in the encoder
-                int cblkx, cblky, cblkno=0, xx0, x0, xx1, y0, yy0, yy1, bandpos;
-                yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
-                y0 = yy0;
-                yy1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[1][0] + 1, band->log2_cblk_height) << band->log2_cblk_height,
-                            band->coord[1][1]) - band->coord[1][0] + yy0;
+                Jpeg2000Prec *prec = band->prec;
+                Jpeg2000CblkRow *rows;
+                int cblkno, cblky;
 
                 if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
                     continue;
 
-                bandpos = bandno + (reslevelno > 0);
-
-                for (cblky = 0; cblky < prec->nb_codeblocks_height; cblky++){
-                    if (reslevelno == 0 || bandno == 1)
-                        xx0 = 0;
-                    else
-                        xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
-                    x0 = xx0;
-                    xx1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[0][0] + 1, band->log2_cblk_width) << band->log2_cblk_width,
-                                band->coord[0][1]) - band->coord[0][0] + xx0;
-
-                    for (cblkx = 0; cblkx < prec->nb_codeblocks_width; cblkx++, cblkno++){
-                        int y, x;
-                        if (codsty->transform == FF_DWT53){
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data + (y-yy0)*t1.stride;
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr++ = comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] * (1 << NMSEDEC_FRACBITS);
-                                }
-                            }
-                        } else{
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data + (y-yy0)*t1.stride;
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr = (comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x]);
-                                    *ptr = (int64_t)*ptr * (int64_t)(16384 * 65536 / band->i_stepsize) >> 15 - NMSEDEC_FRACBITS;
-                                    ptr++;
-                                }
-                            }
-                        }
-                        if (!prec->cblk[cblkno].data)
-                            prec->cblk[cblkno].data = av_malloc(1 + 8192);
-                        if (!prec->cblk[cblkno].passes)
-                            prec->cblk[cblkno].passes = av_malloc_array(JPEG2000_MAX_PASSES, sizeof (*prec->cblk[cblkno].passes));
-                        if (!prec->cblk[cblkno].data || !prec->cblk[cblkno].passes)
-                            return AVERROR(ENOMEM);
-                        encode_cblk(s, &t1, prec->cblk + cblkno, tile, xx1 - xx0, yy1 - yy0,
-                                    bandpos, codsty->nreslevels - reslevelno - 1);
-                        xx0 = xx1;
-                        xx1 = FFMIN(xx1 + (1 << band->log2_cblk_width), band->coord[0][1] - band->coord[0][0] + x0);
-                    }
-                    yy0 = yy1;
-                    yy1 = FFMIN(yy1 + (1 << band->log2_cblk_height), band->coord[1][1] - band->coord[1][0] + y0);
+                for (cblkno = 0; cblkno < prec->nb_codeblocks_width * prec->nb_codeblocks_height; cblkno++){
+                    if (!prec->cblk[cblkno].data)
+                        prec->cblk[cblkno].data = av_malloc(1 + 8192);
+                    if (!prec->cblk[cblkno].passes)
+                        prec->cblk[cblkno].passes = av_malloc_array(JPEG2000_MAX_PASSES, sizeof (*prec->cblk[cblkno].passes));
+                    if (!prec->cblk[cblkno].data || !prec->cblk[cblkno].passes)
+                        return AVERROR(ENOMEM);
                 }
+
+                rows = av_fast_realloc(s->cblk_rows, &s->cblk_rows_size,
+                                       (nb_rows + prec->nb_codeblocks_height) * sizeof(*rows));
+                if (!rows)
+                    return AVERROR(ENOMEM);
+                s->cblk_rows = rows;
+                for (cblky = 0; cblky < prec->nb_codeblocks_height; cblky++)
+                    s->cblk_rows[nb_rows++] = (Jpeg2000CblkRow){ compno, reslevelno, bandno, cblky };
             }
         }
-        av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
     }
 
+    s->avctx->execute2(s->avctx, encode_cblk_row, tile, NULL, nb_rows);
+    av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
+
     av_log(s->avctx, AV_LOG_DEBUG, "rate control\n");
     if (s->compression_rate_enc)
         makelayers(s, tile);
@@ -1782,6 +1827,12 @@ static av_cold int j2kenc_init(AVCodecContext *avctx)
         }
     }
 
+    s->t1 = av_calloc(FFMAX(avctx->thread_count, 1), sizeof(*s->t1));
+    if (!s->t1)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < FFMAX(avctx->thread_count, 1); i++)
+        s->t1[i].stride = (1<<codsty->log2_cblk_width) + 2;
+
     ff_thread_once(&init_static_once, init_luts);
 
     init_quantization(s);
@@ -1798,6 +1849,8 @@ static int j2kenc_destroy(AVCodecContext *avctx)
     Jpeg2000EncoderContext *s = avctx->priv_data;
 
     cleanup(s);
+    av_freep(&s->t1);
+    av_freep(&s->cblk_rows);
     return 0;
 }
 
@@ -1839,7 +1892,7 @@ const FFCodec ff_jpeg2000_encoder = {
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_JPEG2000,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE |
-                      AV_CODEC_CAP_FRAME_THREADS,
+                      AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(Jpeg2000EncoderContext),
     .init           = j2kenc_init,
     FF_CODEC_ENCODE_CB(encode_frame),
@@ -125,6 +125,7 @@ typedef struct Jpeg2000T1Context {
     uint16_t flags[6156];
     MqcState mqc;
     int stride;
+    uint8_t *ht_buf; ///< scratch buffer of the HT block decoder, allocated on first use
 } Jpeg2000T1Context;
 
 typedef struct Jpeg2000TgtNode {
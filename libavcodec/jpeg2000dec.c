@@ -1890,7 +1890,9 @@ static inline int tile_codeblocks(const Jpeg2000DecoderContext *s, Jpeg2000Tile
 {
     Jpeg2000T1Context t1;
 
-    int compno, reslevelno, bandno;
+    int compno, reslevelno, bandno, err = 0;
+
+    t1.ht_buf = NULL;
 
     /* Loop on tile components */
     for (compno = 0; compno < s->ncomponents; compno++) {
@@ -1922,7 +1924,8 @@ static inline int tile_codeblocks(const Jpeg2000DecoderContext *s, Jpeg2000Tile
 
                 if ((codsty->cblk_style & JPEG2000_CTSY_HTJ2K_F) && magp >= 31) {
                     avpriv_request_sample(s->avctx, "JPEG2000_CTSY_HTJ2K_F and magp >= 31");
-                    return AVERROR_PATCHWELCOME;
+                    err = AVERROR_PATCHWELCOME;
+                    goto end;
                 }
 
                 nb_precincts = rlevel->num_precincts_x * rlevel->num_precincts_y;
@@ -1974,7 +1977,9 @@ static inline int tile_codeblocks(const Jpeg2000DecoderContext *s, Jpeg2000Tile
             ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
 
     } /*end comp */
-    return 0;
+end:
+    av_freep(&t1.ht_buf);
+    return err;
 }
 
 #define WRITE_FRAME(D, PIXEL)                                                                     \
@@ -90,11 +90,21 @@ static void rct_int(void *_src0, void *_src1, void *_src2, int csize)
     }
 }
 
+static void ht_sign_mag(int32_t *dst, const int32_t *src, int len, int shift)
+{
+    for (int i = 0; i < len; i++) {
+        int32_t val = src[i];
+        val = val >> 31 ? 0x80000000 - val : val;
+        dst[i] = val >> shift;
+    }
+}
+
 av_cold void ff_jpeg2000dsp_init(Jpeg2000DSPContext *c)
 {
     c->mct_decode[FF_DWT97]     = ict_float;
     c->mct_decode[FF_DWT53]     = rct_int;
     c->mct_decode[FF_DWT97_INT] = ict_int;
+    c->ht_sign_mag              = ht_sign_mag;
 
 #if ARCH_RISCV
     ff_jpeg2000dsp_init_riscv(c);
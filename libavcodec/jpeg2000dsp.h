@@ -28,6 +28,12 @@
 
 typedef struct Jpeg2000DSPContext {
     void (*mct_decode[FF_DWT_NB])(void *src0, void *src1, void *src2, int csize);
+    /**
+     * Convert HT decoded samples from sign-magnitude to two's complement
+     * and scale them down by shift.
+     * @param len number of samples, must be a positive multiple of 8
+     */
+    void (*ht_sign_mag)(int32_t *dst, const int32_t *src, int len, int shift);
 } Jpeg2000DSPContext;
 
 extern const float ff_jpeg2000_f_ict_params[4];
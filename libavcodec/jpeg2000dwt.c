@@ -25,6 +25,10 @@
  * Discrete wavelet transform
  */
 
+#include <string.h>
+
+#include "config.h"
+#include "libavutil/attributes.h"
 #include "libavutil/error.h"
 #include "libavutil/macros.h"
 #include "libavutil/mem.h"
@@ -93,6 +97,66 @@ static void sd_1d53(int *p, int i0, int i1)
         p[2*i] += (p[2*i-1] + p[2*i+1] + 2) >> 2;
 }
 
+static void lift53_sub_c(int32_t *dst, const int32_t *a, const int32_t *b, int len)
+{
+    for (int i = 0; i < len; i++)
+        dst[i] -= (a[i] + b[i]) >> 1;
+}
+
+static void lift53_add_c(int32_t *dst, const int32_t *a, const int32_t *b, int len)
+{
+    for (int i = 0; i < len; i++)
+        dst[i] += (a[i] + b[i] + 2) >> 2;
+}
+
+/* row k of the extended vertical line, k in [-pad, lv + mv + pad) */
+#define STRIP_ROW(k) (buf + ((k) + pad) * FF_DWT_STRIP)
+
+/**
+ * Vertical pass of the 5/3 forward transform, done on strips of
+ * FF_DWT_STRIP columns so that the lifting steps operate on whole rows
+ * instead of walking the image one column at a time.
+ * Equivalent to running sd_1d53() on every column.
+ */
+static void sd_ver53(DWTContext *s, int *t, int w, int lh, int lv, int mv)
+{
+    const int pad = 3;
+    int32_t *buf = s->i_stripbuf;
+    int i0 = mv, i1 = mv + lv;
+
+    for (int x = 0; x < lh; x += FF_DWT_STRIP) {
+        int n = FFMIN(FF_DWT_STRIP, lh - x), i, j = 0;
+        int *col = t + x;
+
+        if (lv <= 1) {
+            if (lv && mv)
+                for (i = 0; i < n; i++)
+                    col[i] *= 2;
+            continue;
+        }
+
+        for (i = 0; i < lv; i++)
+            memcpy(STRIP_ROW(mv + i), col + w*i, n * sizeof(*col));
+
+        // extend53()
+        memcpy(STRIP_ROW(i0 - 1), STRIP_ROW(i0 + 1), n * sizeof(*buf));
+        memcpy(STRIP_ROW(i1),     STRIP_ROW(i1 - 2), n * sizeof(*buf));
+        memcpy(STRIP_ROW(i0 - 2), STRIP_ROW(i0 + 2), n * sizeof(*buf));
+        memcpy(STRIP_ROW(i1 + 1), STRIP_ROW(i1 - 3), n * sizeof(*buf));
+
+        for (i = ((i0+1)>>1) - 1; i < (i1+1)>>1; i++)
+            s->lift53_sub(STRIP_ROW(2*i+1), STRIP_ROW(2*i), STRIP_ROW(2*i+2), n);
+        for (i = ((i0+1)>>1); i < (i1+1)>>1; i++)
+            s->lift53_add(STRIP_ROW(2*i), STRIP_ROW(2*i-1), STRIP_ROW(2*i+1), n);
+
+        // copy back and deinterleave
+        for (i =   mv; i < lv; i+=2, j++)
+            memcpy(col + w*j, STRIP_ROW(mv + i), n * sizeof(*col));
+        for (i = 1-mv; i < lv; i+=2, j++)
+            memcpy(col + w*j, STRIP_ROW(mv + i), n * sizeof(*col));
+    }
+}
+
 static void dwt_encode53(DWTContext *s, int *t)
 {
     int lev,
@@ -109,21 +173,7 @@ static void dwt_encode53(DWTContext *s, int *t)
         int *l;
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
-
-            for (i = 0; i < lv; i++)
-                l[i] = t[w*i + lp];
-
-            sd_1d53(line, mv, mv + lv);
-
-            // copy back and deinterleave
-            for (i =   mv; i < lv; i+=2, j++)
-                t[w*j + lp] = l[i];
-            for (i = 1-mv; i < lv; i+=2, j++)
-                t[w*j + lp] = l[i];
-        }
+        sd_ver53(s, t, w, lh, lv, mv);
 
         // HOR_SD
         l = line + mh;
@@ -244,6 +294,77 @@ static void sd_1d97_int(int *p, int i0, int i1)
         p[2 * i]     += (I_LFTG_DELTA * (p[2 * i - 1] + p[2 * i + 1]) + (1 << 15)) >> 16;
 }
 
+static void lift97_int_sub_c(int32_t *dst, const int32_t *a, const int32_t *b,
+                             int len, int coef)
+{
+    for (int i = 0; i < len; i++)
+        dst[i] -= (coef * (int64_t)(a[i] + b[i]) + (1 << 15)) >> 16;
+}
+
+static void lift97_int_add_c(int32_t *dst, const int32_t *a, const int32_t *b,
+                             int len, int coef)
+{
+    for (int i = 0; i < len; i++)
+        dst[i] += (coef * (int64_t)(a[i] + b[i]) + (1 << 15)) >> 16;
+}
+
+/**
+ * Vertical pass of the integer 9/7 forward transform, done on strips of
+ * FF_DWT_STRIP columns. Equivalent to running sd_1d97_int() on every
+ * column, including the scaling of the low-pass rows on copy back.
+ */
+static void sd_ver97_int(DWTContext *s, int *t, int w, int lh, int lv, int mv)
+{
+    const int pad = 5;
+    int32_t *buf = s->i_stripbuf;
+    int i0 = mv, i1 = mv + lv;
+
+    for (int x = 0; x < lh; x += FF_DWT_STRIP) {
+        int n = FFMIN(FF_DWT_STRIP, lh - x), i, j = 0;
+        int *col = t + x;
+
+        if (lv <= 1) {
+            if (lv && mv)
+                for (i = 0; i < n; i++)
+                    col[i] = (col[i] * I_LFTG_X + (1<<14)) >> 15;
+            else if (lv)
+                for (i = 0; i < n; i++) {
+                    int v = (col[i] * I_LFTG_K + (1<<15)) >> 16;
+                    col[i] = (v * I_LFTG_X + (1 << 15)) >> 16;
+                }
+            continue;
+        }
+
+        for (i = 0; i < lv; i++)
+            memcpy(STRIP_ROW(mv + i), col + w*i, n * sizeof(*col));
+
+        // extend97_int()
+        for (i = 1; i <= 4; i++) {
+            memcpy(STRIP_ROW(i0 - i),     STRIP_ROW(i0 + i),     n * sizeof(*buf));
+            memcpy(STRIP_ROW(i1 + i - 1), STRIP_ROW(i1 - i - 1), n * sizeof(*buf));
+        }
+
+        for (i = ((i0+1)>>1) - 2; i < ((i1+1)>>1) + 1; i++)
+            s->lift97_int_sub(STRIP_ROW(2*i+1), STRIP_ROW(2*i),   STRIP_ROW(2*i+2), n, I_LFTG_ALPHA);
+        for (i = ((i0+1)>>1) - 1; i < ((i1+1)>>1) + 1; i++)
+            s->lift97_int_sub(STRIP_ROW(2*i),   STRIP_ROW(2*i-1), STRIP_ROW(2*i+1), n, I_LFTG_BETA);
+        for (i = ((i0+1)>>1) - 1; i < ((i1+1)>>1); i++)
+            s->lift97_int_add(STRIP_ROW(2*i+1), STRIP_ROW(2*i),   STRIP_ROW(2*i+2), n, I_LFTG_GAMMA);
+        for (i = ((i0+1)>>1); i < ((i1+1)>>1); i++)
+            s->lift97_int_add(STRIP_ROW(2*i),   STRIP_ROW(2*i-1), STRIP_ROW(2*i+1), n, I_LFTG_DELTA);
+
+        // copy back and deinterleave
+        for (i =   mv; i < lv; i+=2, j++) {
+            const int32_t *l = STRIP_ROW(mv + i);
+            int *dst = col + w*j;
+            for (int k = 0; k < n; k++)
+                dst[k] = ((l[k] * I_LFTG_X) + (1 << 15)) >> 16;
+        }
+        for (i = 1-mv; i < lv; i+=2, j++)
+            memcpy(col + w*j, STRIP_ROW(mv + i), n * sizeof(*col));
+    }
+}
+
 static void dwt_encode97_int(DWTContext *s, int *t)
 {
     int lev;
@@ -265,21 +386,7 @@ static void dwt_encode97_int(DWTContext *s, int *t)
         int *l;
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
-
-            for (i = 0; i < lv; i++)
-                l[i] = t[w*i + lp];
-
-            sd_1d97_int(line, mv, mv + lv);
-
-            // copy back and deinterleave
-            for (i =   mv; i < lv; i+=2, j++)
-                t[w*j + lp] = ((l[i] * I_LFTG_X) + (1 << 15)) >> 16;
-            for (i = 1-mv; i < lv; i+=2, j++)
-                t[w*j + lp] = l[i];
-        }
+        sd_ver97_int(s, t, w, lh, lv, mv);
 
         // HOR_SD
         l = line + mh;
@@ -574,6 +681,14 @@ int ff_jpeg2000_dwt_init(DWTContext *s, int border[2][2],
     default:
         return -1;
     }
+
+    s->lift53_sub     = lift53_sub_c;
+    s->lift53_add     = lift53_add_c;
+    s->lift97_int_sub = lift97_int_sub_c;
+    s->lift97_int_add = lift97_int_add_c;
+#if ARCH_X86
+    ff_jpeg2000dwt_init_x86(s);
+#endif
     return 0;
 }
 
@@ -582,6 +697,14 @@ int ff_dwt_encode(DWTContext *s, void *t)
     if (s->ndeclevels == 0)
         return 0;
 
+    if (s->type != FF_DWT97 && !s->i_stripbuf) {
+        int maxlen = s->linelen[s->ndeclevels - 1][1];
+        s->i_stripbuf = av_malloc_array((maxlen + 12) * FF_DWT_STRIP,
+                                        sizeof(*s->i_stripbuf));
+        if (!s->i_stripbuf)
+            return AVERROR(ENOMEM);
+    }
+
     switch(s->type){
         case FF_DWT97:
             dwt_encode97_float(s, t); break;
@@ -620,4 +743,5 @@ void ff_dwt_destroy(DWTContext *s)
 {
     av_freep(&s->f_linebuf);
     av_freep(&s->i_linebuf);
+    av_freep(&s->i_stripbuf);
 }
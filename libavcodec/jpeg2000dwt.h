@@ -30,6 +30,7 @@
 #include <stdint.h>
 
 #define FF_DWT_MAX_DECLVLS 32 ///< max number of decomposition levels
+#define FF_DWT_STRIP       32 ///< number of columns per strip of the vertical encoding pass
 #define F_LFTG_K      1.230174104914001f
 #define F_LFTG_X      0.812893066115961f
 
@@ -48,6 +49,21 @@ typedef struct DWTContext {
     uint8_t type;                        ///< 0 for 9/7; 1 for 5/3
     int32_t *i_linebuf;                  ///< int buffer used by transform
     float   *f_linebuf;                  ///< float buffer used by transform
+    int32_t *i_stripbuf;                 ///< int buffer used by the vertical encoding pass
+
+    /**
+     * Vertical lifting steps of the forward transform, applied to len
+     * consecutive columns at once.
+     * dst, a and b must be 32-byte aligned; len may be rounded up to a
+     * multiple of 8, so the rows must be padded accordingly.
+     */
+    void (*lift53_sub)(int32_t *dst, const int32_t *a, const int32_t *b, int len);
+    void (*lift53_add)(int32_t *dst, const int32_t *a, const int32_t *b, int len);
+    /* coef is a lifting parameter in 16.16 fixed point, 0 <= coef < 1 << 17 */
+    void (*lift97_int_sub)(int32_t *dst, const int32_t *a, const int32_t *b,
+                           int len, int coef);
+    void (*lift97_int_add)(int32_t *dst, const int32_t *a, const int32_t *b,
+                           int len, int coef);
 } DWTContext;
 
 /**
@@ -65,4 +81,6 @@ int ff_dwt_decode(DWTContext *s, void *t);
 
 void ff_dwt_destroy(DWTContext *s);
 
+void ff_jpeg2000dwt_init_x86(DWTContext *s);
+
 #endif /* AVCODEC_JPEG2000DWT_H */
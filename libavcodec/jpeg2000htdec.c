@@ -64,6 +64,21 @@
 #define HT_SHIFT_REF 3
 #define HT_SHIFT_REF_IND 2
 
+/**
+ * Layout of the scratch buffer of a Jpeg2000T1Context, sized for the largest
+ * code-block allowed by Rec. ITU-T T.800, Table A.18: width and height are at
+ * most 1024 and width * height is at most 4096, so (width + 4) * (height + 4)
+ * is at most 1028 * 8 and 4 * quad_width * quad_height at most 1025 * 5.
+ */
+#define HT_MAX_SAMPLES    (1028 * 8)
+#define HT_MAX_QUADS      (1025 * 5)
+#define HT_SAMPLE_OFFSET  0
+#define HT_MU_OFFSET      (HT_SAMPLE_OFFSET + HT_MAX_SAMPLES * sizeof(int32_t))
+#define HT_STATE_OFFSET   (HT_MU_OFFSET     + HT_MAX_QUADS   * sizeof(uint32_t))
+#define HT_SIGMA_OFFSET   (HT_STATE_OFFSET  + HT_MAX_SAMPLES)
+#define HT_E_OFFSET       (HT_SIGMA_OFFSET  + HT_MAX_QUADS)
+#define HT_BUF_SIZE       (HT_E_OFFSET      + HT_MAX_QUADS)
+
 /* See Rec. ITU-T T.800, Table 2 */
 const static uint8_t mel_e[13] = { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 4, 5 };
 
@@ -594,14 +609,12 @@ static int jpeg2000_decode_ht_cleanup_segment(const Jpeg2000DecoderContext *s,
     if (maxbp >= 32)
         return AVERROR_INVALIDDATA;
 
-    sigma_n = av_calloc(buf_size, sizeof(uint8_t));
-    E       = av_calloc(buf_size, sizeof(uint8_t));
-    mu_n    = av_calloc(buf_size, sizeof(uint32_t));
-
-    if (!sigma_n || !E || !mu_n) {
-        ret = AVERROR(ENOMEM);
-        goto free;
-    }
+    sigma_n = t1->ht_buf + HT_SIGMA_OFFSET;
+    E       = t1->ht_buf + HT_E_OFFSET;
+    mu_n    = (uint32_t *)(t1->ht_buf + HT_MU_OFFSET);
+    memset(sigma_n, 0, buf_size * sizeof(*sigma_n));
+    memset(E,       0, buf_size * sizeof(*E));
+    memset(mu_n,    0, buf_size * sizeof(*mu_n));
 
     sigma = sigma_n;
     mu = mu_n;
@@ -984,9 +997,6 @@ static int jpeg2000_decode_ht_cleanup_segment(const Jpeg2000DecoderContext *s,
     }
     ret = 1;
 free:
-    av_freep(&sigma_n);
-    av_freep(&E);
-    av_freep(&mu_n);
     return ret;
 }
 
@@ -1261,13 +1271,17 @@ ff_jpeg2000_decode_htj2k(const Jpeg2000DecoderContext *s, Jpeg2000CodingStyle *c
 
     jpeg2000_init_mel_decoder(&mel_state);
 
-    sample_buf = av_calloc((width + 4) * (height + 4), sizeof(int32_t));
-    block_states = av_calloc((width + 4) * (height + 4), sizeof(uint8_t));
-
-    if (!sample_buf || !block_states) {
-        ret = AVERROR(ENOMEM);
-        goto free;
+    if (!t1->ht_buf) {
+        t1->ht_buf = av_malloc(HT_BUF_SIZE);
+        if (!t1->ht_buf) {
+            ret = AVERROR(ENOMEM);
+            goto free;
+        }
     }
+    sample_buf   = (int32_t *)(t1->ht_buf + HT_SAMPLE_OFFSET);
+    block_states = t1->ht_buf + HT_STATE_OFFSET;
+    memset(sample_buf,   0, (width + 4) * (height + 4) * sizeof(*sample_buf));
+    memset(block_states, 0, (width + 4) * (height + 4) * sizeof(*block_states));
     if ((ret = jpeg2000_decode_ht_cleanup_segment(s, cblk, t1, &mel_state, &mel, &vlc,
                                           &mag_sgn, Dcup, Lcup, Pcup, pLSB, width,
                                           height, sample_buf, block_states)) < 0) {
@@ -1295,7 +1309,11 @@ ff_jpeg2000_decode_htj2k(const Jpeg2000DecoderContext *s, Jpeg2000CodingStyle *c
 
     /* Reconstruct the sample values */
     for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
+        int x = width & ~7;
+        if (x)
+            s->dsp.ht_sign_mag(t1->data + y * t1->stride, sample_buf + y * width,
+                               x, pLSB - 1);
+        for (; x < width; x++) {
             n = x + (y * t1->stride);
             val = sample_buf[x + (y * width)];
             /* Convert sign-magnitude to two's complement. */
@@ -1305,8 +1323,6 @@ ff_jpeg2000_decode_htj2k(const Jpeg2000DecoderContext *s, Jpeg2000CodingStyle *c
         }
     }
 free:
-    av_freep(&sample_buf);
-    av_freep(&block_states);
     return ret;
 }
 
@@ -417,6 +417,22 @@ static int pix_abs8_xy2_c(MpegEncContext *v, const uint8_t *pix1, const uint8_t
     return s;
 }
 
+void ff_sad16_x4_c(MpegEncContext *v, const uint8_t *pix1,
+                   const uint8_t *const ref[4], ptrdiff_t stride, int h,
+                   int scores[4])
+{
+    for (int i = 0; i < 4; i++)
+        scores[i] = pix_abs16_c(v, pix1, ref[i], stride, h);
+}
+
+void ff_sad8_x4_c(MpegEncContext *v, const uint8_t *pix1,
+                  const uint8_t *const ref[4], ptrdiff_t stride, int h,
+                  int scores[4])
+{
+    for (int i = 0; i < 4; i++)
+        scores[i] = pix_abs8_c(v, pix1, ref[i], stride, h);
+}
+
 static int nsse16_c(MpegEncContext *c, const uint8_t *s1, const uint8_t *s2,
                     ptrdiff_t stride, int h)
 {
@@ -52,6 +52,15 @@ typedef int (*me_cmp_func)(struct MpegEncContext *c,
                            const uint8_t *blk2 /* align 1 */, ptrdiff_t stride,
                            int h);
 
+/* Compare blk1 against the four candidate blocks ref[0..3] in one call and
+ * store the four results in scores. The alignment and h requirements are
+ * the same as for me_cmp_func. These are only provided where they are
+ * faster than four separate calls, so callers must handle NULL. */
+typedef void (*me_cmp_x4_func)(struct MpegEncContext *c,
+                               const uint8_t *blk1 /* align width (8 or 16) */,
+                               const uint8_t *const ref[4] /* align 1 */,
+                               ptrdiff_t stride, int h, int scores[4]);
+
 typedef struct MECmpContext {
     int (*sum_abs_dctelem)(const int16_t *block /* align 16 */);
 
@@ -79,8 +88,18 @@ typedef struct MECmpContext {
 
     me_cmp_func pix_abs[2][4];
     me_cmp_func median_sad[6];
+
+    me_cmp_x4_func sad_x4[2]; ///< sad[] against 4 candidates, [0] 16xh [1] 8xh, may be NULL
 } MECmpContext;
 
+/* Reference versions of sad_x4[], not used by ff_me_cmp_init(). */
+void ff_sad16_x4_c(struct MpegEncContext *v, const uint8_t *pix1,
+                   const uint8_t *const ref[4], ptrdiff_t stride, int h,
+                   int scores[4]);
+void ff_sad8_x4_c(struct MpegEncContext *v, const uint8_t *pix1,
+                  const uint8_t *const ref[4], ptrdiff_t stride, int h,
+                  int scores[4]);
+
 void ff_me_cmp_init(MECmpContext *c, AVCodecContext *avctx);
 void ff_me_cmp_init_aarch64(MECmpContext *c, AVCodecContext *avctx);
 void ff_me_cmp_init_alpha(MECmpContext *c, AVCodecContext *avctx);
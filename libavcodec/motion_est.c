@@ -332,6 +332,10 @@ int ff_init_me(MpegEncContext *s){
     if (ret < 0)
         return ret;
 
+    /* The diamond search can check several candidates at once when
+     * comparing luma only with SAD. */
+    c->sad_x4 = c->avctx->me_cmp == FF_CMP_SAD;
+
     c->flags    = get_flags(c, 0, c->avctx->me_cmp    &FF_CMP_CHROMA);
     c->sub_flags= get_flags(c, 0, c->avctx->me_sub_cmp&FF_CMP_CHROMA);
     c->mb_flags = get_flags(c, 0, c->avctx->mb_cmp    &FF_CMP_CHROMA);
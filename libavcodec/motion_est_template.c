@@ -413,6 +413,94 @@ if( (y)>(ymax<<(S)) ) av_log(NULL, AV_LOG_ERROR, "%d %d %d %d %d ymax" #v, ymax,
     const int qpel= flags&FLAG_QPEL;\
     const int shift= 1+qpel;\
 
+/**
+ * small_diamond_search() for full-pel luma SAD, evaluating all neighbours
+ * which are not in the map yet with one batched compare. The candidates are
+ * then processed in the same order as in small_diamond_search(), so the
+ * result is identical.
+ */
+static int small_diamond_search_x4(MpegEncContext *s, int *best, int dmin,
+                                   int src_index, int ref_index, const int penalty_factor,
+                                   int size, int h, int flags)
+{
+    static const int8_t dia[4][2] = { { -1, 0 }, { 0, -1 }, { 1, 0 }, { 0, 1 } };
+    MotionEstContext * const c = &s->me;
+    const me_cmp_x4_func cmp_x4 = s->mecc.sad_x4[size];
+    const me_cmp_func cmpf = s->mecc.me_cmp[size];
+    const uint8_t *const src = c->src[src_index][0];
+    const uint8_t *const ref = c->ref[ref_index][0];
+    const ptrdiff_t stride = c->stride;
+    int next_dir = -1;
+    LOAD_COMMON
+    LOAD_COMMON2
+    unsigned map_generation = c->map_generation;
+
+    { /* ensure that the best point is in the MAP as h/qpel refinement needs it */
+        const unsigned key = ((unsigned)best[1]<<ME_MAP_MV_BITS) + best[0] + map_generation;
+        const int index= (((unsigned)best[1]<<ME_MAP_SHIFT) + best[0])&(ME_MAP_SIZE-1);
+        if (map[index] != key) { // this will be executed only very rarely
+            score_map[index] = cmpf(s, src, ref + best[0] + best[1] * stride, stride, h);
+            map[index]= key;
+        }
+    }
+
+    for (;;) {
+        const uint8_t *refs[4];
+        unsigned key[4];
+        int index[4], scores[4], check = 0;
+        const int dir = next_dir;
+        const int x = best[0];
+        const int y = best[1];
+        next_dir = -1;
+
+        for (int i = 0; i < 4; i++) {
+            const int nx = x + dia[i][0];
+            const int ny = y + dia[i][1];
+
+            refs[i] = ref + x + y * stride;
+            /* never go back in the direction we came from */
+            if (dir == (i ^ 2) || nx < xmin || nx > xmax || ny < ymin || ny > ymax)
+                continue;
+            key[i]   = ((unsigned)ny << ME_MAP_MV_BITS) + nx + map_generation;
+            index[i] = (((unsigned)ny << ME_MAP_SHIFT) + nx) & (ME_MAP_SIZE - 1);
+            if (map[index[i]] != key[i]) {
+                refs[i] = ref + nx + ny * stride;
+                check  |= 1 << i;
+            }
+        }
+
+        if (!check)
+            return dmin;
+
+        if (check & (check - 1)) {
+            cmp_x4(s, src, refs, stride, h, scores);
+        } else {
+            const int i = av_log2(check);
+            scores[i] = cmpf(s, src, refs[i], stride, h);
+        }
+
+        for (int i = 0; i < 4; i++) {
+            const int nx = x + dia[i][0];
+            const int ny = y + dia[i][1];
+            int d;
+
+            if (!(check & (1 << i)))
+                continue;
+            d = scores[i];
+            map[index[i]]       = key[i];
+            score_map[index[i]] = d;
+            d += (mv_penalty[(int)((unsigned)nx << shift) - pred_x] +
+                  mv_penalty[(int)((unsigned)ny << shift) - pred_y]) * penalty_factor;
+            if (d < dmin) {
+                best[0]  = nx;
+                best[1]  = ny;
+                dmin     = d;
+                next_dir = i;
+            }
+        }
+    }
+}
+
 static av_always_inline int small_diamond_search(MpegEncContext * s, int *best, int dmin,
                                        int src_index, int ref_index, const int penalty_factor,
                                        int size, int h, int flags)
@@ -436,6 +524,11 @@ static av_always_inline int small_diamond_search(MpegEncContext * s, int *best,
         }
     }
 
+    if (size < 2 && !(flags & (FLAG_DIRECT | FLAG_CHROMA)) &&
+        c->sad_x4 && s->mecc.sad_x4[size])
+        return small_diamond_search_x4(s, best, dmin, src_index, ref_index,
+                                       penalty_factor, size, h, flags);
+
     for(;;){
         int d;
         const int dir= next_dir;
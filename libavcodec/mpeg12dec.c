@@ -43,6 +43,7 @@
 #include "codec_internal.h"
 #include "decode.h"
 #include "error_resilience.h"
+#include "get_bits_cached.h"
 #include "hwaccel_internal.h"
 #include "hwconfig.h"
 #include "idctdsp.h"
@@ -159,80 +160,70 @@ static int mpeg_decode_motion(MpegEncContext *s, int fcode, int pred)
 static inline int mpeg1_decode_block_inter(MpegEncContext *s,
                                            int16_t *block, int n)
 {
-    int level, i, j, run;
+    BitstreamContext bc;
+    int level, i, j, run, sign;
     uint8_t *const scantable     = s->intra_scantable.permutated;
     const uint16_t *quant_matrix = s->inter_matrix;
     const int qscale             = s->qscale;
 
-    {
-        OPEN_READER(re, &s->gb);
-        i = -1;
-        // special case for first coefficient, no need to add second VLC table
-        UPDATE_CACHE(re, &s->gb);
-        if (((int32_t) GET_CACHE(re, &s->gb)) < 0) {
-            level = (3 * qscale * quant_matrix[0]) >> 5;
+    bits_init_from_gb(&bc, &s->gb);
+    i = -1;
+    // special case for first coefficient, no need to add second VLC table
+    if (bits_peek(&bc, 1)) {
+        level = (3 * qscale * quant_matrix[0]) >> 5;
+        level = (level - 1) | 1;
+        if (bits_peek(&bc, 2) & 1)
+            level = -level;
+        block[0] = level;
+        i++;
+        bits_skip(&bc, 2);
+        if (bits_peek(&bc, 2) == 2)
+            goto end;
+    }
+    /* now quantify & encode AC coefficients */
+    for (;;) {
+        BITS_RL_VLC(level, run, &bc, ff_mpeg1_rl_vlc, TEX_VLC_BITS, 2);
+
+        if (level != 0) {
+            i += run;
+            if (i > MAX_INDEX)
+                break;
+            j = scantable[i];
+            level = ((level * 2 + 1) * qscale * quant_matrix[j]) >> 5;
             level = (level - 1) | 1;
-            if (GET_CACHE(re, &s->gb) & 0x40000000)
+            sign  = -(int)bits_read_bit(&bc);
+            level = (level ^ sign) - sign;
+        } else {
+            /* escape */
+            run   = bits_read(&bc, 6) + 1;
+            level = bits_read_signed(&bc, 8);
+            if (level == -128) {
+                level = bits_read(&bc, 8) - 256;
+            } else if (level == 0) {
+                level = bits_read(&bc, 8);
+            }
+            i += run;
+            if (i > MAX_INDEX)
+                break;
+            j = scantable[i];
+            if (level < 0) {
                 level = -level;
-            block[0] = level;
-            i++;
-            SKIP_BITS(re, &s->gb, 2);
-            if (((int32_t) GET_CACHE(re, &s->gb)) <= (int32_t) 0xBFFFFFFF)
-                goto end;
-        }
-        /* now quantify & encode AC coefficients */
-        for (;;) {
-            GET_RL_VLC(level, run, re, &s->gb, ff_mpeg1_rl_vlc,
-                       TEX_VLC_BITS, 2, 0);
-
-            if (level != 0) {
-                i += run;
-                if (i > MAX_INDEX)
-                    break;
-                j = scantable[i];
                 level = ((level * 2 + 1) * qscale * quant_matrix[j]) >> 5;
                 level = (level - 1) | 1;
-                level = (level ^ SHOW_SBITS(re, &s->gb, 1)) -
-                        SHOW_SBITS(re, &s->gb, 1);
-                SKIP_BITS(re, &s->gb, 1);
+                level = -level;
             } else {
-                /* escape */
-                run = SHOW_UBITS(re, &s->gb, 6) + 1;
-                LAST_SKIP_BITS(re, &s->gb, 6);
-                UPDATE_CACHE(re, &s->gb);
-                level = SHOW_SBITS(re, &s->gb, 8);
-                SKIP_BITS(re, &s->gb, 8);
-                if (level == -128) {
-                    level = SHOW_UBITS(re, &s->gb, 8) - 256;
-                    SKIP_BITS(re, &s->gb, 8);
-                } else if (level == 0) {
-                    level = SHOW_UBITS(re, &s->gb, 8);
-                    SKIP_BITS(re, &s->gb, 8);
-                }
-                i += run;
-                if (i > MAX_INDEX)
-                    break;
-                j = scantable[i];
-                if (level < 0) {
-                    level = -level;
-                    level = ((level * 2 + 1) * qscale * quant_matrix[j]) >> 5;
-                    level = (level - 1) | 1;
-                    level = -level;
-                } else {
-                    level = ((level * 2 + 1) * qscale * quant_matrix[j]) >> 5;
-                    level = (level - 1) | 1;
-                }
+                level = ((level * 2 + 1) * qscale * quant_matrix[j]) >> 5;
+                level = (level - 1) | 1;
             }
-
-            block[j] = level;
-            if (((int32_t) GET_CACHE(re, &s->gb)) <= (int32_t) 0xBFFFFFFF)
-                break;
-            UPDATE_CACHE(re, &s->gb);
         }
-end:
-        LAST_SKIP_BITS(re, &s->gb, 2);
-        CLOSE_READER(re, &s->gb);
+
+        block[j] = level;
+        if (bits_peek(&bc, 2) == 2)
+            break;
     }
+end:
+    bits_skip(&bc, 2);
+    bits_update_gb(&s->gb, &bc);
 
     check_scantable_index(s, i);
 
@@ -243,7 +234,8 @@ end:
 static inline int mpeg2_decode_block_non_intra(MpegEncContext *s,
                                                int16_t *block, int n)
 {
-    int level, i, j, run;
+    BitstreamContext bc;
+    int level, i, j, run, sign;
     uint8_t *const scantable = s->intra_scantable.permutated;
     const uint16_t *quant_matrix;
     const int qscale = s->qscale;
@@ -251,72 +243,63 @@ static inline int mpeg2_decode_block_non_intra(MpegEncContext *s,
 
     mismatch = 1;
 
-    {
-        OPEN_READER(re, &s->gb);
-        i = -1;
-        if (n < 4)
-            quant_matrix = s->inter_matrix;
-        else
-            quant_matrix = s->chroma_inter_matrix;
-
-        // Special case for first coefficient, no need to add second VLC table.
-        UPDATE_CACHE(re, &s->gb);
-        if (((int32_t) GET_CACHE(re, &s->gb)) < 0) {
-            level = (3 * qscale * quant_matrix[0]) >> 5;
-            if (GET_CACHE(re, &s->gb) & 0x40000000)
-                level = -level;
-            block[0]  = level;
-            mismatch ^= level;
-            i++;
-            SKIP_BITS(re, &s->gb, 2);
-            if (((int32_t) GET_CACHE(re, &s->gb)) <= (int32_t) 0xBFFFFFFF)
-                goto end;
-        }
+    bits_init_from_gb(&bc, &s->gb);
+    i = -1;
+    if (n < 4)
+        quant_matrix = s->inter_matrix;
+    else
+        quant_matrix = s->chroma_inter_matrix;
+
+    // Special case for first coefficient, no need to add second VLC table.
+    if (bits_peek(&bc, 1)) {
+        level = (3 * qscale * quant_matrix[0]) >> 5;
+        if (bits_peek(&bc, 2) & 1)
+            level = -level;
+        block[0]  = level;
+        mismatch ^= level;
+        i++;
+        bits_skip(&bc, 2);
+        if (bits_peek(&bc, 2) == 2)
+            goto end;
+    }
 
-        /* now quantify & encode AC coefficients */
-        for (;;) {
-            GET_RL_VLC(level, run, re, &s->gb, ff_mpeg1_rl_vlc,
-                       TEX_VLC_BITS, 2, 0);
+    /* now quantify & encode AC coefficients */
+    for (;;) {
+        BITS_RL_VLC(level, run, &bc, ff_mpeg1_rl_vlc, TEX_VLC_BITS, 2);
 
-            if (level != 0) {
-                i += run;
-                if (i > MAX_INDEX)
-                    break;
-                j = scantable[i];
-                level = ((level * 2 + 1) * qscale * quant_matrix[j]) >> 5;
-                level = (level ^ SHOW_SBITS(re, &s->gb, 1)) -
-                        SHOW_SBITS(re, &s->gb, 1);
-                SKIP_BITS(re, &s->gb, 1);
-            } else {
-                /* escape */
-                run = SHOW_UBITS(re, &s->gb, 6) + 1;
-                LAST_SKIP_BITS(re, &s->gb, 6);
-                UPDATE_CACHE(re, &s->gb);
-                level = SHOW_SBITS(re, &s->gb, 12);
-                SKIP_BITS(re, &s->gb, 12);
-
-                i += run;
-                if (i > MAX_INDEX)
-                    break;
-                j = scantable[i];
-                if (level < 0) {
-                    level = ((-level * 2 + 1) * qscale * quant_matrix[j]) >> 5;
-                    level = -level;
-                } else {
-                    level = ((level * 2 + 1) * qscale * quant_matrix[j]) >> 5;
-                }
-            }
+        if (level != 0) {
+            i += run;
+            if (i > MAX_INDEX)
+                break;
+            j = scantable[i];
+            level = ((level * 2 + 1) * qscale * quant_matrix[j]) >> 5;
+            sign  = -(int)bits_read_bit(&bc);
+            level = (level ^ sign) - sign;
+        } else {
+            /* escape */
+            run   = bits_read(&bc, 6) + 1;
+            level = bits_read_signed(&bc, 12);
 
-            mismatch ^= level;
-            block[j]  = level;
-            if (((int32_t) GET_CACHE(re, &s->gb)) <= (int32_t) 0xBFFFFFFF)
+            i += run;
+            if (i > MAX_INDEX)
                 break;
-            UPDATE_CACHE(re, &s->gb);
+            j = scantable[i];
+            if (level < 0) {
+                level = ((-level * 2 + 1) * qscale * quant_matrix[j]) >> 5;
+                level = -level;
+            } else {
+                level = ((level * 2 + 1) * qscale * quant_matrix[j]) >> 5;
+            }
         }
-end:
-        LAST_SKIP_BITS(re, &s->gb, 2);
-        CLOSE_READER(re, &s->gb);
+
+        mismatch ^= level;
+        block[j]  = level;
+        if (bits_peek(&bc, 2) == 2)
+            break;
     }
+end:
+    bits_skip(&bc, 2);
+    bits_update_gb(&s->gb, &bc);
     block[63] ^= (mismatch & 1);
 
     check_scantable_index(s, i);
@@ -328,7 +311,8 @@ end:
 static inline int mpeg2_decode_block_intra(MpegEncContext *s,
                                            int16_t *block, int n)
 {
-    int level, dc, diff, i, j, run;
+    BitstreamContext bc;
+    int level, dc, diff, i, j, run, sign;
     int component;
     const RL_VLC_ELEM *rl_vlc;
     uint8_t *const scantable = s->intra_scantable.permutated;
@@ -357,48 +341,41 @@ static inline int mpeg2_decode_block_intra(MpegEncContext *s,
     else
         rl_vlc = ff_mpeg1_rl_vlc;
 
-    {
-        OPEN_READER(re, &s->gb);
-        /* now quantify & encode AC coefficients */
-        for (;;) {
-            UPDATE_CACHE(re, &s->gb);
-            GET_RL_VLC(level, run, re, &s->gb, rl_vlc,
-                       TEX_VLC_BITS, 2, 0);
+    bits_init_from_gb(&bc, &s->gb);
+    /* now quantify & encode AC coefficients */
+    for (;;) {
+        BITS_RL_VLC(level, run, &bc, rl_vlc, TEX_VLC_BITS, 2);
 
-            if (level == 127) {
+        if (level == 127) {
+            break;
+        } else if (level != 0) {
+            i += run;
+            if (i > MAX_INDEX)
                 break;
-            } else if (level != 0) {
-                i += run;
-                if (i > MAX_INDEX)
-                    break;
-                j = scantable[i];
-                level = (level * qscale * quant_matrix[j]) >> 4;
-                level = (level ^ SHOW_SBITS(re, &s->gb, 1)) -
-                        SHOW_SBITS(re, &s->gb, 1);
-                LAST_SKIP_BITS(re, &s->gb, 1);
+            j = scantable[i];
+            level = (level * qscale * quant_matrix[j]) >> 4;
+            sign  = -(int)bits_read_bit(&bc);
+            level = (level ^ sign) - sign;
+        } else {
+            /* escape */
+            run   = bits_read(&bc, 6) + 1;
+            level = bits_read_signed(&bc, 12);
+            i += run;
+            if (i > MAX_INDEX)
+                break;
+            j = scantable[i];
+            if (level < 0) {
+                level = (-level * qscale * quant_matrix[j]) >> 4;
+                level = -level;
             } else {
-                /* escape */
-                run = SHOW_UBITS(re, &s->gb, 6) + 1;
-                SKIP_BITS(re, &s->gb, 6);
-                level = SHOW_SBITS(re, &s->gb, 12);
-                LAST_SKIP_BITS(re, &s->gb, 12);
-                i += run;
-                if (i > MAX_INDEX)
-                    break;
-                j = scantable[i];
-                if (level < 0) {
-                    level = (-level * qscale * quant_matrix[j]) >> 4;
-                    level = -level;
-                } else {
-                    level = (level * qscale * quant_matrix[j]) >> 4;
-                }
+                level = (level * qscale * quant_matrix[j]) >> 4;
             }
-
-            mismatch ^= level;
-            block[j]  = level;
         }
-        CLOSE_READER(re, &s->gb);
+
+        mismatch ^= level;
+        block[j]  = level;
     }
+    bits_update_gb(&s->gb, &bc);
     block[63] ^= mismatch & 1;
 
     check_scantable_index(s, i);
@@ -29,6 +29,7 @@
 #include "libavutil/thread.h"
 #include "codec_internal.h"
 #include "error_resilience.h"
+#include "get_bits_cached.h"
 #include "hwconfig.h"
 #include "idctdsp.h"
 #include "mpegutils.h"
@@ -1290,7 +1291,8 @@ static inline int mpeg4_decode_block(Mpeg4DecContext *ctx, int16_t *block,
                                      int use_intra_dc_vlc, int rvlc)
 {
     MpegEncContext *s = &ctx->m;
-    int level, i, last, run, qmul, qadd;
+    BitstreamContext bc;
+    int level, i, last, run, qmul, qadd, sign;
     int av_uninit(dc_pred_dir);
     RLTable *rl;
     RL_VLC_ELEM *rl_vlc;
@@ -1368,174 +1370,153 @@ static inline int mpeg4_decode_block(Mpeg4DecContext *ctx, int16_t *block,
                 rl_vlc = ff_h263_rl_inter.rl_vlc[s->qscale];
         }
     }
-    {
-        OPEN_READER(re, &s->gb);
-        for (;;) {
-            UPDATE_CACHE(re, &s->gb);
-            GET_RL_VLC(level, run, re, &s->gb, rl_vlc, TEX_VLC_BITS, 2, 0);
-            if (level == 0) {
-                /* escape */
-                if (rvlc) {
-                    if (SHOW_UBITS(re, &s->gb, 1) == 0) {
-                        av_log(s->avctx, AV_LOG_ERROR,
-                               "1. marker bit missing in rvlc esc\n");
-                        return AVERROR_INVALIDDATA;
-                    }
-                    SKIP_CACHE(re, &s->gb, 1);
+    bits_init_from_gb(&bc, &s->gb);
+    for (;;) {
+        BITS_RL_VLC(level, run, &bc, rl_vlc, TEX_VLC_BITS, 2);
+        if (level == 0) {
+            /* escape */
+            if (rvlc) {
+                if (!bits_read_bit(&bc)) {
+                    av_log(s->avctx, AV_LOG_ERROR,
+                           "1. marker bit missing in rvlc esc\n");
+                    return AVERROR_INVALIDDATA;
+                }
+                last = bits_read_bit(&bc);
+                run  = bits_read(&bc, 6);
 
-                    last = SHOW_UBITS(re, &s->gb, 1);
-                    SKIP_CACHE(re, &s->gb, 1);
-                    run = SHOW_UBITS(re, &s->gb, 6);
-                    SKIP_COUNTER(re, &s->gb, 1 + 1 + 6);
-                    UPDATE_CACHE(re, &s->gb);
+                if (!bits_read_bit(&bc)) {
+                    av_log(s->avctx, AV_LOG_ERROR,
+                           "2. marker bit missing in rvlc esc\n");
+                    return AVERROR_INVALIDDATA;
+                }
+                level = bits_read(&bc, 11);
 
-                    if (SHOW_UBITS(re, &s->gb, 1) == 0) {
-                        av_log(s->avctx, AV_LOG_ERROR,
-                               "2. marker bit missing in rvlc esc\n");
-                        return AVERROR_INVALIDDATA;
-                    }
-                    SKIP_CACHE(re, &s->gb, 1);
+                if (bits_read(&bc, 5) != 0x10) {
+                    av_log(s->avctx, AV_LOG_ERROR, "reverse esc missing\n");
+                    return AVERROR_INVALIDDATA;
+                }
 
-                    level = SHOW_UBITS(re, &s->gb, 11);
-                    SKIP_CACHE(re, &s->gb, 11);
+                level = level * qmul + qadd;
+                sign  = -(int)bits_read_bit(&bc);
+                level = (level ^ sign) - sign;
 
-                    if (SHOW_UBITS(re, &s->gb, 5) != 0x10) {
-                        av_log(s->avctx, AV_LOG_ERROR, "reverse esc missing\n");
-                        return AVERROR_INVALIDDATA;
-                    }
-                    SKIP_CACHE(re, &s->gb, 5);
+                i += run + 1;
+                if (last)
+                    i += 192;
+            } else {
+                int cache = bits_peek(&bc, 2);
 
-                    level = level * qmul + qadd;
-                    level = (level ^ SHOW_SBITS(re, &s->gb, 1)) - SHOW_SBITS(re, &s->gb, 1);
-                    SKIP_COUNTER(re, &s->gb, 1 + 11 + 5 + 1);
+                if (IS_3IV1)
+                    cache ^= 3;
 
-                    i += run + 1;
-                    if (last)
-                        i += 192;
-                } else {
-                    int cache;
-                    cache = GET_CACHE(re, &s->gb);
-
-                    if (IS_3IV1)
-                        cache ^= 0xC0000000;
-
-                    if (cache & 0x80000000) {
-                        if (cache & 0x40000000) {
-                            /* third escape */
-                            SKIP_CACHE(re, &s->gb, 2);
-                            last = SHOW_UBITS(re, &s->gb, 1);
-                            SKIP_CACHE(re, &s->gb, 1);
-                            run = SHOW_UBITS(re, &s->gb, 6);
-                            SKIP_COUNTER(re, &s->gb, 2 + 1 + 6);
-                            UPDATE_CACHE(re, &s->gb);
-
-                            if (IS_3IV1) {
-                                level = SHOW_SBITS(re, &s->gb, 12);
-                                LAST_SKIP_BITS(re, &s->gb, 12);
-                            } else {
-                                if (SHOW_UBITS(re, &s->gb, 1) == 0) {
-                                    av_log(s->avctx, AV_LOG_ERROR,
-                                           "1. marker bit missing in 3. esc\n");
-                                    if (!(s->avctx->err_recognition & AV_EF_IGNORE_ERR) || get_bits_left(&s->gb) <= 0)
-                                        return AVERROR_INVALIDDATA;
-                                }
-                                SKIP_CACHE(re, &s->gb, 1);
+                if (cache & 2) {
+                    if (cache & 1) {
+                        /* third escape */
+                        bits_skip(&bc, 2);
+                        last = bits_read_bit(&bc);
+                        run  = bits_read(&bc, 6);
 
-                                level = SHOW_SBITS(re, &s->gb, 12);
-                                SKIP_CACHE(re, &s->gb, 12);
+                        if (IS_3IV1) {
+                            level = bits_read_signed(&bc, 12);
+                        } else {
+                            if (!bits_read_bit(&bc)) {
+                                av_log(s->avctx, AV_LOG_ERROR,
+                                       "1. marker bit missing in 3. esc\n");
+                                if (!(s->avctx->err_recognition & AV_EF_IGNORE_ERR) || get_bits_left(&s->gb) <= 0)
+                                    return AVERROR_INVALIDDATA;
+                            }
 
-                                if (SHOW_UBITS(re, &s->gb, 1) == 0) {
-                                    av_log(s->avctx, AV_LOG_ERROR,
-                                           "2. marker bit missing in 3. esc\n");
-                                    if (!(s->avctx->err_recognition & AV_EF_IGNORE_ERR) || get_bits_left(&s->gb) <= 0)
-                                        return AVERROR_INVALIDDATA;
-                                }
+                            level = bits_read_signed(&bc, 12);
 
-                                SKIP_COUNTER(re, &s->gb, 1 + 12 + 1);
+                            if (!bits_read_bit(&bc)) {
+                                av_log(s->avctx, AV_LOG_ERROR,
+                                       "2. marker bit missing in 3. esc\n");
+                                if (!(s->avctx->err_recognition & AV_EF_IGNORE_ERR) || get_bits_left(&s->gb) <= 0)
+                                    return AVERROR_INVALIDDATA;
                             }
+                        }
 
 #if 0
-                            if (s->error_recognition >= FF_ER_COMPLIANT) {
-                                const int abs_level= FFABS(level);
-                                if (abs_level<=MAX_LEVEL && run<=MAX_RUN) {
-                                    const int run1= run - rl->max_run[last][abs_level] - 1;
-                                    if (abs_level <= rl->max_level[last][run]) {
-                                        av_log(s->avctx, AV_LOG_ERROR, "illegal 3. esc, vlc encoding possible\n");
+                        if (s->error_recognition >= FF_ER_COMPLIANT) {
+                            const int abs_level= FFABS(level);
+                            if (abs_level<=MAX_LEVEL && run<=MAX_RUN) {
+                                const int run1= run - rl->max_run[last][abs_level] - 1;
+                                if (abs_level <= rl->max_level[last][run]) {
+                                    av_log(s->avctx, AV_LOG_ERROR, "illegal 3. esc, vlc encoding possible\n");
+                                    return AVERROR_INVALIDDATA;
+                                }
+                                if (s->error_recognition > FF_ER_COMPLIANT) {
+                                    if (abs_level <= rl->max_level[last][run]*2) {
+                                        av_log(s->avctx, AV_LOG_ERROR, "illegal 3. esc, esc 1 encoding possible\n");
                                         return AVERROR_INVALIDDATA;
                                     }
-                                    if (s->error_recognition > FF_ER_COMPLIANT) {
-                                        if (abs_level <= rl->max_level[last][run]*2) {
-                                            av_log(s->avctx, AV_LOG_ERROR, "illegal 3. esc, esc 1 encoding possible\n");
-                                            return AVERROR_INVALIDDATA;
-                                        }
-                                        if (run1 >= 0 && abs_level <= rl->max_level[last][run1]) {
-                                            av_log(s->avctx, AV_LOG_ERROR, "illegal 3. esc, esc 2 encoding possible\n");
-                                            return AVERROR_INVALIDDATA;
-                                        }
+                                    if (run1 >= 0 && abs_level <= rl->max_level[last][run1]) {
+                                        av_log(s->avctx, AV_LOG_ERROR, "illegal 3. esc, esc 2 encoding possible\n");
+                                        return AVERROR_INVALIDDATA;
                                     }
                                 }
                             }
+                        }
 #endif
-                            if (level > 0)
-                                level = level * qmul + qadd;
-                            else
-                                level = level * qmul - qadd;
-
-                            if ((unsigned)(level + 2048) > 4095) {
-                                if (s->avctx->err_recognition & (AV_EF_BITSTREAM|AV_EF_AGGRESSIVE)) {
-                                    if (level > 2560 || level < -2560) {
-                                        av_log(s->avctx, AV_LOG_ERROR,
-                                               "|level| overflow in 3. esc, qp=%d\n",
-                                               s->qscale);
-                                        return AVERROR_INVALIDDATA;
-                                    }
+                        if (level > 0)
+                            level = level * qmul + qadd;
+                        else
+                            level = level * qmul - qadd;
+
+                        if ((unsigned)(level + 2048) > 4095) {
+                            if (s->avctx->err_recognition & (AV_EF_BITSTREAM|AV_EF_AGGRESSIVE)) {
+                                if (level > 2560 || level < -2560) {
+                                    av_log(s->avctx, AV_LOG_ERROR,
+                                           "|level| overflow in 3. esc, qp=%d\n",
+                                           s->qscale);
+                                    return AVERROR_INVALIDDATA;
                                 }
-                                level = level < 0 ? -2048 : 2047;
                             }
-
-                            i += run + 1;
-                            if (last)
-                                i += 192;
-                        } else {
-                            /* second escape */
-                            SKIP_BITS(re, &s->gb, 2);
-                            GET_RL_VLC(level, run, re, &s->gb, rl_vlc, TEX_VLC_BITS, 2, 1);
-                            i    += run + rl->max_run[run >> 7][level / qmul] + 1;  // FIXME opt indexing
-                            level = (level ^ SHOW_SBITS(re, &s->gb, 1)) - SHOW_SBITS(re, &s->gb, 1);
-                            LAST_SKIP_BITS(re, &s->gb, 1);
+                            level = level < 0 ? -2048 : 2047;
                         }
+
+                        i += run + 1;
+                        if (last)
+                            i += 192;
                     } else {
-                        /* first escape */
-                        SKIP_BITS(re, &s->gb, 1);
-                        GET_RL_VLC(level, run, re, &s->gb, rl_vlc, TEX_VLC_BITS, 2, 1);
-                        i    += run;
-                        level = level + rl->max_level[run >> 7][(run - 1) & 63] * qmul;  // FIXME opt indexing
-                        level = (level ^ SHOW_SBITS(re, &s->gb, 1)) - SHOW_SBITS(re, &s->gb, 1);
-                        LAST_SKIP_BITS(re, &s->gb, 1);
+                        /* second escape */
+                        bits_skip(&bc, 2);
+                        BITS_RL_VLC(level, run, &bc, rl_vlc, TEX_VLC_BITS, 2);
+                        i    += run + rl->max_run[run >> 7][level / qmul] + 1;  // FIXME opt indexing
+                        sign  = -(int)bits_read_bit(&bc);
+                        level = (level ^ sign) - sign;
                     }
+                } else {
+                    /* first escape */
+                    bits_skip(&bc, 1);
+                    BITS_RL_VLC(level, run, &bc, rl_vlc, TEX_VLC_BITS, 2);
+                    i    += run;
+                    level = level + rl->max_level[run >> 7][(run - 1) & 63] * qmul;  // FIXME opt indexing
+                    sign  = -(int)bits_read_bit(&bc);
+                    level = (level ^ sign) - sign;
                 }
-            } else {
-                i    += run;
-                level = (level ^ SHOW_SBITS(re, &s->gb, 1)) - SHOW_SBITS(re, &s->gb, 1);
-                LAST_SKIP_BITS(re, &s->gb, 1);
             }
-            ff_tlog(s->avctx, "dct[%d][%d] = %- 4d end?:%d\n", scan_table[i&63]&7, scan_table[i&63] >> 3, level, i>62);
-            if (i > 62) {
-                i -= 192;
-                if (i & (~63)) {
-                    av_log(s->avctx, AV_LOG_ERROR,
-                           "ac-tex damaged at %d %d\n", s->mb_x, s->mb_y);
-                    return AVERROR_INVALIDDATA;
-                }
-
-                block[scan_table[i]] = level;
-                break;
+        } else {
+            i    += run;
+            sign  = -(int)bits_read_bit(&bc);
+            level = (level ^ sign) - sign;
+        }
+        ff_tlog(s->avctx, "dct[%d][%d] = %- 4d end?:%d\n", scan_table[i&63]&7, scan_table[i&63] >> 3, level, i>62);
+        if (i > 62) {
+            i -= 192;
+            if (i & (~63)) {
+                av_log(s->avctx, AV_LOG_ERROR,
+                       "ac-tex damaged at %d %d\n", s->mb_x, s->mb_y);
+                return AVERROR_INVALIDDATA;
             }
 
             block[scan_table[i]] = level;
+            break;
         }
-        CLOSE_READER(re, &s->gb);
+
+        block[scan_table[i]] = level;
     }
+    bits_update_gb(&s->gb, &bc);
 
 not_coded:
     if (intra) {
@@ -1320,23 +1320,117 @@ static int encode_frame(AVCodecContext *c, const AVFrame *frame, AVPacket *pkt)
     return size;
 }
 
+typedef struct BCountTrial {
+    MpegEncContext *s;
+    int b_count;
+    int p_lambda, b_lambda, lambda2;
+    int64_t rd;
+    int ret;
+} BCountTrial;
+
+/**
+ * Encode the downscaled lookahead with b_count B-frames between the
+ * P-frames and compute its rate-distortion cost.
+ * Trials for different B-frame counts only read the shared downscaled
+ * input, so they can run concurrently.
+ */
+static int estimate_b_count_thread(AVCodecContext *avctx, void *arg)
+{
+    BCountTrial *t = arg;
+    MpegEncContext *s = t->s;
+    AVCodecContext *c = NULL;
+    AVPacket *pkt     = av_packet_alloc();
+    AVFrame *frame    = av_frame_alloc();
+    int i, out_size, ret;
+
+    t->rd = 0;
+    if (!pkt || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    c = avcodec_alloc_context3(NULL);
+    if (!c) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    c->width        = s->width  >> s->brd_scale;
+    c->height       = s->height >> s->brd_scale;
+    c->flags        = AV_CODEC_FLAG_QSCALE | AV_CODEC_FLAG_PSNR;
+    c->flags       |= s->avctx->flags & AV_CODEC_FLAG_QPEL;
+    c->mb_decision  = s->avctx->mb_decision;
+    c->me_cmp       = s->avctx->me_cmp;
+    c->mb_cmp       = s->avctx->mb_cmp;
+    c->me_sub_cmp   = s->avctx->me_sub_cmp;
+    c->pix_fmt      = AV_PIX_FMT_YUV420P;
+    c->time_base    = s->avctx->time_base;
+    c->max_b_frames = s->max_b_frames;
+
+    ret = avcodec_open2(c, s->avctx->codec, NULL);
+    if (ret < 0)
+        goto fail;
+
+    for (i = 0; i < s->max_b_frames + 2; i++) {
+        /* each trial needs its own picture types and qualities, so send
+         * new references to the shared downscaled frames */
+        ret = av_frame_ref(frame, s->tmp_frames[i]);
+        if (ret < 0)
+            goto fail;
+
+        if (!i) {
+            frame->pict_type = AV_PICTURE_TYPE_I;
+            frame->quality   = 1 * FF_QP2LAMBDA;
+        } else {
+            int is_p = (i - 1) % (t->b_count + 1) == t->b_count ||
+                       i - 1 == s->max_b_frames;
+
+            frame->pict_type = is_p ? AV_PICTURE_TYPE_P : AV_PICTURE_TYPE_B;
+            frame->quality   = is_p ? t->p_lambda : t->b_lambda;
+        }
+
+        out_size = encode_frame(c, frame, pkt);
+        av_frame_unref(frame);
+        if (out_size < 0) {
+            ret = out_size;
+            goto fail;
+        }
+
+        //rd += (out_size * lambda2) >> FF_LAMBDA_SHIFT;
+        if (i)
+            t->rd += (out_size * t->lambda2) >> (FF_LAMBDA_SHIFT - 3);
+    }
+
+    /* get the delayed frames */
+    out_size = encode_frame(c, NULL, pkt);
+    if (out_size < 0) {
+        ret = out_size;
+        goto fail;
+    }
+    t->rd += (out_size * t->lambda2) >> (FF_LAMBDA_SHIFT - 3);
+
+    t->rd += c->error[0] + c->error[1] + c->error[2];
+
+fail:
+    avcodec_free_context(&c);
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    t->ret = ret;
+    return ret;
+}
+
 static int estimate_best_b_count(MpegEncContext *s)
 {
-    AVPacket *pkt;
+    BCountTrial trials[MAX_B_FRAMES + 1];
     const int scale = s->brd_scale;
     int width  = s->width  >> scale;
     int height = s->height >> scale;
-    int i, j, out_size, p_lambda, b_lambda, lambda2;
+    int i, j, nb_trials, p_lambda, b_lambda, lambda2;
     int64_t best_rd  = INT64_MAX;
     int best_b_count = -1;
-    int ret = 0;
 
     av_assert0(scale >= 0 && scale <= 3);
 
-    pkt = av_packet_alloc();
-    if (!pkt)
-        return AVERROR(ENOMEM);
-
     //emms_c();
     //s->next_picture_ptr->quality;
     p_lambda = s->last_lambda_for[AV_PICTURE_TYPE_P];
@@ -1379,89 +1473,32 @@ static int estimate_best_b_count(MpegEncContext *s)
         }
     }
 
-    for (j = 0; j < s->max_b_frames + 1; j++) {
-        AVCodecContext *c;
-        int64_t rd = 0;
-
-        if (!s->input_picture[j])
+    for (nb_trials = 0; nb_trials < s->max_b_frames + 1; nb_trials++) {
+        if (!s->input_picture[nb_trials])
             break;
-
-        c = avcodec_alloc_context3(NULL);
-        if (!c) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
-        }
-
-        c->width        = width;
-        c->height       = height;
-        c->flags        = AV_CODEC_FLAG_QSCALE | AV_CODEC_FLAG_PSNR;
-        c->flags       |= s->avctx->flags & AV_CODEC_FLAG_QPEL;
-        c->mb_decision  = s->avctx->mb_decision;
-        c->me_cmp       = s->avctx->me_cmp;
-        c->mb_cmp       = s->avctx->mb_cmp;
-        c->me_sub_cmp   = s->avctx->me_sub_cmp;
-        c->pix_fmt      = AV_PIX_FMT_YUV420P;
-        c->time_base    = s->avctx->time_base;
-        c->max_b_frames = s->max_b_frames;
-
-        ret = avcodec_open2(c, s->avctx->codec, NULL);
-        if (ret < 0)
-            goto fail;
-
-
-        s->tmp_frames[0]->pict_type = AV_PICTURE_TYPE_I;
-        s->tmp_frames[0]->quality   = 1 * FF_QP2LAMBDA;
-
-        out_size = encode_frame(c, s->tmp_frames[0], pkt);
-        if (out_size < 0) {
-            ret = out_size;
-            goto fail;
-        }
-
-        //rd += (out_size * lambda2) >> FF_LAMBDA_SHIFT;
-
-        for (i = 0; i < s->max_b_frames + 1; i++) {
-            int is_p = i % (j + 1) == j || i == s->max_b_frames;
-
-            s->tmp_frames[i + 1]->pict_type = is_p ?
-                                     AV_PICTURE_TYPE_P : AV_PICTURE_TYPE_B;
-            s->tmp_frames[i + 1]->quality   = is_p ? p_lambda : b_lambda;
-
-            out_size = encode_frame(c, s->tmp_frames[i + 1], pkt);
-            if (out_size < 0) {
-                ret = out_size;
-                goto fail;
-            }
-
-            rd += (out_size * lambda2) >> (FF_LAMBDA_SHIFT - 3);
-        }
-
-        /* get the delayed frames */
-        out_size = encode_frame(c, NULL, pkt);
-        if (out_size < 0) {
-            ret = out_size;
-            goto fail;
-        }
-        rd += (out_size * lambda2) >> (FF_LAMBDA_SHIFT - 3);
-
-        rd += c->error[0] + c->error[1] + c->error[2];
-
-        if (rd < best_rd) {
-            best_rd = rd;
+        trials[nb_trials] = (BCountTrial){
+            .s        = s,
+            .b_count  = nb_trials,
+            .p_lambda = p_lambda,
+            .b_lambda = b_lambda,
+            .lambda2  = lambda2,
+        };
+    }
+
+    /* the trials are independent; with slice threading they run on the
+     * encoder's worker threads */
+    s->avctx->execute(s->avctx, estimate_b_count_thread, trials, NULL,
+                      nb_trials, sizeof(*trials));
+
+    for (j = 0; j < nb_trials; j++) {
+        if (trials[j].ret < 0)
+            return trials[j].ret;
+        if (trials[j].rd < best_rd) {
+            best_rd = trials[j].rd;
             best_b_count = j;
         }
-
-fail:
-        avcodec_free_context(&c);
-        av_packet_unref(pkt);
-        if (ret < 0) {
-            best_b_count = ret;
-            break;
-        }
     }
 
-    av_packet_free(&pkt);
-
     return best_b_count;
 }
 
@@ -383,38 +383,66 @@ static int bands_dist(OpusPsyContext *s, CeltFrame *f, float *total_dist)
     return 0;
 }
 
+static int trial_bands_dist(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    OpusPsyContext *s = arg;
+    CeltFrame *f = &s->trial_frame[threadnr];
+
+    /* Every trial starts from the same frame state, so the result does not
+     * depend on which thread runs it or in which order */
+    memcpy(f, s->trial_src, sizeof(*f));
+    f->pvq              = s->trial_pvq[threadnr];
+    f->intensity_stereo = s->trial_intensity[jobnr];
+    f->dual_stereo      = s->trial_dual[jobnr];
+
+    return bands_dist(s, f, &s->trial_dist[jobnr]);
+}
+
+/* Run the trial encodes set up in trial_intensity/trial_dual concurrently */
+static void run_trials(OpusPsyContext *s, const CeltFrame *f, int nb_trials)
+{
+    s->trial_src = f;
+    s->avctx->execute2(s->avctx, trial_bands_dist, s, NULL, nb_trials);
+}
+
 static void celt_search_for_dual_stereo(OpusPsyContext *s, CeltFrame *f)
 {
-    float td1, td2;
     f->dual_stereo = 0;
 
     if (s->avctx->ch_layout.nb_channels < 2)
         return;
 
-    bands_dist(s, f, &td1);
-    f->dual_stereo = 1;
-    bands_dist(s, f, &td2);
+    for (int i = 0; i < 2; i++) {
+        s->trial_intensity[i] = f->intensity_stereo;
+        s->trial_dual[i]      = i;
+    }
+    run_trials(s, f, 2);
 
-    f->dual_stereo = td2 < td1;
-    s->dual_stereo_used += td2 < td1;
+    f->dual_stereo = s->trial_dist[1] < s->trial_dist[0];
+    s->dual_stereo_used += f->dual_stereo;
 }
 
 static void celt_search_for_intensity(OpusPsyContext *s, CeltFrame *f)
 {
     int i, best_band = CELT_MAX_BANDS - 1;
-    float dist, best_dist = FLT_MAX;
+    float best_dist = FLT_MAX;
     /* TODO: fix, make some heuristic up here using the lambda value */
-    float end_band = 0;
+    int end_band = 0;
+    int nb_trials = f->end_band - end_band + 1;
 
     if (s->avctx->ch_layout.nb_channels < 2)
         return;
 
-    for (i = f->end_band; i >= end_band; i--) {
-        f->intensity_stereo = i;
-        bands_dist(s, f, &dist);
-        if (best_dist > dist) {
-            best_dist = dist;
-            best_band = i;
+    for (i = 0; i < nb_trials; i++) {
+        s->trial_intensity[i] = f->end_band - i;
+        s->trial_dual[i]      = f->dual_stereo;
+    }
+    run_trials(s, f, nb_trials);
+
+    for (i = 0; i < nb_trials; i++) {
+        if (best_dist > s->trial_dist[i]) {
+            best_dist = s->trial_dist[i];
+            best_band = s->trial_intensity[i];
         }
     }
 
@@ -570,11 +598,28 @@ av_cold int ff_opus_psy_init(OpusPsyContext *s, AVCodecContext *avctx,
             goto fail;
     }
 
+    s->nb_trial_threads = avctx->active_thread_type & FF_THREAD_SLICE ?
+                          FFMAX(avctx->thread_count, 1) : 1;
+    s->trial_frame = av_malloc_array(s->nb_trial_threads, sizeof(*s->trial_frame));
+    s->trial_pvq   = av_calloc(s->nb_trial_threads, sizeof(*s->trial_pvq));
+    if (!s->trial_frame || !s->trial_pvq) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (i = 0; i < s->nb_trial_threads; i++)
+        if ((ret = ff_celt_pvq_init(&s->trial_pvq[i], 1)) < 0)
+            goto fail;
+
     return 0;
 
 fail:
     av_freep(&s->inflection_points);
     av_freep(&s->dsp);
+    av_freep(&s->trial_frame);
+    if (s->trial_pvq)
+        for (i = 0; i < s->nb_trial_threads; i++)
+            ff_celt_pvq_uninit(&s->trial_pvq[i]);
+    av_freep(&s->trial_pvq);
 
     for (i = 0; i < CELT_BLOCK_NB; i++) {
         av_tx_uninit(&s->mdct[i]);
@@ -598,6 +643,11 @@ av_cold int ff_opus_psy_end(OpusPsyContext *s)
 
     av_freep(&s->inflection_points);
     av_freep(&s->dsp);
+    av_freep(&s->trial_frame);
+    if (s->trial_pvq)
+        for (i = 0; i < s->nb_trial_threads; i++)
+            ff_celt_pvq_uninit(&s->trial_pvq[i]);
+    av_freep(&s->trial_pvq);
 
     for (i = 0; i < CELT_BLOCK_NB; i++) {
         av_tx_uninit(&s->mdct[i]);
@@ -69,6 +69,15 @@ typedef struct OpusPsyContext {
 
     DECLARE_ALIGNED(32, float, scratch)[2048];
 
+    /* Stereo search trial encodes, one frame and PVQ workspace per thread */
+    CeltFrame *trial_frame;
+    struct CeltPVQ **trial_pvq;
+    int nb_trial_threads;
+    const CeltFrame *trial_src;
+    int   trial_intensity[CELT_MAX_BANDS + 1];
+    int   trial_dual[CELT_MAX_BANDS + 1];
+    float trial_dist[CELT_MAX_BANDS + 1];
+
     /* Stats */
     float avg_is_band;
     int64_t dual_stereo_used;
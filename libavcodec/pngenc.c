@@ -41,6 +41,23 @@
 #include <zlib.h>
 
 #define IOBUF_SIZE 4096
+#define MAX_DEFLATE_SLICES 1024
+
+/**
+ * A range of rows compressed independently when deflate_slices is set.
+ * The compressed data of all slices forms a single zlib stream.
+ */
+typedef struct PNGEncSlice {
+    uint8_t *crow_base;
+    unsigned int crow_size;
+    uint8_t *dict;               ///< filtered rows preceding the slice
+    unsigned int dict_size;
+    uint8_t *buf;                ///< compressed data
+    unsigned int buf_size;
+    size_t len;                  ///< size of the compressed data
+    size_t in_len;               ///< size of the uncompressed data
+    uLong adler;                 ///< Adler-32 of the uncompressed data
+} PNGEncSlice;
 
 typedef struct APNGFctlChunk {
     uint32_t sequence_number;
@@ -62,6 +79,13 @@ typedef struct PNGEncContext {
 
     FFZStream zstream;
     uint8_t buf[IOBUF_SIZE];
+    int compression_level;
+
+    int nb_deflate_slices;       ///< option, 0 to use a single deflate stream
+    PNGEncSlice *slices;
+    int nb_slices;               ///< number of slices of the current image
+    FFZStream *slice_zstreams;   ///< raw deflate streams, one per thread
+    int nb_slice_zstreams;
     int dpi;                     ///< Physical pixel density, in dots per inch, if set
     int dpm;                     ///< Physical pixel density, in dots per meter, if set
 
@@ -505,6 +529,149 @@ static int encode_headers(AVCodecContext *avctx, const AVFrame *pict)
     return 0;
 }
 
+static int deflate_slice_data(z_stream *zstream, PNGEncSlice *sl,
+                              const uint8_t *data, int size, int flush)
+{
+    int ret;
+
+    zstream->next_in  = data;
+    zstream->avail_in = size;
+    for (;;) {
+        if (!zstream->avail_out) {
+            size_t used = zstream->next_out - sl->buf;
+            uint8_t *buf = av_fast_realloc(sl->buf, &sl->buf_size,
+                                           sl->buf_size + sl->buf_size / 2 + 64);
+            if (!buf)
+                return AVERROR(ENOMEM);
+            sl->buf            = buf;
+            zstream->next_out  = buf + used;
+            zstream->avail_out = sl->buf_size - used;
+        }
+        ret = deflate(zstream, flush);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+            return AVERROR_EXTERNAL;
+        if (flush == Z_NO_FLUSH ? !zstream->avail_in :
+            flush == Z_FINISH   ? ret == Z_STREAM_END : zstream->avail_out > 0)
+            return 0;
+    }
+}
+
+static int deflate_slice(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s      = avctx->priv_data;
+    const AVFrame *p      = arg;
+    PNGEncSlice *sl       = &s->slices[jobnr];
+    z_stream *zstream     = &s->slice_zstreams[threadnr].zstream;
+    int row_size          = (p->width * s->bits_per_pixel + 7) >> 3;
+    int bpp               = s->bits_per_pixel >> 3;
+    int y0                = (int64_t)p->height *  jobnr      / s->nb_slices;
+    int y1                = (int64_t)p->height * (jobnr + 1) / s->nb_slices;
+    int dict_rows         = (32768 + row_size) / (row_size + 1);
+    int dict_y            = FFMAX(y0 - dict_rows, 0);
+    const uint8_t *top    = NULL;
+    uint8_t *crow_buf, *crow;
+    size_t dict_len = 0;
+    int y, ret;
+
+    av_fast_malloc(&sl->crow_base, &sl->crow_size,
+                   (row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+    av_fast_malloc(&sl->dict, &sl->dict_size, (size_t)(y0 - dict_y) * (row_size + 1));
+    av_fast_malloc(&sl->buf, &sl->buf_size,
+                   deflateBound(zstream, (uLong)(y1 - y0) * (row_size + 1)) + 64);
+    if (!sl->crow_base || (y0 > dict_y && !sl->dict) || !sl->buf)
+        return AVERROR(ENOMEM);
+    // pixel data should be aligned, but there's a control byte before it
+    crow_buf = sl->crow_base + 15;
+
+    deflateReset(zstream);
+    // the first slice leaves room for the zlib header
+    zstream->next_out  = sl->buf + 2 * !jobnr;
+    zstream->avail_out = sl->buf_size - 2 * !jobnr;
+
+    /* Filter again the rows preceding the slice, so that the window of the
+     * stream is the same as if it was compressed in one go. */
+    if (dict_y)
+        top = p->data[0] + (dict_y - 1) * p->linesize[0];
+    for (y = dict_y; y < y0; y++) {
+        const uint8_t *ptr = p->data[0] + y * p->linesize[0];
+        crow = png_choose_filter(s, crow_buf, ptr, top, row_size, bpp);
+        memcpy(sl->dict + dict_len, crow, row_size + 1);
+        dict_len += row_size + 1;
+        top = ptr;
+    }
+    if (dict_len && deflateSetDictionary(zstream, sl->dict, dict_len) != Z_OK)
+        return AVERROR_EXTERNAL;
+
+    sl->adler  = adler32(0, NULL, 0);
+    sl->in_len = 0;
+    for (y = y0; y < y1; y++) {
+        const uint8_t *ptr = p->data[0] + y * p->linesize[0];
+        crow = png_choose_filter(s, crow_buf, ptr, top, row_size, bpp);
+        sl->adler   = adler32(sl->adler, crow, row_size + 1);
+        sl->in_len += row_size + 1;
+        if ((ret = deflate_slice_data(zstream, sl, crow, row_size + 1, Z_NO_FLUSH)) < 0)
+            return ret;
+        top = ptr;
+    }
+    /* All but the last slice end on a byte boundary without a final block,
+     * so that the next one can be appended. */
+    ret = deflate_slice_data(zstream, sl, NULL, 0,
+                             jobnr == s->nb_slices - 1 ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret < 0)
+        return ret;
+    sl->len = zstream->next_out - sl->buf;
+
+    return 0;
+}
+
+/**
+ * Compress the image as several slices in parallel, each one primed with
+ * the last 32 KiB of the previous one, and concatenate them into a single
+ * zlib stream.
+ */
+static int encode_frame_slices(AVCodecContext *avctx, const AVFrame *pict)
+{
+    PNGEncContext *s = avctx->priv_data;
+    int level = s->compression_level == Z_DEFAULT_COMPRESSION ? 6 : s->compression_level;
+    int ret[MAX_DEFLATE_SLICES];
+    PNGEncSlice *last;
+    unsigned header;
+    uLong adler;
+
+    s->nb_slices = FFMIN(s->nb_deflate_slices, pict->height);
+    avctx->execute2(avctx, deflate_slice, (void *)pict, ret, s->nb_slices);
+    for (int i = 0; i < s->nb_slices; i++)
+        if (ret[i] < 0)
+            return ret[i];
+
+    /* zlib header, as written by deflate() */
+    header  = (Z_DEFLATED + ((MAX_WBITS - 8) << 4)) << 8;
+    header |= (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+    header += 31 - header % 31;
+    AV_WB16(s->slices[0].buf, header);
+
+    adler = s->slices[0].adler;
+    for (int i = 1; i < s->nb_slices; i++)
+        adler = adler32_combine(adler, s->slices[i].adler, s->slices[i].in_len);
+    last = &s->slices[s->nb_slices - 1];
+    if (last->buf_size - last->len < 4) {
+        uint8_t *buf = av_fast_realloc(last->buf, &last->buf_size, last->len + 4);
+        if (!buf)
+            return AVERROR(ENOMEM);
+        last->buf = buf;
+    }
+    AV_WB32(last->buf + last->len, adler);
+    last->len += 4;
+
+    for (int i = 0; i < s->nb_slices; i++) {
+        if (s->bytestream_end - s->bytestream < (int64_t)s->slices[i].len + 100)
+            return AVERROR_BUG;
+        png_write_image_data(avctx, s->slices[i].buf, s->slices[i].len);
+    }
+
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 {
     PNGEncContext *s       = avctx->priv_data;
@@ -517,6 +684,9 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
     uint8_t *progressive_buf = NULL;
     uint8_t *top_buf         = NULL;
 
+    if (s->nb_deflate_slices > 1 && !s->is_progressive)
+        return encode_frame_slices(avctx, pict);
+
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
     crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
@@ -1183,6 +1353,26 @@ static av_cold int png_enc_init(AVCodecContext *avctx)
     compression_level = avctx->compression_level == FF_COMPRESSION_DEFAULT
                       ? Z_DEFAULT_COMPRESSION
                       : av_clip(avctx->compression_level, 0, 9);
+    s->compression_level = compression_level;
+
+    if (s->nb_deflate_slices > 1) {
+        if (s->is_progressive)
+            av_log(avctx, AV_LOG_WARNING,
+                   "deflate_slices is not supported with interlacing, ignoring\n");
+        s->slices = av_calloc(s->nb_deflate_slices, sizeof(*s->slices));
+        s->slice_zstreams = av_calloc(FFMAX(avctx->thread_count, 1),
+                                      sizeof(*s->slice_zstreams));
+        if (!s->slices || !s->slice_zstreams)
+            return AVERROR(ENOMEM);
+        s->nb_slice_zstreams = FFMAX(avctx->thread_count, 1);
+        for (int i = 0; i < s->nb_slice_zstreams; i++) {
+            int ret = ff_deflate_init2(&s->slice_zstreams[i], compression_level,
+                                       -MAX_WBITS, avctx);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
     return ff_deflate_init(&s->zstream, compression_level, avctx);
 }
 
@@ -1191,6 +1381,17 @@ static av_cold int png_enc_close(AVCodecContext *avctx)
     PNGEncContext *s = avctx->priv_data;
 
     ff_deflate_end(&s->zstream);
+    for (int i = 0; i < s->nb_slice_zstreams; i++)
+        ff_deflate_end(&s->slice_zstreams[i]);
+    av_freep(&s->slice_zstreams);
+    if (s->slices) {
+        for (int i = 0; i < s->nb_deflate_slices; i++) {
+            av_freep(&s->slices[i].crow_base);
+            av_freep(&s->slices[i].dict);
+            av_freep(&s->slices[i].buf);
+        }
+        av_freep(&s->slices);
+    }
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1211,6 +1412,7 @@ static const AVOption options[] = {
         { "avg",   NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_AVG },   INT_MIN, INT_MAX, VE, .unit = "pred" },
         { "paeth", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_PAETH }, INT_MIN, INT_MAX, VE, .unit = "pred" },
         { "mixed", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_MIXED }, INT_MIN, INT_MAX, VE, .unit = "pred" },
+    { "deflate_slices", "Number of row ranges compressed in parallel (0 to use a single stream)", OFFSET(nb_deflate_slices), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, MAX_DEFLATE_SLICES, VE },
     { NULL},
 };
 
@@ -1227,6 +1429,7 @@ const FFCodec ff_png_encoder = {
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_PNG,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(PNGEncContext),
     .init           = png_enc_init,
@@ -1241,7 +1444,7 @@ const FFCodec ff_png_encoder = {
         AV_PIX_FMT_MONOBLACK, AV_PIX_FMT_NONE
     },
     .p.priv_class   = &pngenc_class,
-    .caps_internal  = FF_CODEC_CAP_ICC_PROFILES,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP | FF_CODEC_CAP_ICC_PROFILES,
 };
 
 const FFCodec ff_apng_encoder = {
@@ -1250,6 +1453,7 @@ const FFCodec ff_apng_encoder = {
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_APNG,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(PNGEncContext),
     .init           = png_enc_init,
@@ -1264,5 +1468,5 @@ const FFCodec ff_apng_encoder = {
         AV_PIX_FMT_NONE
     },
     .p.priv_class   = &pngenc_class,
-    .caps_internal  = FF_CODEC_CAP_ICC_PROFILES,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP | FF_CODEC_CAP_ICC_PROFILES,
 };
@@ -27,7 +27,6 @@
 #include "libavutil/macros.h"
 #include "libavutil/mem.h"
 #include "libavutil/mem_internal.h"
-#include "libavutil/thread.h"
 
 #ifndef REFSTRUCT_CHECKED
 #ifndef ASSERT_LEVEL
@@ -188,36 +187,74 @@ struct FFRefStructPool {
     void (*free_entry_cb)(FFRefStructOpaque opaque, void *obj);
     void (*free_cb)(FFRefStructOpaque opaque);
 
-    int uninited;
+    atomic_int uninited;
     unsigned entry_flags;
     unsigned pool_flags;
 
     /** The number of outstanding entries not in available_entries. */
     atomic_uintptr_t refcount;
     /**
-     * This is a linked list of available entries;
+     * This is a lock-free stack (a RefCount*) of available entries;
      * the RefCount's opaque pointer is used as next pointer
      * for available entries.
      * While the entries are in use, the opaque is a pointer
      * to the corresponding FFRefStructPool.
+     *
+     * Entries are only ever pushed individually; popping is done by
+     * taking the whole list at once, which makes it immune to the
+     * ABA problem of popping single entries.
      */
-    RefCount *available_entries;
-    AVMutex mutex;
+    atomic_intptr_t available_entries;
+    /**
+     * The number of threads that might have taken available_entries
+     * and not yet put back the entries they do not need. Allows
+     * to distinguish an empty pool from one that is just in use.
+     */
+    atomic_int nb_popping;
 };
 
+#define POOL_MAX_RETRIES 64
+
+static void pool_free_entry(FFRefStructPool *pool, RefCount *ref)
+{
+    if (pool->free_entry_cb)
+        pool->free_entry_cb(pool->opaque, get_userdata(ref));
+    av_free(ref);
+}
+
+static void pool_free_entries(FFRefStructPool *pool, RefCount *entry)
+{
+    while (entry) {
+        void *next = entry->opaque.nc;
+        pool_free_entry(pool, entry);
+        entry = next;
+    }
+}
+
 static void pool_free(FFRefStructPool *pool)
 {
-    ff_mutex_destroy(&pool->mutex);
+    /* Entries returned concurrently with refstruct_pool_uninit()
+     * may still be on the list. */
+    pool_free_entries(pool, (RefCount*)atomic_load_explicit(&pool->available_entries,
+                                                            memory_order_acquire));
     if (pool->free_cb)
         pool->free_cb(pool->opaque);
     av_free(get_refcount(pool));
 }
 
-static void pool_free_entry(FFRefStructPool *pool, RefCount *ref)
+/**
+ * Push the list of entries from first to last onto the available entries.
+ */
+static void pool_push_entries(FFRefStructPool *pool, RefCount *first, RefCount *last)
 {
-    if (pool->free_entry_cb)
-        pool->free_entry_cb(pool->opaque, get_userdata(ref));
-    av_free(ref);
+    intptr_t head = atomic_load_explicit(&pool->available_entries,
+                                         memory_order_relaxed);
+    do {
+        last->opaque.nc = (RefCount*)head;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->available_entries,
+                                                    &head, (intptr_t)first,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
 }
 
 static void pool_return_entry(void *ref_)
@@ -225,21 +262,56 @@ static void pool_return_entry(void *ref_)
     RefCount *ref = ref_;
     FFRefStructPool *pool = ref->opaque.nc;
 
-    ff_mutex_lock(&pool->mutex);
-    if (!pool->uninited) {
-        ref->opaque.nc = pool->available_entries;
-        pool->available_entries = ref;
-        ref = NULL;
-    }
-    ff_mutex_unlock(&pool->mutex);
-
-    if (ref)
+    if (!atomic_load_explicit(&pool->uninited, memory_order_relaxed))
+        pool_push_entries(pool, ref, ref);
+    else
         pool_free_entry(pool, ref);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         pool_free(pool);
 }
 
+/**
+ * Take an available entry, if any.
+ */
+static RefCount *pool_pop_entry(FFRefStructPool *pool)
+{
+    RefCount *ref, *rest, *last;
+    intptr_t expected = 0;
+
+    for (int retries = 0;; retries++) {
+        atomic_fetch_add_explicit(&pool->nb_popping, 1, memory_order_relaxed);
+        ref = (RefCount*)atomic_exchange_explicit(&pool->available_entries, 0,
+                                                  memory_order_acquire);
+        if (ref)
+            break;
+        // Only allocate a new entry if the pool is really empty, not when
+        // another thread is just about to put the other entries back;
+        // otherwise the pool would grow with every such collision.
+        if (atomic_fetch_sub_explicit(&pool->nb_popping, 1, memory_order_relaxed) == 1 ||
+            retries >= POOL_MAX_RETRIES)
+            return NULL;
+    }
+
+    rest = ref->opaque.nc;
+    if (!rest)
+        goto end;
+
+    // Put the remaining entries back; this is a single store unless other
+    // entries have been returned in the meantime.
+    if (!atomic_compare_exchange_strong_explicit(&pool->available_entries,
+                                                 &expected, (intptr_t)rest,
+                                                 memory_order_release,
+                                                 memory_order_relaxed)) {
+        for (last = rest; last->opaque.nc; last = last->opaque.nc);
+        pool_push_entries(pool, rest, last);
+    }
+
+end:
+    atomic_fetch_sub_explicit(&pool->nb_popping, 1, memory_order_release);
+    return ref;
+}
+
 static void pool_reset_entry(FFRefStructOpaque opaque, void *entry)
 {
     FFRefStructPool *pool = opaque.nc;
@@ -250,22 +322,17 @@ static void pool_reset_entry(FFRefStructOpaque opaque, void *entry)
 static int refstruct_pool_get_ext(void *datap, FFRefStructPool *pool)
 {
     void *ret = NULL;
+    RefCount *ref;
 
     memcpy(datap, &(void *){ NULL }, sizeof(void*));
 
-    ff_mutex_lock(&pool->mutex);
-    ff_assert(!pool->uninited);
-    if (pool->available_entries) {
-        RefCount *ref = pool->available_entries;
+    ff_assert(!atomic_load_explicit(&pool->uninited, memory_order_relaxed));
+    ref = pool_pop_entry(pool);
+    if (ref) {
         ret = get_userdata(ref);
-        pool->available_entries = ref->opaque.nc;
         ref->opaque.nc = pool;
         atomic_init(&ref->refcount, 1);
-    }
-    ff_mutex_unlock(&pool->mutex);
-
-    if (!ret) {
-        RefCount *ref;
+    } else {
         ret = ff_refstruct_alloc_ext(pool->size, pool->entry_flags, pool,
                                      pool->reset_cb ? pool_reset_entry : NULL);
         if (!ret)
@@ -318,18 +385,11 @@ static void refstruct_pool_uninit(FFRefStructOpaque unused, void *obj)
     FFRefStructPool *pool = obj;
     RefCount *entry;
 
-    ff_mutex_lock(&pool->mutex);
-    ff_assert(!pool->uninited);
-    pool->uninited = 1;
-    entry = pool->available_entries;
-    pool->available_entries = NULL;
-    ff_mutex_unlock(&pool->mutex);
-
-    while (entry) {
-        void *next = entry->opaque.nc;
-        pool_free_entry(pool, entry);
-        entry = next;
-    }
+    ff_assert(!atomic_load_explicit(&pool->uninited, memory_order_relaxed));
+    atomic_store_explicit(&pool->uninited, 1, memory_order_relaxed);
+    entry = (RefCount*)atomic_exchange_explicit(&pool->available_entries, 0,
+                                                memory_order_acquire);
+    pool_free_entries(pool, entry);
 }
 
 FFRefStructPool *ff_refstruct_pool_alloc(size_t size, unsigned flags)
@@ -346,7 +406,6 @@ FFRefStructPool *ff_refstruct_pool_alloc_ext_c(size_t size, unsigned flags,
 {
     FFRefStructPool *pool = ff_refstruct_alloc_ext(sizeof(*pool), 0, NULL,
                                                    refstruct_pool_uninit);
-    int err;
 
     if (!pool)
         return NULL;
@@ -374,13 +433,9 @@ FFRefStructPool *ff_refstruct_pool_alloc_ext_c(size_t size, unsigned flags,
     }
 
     atomic_init(&pool->refcount, 1);
+    atomic_init(&pool->uninited, 0);
+    atomic_init(&pool->available_entries, 0);
+    atomic_init(&pool->nb_popping, 0);
 
-    err = ff_mutex_init(&pool->mutex, NULL);
-    if (err) {
-        // Don't call ff_refstruct_uninit() on pool, as it hasn't been properly
-        // set up and is just a POD right now.
-        av_free(get_refcount(pool));
-        return NULL;
-    }
     return pool;
 }
@@ -322,7 +322,7 @@ void ff_snow_pred_block(SnowContext *s, uint8_t *dst, uint8_t *tmp, ptrdiff_t st
             }
         }
     }else{
-        const uint8_t *src = s->last_picture[block->ref]->data[plane_index];
+        const uint8_t *src = s->last_picture[block->ref].f->data[plane_index];
         const int scale= plane_index ?  (2*s->mv_scale)>>s->chroma_h_shift : 2*s->mv_scale;
         int mx= block->mx*scale;
         int my= block->my*scale;
@@ -432,14 +432,14 @@ av_cold int ff_snow_common_init(AVCodecContext *avctx){
         return AVERROR(ENOMEM);
 
     for(i=0; i<MAX_REF_FRAMES; i++) {
-        s->last_picture[i] = av_frame_alloc();
-        if (!s->last_picture[i])
+        s->last_picture[i].f = av_frame_alloc();
+        if (!s->last_picture[i].f)
             return AVERROR(ENOMEM);
     }
 
     s->mconly_picture = av_frame_alloc();
-    s->current_picture = av_frame_alloc();
-    if (!s->mconly_picture || !s->current_picture)
+    s->current_picture.f = av_frame_alloc();
+    if (!s->mconly_picture || !s->current_picture.f)
         return AVERROR(ENOMEM);
 
     ff_thread_once(&init_static_once, snow_static_init);
@@ -460,9 +460,15 @@ int ff_snow_common_init_after_header(AVCodecContext *avctx) {
     }
 
     for(plane_index=0; plane_index < s->nb_planes; plane_index++){
+        DWTELEM  *dwt_buffer = s->spatial_dwt_buffer;
+        IDWTELEM *idwt_buffer= s->spatial_idwt_buffer;
         int w= s->avctx->width;
         int h= s->avctx->height;
 
+        if (s->plane_dwt_buffer[plane_index]) {
+            dwt_buffer = s->plane_dwt_buffer[plane_index];
+            idwt_buffer= s->plane_idwt_buffer[plane_index];
+        }
         if(plane_index){
             w = AV_CEIL_RSHIFT(w, s->chroma_h_shift);
             h = AV_CEIL_RSHIFT(h, s->chroma_v_shift);
@@ -474,7 +480,7 @@ int ff_snow_common_init_after_header(AVCodecContext *avctx) {
             for(orientation=level ? 1 : 0; orientation<4; orientation++){
                 SubBand *b= &s->plane[plane_index].band[level][orientation];
 
-                b->buf= s->spatial_dwt_buffer;
+                b->buf= dwt_buffer;
                 b->level= level;
                 b->stride= s->plane[plane_index].width << (s->spatial_decomposition_count - level);
                 b->width = (w + !(orientation&1))>>1;
@@ -492,7 +498,7 @@ int ff_snow_common_init_after_header(AVCodecContext *avctx) {
                     b->buf += b->stride>>1;
                     b->buf_y_offset = b->stride_line >> 1;
                 }
-                b->ibuf= s->spatial_idwt_buffer + (b->buf - s->spatial_dwt_buffer);
+                b->ibuf= idwt_buffer + (b->buf - dwt_buffer);
 
                 if(level)
                     b->parent= &s->plane[plane_index].band[level-1][orientation];
@@ -515,14 +521,14 @@ void ff_snow_release_buffer(AVCodecContext *avctx)
 {
     SnowContext *s = avctx->priv_data;
 
-    if(s->last_picture[s->max_ref_frames-1]->data[0]){
-        av_frame_unref(s->last_picture[s->max_ref_frames-1]);
+    if(s->last_picture[s->max_ref_frames-1].f->data[0]){
+        ff_thread_release_ext_buffer(&s->last_picture[s->max_ref_frames-1]);
     }
 }
 
 int ff_snow_frames_prepare(SnowContext *s)
 {
-   AVFrame *tmp;
+   ThreadFrame tmp;
 
     ff_snow_release_buffer(s->avctx);
 
@@ -534,18 +540,18 @@ int ff_snow_frames_prepare(SnowContext *s)
 
     if(s->keyframe){
         s->ref_frames= 0;
-        s->current_picture->flags |= AV_FRAME_FLAG_KEY;
+        s->current_picture.f->flags |= AV_FRAME_FLAG_KEY;
     }else{
         int i;
-        for(i=0; i<s->max_ref_frames && s->last_picture[i]->data[0]; i++)
-            if(i && (s->last_picture[i-1]->flags & AV_FRAME_FLAG_KEY))
+        for(i=0; i<s->max_ref_frames && s->last_picture[i].f->data[0]; i++)
+            if(i && (s->last_picture[i-1].f->flags & AV_FRAME_FLAG_KEY))
                 break;
         s->ref_frames= i;
         if(s->ref_frames==0){
             av_log(s->avctx,AV_LOG_ERROR, "No reference frames\n");
             return AVERROR_INVALIDDATA;
         }
-        s->current_picture->flags &= ~AV_FRAME_FLAG_KEY;
+        s->current_picture.f->flags &= ~AV_FRAME_FLAG_KEY;
     }
 
     return 0;
@@ -566,10 +572,11 @@ av_cold void ff_snow_common_end(SnowContext *s)
     av_freep(&s->emu_edge_buffer);
 
     for(i=0; i<MAX_REF_FRAMES; i++){
-        if(s->last_picture[i] && s->last_picture[i]->data[0]) {
-            av_assert0(s->last_picture[i]->data[0] != s->current_picture->data[0]);
+        if(s->last_picture[i].f && s->last_picture[i].f->data[0]) {
+            av_assert0(s->last_picture[i].f->data[0] != s->current_picture.f->data[0]);
         }
-        av_frame_free(&s->last_picture[i]);
+        ff_thread_release_ext_buffer(&s->last_picture[i]);
+        av_frame_free(&s->last_picture[i].f);
     }
 
     for(plane_index=0; plane_index < MAX_PLANES; plane_index++){
@@ -582,5 +589,6 @@ av_cold void ff_snow_common_end(SnowContext *s)
         }
     }
     av_frame_free(&s->mconly_picture);
-    av_frame_free(&s->current_picture);
+    ff_thread_release_ext_buffer(&s->current_picture);
+    av_frame_free(&s->current_picture.f);
 }
@@ -27,6 +27,7 @@
 #include "avcodec.h"
 #include "hpeldsp.h"
 #include "snow_dwt.h"
+#include "threadframe.h"
 
 #include "rangecoder.h"
 #include "mathops.h"
@@ -119,8 +120,8 @@ typedef struct SnowContext{
     H264QpelContext h264qpel;
     SnowDWTContext dwt;
     AVFrame *input_picture;              ///< new_picture with the internal linesizes
-    AVFrame *current_picture;
-    AVFrame *last_picture[MAX_REF_FRAMES];
+    ThreadFrame current_picture;
+    ThreadFrame last_picture[MAX_REF_FRAMES];
     AVFrame *mconly_picture;
 //     uint8_t q_context[16];
     uint8_t header_state[32];
@@ -161,7 +162,12 @@ typedef struct SnowContext{
     int nb_planes;
     Plane plane[MAX_PLANES];
     BlockNode *block;
-    slice_buffer sb;
+    slice_buffer sb[MAX_PLANES];         ///< decoder only, one per plane so that planes can be reconstructed concurrently
+    IDWTELEM *plane_temp_idwt[MAX_PLANES];
+    uint8_t *plane_scratchbuf[MAX_PLANES];
+    DWTELEM *plane_dwt_buffer[MAX_PLANES];  ///< encoder only, one per plane so that planes can be transformed concurrently
+    IDWTELEM *plane_idwt_buffer[MAX_PLANES];
+    DWTELEM *plane_temp_dwt[MAX_PLANES];
 
     uint8_t *scratchbuf;
     uint8_t *emu_edge_buffer;
@@ -217,7 +223,7 @@ static av_always_inline int same_block(BlockNode *a, BlockNode *b){
 
 //FIXME name cleanup (b_w, block_w, b_width stuff)
 //XXX should we really inline it?
-static av_always_inline void add_yblock(SnowContext *s, int sliced, slice_buffer *sb, IDWTELEM *dst, uint8_t *dst8, const uint8_t *obmc, int src_x, int src_y, int b_w, int b_h, int w, int h, int dst_stride, int src_stride, int obmc_stride, int b_x, int b_y, int add, int offset_dst, int plane_index){
+static av_always_inline void add_yblock(SnowContext *s, int sliced, slice_buffer *sb, IDWTELEM *dst, uint8_t *dst8, const uint8_t *obmc, int src_x, int src_y, int b_w, int b_h, int w, int h, int dst_stride, int src_stride, int obmc_stride, int b_x, int b_y, int add, int offset_dst, int plane_index, uint8_t *tmp){
     const int b_width = s->b_width  << s->block_max_depth;
     const int b_height= s->b_height << s->block_max_depth;
     const int b_stride= b_width;
@@ -229,7 +235,6 @@ static av_always_inline void add_yblock(SnowContext *s, int sliced, slice_buffer
     // When src_stride is large enough, it is possible to interleave the blocks.
     // Otherwise the blocks are written sequentially in the tmp buffer.
     int tmp_step= src_stride >= 7*MB_SIZE ? MB_SIZE : MB_SIZE*src_stride;
-    uint8_t *tmp = s->scratchbuf;
     uint8_t *ptmp;
     int x,y;
 
@@ -351,8 +356,8 @@ static av_always_inline void predict_slice(SnowContext *s, IDWTELEM *buf, int pl
     int block_h    = plane_index ? block_size>>s->chroma_v_shift : block_size;
     const uint8_t *obmc  = plane_index ? ff_obmc_tab[s->block_max_depth+s->chroma_h_shift] : ff_obmc_tab[s->block_max_depth];
     const int obmc_stride= plane_index ? (2*block_size)>>s->chroma_h_shift : 2*block_size;
-    int ref_stride= s->current_picture->linesize[plane_index];
-    uint8_t *dst8= s->current_picture->data[plane_index];
+    int ref_stride= s->current_picture.f->linesize[plane_index];
+    uint8_t *dst8= s->current_picture.f->data[plane_index];
     int w= p->width;
     int h= p->height;
     av_assert2(s->chroma_h_shift == s->chroma_v_shift); // obmc params assume squares
@@ -388,7 +393,7 @@ static av_always_inline void predict_slice(SnowContext *s, IDWTELEM *buf, int pl
                    w, h,
                    w, ref_stride, obmc_stride,
                    mb_x - 1, mb_y - 1,
-                   add, 1, plane_index);
+                   add, 1, plane_index, s->plane_scratchbuf[plane_index]);
     }
 }
 
@@ -27,6 +27,7 @@
 #include "decode.h"
 #include "snow_dwt.h"
 #include "snow.h"
+#include "thread.h"
 
 #include "rangecoder.h"
 #include "mathops.h"
@@ -188,8 +189,8 @@ static av_always_inline void predict_slice_buffered(SnowContext *s, slice_buffer
     int block_h    = plane_index ? block_size>>s->chroma_v_shift : block_size;
     const uint8_t *obmc  = plane_index ? ff_obmc_tab[s->block_max_depth+s->chroma_h_shift] : ff_obmc_tab[s->block_max_depth];
     int obmc_stride= plane_index ? (2*block_size)>>s->chroma_h_shift : 2*block_size;
-    int ref_stride= s->current_picture->linesize[plane_index];
-    uint8_t *dst8= s->current_picture->data[plane_index];
+    int ref_stride= s->current_picture.f->linesize[plane_index];
+    uint8_t *dst8= s->current_picture.f->data[plane_index];
     int w= p->width;
     int h= p->height;
 
@@ -231,7 +232,7 @@ static av_always_inline void predict_slice_buffered(SnowContext *s, slice_buffer
                    w, h,
                    w, ref_stride, obmc_stride,
                    mb_x - 1, mb_y - 1,
-                   add, 0, plane_index);
+                   add, 0, plane_index, s->plane_scratchbuf[plane_index]);
     }
 
     if(s->avmv && mb_y < mb_h && plane_index == 0)
@@ -585,6 +586,104 @@ static int decode_blocks(SnowContext *s){
     return 0;
 }
 
+static void await_references(SnowContext *s)
+{
+    for (int i = 0; i < s->ref_frames; i++)
+        ff_thread_await_progress(&s->last_picture[i], INT_MAX, 0);
+}
+
+/**
+ * Run the inverse wavelet transform and the overlapped block motion
+ * compensation of one plane. The coefficients must already have been
+ * unpacked, so that the planes do not depend on each other anymore.
+ */
+static int reconstruct_plane(AVCodecContext *avctx, void *arg, int plane_index, int threadnr)
+{
+    SnowContext *s = avctx->priv_data;
+    Plane *p= &s->plane[plane_index];
+    slice_buffer *sb = &s->sb[plane_index];
+    int w= p->width;
+    int h= p->height;
+    int level, orientation, x;
+    int decode_state[MAX_DECOMPOSITIONS][4][1]; /* Stored state info for unpack_coeffs. 1 variable per instance. */
+    const int mb_h= s->b_height << s->block_max_depth;
+    const int block_size = MB_SIZE >> s->block_max_depth;
+    const int block_h    = plane_index ? block_size>>s->chroma_v_shift : block_size;
+    int mb_y;
+    DWTCompose cs[MAX_DECOMPOSITIONS];
+    int yd=0, yq=0;
+    int y;
+    int end_y;
+
+    ff_spatial_idwt_buffered_init(cs, sb, w, h, 1, s->spatial_decomposition_type, s->spatial_decomposition_count);
+    for(mb_y=0; mb_y<=mb_h; mb_y++){
+
+        int slice_starty = block_h*mb_y;
+        int slice_h = block_h*(mb_y+1);
+
+        if (!(s->keyframe || s->avctx->debug&512)){
+            slice_starty = FFMAX(0, slice_starty - (block_h >> 1));
+            slice_h -= (block_h >> 1);
+        }
+
+        for(level=0; level<s->spatial_decomposition_count; level++){
+            for(orientation=level ? 1 : 0; orientation<4; orientation++){
+                SubBand *b= &p->band[level][orientation];
+                int start_y;
+                int end_y;
+                int our_mb_start = mb_y;
+                int our_mb_end = (mb_y + 1);
+                const int extra= 3;
+                start_y = (mb_y ? ((block_h * our_mb_start) >> (s->spatial_decomposition_count - level)) + s->spatial_decomposition_count - level + extra: 0);
+                end_y = (((block_h * our_mb_end) >> (s->spatial_decomposition_count - level)) + s->spatial_decomposition_count - level + extra);
+                if (!(s->keyframe || s->avctx->debug&512)){
+                    start_y = FFMAX(0, start_y - (block_h >> (1+s->spatial_decomposition_count - level)));
+                    end_y = FFMAX(0, end_y - (block_h >> (1+s->spatial_decomposition_count - level)));
+                }
+                start_y = FFMIN(b->height, start_y);
+                end_y = FFMIN(b->height, end_y);
+
+                if (start_y != end_y){
+                    if (orientation == 0){
+                        SubBand * correlate_band = &p->band[0][0];
+                        int correlate_end_y = FFMIN(b->height, end_y + 1);
+                        int correlate_start_y = FFMIN(b->height, (start_y ? start_y + 1 : 0));
+                        decode_subband_slice_buffered(s, correlate_band, sb, correlate_start_y, correlate_end_y, decode_state[0][0]);
+                        correlate_slice_buffered(s, sb, correlate_band, correlate_band->ibuf, correlate_band->stride, 1, 0, correlate_start_y, correlate_end_y);
+                        dequantize_slice_buffered(s, sb, correlate_band, correlate_band->ibuf, correlate_band->stride, start_y, end_y);
+                    }
+                    else
+                        decode_subband_slice_buffered(s, b, sb, start_y, end_y, decode_state[level][orientation]);
+                }
+            }
+        }
+
+        for(; yd<slice_h; yd+=4){
+            ff_spatial_idwt_buffered_slice(&s->dwt, cs, sb, s->plane_temp_idwt[plane_index], w, h, 1, s->spatial_decomposition_type, s->spatial_decomposition_count, yd);
+        }
+
+        if(s->qlog == LOSSLESS_QLOG){
+            for(; yq<slice_h && yq<h; yq++){
+                IDWTELEM * line = slice_buffer_get_line(sb, yq);
+                for(x=0; x<w; x++){
+                    line[x] *= 1<<FRAC_BITS;
+                }
+            }
+        }
+
+        predict_slice_buffered(s, sb, s->spatial_idwt_buffer, plane_index, 1, mb_y);
+
+        y = FFMIN(p->height, slice_starty);
+        end_y = FFMIN(p->height, slice_h);
+        while(y < end_y)
+            ff_slice_buffer_release(sb, y++);
+    }
+
+    ff_slice_buffer_flush(sb);
+
+    return 0;
+}
+
 static int decode_frame(AVCodecContext *avctx, AVFrame *picture,
                         int *got_frame, AVPacket *avpkt)
 {
@@ -599,7 +698,7 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *picture,
     ff_init_range_decoder(c, buf, buf_size);
     ff_build_rac_states(c, 0.05*(1LL<<32), 256-8);
 
-    s->current_picture->pict_type= AV_PICTURE_TYPE_I; //FIXME I vs. P
+    s->current_picture.f->pict_type= AV_PICTURE_TYPE_I; //FIXME I vs. P
     if ((res = decode_header(s)) < 0)
         return res;
 
@@ -616,14 +715,22 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *picture,
     if ((res=ff_snow_common_init_after_header(avctx)) < 0)
         return res;
 
-    // realloc slice buffer for the case that spatial_decomposition_count changed
-    ff_slice_buffer_destroy(&s->sb);
-    if ((res = ff_slice_buffer_init(&s->sb, s->plane[0].height,
-                                    (MB_SIZE >> s->block_max_depth) +
-                                    s->spatial_decomposition_count * 11 + 1,
-                                    s->plane[0].width,
-                                    s->spatial_idwt_buffer)) < 0)
-        return res;
+    // realloc slice buffers for the case that spatial_decomposition_count changed
+    for (int i = 0; i < s->nb_planes; i++) {
+        ff_slice_buffer_destroy(&s->sb[i]);
+        if ((res = ff_slice_buffer_init(&s->sb[i], s->plane[i].height,
+                                        (MB_SIZE >> s->block_max_depth) +
+                                        s->spatial_decomposition_count * 11 + 1,
+                                        s->plane[i].width,
+                                        s->spatial_idwt_buffer)) < 0)
+            return res;
+        if (!s->plane_temp_idwt[i]) {
+            int scratch_size = FFMAX(s->mconly_picture->linesize[0], 2*avctx->width+256) * 7 * MB_SIZE;
+            if (!FF_ALLOCZ_TYPED_ARRAY(s->plane_temp_idwt[i],  avctx->width) ||
+                !FF_ALLOCZ_TYPED_ARRAY(s->plane_scratchbuf[i], scratch_size))
+                return AVERROR(ENOMEM);
+        }
+    }
 
     for(plane_index=0; plane_index < s->nb_planes; plane_index++){
         Plane *p= &s->plane[plane_index];
@@ -637,13 +744,13 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *picture,
     if ((res = ff_snow_frames_prepare(s)) < 0)
         return res;
 
-    s->current_picture->width  = s->avctx->width;
-    s->current_picture->height = s->avctx->height;
-    res = ff_get_buffer(s->avctx, s->current_picture, AV_GET_BUFFER_FLAG_REF);
+    s->current_picture.f->width  = s->avctx->width;
+    s->current_picture.f->height = s->avctx->height;
+    res = ff_thread_get_ext_buffer(s->avctx, &s->current_picture, AV_GET_BUFFER_FLAG_REF);
     if (res < 0)
         return res;
 
-    s->current_picture->pict_type = s->keyframe ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_P;
+    s->current_picture.f->pict_type = s->keyframe ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_P;
 
     //keyframe flag duplication mess FIXME
     if(avctx->debug&FF_DEBUG_PICT_INFO)
@@ -659,10 +766,12 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *picture,
         size_t size;
         res = av_size_mult(s->b_width * s->b_height, sizeof(AVMotionVector) << (s->block_max_depth*2), &size);
         if (res)
-            return res;
+            goto fail;
         av_fast_malloc(&s->avmv, &s->avmv_size, size);
-        if (!s->avmv)
-            return AVERROR(ENOMEM);
+        if (!s->avmv) {
+            res = AVERROR(ENOMEM);
+            goto fail;
+        }
     } else {
         s->avmv_size = 0;
         av_freep(&s->avmv);
@@ -670,14 +779,16 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *picture,
     s->avmv_index = 0;
 
     if ((res = decode_blocks(s)) < 0)
-        return res;
+        goto fail;
+
+    if (s->avctx->debug&2048)
+        await_references(s);
 
     for(plane_index=0; plane_index < s->nb_planes; plane_index++){
         Plane *p= &s->plane[plane_index];
         int w= p->width;
         int h= p->height;
         int x, y;
-        int decode_state[MAX_DECOMPOSITIONS][4][1]; /* Stored state info for unpack_coeffs. 1 variable per instance. */
 
         if(s->avctx->debug&2048){
             memset(s->spatial_dwt_buffer, 0, sizeof(DWTELEM)*w*h);
@@ -685,7 +796,7 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *picture,
 
             for(y=0; y<h; y++){
                 for(x=0; x<w; x++){
-                    int v= s->current_picture->data[plane_index][y*s->current_picture->linesize[plane_index] + x];
+                    int v= s->current_picture.f->data[plane_index][y*s->current_picture.f->linesize[plane_index] + x];
                     s->mconly_picture->data[plane_index][y*s->mconly_picture->linesize[plane_index] + x]= v;
                 }
             }
@@ -697,92 +808,24 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *picture,
                 unpack_coeffs(s, b, b->parent, orientation);
             }
         }
+    }
 
-        {
-        const int mb_h= s->b_height << s->block_max_depth;
-        const int block_size = MB_SIZE >> s->block_max_depth;
-        const int block_h    = plane_index ? block_size>>s->chroma_v_shift : block_size;
-        int mb_y;
-        DWTCompose cs[MAX_DECOMPOSITIONS];
-        int yd=0, yq=0;
-        int y;
-        int end_y;
-
-        ff_spatial_idwt_buffered_init(cs, &s->sb, w, h, 1, s->spatial_decomposition_type, s->spatial_decomposition_count);
-        for(mb_y=0; mb_y<=mb_h; mb_y++){
-
-            int slice_starty = block_h*mb_y;
-            int slice_h = block_h*(mb_y+1);
-
-            if (!(s->keyframe || s->avctx->debug&512)){
-                slice_starty = FFMAX(0, slice_starty - (block_h >> 1));
-                slice_h -= (block_h >> 1);
-            }
-
-            for(level=0; level<s->spatial_decomposition_count; level++){
-                for(orientation=level ? 1 : 0; orientation<4; orientation++){
-                    SubBand *b= &p->band[level][orientation];
-                    int start_y;
-                    int end_y;
-                    int our_mb_start = mb_y;
-                    int our_mb_end = (mb_y + 1);
-                    const int extra= 3;
-                    start_y = (mb_y ? ((block_h * our_mb_start) >> (s->spatial_decomposition_count - level)) + s->spatial_decomposition_count - level + extra: 0);
-                    end_y = (((block_h * our_mb_end) >> (s->spatial_decomposition_count - level)) + s->spatial_decomposition_count - level + extra);
-                    if (!(s->keyframe || s->avctx->debug&512)){
-                        start_y = FFMAX(0, start_y - (block_h >> (1+s->spatial_decomposition_count - level)));
-                        end_y = FFMAX(0, end_y - (block_h >> (1+s->spatial_decomposition_count - level)));
-                    }
-                    start_y = FFMIN(b->height, start_y);
-                    end_y = FFMIN(b->height, end_y);
-
-                    if (start_y != end_y){
-                        if (orientation == 0){
-                            SubBand * correlate_band = &p->band[0][0];
-                            int correlate_end_y = FFMIN(b->height, end_y + 1);
-                            int correlate_start_y = FFMIN(b->height, (start_y ? start_y + 1 : 0));
-                            decode_subband_slice_buffered(s, correlate_band, &s->sb, correlate_start_y, correlate_end_y, decode_state[0][0]);
-                            correlate_slice_buffered(s, &s->sb, correlate_band, correlate_band->ibuf, correlate_band->stride, 1, 0, correlate_start_y, correlate_end_y);
-                            dequantize_slice_buffered(s, &s->sb, correlate_band, correlate_band->ibuf, correlate_band->stride, start_y, end_y);
-                        }
-                        else
-                            decode_subband_slice_buffered(s, b, &s->sb, start_y, end_y, decode_state[level][orientation]);
-                    }
-                }
-            }
-
-            for(; yd<slice_h; yd+=4){
-                ff_spatial_idwt_buffered_slice(&s->dwt, cs, &s->sb, s->temp_idwt_buffer, w, h, 1, s->spatial_decomposition_type, s->spatial_decomposition_count, yd);
-            }
-
-            if(s->qlog == LOSSLESS_QLOG){
-                for(; yq<slice_h && yq<h; yq++){
-                    IDWTELEM * line = slice_buffer_get_line(&s->sb, yq);
-                    for(x=0; x<w; x++){
-                        line[x] *= 1<<FRAC_BITS;
-                    }
-                }
-            }
+    /* All range coded data has been read, the next frame can start with
+     * the header and context states of this one. */
+    ff_thread_finish_setup(avctx);
 
-            predict_slice_buffered(s, &s->sb, s->spatial_idwt_buffer, plane_index, 1, mb_y);
+    await_references(s);
 
-            y = FFMIN(p->height, slice_starty);
-            end_y = FFMIN(p->height, slice_h);
-            while(y < end_y)
-                ff_slice_buffer_release(&s->sb, y++);
-        }
-
-        ff_slice_buffer_flush(&s->sb);
-        }
-
-    }
+    avctx->execute2(avctx, reconstruct_plane, NULL, NULL, s->nb_planes);
 
     emms_c();
 
+    ff_thread_report_progress(&s->current_picture, INT_MAX, 0);
+
     ff_snow_release_buffer(avctx);
 
     if(!(s->avctx->debug&2048))
-        res = av_frame_ref(picture, s->current_picture);
+        res = av_frame_ref(picture, s->current_picture.f);
     else
         res = av_frame_ref(picture, s->mconly_picture);
     if (res >= 0 && s->avmv_index) {
@@ -803,13 +846,91 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *picture,
     if(bytes_read ==0) av_log(s->avctx, AV_LOG_ERROR, "error at end of frame\n"); //FIXME
 
     return bytes_read;
+fail:
+    ff_thread_report_progress(&s->current_picture, INT_MAX, 0);
+    return res;
+}
+
+#if HAVE_THREADS
+static int update_thread_context(AVCodecContext *dst, const AVCodecContext *src)
+{
+    SnowContext *s = dst->priv_data;
+    const SnowContext *s1 = src->priv_data;
+    int ret;
+
+    if (dst == src)
+        return 0;
+
+    s->always_reset                 = s1->always_reset;
+    s->version                      = s1->version;
+    s->spatial_decomposition_type   = s1->spatial_decomposition_type;
+    s->spatial_decomposition_count  = s1->spatial_decomposition_count;
+    s->temporal_decomposition_type  = s1->temporal_decomposition_type;
+    s->temporal_decomposition_count = s1->temporal_decomposition_count;
+    s->max_ref_frames               = s1->max_ref_frames;
+    s->colorspace_type              = s1->colorspace_type;
+    s->chroma_h_shift               = s1->chroma_h_shift;
+    s->chroma_v_shift               = s1->chroma_v_shift;
+    s->nb_planes                    = s1->nb_planes;
+    s->spatial_scalability          = s1->spatial_scalability;
+    s->qlog                         = s1->qlog;
+    s->mv_scale                     = s1->mv_scale;
+    s->qbias                        = s1->qbias;
+    s->block_max_depth              = s1->block_max_depth;
+
+    /* The context states are only reset on keyframes. Planes beyond
+     * nb_planes can only come into use after a keyframe, but a later
+     * header can raise the decomposition count, so copy all levels. */
+    memcpy(s->header_state, s1->header_state, sizeof(s->header_state));
+    memcpy(s->block_state,  s1->block_state,  sizeof(s->block_state));
+    for (int plane_index = 0; plane_index < s->nb_planes; plane_index++) {
+        Plane *p = &s->plane[plane_index];
+        const Plane *p1 = &s1->plane[plane_index];
+
+        p->htaps   = p1->htaps;
+        p->diag_mc = p1->diag_mc;
+        memcpy(p->hcoeff, p1->hcoeff, sizeof(p->hcoeff));
+        for (int level = 0; level < MAX_DECOMPOSITIONS; level++) {
+            for (int orientation = level ? 1 : 0; orientation < 4; orientation++) {
+                SubBand *b = &p->band[level][orientation];
+                const SubBand *b1 = &p1->band[level][orientation];
+
+                b->qlog = b1->qlog;
+                memcpy(b->state, b1->state, sizeof(b->state));
+            }
+        }
+    }
+
+    /* The oldest reference of src is dropped by ff_snow_frames_prepare()
+     * in dst anyway, and src releases it while decoding concurrently. */
+    for (int i = 0; i < MAX_REF_FRAMES; i++) {
+        ff_thread_release_ext_buffer(&s->last_picture[i]);
+        if (i < s->max_ref_frames - 1 && s1->last_picture[i].f->data[0]) {
+            ret = ff_thread_ref_frame(&s->last_picture[i], &s1->last_picture[i]);
+            if (ret < 0)
+                return ret;
+        }
+    }
+    ff_thread_release_ext_buffer(&s->current_picture);
+    if (s1->current_picture.f->data[0]) {
+        ret = ff_thread_ref_frame(&s->current_picture, &s1->current_picture);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
 }
+#endif
 
 static av_cold int decode_end(AVCodecContext *avctx)
 {
     SnowContext *s = avctx->priv_data;
 
-    ff_slice_buffer_destroy(&s->sb);
+    for (int i = 0; i < MAX_PLANES; i++) {
+        ff_slice_buffer_destroy(&s->sb[i]);
+        av_freep(&s->plane_temp_idwt[i]);
+        av_freep(&s->plane_scratchbuf[i]);
+    }
 
     ff_snow_common_end(s);
 
@@ -828,6 +949,9 @@ const FFCodec ff_snow_decoder = {
     .init           = ff_snow_common_init,
     .close          = decode_end,
     FF_CODEC_DECODE_CB(decode_frame),
-    .p.capabilities = AV_CODEC_CAP_DR1,
-    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
+    UPDATE_THREAD_CONTEXT(update_thread_context),
+    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                      AV_CODEC_CAP_SLICE_THREADS,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP |
+                      FF_CODEC_CAP_ALLOCATE_PROGRESS,
 };
@@ -277,6 +277,16 @@ static av_cold int encode_init(AVCodecContext *avctx)
     if (ret)
         return ret;
 
+    for (i = 0; i < s->nb_planes; i++) {
+        int scratch_size = FFMAX(s->mconly_picture->linesize[0], 2*avctx->width+256) * 7 * MB_SIZE;
+        if (!FF_ALLOCZ_TYPED_ARRAY(s->plane_dwt_buffer[i],  avctx->width * avctx->height) ||
+            !FF_ALLOCZ_TYPED_ARRAY(s->plane_idwt_buffer[i], avctx->width * avctx->height) ||
+            !FF_ALLOCZ_TYPED_ARRAY(s->plane_temp_dwt[i],    avctx->width) ||
+            !FF_ALLOCZ_TYPED_ARRAY(s->plane_temp_idwt[i],   avctx->width) ||
+            !FF_ALLOCZ_TYPED_ARRAY(s->plane_scratchbuf[i],  scratch_size))
+            return AVERROR(ENOMEM);
+    }
+
     ret  = ff_set_cmp(&enc->mecc, enc->mecc.me_cmp, s->avctx->me_cmp);
     ret |= ff_set_cmp(&enc->mecc, enc->mecc.me_sub_cmp, s->avctx->me_sub_cmp);
     if (ret < 0)
@@ -398,8 +408,8 @@ static int encode_q_branch(SnowEncContext *enc, int level, int x, int y)
     int pmx, pmy;
     int mx=0, my=0;
     int l,cr,cb;
-    const int stride= s->current_picture->linesize[0];
-    const int uvstride= s->current_picture->linesize[1];
+    const int stride= s->current_picture.f->linesize[0];
+    const int uvstride= s->current_picture.f->linesize[1];
     const uint8_t *const current_data[3] = { s->input_picture->data[0] + (x + y*  stride)*block_w,
                                 s->input_picture->data[1] + ((x*block_w)>>s->chroma_h_shift) + ((y*uvstride*block_w)>>s->chroma_v_shift),
                                 s->input_picture->data[2] + ((x*block_w)>>s->chroma_h_shift) + ((y*uvstride*block_w)>>s->chroma_v_shift)};
@@ -475,7 +485,7 @@ static int encode_q_branch(SnowEncContext *enc, int level, int x, int y)
     score= INT_MAX;
     best_ref= 0;
     for(ref=0; ref<s->ref_frames; ref++){
-        init_ref(c, current_data, s->last_picture[ref]->data, NULL, block_w*x, block_w*y, 0);
+        init_ref(c, current_data, s->last_picture[ref].f->data, NULL, block_w*x, block_w*y, 0);
 
         ref_score= ff_epzs_motion_search(&enc->m, &ref_mx, &ref_my, P, 0, /*ref_index*/ 0, last_mv,
                                          (1<<16)>>shift, level-LOG2_MB_SIZE+4, block_w);
@@ -663,7 +673,7 @@ static int get_dc(SnowEncContext *enc, int mb_x, int mb_y, int plane_index)
     const int block_h    = plane_index ? block_size>>s->chroma_v_shift : block_size;
     const uint8_t *obmc  = plane_index ? ff_obmc_tab[s->block_max_depth+s->chroma_h_shift] : ff_obmc_tab[s->block_max_depth];
     const int obmc_stride= plane_index ? (2*block_size)>>s->chroma_h_shift : 2*block_size;
-    const int ref_stride= s->current_picture->linesize[plane_index];
+    const int ref_stride= s->current_picture.f->linesize[plane_index];
     const uint8_t *src = s->input_picture->data[plane_index];
     IDWTELEM *dst= (IDWTELEM*)enc->m.sc.obmc_scratchpad + plane_index*block_size*block_size*4; //FIXME change to unsigned
     const int b_stride = s->b_width << s->block_max_depth;
@@ -688,7 +698,7 @@ static int get_dc(SnowEncContext *enc, int mb_x, int mb_y, int plane_index)
         int y= block_h*mb_y2 + block_h/2;
 
         add_yblock(s, 0, NULL, dst + (i&1)*block_w + (i>>1)*obmc_stride*block_h, NULL, obmc,
-                    x, y, block_w, block_h, w, h, obmc_stride, ref_stride, obmc_stride, mb_x2, mb_y2, 0, 0, plane_index);
+                    x, y, block_w, block_h, w, h, obmc_stride, ref_stride, obmc_stride, mb_x2, mb_y2, 0, 0, plane_index, s->scratchbuf);
 
         for(y2= FFMAX(y, 0); y2<FFMIN(h, y+block_h); y2++){
             for(x2= FFMAX(x, 0); x2<FFMIN(w, x+block_w); x2++){
@@ -760,8 +770,8 @@ static int get_block_rd(SnowEncContext *enc, int mb_x, int mb_y,
     const int block_w    = plane_index ? block_size>>s->chroma_h_shift : block_size;
     const int block_h    = plane_index ? block_size>>s->chroma_v_shift : block_size;
     const int obmc_stride= plane_index ? (2*block_size)>>s->chroma_h_shift : 2*block_size;
-    const int ref_stride= s->current_picture->linesize[plane_index];
-    uint8_t *dst= s->current_picture->data[plane_index];
+    const int ref_stride= s->current_picture.f->linesize[plane_index];
+    uint8_t *dst= s->current_picture.f->data[plane_index];
     const uint8_t *src = s->input_picture->data[plane_index];
     IDWTELEM *pred= (IDWTELEM*)enc->m.sc.obmc_scratchpad + plane_index*block_size*block_size*4;
     uint8_t *cur = s->scratchbuf;
@@ -865,8 +875,8 @@ static int get_4block_rd(SnowEncContext *enc, int mb_x, int mb_y, int plane_inde
     const int block_h    = plane_index ? block_size>>s->chroma_v_shift : block_size;
     const uint8_t *obmc  = plane_index ? ff_obmc_tab[s->block_max_depth+s->chroma_h_shift] : ff_obmc_tab[s->block_max_depth];
     const int obmc_stride= plane_index ? (2*block_size)>>s->chroma_h_shift : 2*block_size;
-    const int ref_stride= s->current_picture->linesize[plane_index];
-    uint8_t *dst= s->current_picture->data[plane_index];
+    const int ref_stride= s->current_picture.f->linesize[plane_index];
+    uint8_t *dst= s->current_picture.f->data[plane_index];
     const uint8_t *src = s->input_picture->data[plane_index];
     //FIXME zero_dst is const but add_yblock changes dst if add is 0 (this is never the case for dst=zero_dst
     // const has only been removed from zero_dst to suppress a warning
@@ -887,7 +897,7 @@ static int get_4block_rd(SnowEncContext *enc, int mb_x, int mb_y, int plane_inde
         int y= block_h*mb_y2 + block_h/2;
 
         add_yblock(s, 0, NULL, zero_dst, dst, obmc,
-                   x, y, block_w, block_h, w, h, /*dst_stride*/0, ref_stride, obmc_stride, mb_x2, mb_y2, 1, 1, plane_index);
+                   x, y, block_w, block_h, w, h, /*dst_stride*/0, ref_stride, obmc_stride, mb_x2, mb_y2, 1, 1, plane_index, s->scratchbuf);
 
         //FIXME find a cleaner/simpler way to skip the outside stuff
         for(y2= y; y2<0; y2++)
@@ -1248,8 +1258,8 @@ static void iterative_me(SnowEncContext *enc)
                 //skip stuff outside the picture
                 if(mb_x==0 || mb_y==0 || mb_x==b_width-1 || mb_y==b_height-1){
                     const uint8_t *src = s->input_picture->data[0];
-                    uint8_t *dst= s->current_picture->data[0];
-                    const int stride= s->current_picture->linesize[0];
+                    uint8_t *dst= s->current_picture.f->data[0];
+                    const int stride= s->current_picture.f->linesize[0];
                     const int block_w= MB_SIZE >> s->block_max_depth;
                     const int block_h= MB_SIZE >> s->block_max_depth;
                     const int sx= block_w*mb_x - block_w/2;
@@ -1717,7 +1727,9 @@ static int ratecontrol_1pass(SnowEncContext *enc, AVFrame *pict)
     return delta_qlog;
 }
 
-static void calculate_visual_weight(SnowContext *s, Plane *p){
+static void calculate_visual_weight(SnowContext *s, int plane_index){
+    Plane *p = &s->plane[plane_index];
+    IDWTELEM *buf = s->plane_idwt_buffer[plane_index];
     int width = p->width;
     int height= p->height;
     int level, orientation, x, y;
@@ -1728,12 +1740,12 @@ static void calculate_visual_weight(SnowContext *s, Plane *p){
             SubBand *b= &p->band[level][orientation];
             IDWTELEM *ibuf= b->ibuf;
 
-            memset(s->spatial_idwt_buffer, 0, sizeof(*s->spatial_idwt_buffer)*width*height);
+            memset(buf, 0, sizeof(*buf)*width*height);
             ibuf[b->width/2 + b->height/2*b->stride]= 256*16;
-            ff_spatial_idwt(s->spatial_idwt_buffer, s->temp_idwt_buffer, width, height, width, s->spatial_decomposition_type, s->spatial_decomposition_count);
+            ff_spatial_idwt(buf, s->plane_temp_idwt[plane_index], width, height, width, s->spatial_decomposition_type, s->spatial_decomposition_count);
             for(y=0; y<height; y++){
                 for(x=0; x<width; x++){
-                    int64_t d= s->spatial_idwt_buffer[x + y*width]*16;
+                    int64_t d= buf[x + y*width]*16;
                     error += d*d;
                 }
             }
@@ -1747,6 +1759,102 @@ static void calculate_visual_weight(SnowContext *s, Plane *p){
     }
 }
 
+/* The three plane jobs below run concurrently for all planes with slice
+ * threading; only the range coding in between has to stay serial. */
+static int transform_plane(AVCodecContext *avctx, void *arg, int plane_index, int threadnr)
+{
+    SnowEncContext *const enc = avctx->priv_data;
+    SnowContext *const s = &enc->com;
+    const AVFrame *pict = arg;
+    Plane *p= &s->plane[plane_index];
+    DWTELEM  *dwt_buf = s->plane_dwt_buffer[plane_index];
+    IDWTELEM *idwt_buf= s->plane_idwt_buffer[plane_index];
+    int w= p->width;
+    int h= p->height;
+    int x, y;
+
+    //FIXME optimize
+    if(pict->data[plane_index]) //FIXME gray hack
+        for(y=0; y<h; y++){
+            for(x=0; x<w; x++){
+                idwt_buf[y*w + x]= pict->data[plane_index][y*pict->linesize[plane_index] + x]<<FRAC_BITS;
+            }
+        }
+    predict_plane(s, idwt_buf, plane_index, 0);
+
+    if(s->qlog == LOSSLESS_QLOG){
+        for(y=0; y<h; y++){
+            for(x=0; x<w; x++){
+                dwt_buf[y*w + x]= (idwt_buf[y*w + x] + (1<<(FRAC_BITS-1))-1)>>FRAC_BITS;
+            }
+        }
+    }else{
+        for(y=0; y<h; y++){
+            for(x=0; x<w; x++){
+                dwt_buf[y*w + x]= idwt_buf[y*w + x] * (1 << ENCODER_EXTRA_BITS);
+            }
+        }
+    }
+
+    ff_spatial_dwt(dwt_buf, s->plane_temp_dwt[plane_index], w, h, w, s->spatial_decomposition_type, s->spatial_decomposition_count);
+
+    return 0;
+}
+
+static int quantize_plane(AVCodecContext *avctx, void *arg, int plane_index, int threadnr)
+{
+    SnowEncContext *const enc = avctx->priv_data;
+    SnowContext *const s = &enc->com;
+    const AVFrame *pic = arg;
+    Plane *p= &s->plane[plane_index];
+    int level, orientation;
+
+    for(level=0; level<s->spatial_decomposition_count; level++){
+        for(orientation=level ? 1 : 0; orientation<4; orientation++){
+            SubBand *b= &p->band[level][orientation];
+
+            quantize(s, b, b->ibuf, b->buf, b->stride, s->qbias);
+            if(orientation==0)
+                decorrelate(s, b, b->ibuf, b->stride, pic->pict_type == AV_PICTURE_TYPE_P, 0);
+        }
+    }
+
+    return 0;
+}
+
+static int reconstruct_plane(AVCodecContext *avctx, void *arg, int plane_index, int threadnr)
+{
+    SnowEncContext *const enc = avctx->priv_data;
+    SnowContext *const s = &enc->com;
+    Plane *p= &s->plane[plane_index];
+    IDWTELEM *idwt_buf= s->plane_idwt_buffer[plane_index];
+    int w= p->width;
+    int h= p->height;
+    int level, orientation, x, y;
+
+    for(level=0; level<s->spatial_decomposition_count; level++){
+        for(orientation=level ? 1 : 0; orientation<4; orientation++){
+            SubBand *b= &p->band[level][orientation];
+
+            if(orientation==0)
+                correlate(s, b, b->ibuf, b->stride, 1, 0);
+            dequantize(s, b, b->ibuf, b->stride);
+        }
+    }
+
+    ff_spatial_idwt(idwt_buf, s->plane_temp_idwt[plane_index], w, h, w, s->spatial_decomposition_type, s->spatial_decomposition_count);
+    if(s->qlog == LOSSLESS_QLOG){
+        for(y=0; y<h; y++){
+            for(x=0; x<w; x++){
+                idwt_buf[y*w + x] *= 1 << FRAC_BITS;
+            }
+        }
+    }
+    predict_plane(s, idwt_buf, plane_index, 1);
+
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                         const AVFrame *pict, int *got_packet)
 {
@@ -1811,46 +1919,46 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
         enc->lambda = 0;
     }//else keep previous frame's qlog until after motion estimation
 
-    if (s->current_picture->data[0]) {
+    if (s->current_picture.f->data[0]) {
         int w = s->avctx->width;
         int h = s->avctx->height;
 
-        enc->mpvencdsp.draw_edges(s->current_picture->data[0],
-                                  s->current_picture->linesize[0], w   , h   ,
+        enc->mpvencdsp.draw_edges(s->current_picture.f->data[0],
+                                  s->current_picture.f->linesize[0], w   , h   ,
                                   EDGE_WIDTH  , EDGE_WIDTH  , EDGE_TOP | EDGE_BOTTOM);
-        if (s->current_picture->data[2]) {
-            enc->mpvencdsp.draw_edges(s->current_picture->data[1],
-                                      s->current_picture->linesize[1], w>>s->chroma_h_shift, h>>s->chroma_v_shift,
+        if (s->current_picture.f->data[2]) {
+            enc->mpvencdsp.draw_edges(s->current_picture.f->data[1],
+                                      s->current_picture.f->linesize[1], w>>s->chroma_h_shift, h>>s->chroma_v_shift,
                                       EDGE_WIDTH>>s->chroma_h_shift, EDGE_WIDTH>>s->chroma_v_shift, EDGE_TOP | EDGE_BOTTOM);
-            enc->mpvencdsp.draw_edges(s->current_picture->data[2],
-                                      s->current_picture->linesize[2], w>>s->chroma_h_shift, h>>s->chroma_v_shift,
+            enc->mpvencdsp.draw_edges(s->current_picture.f->data[2],
+                                      s->current_picture.f->linesize[2], w>>s->chroma_h_shift, h>>s->chroma_v_shift,
                                       EDGE_WIDTH>>s->chroma_h_shift, EDGE_WIDTH>>s->chroma_v_shift, EDGE_TOP | EDGE_BOTTOM);
         }
         emms_c();
     }
 
     ff_snow_frames_prepare(s);
-    ret = get_encode_buffer(s, s->current_picture);
+    ret = get_encode_buffer(s, s->current_picture.f);
     if (ret < 0)
         return ret;
 
     mpv->current_picture_ptr    = &mpv->current_picture;
-    mpv->current_picture.f      = s->current_picture;
+    mpv->current_picture.f      = s->current_picture.f;
     mpv->current_picture.f->pts = pict->pts;
     if(pic->pict_type == AV_PICTURE_TYPE_P){
         int block_width = (width +15)>>4;
         int block_height= (height+15)>>4;
-        int stride= s->current_picture->linesize[0];
+        int stride= s->current_picture.f->linesize[0];
 
-        av_assert0(s->current_picture->data[0]);
-        av_assert0(s->last_picture[0]->data[0]);
+        av_assert0(s->current_picture.f->data[0]);
+        av_assert0(s->last_picture[0].f->data[0]);
 
         mpv->avctx = s->avctx;
-        mpv->last_picture.f   = s->last_picture[0];
+        mpv->last_picture.f   = s->last_picture[0].f;
         mpv-> new_picture     = s->input_picture;
         mpv->last_picture_ptr = &mpv->last_picture;
         mpv->linesize   = stride;
-        mpv->uvlinesize = s->current_picture->linesize[1];
+        mpv->uvlinesize = s->current_picture.f->linesize[1];
         mpv->width      = width;
         mpv->height     = height;
         mpv->mb_width   = block_width;
@@ -1903,7 +2011,7 @@ redo_frame:
 
     if(s->last_spatial_decomposition_count != s->spatial_decomposition_count){
         for(plane_index=0; plane_index < s->nb_planes; plane_index++){
-            calculate_visual_weight(s, &s->plane[plane_index]);
+            calculate_visual_weight(s, plane_index);
         }
     }
 
@@ -1912,109 +2020,71 @@ redo_frame:
     encode_blocks(enc, 1);
     mpv->mv_bits   = 8 * (s->c.bytestream - s->c.bytestream_start) - mpv->misc_bits;
 
-    for(plane_index=0; plane_index < s->nb_planes; plane_index++){
-        Plane *p= &s->plane[plane_index];
-        int w= p->width;
-        int h= p->height;
-        int x, y;
-//        int bits= put_bits_count(&s->c.pb);
+    if (!enc->memc_only) {
+        if(   pic->pict_type == AV_PICTURE_TYPE_P
+           && !(avctx->flags&AV_CODEC_FLAG_PASS2)
+           && mpv->me.scene_change_score > enc->scenechange_threshold) {
+            ff_init_range_encoder(c, pkt->data, pkt->size);
+            ff_build_rac_states(c, (1LL<<32)/20, 256-8);
+            pic->pict_type= AV_PICTURE_TYPE_I;
+            s->keyframe=1;
+            s->current_picture.f->flags |= AV_FRAME_FLAG_KEY;
+            goto redo_frame;
+        }
 
-        if (!enc->memc_only) {
-            //FIXME optimize
-            if(pict->data[plane_index]) //FIXME gray hack
-                for(y=0; y<h; y++){
-                    for(x=0; x<w; x++){
-                        s->spatial_idwt_buffer[y*w + x]= pict->data[plane_index][y*pict->linesize[plane_index] + x]<<FRAC_BITS;
-                    }
-                }
-            predict_plane(s, s->spatial_idwt_buffer, plane_index, 0);
+        avctx->execute2(avctx, transform_plane, (void *)pict, NULL, s->nb_planes);
 
-            if(   plane_index==0
-               && pic->pict_type == AV_PICTURE_TYPE_P
-               && !(avctx->flags&AV_CODEC_FLAG_PASS2)
-               && mpv->me.scene_change_score > enc->scenechange_threshold) {
+        if (enc->pass1_rc) {
+            int delta_qlog = ratecontrol_1pass(enc, pic);
+            if (delta_qlog <= INT_MIN)
+                return -1;
+            if(delta_qlog){
+                //reordering qlog in the bitstream would eliminate this reset
                 ff_init_range_encoder(c, pkt->data, pkt->size);
-                ff_build_rac_states(c, (1LL<<32)/20, 256-8);
-                pic->pict_type= AV_PICTURE_TYPE_I;
-                s->keyframe=1;
-                s->current_picture->flags |= AV_FRAME_FLAG_KEY;
-                goto redo_frame;
+                memcpy(s->header_state, rc_header_bak, sizeof(s->header_state));
+                memcpy(s->block_state, rc_block_bak, sizeof(s->block_state));
+                encode_header(s);
+                encode_blocks(enc, 0);
             }
+        }
 
-            if(s->qlog == LOSSLESS_QLOG){
-                for(y=0; y<h; y++){
-                    for(x=0; x<w; x++){
-                        s->spatial_dwt_buffer[y*w + x]= (s->spatial_idwt_buffer[y*w + x] + (1<<(FRAC_BITS-1))-1)>>FRAC_BITS;
-                    }
-                }
-            }else{
-                for(y=0; y<h; y++){
-                    for(x=0; x<w; x++){
-                        s->spatial_dwt_buffer[y*w + x]= s->spatial_idwt_buffer[y*w + x] * (1 << ENCODER_EXTRA_BITS);
-                    }
-                }
-            }
+        avctx->execute2(avctx, quantize_plane, pic, NULL, s->nb_planes);
 
-            ff_spatial_dwt(s->spatial_dwt_buffer, s->temp_dwt_buffer, w, h, w, s->spatial_decomposition_type, s->spatial_decomposition_count);
-
-            if (enc->pass1_rc && plane_index==0) {
-                int delta_qlog = ratecontrol_1pass(enc, pic);
-                if (delta_qlog <= INT_MIN)
-                    return -1;
-                if(delta_qlog){
-                    //reordering qlog in the bitstream would eliminate this reset
-                    ff_init_range_encoder(c, pkt->data, pkt->size);
-                    memcpy(s->header_state, rc_header_bak, sizeof(s->header_state));
-                    memcpy(s->block_state, rc_block_bak, sizeof(s->block_state));
-                    encode_header(s);
-                    encode_blocks(enc, 0);
-                }
-            }
+        for(plane_index=0; plane_index < s->nb_planes; plane_index++){
+            Plane *p= &s->plane[plane_index];
 
             for(level=0; level<s->spatial_decomposition_count; level++){
                 for(orientation=level ? 1 : 0; orientation<4; orientation++){
                     SubBand *b= &p->band[level][orientation];
 
-                    quantize(s, b, b->ibuf, b->buf, b->stride, s->qbias);
-                    if(orientation==0)
-                        decorrelate(s, b, b->ibuf, b->stride, pic->pict_type == AV_PICTURE_TYPE_P, 0);
                     if (!enc->no_bitstream)
                     encode_subband(s, b, b->ibuf, b->parent ? b->parent->ibuf : NULL, b->stride, orientation);
                     av_assert0(b->parent==NULL || b->parent->stride == b->stride*2);
-                    if(orientation==0)
-                        correlate(s, b, b->ibuf, b->stride, 1, 0);
                 }
             }
+        }
 
-            for(level=0; level<s->spatial_decomposition_count; level++){
-                for(orientation=level ? 1 : 0; orientation<4; orientation++){
-                    SubBand *b= &p->band[level][orientation];
+        avctx->execute2(avctx, reconstruct_plane, NULL, NULL, s->nb_planes);
+    }
 
-                    dequantize(s, b, b->ibuf, b->stride);
-                }
-            }
+    for(plane_index=0; plane_index < s->nb_planes; plane_index++){
+        Plane *p= &s->plane[plane_index];
+        int w= p->width;
+        int h= p->height;
+        int x, y;
 
-            ff_spatial_idwt(s->spatial_idwt_buffer, s->temp_idwt_buffer, w, h, w, s->spatial_decomposition_type, s->spatial_decomposition_count);
-            if(s->qlog == LOSSLESS_QLOG){
-                for(y=0; y<h; y++){
-                    for(x=0; x<w; x++){
-                        s->spatial_idwt_buffer[y*w + x] *= 1 << FRAC_BITS;
-                    }
-                }
-            }
-            predict_plane(s, s->spatial_idwt_buffer, plane_index, 1);
-        }else{
+        if (enc->memc_only) {
             //ME/MC only
             if(pic->pict_type == AV_PICTURE_TYPE_I){
                 for(y=0; y<h; y++){
                     for(x=0; x<w; x++){
-                        s->current_picture->data[plane_index][y*s->current_picture->linesize[plane_index] + x]=
+                        s->current_picture.f->data[plane_index][y*s->current_picture.f->linesize[plane_index] + x]=
                             pict->data[plane_index][y*pict->linesize[plane_index] + x];
                     }
                 }
             }else{
-                memset(s->spatial_idwt_buffer, 0, sizeof(IDWTELEM)*w*h);
-                predict_plane(s, s->spatial_idwt_buffer, plane_index, 1);
+                memset(s->plane_idwt_buffer[plane_index], 0, sizeof(IDWTELEM)*w*h);
+                predict_plane(s, s->plane_idwt_buffer[plane_index], plane_index, 1);
             }
         }
         if(s->avctx->flags&AV_CODEC_FLAG_PSNR){
@@ -2023,7 +2093,7 @@ redo_frame:
             if(pict->data[plane_index]) //FIXME gray hack
                 for(y=0; y<h; y++){
                     for(x=0; x<w; x++){
-                        int d= s->current_picture->data[plane_index][y*s->current_picture->linesize[plane_index] + x] - pict->data[plane_index][y*pict->linesize[plane_index] + x];
+                        int d= s->current_picture.f->data[plane_index][y*s->current_picture.f->linesize[plane_index] + x] - pict->data[plane_index][y*pict->linesize[plane_index] + x];
                         error += d*d;
                     }
                 }
@@ -2038,8 +2108,8 @@ redo_frame:
 
     ff_snow_release_buffer(avctx);
 
-    s->current_picture->pict_type = pic->pict_type;
-    s->current_picture->quality = pic->quality;
+    s->current_picture.f->pict_type = pic->pict_type;
+    s->current_picture.f->quality = pic->quality;
     mpv->frame_bits = 8 * (s->c.bytestream - s->c.bytestream_start);
     mpv->p_tex_bits = mpv->frame_bits - mpv->misc_bits - mpv->mv_bits;
     mpv->total_bits += 8*(s->c.bytestream - s->c.bytestream_start);
@@ -2055,16 +2125,16 @@ redo_frame:
 
     emms_c();
 
-    ff_side_data_set_encoder_stats(pkt, s->current_picture->quality,
+    ff_side_data_set_encoder_stats(pkt, s->current_picture.f->quality,
                                    enc->encoding_error,
                                    (s->avctx->flags&AV_CODEC_FLAG_PSNR) ? SNOW_MAX_PLANES : 0,
-                                   s->current_picture->pict_type);
+                                   s->current_picture.f->pict_type);
     if (s->avctx->flags & AV_CODEC_FLAG_RECON_FRAME) {
-        av_frame_replace(avci->recon_frame, s->current_picture);
+        av_frame_replace(avci->recon_frame, s->current_picture.f);
     }
 
     pkt->size = ff_rac_terminate(c, 0);
-    if (s->current_picture->flags & AV_FRAME_FLAG_KEY)
+    if (s->current_picture.f->flags & AV_FRAME_FLAG_KEY)
         pkt->flags |= AV_PKT_FLAG_KEY;
     *got_packet = 1;
 
@@ -2085,6 +2155,14 @@ static av_cold int encode_end(AVCodecContext *avctx)
         av_freep(&s->ref_scores[i]);
     }
 
+    for (int i = 0; i < MAX_PLANES; i++) {
+        av_freep(&s->plane_dwt_buffer[i]);
+        av_freep(&s->plane_idwt_buffer[i]);
+        av_freep(&s->plane_temp_dwt[i]);
+        av_freep(&s->plane_temp_idwt[i]);
+        av_freep(&s->plane_scratchbuf[i]);
+    }
+
     enc->m.me.temp = NULL;
     av_freep(&enc->m.me.scratchpad);
     av_freep(&enc->m.me.map);
@@ -2132,6 +2210,7 @@ const FFCodec ff_snow_encoder = {
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_SNOW,
     .p.capabilities = AV_CODEC_CAP_DR1 |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE |
                       AV_CODEC_CAP_ENCODER_RECON_FRAME,
     .priv_data_size = sizeof(SnowEncContext),
@@ -31,6 +31,29 @@ const uint8_t *avpriv_find_start_code(const uint8_t *p,
                                       const uint8_t *end,
                                       uint32_t *state);
 
+typedef struct StartcodeDSPContext {
+    /**
+     * Find the first zero byte of buf.
+     * buf must be followed by AV_INPUT_BUFFER_PADDING_SIZE readable bytes,
+     * zero bytes in the padding are ignored.
+     * @return offset of the first zero byte, or size if there is none;
+     *         never more than size
+     */
+    int (*find_candidate)(const uint8_t *buf, int size);
+    /**
+     * Find the first three-byte sequence 0x000001, 0x000002 or 0x000003 of buf,
+     * i.e. a start code or an emulation prevention byte in H.264/HEVC/VVC
+     * NAL units, that lies entirely within the first size bytes.
+     * buf must be followed by AV_INPUT_BUFFER_PADDING_SIZE readable bytes.
+     * @return offset of the sequence, or size if there is none
+     */
+    int (*find_escape)(const uint8_t *buf, int size);
+} StartcodeDSPContext;
+
 int ff_startcode_find_candidate_c(const uint8_t *buf, int size);
+int ff_startcode_find_escape_c(const uint8_t *buf, int size);
+
+void ff_startcode_dsp_init(StartcodeDSPContext *c);
+void ff_startcode_dsp_init_x86(StartcodeDSPContext *c);
 
 #endif /* AVCODEC_STARTCODE_H */
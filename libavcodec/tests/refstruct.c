@@ -0,0 +1,252 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Stress test for FFRefStructPool: several threads get and release entries
+ * of a shared pool concurrently; the pool is uninitialized while some of
+ * the entries are still in use.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/thread.h"
+
+#include "libavcodec/refstruct.h"
+
+#define NB_THREADS   8
+#define NB_ITER      20000
+#define NB_HELD      4
+
+typedef struct Entry {
+    atomic_int in_use;
+    int        owner;
+    unsigned   data[15];
+} Entry;
+
+typedef struct PoolStats {
+    atomic_int nb_get;
+    atomic_int nb_init;
+    atomic_int nb_reset;
+    atomic_int nb_free_entry;
+    atomic_int nb_free;
+    atomic_int errors;
+} PoolStats;
+
+typedef struct Sync {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    int             nb_ready;
+    int             uninited;
+} Sync;
+
+typedef struct ThreadArg {
+    FFRefStructPool *pool;
+    PoolStats       *stats;
+    Sync            *sync;
+    int              idx;
+    int              zeroed;
+} ThreadArg;
+
+static int init_entry(FFRefStructOpaque opaque, void *obj)
+{
+    PoolStats *stats = opaque.nc;
+
+    atomic_fetch_add(&stats->nb_init, 1);
+    return 0;
+}
+
+static void reset_entry(FFRefStructOpaque opaque, void *obj)
+{
+    PoolStats *stats = opaque.nc;
+
+    atomic_fetch_add(&stats->nb_reset, 1);
+}
+
+static void free_entry(FFRefStructOpaque opaque, void *obj)
+{
+    PoolStats *stats = opaque.nc;
+
+    atomic_fetch_add(&stats->nb_free_entry, 1);
+}
+
+static void free_pool(FFRefStructOpaque opaque)
+{
+    PoolStats *stats = opaque.nc;
+
+    atomic_fetch_add(&stats->nb_free, 1);
+}
+
+static Entry *get_entry(ThreadArg *arg)
+{
+    Entry *entry = ff_refstruct_pool_get(arg->pool);
+    int err = !entry;
+
+    atomic_fetch_add(&arg->stats->nb_get, 1);
+    if (!entry)
+        goto end;
+    if (arg->zeroed) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(entry->data); i++)
+            err |= !!entry->data[i];
+    }
+    // nobody else may own this entry at the same time
+    if (atomic_exchange(&entry->in_use, 1)) {
+        err = 1;
+        goto end;
+    }
+    entry->owner = arg->idx + 1;
+    for (int i = 0; i < FF_ARRAY_ELEMS(entry->data); i++)
+        entry->data[i] = entry->owner * 0x01010101U;
+end:
+    if (err)
+        atomic_fetch_add(&arg->stats->errors, 1);
+    return entry;
+}
+
+static void release_entry(ThreadArg *arg, Entry **entryp)
+{
+    Entry *entry = *entryp;
+    int err = entry->owner != arg->idx + 1;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(entry->data); i++)
+        err |= entry->data[i] != entry->owner * 0x01010101U;
+    entry->owner = 0;
+    atomic_store(&entry->in_use, 0);
+    ff_refstruct_unref(entryp);
+    if (err)
+        atomic_fetch_add(&arg->stats->errors, 1);
+}
+
+static void *thread_main(void *opaque)
+{
+    ThreadArg *arg = opaque;
+    Sync *sync     = arg->sync;
+    Entry *held[NB_HELD], *last;
+
+    for (int n = 0; n < NB_ITER; n++) {
+        int nb = 1 + (n + arg->idx) % NB_HELD;
+
+        for (int i = 0; i < nb; i++)
+            held[i] = get_entry(arg);
+        // release in varying order to shuffle the list of available entries
+        for (int i = 0; i < nb; i++) {
+            int j = (i + n) % nb;
+            if (held[j])
+                release_entry(arg, &held[j]);
+        }
+    }
+
+    // keep one entry across the uninitialization of the pool
+    last = get_entry(arg);
+
+    pthread_mutex_lock(&sync->mutex);
+    sync->nb_ready++;
+    pthread_cond_broadcast(&sync->cond);
+    while (!sync->uninited)
+        pthread_cond_wait(&sync->cond, &sync->mutex);
+    pthread_mutex_unlock(&sync->mutex);
+
+    if (last)
+        release_entry(arg, &last);
+
+    return NULL;
+}
+
+static int run_test(unsigned flags)
+{
+    PoolStats stats = { 0 };
+    Sync sync = { .nb_ready = 0 };
+    ThreadArg args[NB_THREADS];
+    pthread_t threads[NB_THREADS];
+    FFRefStructPool *pool;
+    int ret = 0;
+
+    pool = ff_refstruct_pool_alloc_ext(sizeof(Entry), flags, &stats,
+                                       init_entry, reset_entry,
+                                       free_entry, free_pool);
+    if (!pool)
+        return 1;
+
+    pthread_mutex_init(&sync.mutex, NULL);
+    pthread_cond_init(&sync.cond, NULL);
+
+    for (int i = 0; i < NB_THREADS; i++) {
+        args[i] = (ThreadArg){ .pool = pool, .stats = &stats, .sync = &sync,
+                               .idx = i,
+                               .zeroed = !!(flags & FF_REFSTRUCT_POOL_FLAG_ZERO_EVERY_TIME) };
+        if (pthread_create(&threads[i], NULL, thread_main, &args[i])) {
+            fprintf(stderr, "pthread_create failed\n");
+            abort();
+        }
+    }
+
+    pthread_mutex_lock(&sync.mutex);
+    while (sync.nb_ready < NB_THREADS)
+        pthread_cond_wait(&sync.cond, &sync.mutex);
+    pthread_mutex_unlock(&sync.mutex);
+
+    ff_refstruct_pool_uninit(&pool);
+    if (atomic_load(&stats.nb_free)) {
+        fprintf(stderr, "pool freed while entries are still in use\n");
+        ret = 1;
+    }
+
+    pthread_mutex_lock(&sync.mutex);
+    sync.uninited = 1;
+    pthread_cond_broadcast(&sync.cond);
+    pthread_mutex_unlock(&sync.mutex);
+
+    for (int i = 0; i < NB_THREADS; i++)
+        pthread_join(threads[i], NULL);
+    pthread_cond_destroy(&sync.cond);
+    pthread_mutex_destroy(&sync.mutex);
+
+    if (atomic_load(&stats.errors)) {
+        fprintf(stderr, "%d entries were handed out incorrectly\n",
+                atomic_load(&stats.errors));
+        ret = 1;
+    }
+    if (atomic_load(&stats.nb_free) != 1) {
+        fprintf(stderr, "pool was freed %d times\n", atomic_load(&stats.nb_free));
+        ret = 1;
+    }
+    if (atomic_load(&stats.nb_free_entry) != atomic_load(&stats.nb_init)) {
+        fprintf(stderr, "%d entries allocated, but %d freed\n",
+                atomic_load(&stats.nb_init), atomic_load(&stats.nb_free_entry));
+        ret = 1;
+    }
+    if (atomic_load(&stats.nb_reset) != atomic_load(&stats.nb_get)) {
+        fprintf(stderr, "%d entries handed out, but %d reset\n",
+                atomic_load(&stats.nb_get), atomic_load(&stats.nb_reset));
+        ret = 1;
+    }
+
+    return ret;
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    ret |= run_test(0);
+    ret |= run_test(FF_REFSTRUCT_POOL_FLAG_ZERO_EVERY_TIME);
+
+    return ret;
+}
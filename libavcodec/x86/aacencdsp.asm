@@ -22,9 +22,9 @@
 
 %include "libavutil/x86/x86util.asm"
 
-SECTION_RODATA
+SECTION_RODATA 32
 
-float_abs_mask: times 4 dd 0x7fffffff
+float_abs_mask: times 8 dd 0x7fffffff
 
 SECTION .text
 
@@ -48,6 +48,38 @@ cglobal abs_pow34, 3, 3, 3, out, in, size
     jl    .loop
     RET
 
+%if HAVE_AVX_EXTERNAL
+; Band sizes are only guaranteed to be multiples of 4, so finish with an xmm
+; tail when the size is not a multiple of the vector length.
+INIT_YMM avx
+cglobal abs_pow34, 3, 3, 3, out, in, size
+    mova   m2, [float_abs_mask]
+    shl    sized, 2
+    add    inq, sizeq
+    add    outq, sizeq
+    neg    sizeq
+    add    sizeq, mmsize
+    jg    .tail
+.loop:
+    andps  m0, m2, [inq+sizeq-mmsize]
+    sqrtps m1, m0
+    mulps  m0, m1
+    sqrtps m0, m0
+    movu   [outq+sizeq-mmsize], m0
+    add    sizeq, mmsize
+    jle   .loop
+.tail:
+    cmp    sizeq, mmsize
+    je    .end
+    andps  xm0, xm2, [inq+sizeq-mmsize]
+    sqrtps xm1, xm0
+    mulps  xm0, xm1
+    sqrtps xm0, xm0
+    movu   [outq+sizeq-mmsize], xm0
+.end:
+    RET
+%endif
+
 ;*******************************************************************
 ;void ff_aac_quantize_bands(int *out, const float *in, const float *scaled,
 ;                           int size, int is_signed, int maxval, const float Q34,
@@ -84,3 +116,50 @@ cglobal aac_quantize_bands, 5, 5, 6, out, in, scaled, size, is_signed, maxval, Q
     add       sizeq, mmsize
     jl       .loop
     RET
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+cglobal aac_quantize_bands, 5, 5, 6, out, in, scaled, size, is_signed, maxval, Q34, rounding
+%if UNIX64 == 0
+    movss        xm0, Q34m
+    movss        xm1, roundingm
+    cvtsi2ss     xm3, dword maxvalm
+%else
+    cvtsi2ss     xm3, maxvald
+%endif
+    vbroadcastss m0, xm0
+    vbroadcastss m1, xm1
+    vbroadcastss m3, xm3
+    shl          is_signedd, 31
+    movd         xm4, is_signedd
+    vpbroadcastd m4, xm4
+    shl          sized,   2
+    add          inq, sizeq
+    add          outq, sizeq
+    add          scaledq, sizeq
+    neg          sizeq
+    add          sizeq, mmsize
+    jg          .tail
+.loop:
+    mulps        m2, m0, [scaledq+sizeq-mmsize]
+    addps        m2, m1
+    minps        m2, m3
+    andps        m5, m4, [inq+sizeq-mmsize]
+    orps         m2, m5
+    cvttps2dq    m2, m2
+    movu         [outq+sizeq-mmsize], m2
+    add          sizeq, mmsize
+    jle         .loop
+.tail:
+    cmp          sizeq, mmsize
+    je          .end
+    mulps        xm2, xm0, [scaledq+sizeq-mmsize]
+    addps        xm2, xm1
+    minps        xm2, xm3
+    andps        xm5, xm4, [inq+sizeq-mmsize]
+    orps         xm2, xm5
+    cvttps2dq    xm2, xm2
+    movu         [outq+sizeq-mmsize], xm2
+.end:
+    RET
+%endif
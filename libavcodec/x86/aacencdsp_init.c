@@ -26,10 +26,14 @@
 #include "libavcodec/aacencdsp.h"
 
 void ff_abs_pow34_sse(float *out, const float *in, const int size);
+void ff_abs_pow34_avx(float *out, const float *in, const int size);
 
 void ff_aac_quantize_bands_sse2(int *out, const float *in, const float *scaled,
                                 int size, int is_signed, int maxval, const float Q34,
                                 const float rounding);
+void ff_aac_quantize_bands_avx2(int *out, const float *in, const float *scaled,
+                                int size, int is_signed, int maxval, const float Q34,
+                                const float rounding);
 
 av_cold void ff_aacenc_dsp_init_x86(AACEncDSPContext *s)
 {
@@ -40,4 +44,10 @@ av_cold void ff_aacenc_dsp_init_x86(AACEncDSPContext *s)
 
     if (EXTERNAL_SSE2(cpu_flags))
         s->quant_bands = ff_aac_quantize_bands_sse2;
+
+    if (EXTERNAL_AVX_FAST(cpu_flags))
+        s->abs_pow34   = ff_abs_pow34_avx;
+
+    if (EXTERNAL_AVX2_FAST(cpu_flags))
+        s->quant_bands = ff_aac_quantize_bands_avx2;
 }
@@ -28,6 +28,7 @@ pf_ict0: times 8 dd 1.402
 pf_ict1: times 8 dd 0.34413
 pf_ict2: times 8 dd 0.71414
 pf_ict3: times 8 dd 1.772
+pd_0x7fffffff: times 8 dd 0x7fffffff
 
 SECTION .text
 
@@ -162,3 +163,36 @@ RCT_INT
 INIT_YMM avx2
 RCT_INT
 %endif
+
+;***************************************************************************
+; ff_ht_sign_mag_<opt>(int32_t *dst, const int32_t *src, int len, int shift)
+;***************************************************************************
+%macro HT_SIGN_MAG 0
+cglobal ht_sign_mag, 4, 4, 5, dst, src, len, shift
+    movd     xm4, shiftd
+    mova      m3, [pd_0x7fffffff]
+    shl     lend, 2
+    add     dstq, lenq
+    add     srcq, lenq
+    neg     lenq
+
+align 16
+.loop:
+    movu      m0, [srcq+lenq]
+    psrad     m1, m0, 31
+    pand      m0, m3
+    pxor      m0, m1
+    psubd     m0, m1
+    psrad     m0, xm4
+    movu [dstq+lenq], m0
+    add     lenq, mmsize
+    jl .loop
+    RET
+%endmacro
+
+INIT_XMM sse2
+HT_SIGN_MAG
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+HT_SIGN_MAG
+%endif
@@ -30,6 +30,8 @@ void ff_ict_float_fma3(void *src0, void *src1, void *src2, int csize);
 void ff_ict_float_fma4(void *src0, void *src1, void *src2, int csize);
 void ff_rct_int_sse2 (void *src0, void *src1, void *src2, int csize);
 void ff_rct_int_avx2 (void *src0, void *src1, void *src2, int csize);
+void ff_ht_sign_mag_sse2(int32_t *dst, const int32_t *src, int len, int shift);
+void ff_ht_sign_mag_avx2(int32_t *dst, const int32_t *src, int len, int shift);
 
 av_cold void ff_jpeg2000dsp_init_x86(Jpeg2000DSPContext *c)
 {
@@ -40,6 +42,7 @@ av_cold void ff_jpeg2000dsp_init_x86(Jpeg2000DSPContext *c)
 
     if (EXTERNAL_SSE2(cpu_flags)) {
         c->mct_decode[FF_DWT53] = ff_rct_int_sse2;
+        c->ht_sign_mag          = ff_ht_sign_mag_sse2;
     }
 
     if (EXTERNAL_AVX_FAST(cpu_flags)) {
@@ -56,5 +59,6 @@ av_cold void ff_jpeg2000dsp_init_x86(Jpeg2000DSPContext *c)
 
     if (EXTERNAL_AVX2_FAST(cpu_flags)) {
         c->mct_decode[FF_DWT53] = ff_rct_int_avx2;
+        c->ht_sign_mag          = ff_ht_sign_mag_avx2;
     }
 }
@@ -0,0 +1,120 @@
+;******************************************************************************
+;* SIMD-optimized JPEG 2000 discrete wavelet transform
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pd_2:      times 8 dd 2
+pd_0x8000: times 8 dd 0x8000
+pd_0xffff: times 8 dd 0xffff
+
+SECTION .text
+
+;******************************************************************************
+; ff_dwt_lift53_{sub,add}_<opt>(int32_t *dst, const int32_t *a,
+;                               const int32_t *b, int len)
+; sub: dst -= (a + b) >> 1
+; add: dst += (a + b + 2) >> 2
+;******************************************************************************
+%macro LIFT53 2 ; name, op
+cglobal dwt_lift53_%1, 4, 4, 2, dst, a, b, len
+    movsxdifnidn lenq, lend
+    shl          lenq, 2
+    add          dstq, lenq
+    add            aq, lenq
+    add            bq, lenq
+    neg          lenq
+.loop:
+    mova           m0, [aq+lenq]
+    paddd          m0, [bq+lenq]
+%ifidn %2, sub
+    psrad          m0, 1
+%else
+    paddd          m0, [pd_2]
+    psrad          m0, 2
+%endif
+    mova           m1, [dstq+lenq]
+    p%2d           m1, m0
+    mova [dstq+lenq], m1
+    add          lenq, mmsize
+    jl .loop
+    RET
+%endmacro
+
+;******************************************************************************
+; ff_dwt_lift97_int_{sub,add}_<opt>(int32_t *dst, const int32_t *a,
+;                                   const int32_t *b, int len, int coef)
+; dst -/+= (coef * (int64_t)(a + b) + (1 << 15)) >> 16
+;
+; With s = a + b = sh * 2^16 + sl and coef = ch * 2^16 + cl (ch is 0 or 1),
+; the product is ch * s + sh * cl + ((sl * cl + 2^15) >> 16), where every
+; term fits in 32 bits.
+;******************************************************************************
+%macro LIFT97_INT 2 ; name, op
+cglobal dwt_lift97_int_%1, 5, 6, 7, dst, a, b, len, coef, mask
+    movsxdifnidn lenq, lend
+    mov         maskd, coefd
+    shr         maskd, 16
+    neg         maskd
+    and         coefd, 0xffff
+    movd          xm4, coefd
+    movd          xm5, maskd
+    VPBROADCASTD   m4, xm4
+    VPBROADCASTD   m5, xm5
+    mova           m6, [pd_0xffff]
+    shl          lenq, 2
+    add          dstq, lenq
+    add            aq, lenq
+    add            bq, lenq
+    neg          lenq
+.loop:
+    mova           m0, [aq+lenq]
+    paddd          m0, [bq+lenq]
+    pand           m1, m0, m6
+    psrad          m2, m0, 16
+    pand           m3, m0, m5
+    pmulld         m1, m4
+    pmulld         m2, m4
+    paddd          m1, [pd_0x8000]
+    psrld          m1, 16
+    paddd          m1, m2
+    paddd          m1, m3
+    mova           m0, [dstq+lenq]
+    p%2d           m0, m1
+    mova [dstq+lenq], m0
+    add          lenq, mmsize
+    jl .loop
+    RET
+%endmacro
+
+INIT_XMM sse2
+LIFT53 sub, sub
+LIFT53 add, add
+INIT_XMM sse4
+LIFT97_INT sub, sub
+LIFT97_INT add, add
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+LIFT53 sub, sub
+LIFT53 add, add
+LIFT97_INT sub, sub
+LIFT97_INT add, add
+%endif
@@ -0,0 +1,59 @@
+/*
+ * SIMD optimized JPEG 2000 discrete wavelet transform
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavcodec/jpeg2000dwt.h"
+
+void ff_dwt_lift53_sub_sse2(int32_t *dst, const int32_t *a, const int32_t *b, int len);
+void ff_dwt_lift53_add_sse2(int32_t *dst, const int32_t *a, const int32_t *b, int len);
+void ff_dwt_lift53_sub_avx2(int32_t *dst, const int32_t *a, const int32_t *b, int len);
+void ff_dwt_lift53_add_avx2(int32_t *dst, const int32_t *a, const int32_t *b, int len);
+void ff_dwt_lift97_int_sub_sse4(int32_t *dst, const int32_t *a, const int32_t *b,
+                                int len, int coef);
+void ff_dwt_lift97_int_add_sse4(int32_t *dst, const int32_t *a, const int32_t *b,
+                                int len, int coef);
+void ff_dwt_lift97_int_sub_avx2(int32_t *dst, const int32_t *a, const int32_t *b,
+                                int len, int coef);
+void ff_dwt_lift97_int_add_avx2(int32_t *dst, const int32_t *a, const int32_t *b,
+                                int len, int coef);
+
+av_cold void ff_jpeg2000dwt_init_x86(DWTContext *s)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_SSE2(cpu_flags)) {
+        s->lift53_sub = ff_dwt_lift53_sub_sse2;
+        s->lift53_add = ff_dwt_lift53_add_sse2;
+    }
+
+    if (EXTERNAL_SSE4(cpu_flags)) {
+        s->lift97_int_sub = ff_dwt_lift97_int_sub_sse4;
+        s->lift97_int_add = ff_dwt_lift97_int_add_sse4;
+    }
+
+    if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+        s->lift53_sub     = ff_dwt_lift53_sub_avx2;
+        s->lift53_add     = ff_dwt_lift53_add_avx2;
+        s->lift97_int_sub = ff_dwt_lift97_int_sub_avx2;
+        s->lift97_int_add = ff_dwt_lift97_int_add_avx2;
+    }
+}
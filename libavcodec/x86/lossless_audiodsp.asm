@@ -178,3 +178,62 @@ SCALARPRODUCT_LOOP 0
     HADDD   m6, m0
     movd   eax, m6
     RET
+
+%if HAVE_AVX2_EXTERNAL
+; int ff_scalarproduct_and_madd_int16(int16_t *v1, int16_t *v2, int16_t *v3,
+;                                     int order, int mul)
+; v1 is only guaranteed to be 16-byte aligned, so one unaligned ymm is
+; processed per iteration to keep supporting orders that are multiples of 16.
+INIT_YMM avx2
+cglobal scalarproduct_and_madd_int16, 4,4,8, v1, v2, v3, order, mul
+    shl orderd, 1
+    movd   xm7, mulm
+    vpbroadcastw m7, xm7
+    pxor    m6, m6
+    add v1q, orderq
+    add v2q, orderq
+    add v3q, orderq
+    neg orderq
+.loop:
+    movu    m4, [v1q + orderq]
+    movu    m2, [v3q + orderq]
+    pmaddwd m0, m4, [v2q + orderq]
+    pmullw  m2, m7
+    paddd   m6, m0
+    paddw   m2, m4
+    movu    [v1q + orderq], m2
+    add     orderq, mmsize
+    jl .loop
+    HADDD   m6, m0
+    movd   eax, xm6
+    RET
+
+; int ff_scalarproduct_and_madd_int32(int16_t *v1, int32_t *v2, int16_t *v3,
+;                                     int order, int mul)
+cglobal scalarproduct_and_madd_int32, 4,4,8, v1, v2, v3, order, mul
+    shl orderd, 1
+    movd   xm7, mulm
+    vpbroadcastw m7, xm7
+    pxor    m6, m6
+    add v1q, orderq
+    lea v2q, [v2q + 2*orderq]
+    add v3q, orderq
+    neg orderq
+.loop:
+    movu     m3, [v1q + orderq]
+    pmovsxwd m4, [v1q + orderq]
+    pmovsxwd m5, [v1q + orderq + mmsize/2]
+    movu     m2, [v3q + orderq]
+    pmulld   m4, [v2q + 2*orderq]
+    pmulld   m5, [v2q + 2*orderq + mmsize]
+    pmullw   m2, m7
+    paddd    m6, m4
+    paddw    m2, m3
+    paddd    m6, m5
+    movu     [v1q + orderq], m2
+    add      orderq, mmsize
+    jl .loop
+    HADDD   m6, m0
+    movd   eax, xm6
+    RET
+%endif
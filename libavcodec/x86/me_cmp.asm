@@ -519,6 +519,103 @@ SAD 8
 SAD 16
 INIT_XMM sse2
 SAD 16
+;------------------------------------------------------------------------------------------
+;void ff_sad_x4_<opt>(MpegEncContext *v, const uint8_t *pix1, const uint8_t *const ref[4],
+;                     ptrdiff_t stride, int h, int scores[4]);
+;------------------------------------------------------------------------------------------
+;%1 = 8/16
+%macro SAD_X4_ROW 4 ; width, accumulator, tmp, ref
+%if %1 == 8
+    movq     m%3, [%4]
+    movhps   m%3, [%4+strideq]
+%elif mmsize == 32
+    movu    xm%3, [%4]
+    vinserti128 m%3, m%3, [%4+strideq], 1
+%else
+    movu     m%3, [%4]
+%endif
+    psadbw   m%3, m4
+    paddd    m%2, m%3
+%endmacro
+
+%macro SAD_X4 1
+%if %1 == 16 && mmsize == 16
+%define rows 1
+%else
+%define rows 2
+%endif
+cglobal sad%1_x4, 6, 10, 6, v, pix1, ref, stride, h, scores, ref0, ref1, ref2, ref3
+    mov      ref0q, [refq+0*gprsize]
+    mov      ref1q, [refq+1*gprsize]
+    mov      ref2q, [refq+2*gprsize]
+    mov      ref3q, [refq+3*gprsize]
+    pxor        m0, m0
+    pxor        m1, m1
+    pxor        m2, m2
+    pxor        m3, m3
+
+align 16
+.loop:
+%if %1 == 8
+    movq        m4, [pix1q]
+    movhps      m4, [pix1q+strideq]
+%elif mmsize == 32
+    movu       xm4, [pix1q]
+    vinserti128 m4, m4, [pix1q+strideq], 1
+%else
+    movu        m4, [pix1q]
+%endif
+    SAD_X4_ROW %1, 0, 5, ref0q
+    SAD_X4_ROW %1, 1, 5, ref1q
+    SAD_X4_ROW %1, 2, 5, ref2q
+    SAD_X4_ROW %1, 3, 5, ref3q
+%if rows == 2
+    lea      pix1q, [pix1q+strideq*2]
+    lea      ref0q, [ref0q+strideq*2]
+    lea      ref1q, [ref1q+strideq*2]
+    lea      ref2q, [ref2q+strideq*2]
+    lea      ref3q, [ref3q+strideq*2]
+%else
+    add      pix1q, strideq
+    add      ref0q, strideq
+    add      ref1q, strideq
+    add      ref2q, strideq
+    add      ref3q, strideq
+%endif
+    sub         hd, rows
+    jg .loop
+
+%if mmsize == 32
+    vextracti128 xm4, m0, 1
+    vextracti128 xm5, m1, 1
+    paddd      xm0, xm4
+    paddd      xm1, xm5
+    vextracti128 xm4, m2, 1
+    vextracti128 xm5, m3, 1
+    paddd      xm2, xm4
+    paddd      xm3, xm5
+%endif
+    ; each accumulator holds two partial sums in dwords 0 and 2
+    shufps     xm0, xm1, q2020
+    shufps     xm2, xm3, q2020
+    movaps     xm1, xm0
+    shufps     xm0, xm2, q2020
+    shufps     xm1, xm2, q3131
+    paddd      xm0, xm1
+    movu [scoresq], xm0
+    RET
+%undef rows
+%endmacro
+
+%if ARCH_X86_64
+INIT_XMM sse2
+SAD_X4 8
+SAD_X4 16
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+SAD_X4 16
+%endif
+%endif
 
 ;------------------------------------------------------------------------------------------
 ;int ff_sad_x2_<opt>(MpegEncContext *v, const uint8_t *pix1, const uint8_t *pix2, ptrdiff_t stride, int h);
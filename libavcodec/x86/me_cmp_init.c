@@ -46,6 +46,15 @@ int ff_sad16_mmxext(MpegEncContext *v, const uint8_t *pix1, const uint8_t *pix2,
                     ptrdiff_t stride, int h);
 int ff_sad16_sse2(MpegEncContext *v, const uint8_t *pix1, const uint8_t *pix2,
                   ptrdiff_t stride, int h);
+void ff_sad8_x4_sse2(MpegEncContext *v, const uint8_t *pix1,
+                     const uint8_t *const ref[4], ptrdiff_t stride, int h,
+                     int scores[4]);
+void ff_sad16_x4_sse2(MpegEncContext *v, const uint8_t *pix1,
+                      const uint8_t *const ref[4], ptrdiff_t stride, int h,
+                      int scores[4]);
+void ff_sad16_x4_avx2(MpegEncContext *v, const uint8_t *pix1,
+                      const uint8_t *const ref[4], ptrdiff_t stride, int h,
+                      int scores[4]);
 int ff_sad8_x2_mmxext(MpegEncContext *v, const uint8_t *pix1, const uint8_t *pix2,
                       ptrdiff_t stride, int h);
 int ff_sad16_x2_mmxext(MpegEncContext *v, const uint8_t *pix1, const uint8_t *pix2,
@@ -300,6 +309,13 @@ av_cold void ff_me_cmp_init_x86(MECmpContext *c, AVCodecContext *avctx)
         }
     }
 
+#if ARCH_X86_64
+    if (EXTERNAL_SSE2(cpu_flags) && !(cpu_flags & AV_CPU_FLAG_SSE2SLOW)) {
+        c->sad_x4[0] = ff_sad16_x4_sse2;
+        c->sad_x4[1] = ff_sad8_x4_sse2;
+    }
+#endif
+
     if (EXTERNAL_SSSE3(cpu_flags)) {
         c->sum_abs_dctelem   = ff_sum_abs_dctelem_ssse3;
 #if HAVE_ALIGNED_STACK
@@ -307,4 +323,9 @@ av_cold void ff_me_cmp_init_x86(MECmpContext *c, AVCodecContext *avctx)
         c->hadamard8_diff[1] = ff_hadamard8_diff_ssse3;
 #endif
     }
+
+#if ARCH_X86_64
+    if (EXTERNAL_AVX2_FAST(cpu_flags))
+        c->sad_x4[0] = ff_sad16_x4_avx2;
+#endif
 }
@@ -0,0 +1,114 @@
+;******************************************************************************
+;* SIMD start code and emulation prevention byte search
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA
+
+cextern pb_1
+cextern pb_2
+
+SECTION .text
+
+;-----------------------------------------------------------------------------
+; int ff_startcode_find_candidate(const uint8_t *buf, int size)
+;-----------------------------------------------------------------------------
+%macro STARTCODE_FIND_CANDIDATE 0
+cglobal startcode_find_candidate, 2, 4, 2, buf, size, idx, mask
+    movsxdifnidn sizeq, sized
+    xor         idxd, idxd
+    test       sized, sized
+    jle .end
+    pxor          m1, m1
+.loop:
+    movu          m0, [bufq+idxq]
+    pcmpeqb       m0, m1
+    pmovmskb   maskd, m0
+    test       maskd, maskd
+    jnz .found
+    add         idxq, mmsize
+    cmp         idxq, sizeq
+    jl .loop
+    mov         idxq, sizeq
+    jmp .end
+.found:
+    bsf        maskd, maskd
+    add         idxq, maskq
+    cmp         idxq, sizeq
+    cmovg       idxq, sizeq
+.end:
+    mov          eax, idxd
+    RET
+%endmacro
+
+INIT_XMM sse2
+STARTCODE_FIND_CANDIDATE
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+STARTCODE_FIND_CANDIDATE
+%endif
+
+;-----------------------------------------------------------------------------
+; int ff_startcode_find_escape(const uint8_t *buf, int size)
+;-----------------------------------------------------------------------------
+%macro STARTCODE_FIND_ESCAPE 0
+cglobal startcode_find_escape, 2, 5, 6, buf, size, idx, mask, end
+    movsxdifnidn sizeq, sized
+    lea          endq, [sizeq-2]
+    xor          idxd, idxd
+    test         endq, endq
+    jle .none
+    pxor           m3, m3
+    mova           m4, [pb_1]
+    mova           m5, [pb_2]
+.loop:
+    movu           m0, [bufq+idxq]
+    movu           m1, [bufq+idxq+1]
+    movu           m2, [bufq+idxq+2]
+    por            m0, m1
+    pcmpeqb        m0, m3           ; buf[i] == 0 && buf[i + 1] == 0
+    psubb          m2, m4
+    pminub         m1, m2, m5
+    pcmpeqb        m1, m2           ; 1 <= buf[i + 2] <= 3
+    pand           m0, m1
+    pmovmskb    maskd, m0
+    test        maskd, maskd
+    jnz .found
+    add          idxq, mmsize
+    cmp          idxq, endq
+    jl .loop
+.none:
+    mov           eax, sized
+    RET
+.found:
+    bsf         maskd, maskd
+    add          idxq, maskq
+    cmp          idxq, endq
+    cmovge       idxq, sizeq
+    mov           eax, idxd
+    RET
+%endmacro
+
+INIT_XMM sse2
+STARTCODE_FIND_ESCAPE
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+STARTCODE_FIND_ESCAPE
+%endif
@@ -0,0 +1,485 @@
+/*
+ * Background writer for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+
+#include "config.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "async_writer.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "url.h"
+
+/* Latency histogram buckets: below 1 ms, then powers of two milliseconds,
+ * the last one collecting everything above. */
+#define NB_BUCKETS 14
+
+enum AsyncJobType {
+    JOB_WRITE,
+    JOB_RENAME,
+    JOB_DELETE,
+};
+
+typedef struct AsyncJob {
+    struct AsyncJob *next;
+    enum AsyncJobType type;
+    char *url;                  ///< file to write or delete, rename source
+    char *dst;                  ///< rename destination
+    AVDictionary *options;
+    uint8_t *data;
+    int size;
+    int64_t queued;             ///< time the job was queued
+} AsyncJob;
+
+typedef struct AsyncFile {
+    AVIOContext *pb;
+    char *url;
+    AVDictionary *options;
+} AsyncFile;
+
+struct FFAsyncWriter {
+    AVFormatContext *s;
+    int max_pending;
+    int ignore_errors;
+
+    AsyncFile *files;           ///< files opened and not closed yet
+    int nb_files;
+
+    /* Everything below is protected by mutex once the thread is started. */
+    AsyncJob *first, *last;
+    int nb_pending;             ///< jobs queued or running
+    int exit;
+    int error;                  ///< first error, sticky
+
+    /* statistics, times in microseconds */
+    int nb_written;
+    int64_t bytes;
+    int nb_failed;
+    int64_t write_hist[NB_BUCKETS];
+    int64_t max_write_time;
+    int64_t max_latency;        ///< from queueing to completion
+    int nb_stalls;              ///< times the muxer waited for a free slot
+    int64_t stall_time;
+
+#if HAVE_THREADS
+    AVMutex mutex;
+    AVCond cond;                ///< job queued or finished, or exit
+    pthread_t thread;
+    int thread_started;
+#endif
+};
+
+static void free_job(AsyncJob *job)
+{
+    av_freep(&job->url);
+    av_freep(&job->dst);
+    av_dict_free(&job->options);
+    av_freep(&job->data);
+    av_free(job);
+}
+
+static int run_job(FFAsyncWriter *w, AsyncJob *job)
+{
+    AVFormatContext *s = w->s;
+    int level = w->ignore_errors ? AV_LOG_WARNING : AV_LOG_ERROR;
+    AVIOContext *pb = NULL;
+    int ret, ret2;
+
+    switch (job->type) {
+    case JOB_WRITE:
+        ret = s->io_open(s, &pb, job->url, AVIO_FLAG_WRITE, &job->options);
+        if (ret < 0) {
+            av_log(s, level, "Failed to open file '%s': %s\n",
+                   job->url, av_err2str(ret));
+            return ret;
+        }
+        avio_write(pb, job->data, job->size);
+        avio_flush(pb);
+        ret  = pb->error;
+        ret2 = ff_format_io_close(s, &pb);
+        if (ret >= 0)
+            ret = ret2;
+        if (ret < 0)
+            av_log(s, level, "Failed to write file '%s': %s\n",
+                   job->url, av_err2str(ret));
+        return ret;
+    case JOB_RENAME:
+        /* ff_rename() logs the error itself */
+        return ff_rename(job->url, job->dst, s);
+    case JOB_DELETE:
+        ret = ffurl_delete(job->url);
+        if (ret < 0 && ret != AVERROR(ENOENT))
+            av_log(s, AV_LOG_WARNING, "Failed to delete file '%s': %s\n",
+                   job->url, av_err2str(ret));
+        return 0;
+    }
+    return AVERROR_BUG;
+}
+
+/* Called with the mutex locked, if any. */
+static void job_done(FFAsyncWriter *w, AsyncJob *job, int ret,
+                     int64_t start, int64_t end)
+{
+    if (ret < 0) {
+        w->nb_failed++;
+        if (!w->ignore_errors && !w->error)
+            w->error = ret;
+    } else if (job->type == JOB_WRITE) {
+        int64_t t = end - start;
+        int bucket = t < 1000 ? 0 : FFMIN(av_log2(t / 1000) + 1, NB_BUCKETS - 1);
+
+        w->nb_written++;
+        w->bytes += job->size;
+        w->write_hist[bucket]++;
+        w->max_write_time = FFMAX(w->max_write_time, t);
+        w->max_latency    = FFMAX(w->max_latency, end - job->queued);
+    }
+}
+
+#if HAVE_THREADS
+static void *writer_thread(void *arg)
+{
+    FFAsyncWriter *w = arg;
+
+    ff_thread_setname("async_writer");
+
+    ff_mutex_lock(&w->mutex);
+    for (;;) {
+        AsyncJob *job = w->first;
+        int64_t start, end;
+        int ret = 0;
+
+        if (!job) {
+            if (w->exit)
+                break;
+            ff_cond_wait(&w->cond, &w->mutex);
+            continue;
+        }
+        w->first = job->next;
+        if (!w->first)
+            w->last = NULL;
+
+        /* drop everything after a failure */
+        if (!w->error) {
+            ff_mutex_unlock(&w->mutex);
+            start = av_gettime_relative();
+            ret   = run_job(w, job);
+            end   = av_gettime_relative();
+            ff_mutex_lock(&w->mutex);
+            job_done(w, job, ret, start, end);
+        }
+        free_job(job);
+        w->nb_pending--;
+        ff_cond_broadcast(&w->cond);
+    }
+    ff_mutex_unlock(&w->mutex);
+
+    return NULL;
+}
+#endif
+
+static int get_error(FFAsyncWriter *w)
+{
+    int ret;
+
+#if HAVE_THREADS
+    ff_mutex_lock(&w->mutex);
+    ret = w->error;
+    ff_mutex_unlock(&w->mutex);
+#else
+    ret = w->error;
+#endif
+    return ret;
+}
+
+static int queue_job(FFAsyncWriter *w, AsyncJob *job)
+{
+    int64_t start, end;
+    int ret;
+
+    job->queued = av_gettime_relative();
+
+#if HAVE_THREADS
+    if (w->thread_started) {
+        ff_mutex_lock(&w->mutex);
+        if (w->nb_pending >= w->max_pending && !w->error) {
+            w->nb_stalls++;
+            while (w->nb_pending >= w->max_pending && !w->error)
+                ff_cond_wait(&w->cond, &w->mutex);
+            w->stall_time += av_gettime_relative() - job->queued;
+        }
+        ret = w->error;
+        if (!ret) {
+            if (w->last)
+                w->last->next = job;
+            else
+                w->first = job;
+            w->last = job;
+            w->nb_pending++;
+            ff_cond_broadcast(&w->cond);
+        }
+        ff_mutex_unlock(&w->mutex);
+        if (ret < 0)
+            free_job(job);
+        return ret;
+    }
+#endif
+
+    if (w->error) {
+        free_job(job);
+        return w->error;
+    }
+    start = job->queued;
+    ret   = run_job(w, job);
+    end   = av_gettime_relative();
+    job_done(w, job, ret, start, end);
+    free_job(job);
+    return w->error;
+}
+
+int ff_async_writer_alloc(FFAsyncWriter **pw, AVFormatContext *s,
+                          int max_pending, int ignore_errors)
+{
+    FFAsyncWriter *w;
+
+    *pw = NULL;
+    if (max_pending <= 0)
+        return AVERROR(EINVAL);
+    w = av_mallocz(sizeof(*w));
+    if (!w)
+        return AVERROR(ENOMEM);
+    w->s             = s;
+    w->max_pending   = max_pending;
+    w->ignore_errors = ignore_errors;
+
+#if HAVE_THREADS
+    {
+        int ret;
+
+        if ((ret = ff_mutex_init(&w->mutex, NULL))) {
+            av_free(w);
+            return AVERROR(ret);
+        }
+        if ((ret = ff_cond_init(&w->cond, NULL))) {
+            ff_mutex_destroy(&w->mutex);
+            av_free(w);
+            return AVERROR(ret);
+        }
+        ret = pthread_create(&w->thread, NULL, writer_thread, w);
+        if (ret) {
+            av_log(s, AV_LOG_ERROR, "pthread_create failed: %s\n", av_err2str(AVERROR(ret)));
+            ff_cond_destroy(&w->cond);
+            ff_mutex_destroy(&w->mutex);
+            av_free(w);
+            return AVERROR(ret);
+        }
+        w->thread_started = 1;
+    }
+#else
+    av_log(s, AV_LOG_WARNING, "Writing files in the background requires threads, "
+           "writing them synchronously\n");
+#endif
+
+    *pw = w;
+    return 0;
+}
+
+static void log_stats(FFAsyncWriter *w)
+{
+    AVBPrint bp;
+    int last = NB_BUCKETS - 1;
+
+    if (!w->nb_written && !w->nb_failed)
+        return;
+
+    av_log(w->s, AV_LOG_VERBOSE,
+           "Background writer: %d files written, %"PRId64" bytes, %d failed, "
+           "maximum write time %"PRId64" ms, maximum latency %"PRId64" ms, "
+           "%d stalls for %"PRId64" ms\n",
+           w->nb_written, w->bytes, w->nb_failed, w->max_write_time / 1000,
+           w->max_latency / 1000, w->nb_stalls, w->stall_time / 1000);
+
+    while (last > 0 && !w->write_hist[last])
+        last--;
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_AUTOMATIC);
+    av_bprintf(&bp, "Write time histogram: <1 ms: %"PRId64, w->write_hist[0]);
+    for (int i = 1; i <= last; i++) {
+        if (i == NB_BUCKETS - 1)
+            av_bprintf(&bp, ", >=%d ms: %"PRId64, 1 << (i - 1), w->write_hist[i]);
+        else
+            av_bprintf(&bp, ", %d-%d ms: %"PRId64, 1 << (i - 1), 1 << i, w->write_hist[i]);
+    }
+    av_log(w->s, AV_LOG_VERBOSE, "%s\n", bp.str);
+    av_bprint_finalize(&bp, NULL);
+}
+
+void ff_async_writer_free(FFAsyncWriter **pw)
+{
+    FFAsyncWriter *w = *pw;
+
+    if (!w)
+        return;
+
+#if HAVE_THREADS
+    if (w->thread_started) {
+        ff_mutex_lock(&w->mutex);
+        w->exit = 1;
+        ff_cond_broadcast(&w->cond);
+        ff_mutex_unlock(&w->mutex);
+        pthread_join(w->thread, NULL);
+    }
+    ff_cond_destroy(&w->cond);
+    ff_mutex_destroy(&w->mutex);
+#endif
+
+    for (int i = 0; i < w->nb_files; i++) {
+        ffio_free_dyn_buf(&w->files[i].pb);
+        av_freep(&w->files[i].url);
+        av_dict_free(&w->files[i].options);
+    }
+    av_freep(&w->files);
+
+    log_stats(w);
+    av_freep(pw);
+}
+
+int ff_async_writer_open(FFAsyncWriter *w, AVIOContext **pb, const char *url,
+                         AVDictionary **options)
+{
+    AsyncFile *files, *f;
+    int ret;
+
+    if ((ret = get_error(w)) < 0)
+        return ret;
+
+    files = av_realloc_array(w->files, w->nb_files + 1, sizeof(*w->files));
+    if (!files)
+        return AVERROR(ENOMEM);
+    w->files = files;
+    f = &files[w->nb_files];
+    memset(f, 0, sizeof(*f));
+
+    f->url = av_strdup(url);
+    if (!f->url)
+        return AVERROR(ENOMEM);
+    if (options && (ret = av_dict_copy(&f->options, *options, 0)) < 0)
+        goto fail;
+    if ((ret = avio_open_dyn_buf(&f->pb)) < 0)
+        goto fail;
+
+    *pb = f->pb;
+    w->nb_files++;
+    return 0;
+fail:
+    av_freep(&f->url);
+    av_dict_free(&f->options);
+    return ret;
+}
+
+int ff_async_writer_close(FFAsyncWriter *w, AVIOContext **pb)
+{
+    AsyncJob *job;
+    AsyncFile f;
+    int i;
+
+    for (i = 0; i < w->nb_files; i++)
+        if (w->files[i].pb == *pb)
+            break;
+    if (i == w->nb_files)
+        return AVERROR(EINVAL);
+    f = w->files[i];
+    w->files[i] = w->files[--w->nb_files];
+    *pb = NULL;
+
+    job = av_mallocz(sizeof(*job));
+    if (!job) {
+        ffio_free_dyn_buf(&f.pb);
+        av_free(f.url);
+        av_dict_free(&f.options);
+        return AVERROR(ENOMEM);
+    }
+    job->type    = JOB_WRITE;
+    job->url     = f.url;
+    job->options = f.options;
+    job->size    = avio_close_dyn_buf(f.pb, &job->data);
+    if (!job->data) {
+        free_job(job);
+        return AVERROR(ENOMEM);
+    }
+
+    return queue_job(w, job);
+}
+
+int ff_async_writer_rename(FFAsyncWriter *w, const char *src, const char *dst)
+{
+    AsyncJob *job = av_mallocz(sizeof(*job));
+
+    if (!job)
+        return AVERROR(ENOMEM);
+    job->type = JOB_RENAME;
+    job->url  = av_strdup(src);
+    job->dst  = av_strdup(dst);
+    if (!job->url || !job->dst) {
+        free_job(job);
+        return AVERROR(ENOMEM);
+    }
+
+    return queue_job(w, job);
+}
+
+int ff_async_writer_delete(FFAsyncWriter *w, const char *url)
+{
+    AsyncJob *job = av_mallocz(sizeof(*job));
+
+    if (!job)
+        return AVERROR(ENOMEM);
+    job->type = JOB_DELETE;
+    job->url  = av_strdup(url);
+    if (!job->url) {
+        free_job(job);
+        return AVERROR(ENOMEM);
+    }
+
+    return queue_job(w, job);
+}
+
+int ff_async_writer_flush(FFAsyncWriter *w)
+{
+#if HAVE_THREADS
+    if (w->thread_started) {
+        int ret;
+
+        ff_mutex_lock(&w->mutex);
+        while (w->nb_pending)
+            ff_cond_wait(&w->cond, &w->mutex);
+        ret = w->error;
+        ff_mutex_unlock(&w->mutex);
+        return ret;
+    }
+#endif
+    return w->error;
+}
@@ -0,0 +1,101 @@
+/*
+ * Background writer for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_ASYNC_WRITER_H
+#define AVFORMAT_ASYNC_WRITER_H
+
+#include "libavutil/dict.h"
+
+#include "avformat.h"
+#include "avio.h"
+
+/**
+ * Queue of output files that are written, renamed and deleted by a
+ * background thread, so that a slow output does not stall muxing.
+ *
+ * Files are muxed into memory and only opened with AVFormatContext.io_open
+ * once they are complete. All operations are performed in the order they
+ * were queued, so that e.g. a playlist renamed after a segment was closed
+ * never references a segment that is not completely written yet.
+ *
+ * Once an operation fails, the operations queued after it are dropped and
+ * the error is returned by the next call, unless errors are ignored.
+ * Failing to delete a file is never an error.
+ *
+ * Without threading support, all operations are performed synchronously.
+ */
+typedef struct FFAsyncWriter FFAsyncWriter;
+
+/**
+ * @param s             context used for opening and closing the files and
+ *                      for logging; its io_open and io_close2 callbacks
+ *                      are called from the writer thread
+ * @param max_pending   number of operations that may be queued or running
+ *                      before ff_async_writer_close() and the other queueing
+ *                      functions block
+ * @param ignore_errors log errors but continue with the next operations
+ */
+int ff_async_writer_alloc(FFAsyncWriter **w, AVFormatContext *s,
+                          int max_pending, int ignore_errors);
+
+/**
+ * Wait for all the queued operations and free the writer. The AVIOContexts
+ * that were opened but not closed are discarded.
+ */
+void ff_async_writer_free(FFAsyncWriter **w);
+
+/**
+ * Open an in-memory AVIOContext for the file url. It is not seekable
+ * beyond what dynamic buffers support.
+ *
+ * @param options options to open url with, copied
+ * @return 0 on success, a negative AVERROR code if an earlier operation
+ *         failed
+ */
+int ff_async_writer_open(FFAsyncWriter *w, AVIOContext **pb, const char *url,
+                         AVDictionary **options);
+
+/**
+ * Queue writing the data of an AVIOContext opened with
+ * ff_async_writer_open() to its file. *pb is freed and set to NULL.
+ *
+ * @return 0 on success, a negative AVERROR code if this or an earlier
+ *         operation failed
+ */
+int ff_async_writer_close(FFAsyncWriter *w, AVIOContext **pb);
+
+/**
+ * Queue renaming a file with ff_rename().
+ */
+int ff_async_writer_rename(FFAsyncWriter *w, const char *src, const char *dst);
+
+/**
+ * Queue deleting a file with ffurl_delete().
+ */
+int ff_async_writer_delete(FFAsyncWriter *w, const char *url);
+
+/**
+ * Wait until all the queued operations are done.
+ *
+ * @return 0 on success, a negative AVERROR code if an operation failed
+ */
+int ff_async_writer_flush(FFAsyncWriter *w);
+
+#endif /* AVFORMAT_ASYNC_WRITER_H */
@@ -36,6 +36,7 @@
 #include "libavcodec/codec_desc.h"
 #include "libavcodec/packet_internal.h"
 #include "avformat.h"
+#include "compactindex.h"
 #include "avio.h"
 #include "demux.h"
 #include "mux.h"
@@ -64,6 +65,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
     avcodec_free_context(&sti->avctx);
     av_bsf_free(&sti->bsfc);
     av_freep(&sti->index_entries);
+    ff_compact_index_free(&sti->compact_index);
+    avpriv_packet_list_free(&sti->interleave_queue);
     av_freep(&sti->probe_data.buf);
 
     av_bsf_free(&sti->extract_extradata.bsf);
@@ -183,6 +186,7 @@ void avformat_free_context(AVFormatContext *s)
     av_freep(&s->streams);
     av_freep(&s->stream_groups);
     ff_flush_packet_queue(s);
+    av_freep(&si->interleave_heap);
     av_freep(&s->url);
     av_free(s);
 }
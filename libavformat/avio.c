@@ -634,6 +634,9 @@ int avio_close(AVIOContext *s)
     else
         av_log(s, AV_LOG_VERBOSE, "Statistics: %"PRId64" bytes read, %d seeks\n",
                ctx->bytes_read, ctx->seek_count);
+    if (ctx->bytes_mapped)
+        av_log(s, AV_LOG_VERBOSE, "Statistics: %"PRId64" bytes mapped\n",
+               ctx->bytes_mapped);
     av_opt_free(s);
 
     error = s->error;
@@ -844,6 +847,22 @@ int ffurl_get_short_seek(void *urlcontext)
     return h->prot->url_get_short_seek(h);
 }
 
+int ffurl_get_mapping(URLContext *h, AVBufferRef **buf)
+{
+    if (!h || !h->prot || !h->prot->url_get_mapping)
+        return AVERROR(ENOSYS);
+    return h->prot->url_get_mapping(h, buf);
+}
+
+int ffurl_copy_range(URLContext *h, int64_t dst, int64_t src, int64_t size)
+{
+    if (!h || !h->prot || !h->prot->url_copy_range)
+        return AVERROR(ENOSYS);
+    if (dst < 0 || src < 0 || size < 0)
+        return AVERROR(EINVAL);
+    return h->prot->url_copy_range(h, dst, src, size);
+}
+
 int ffurl_shutdown(URLContext *h, int flags)
 {
     if (!h || !h->prot || !h->prot->url_shutdown)
@@ -21,6 +21,7 @@
 
 #include "avio.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/log.h"
 
 extern const AVClass ff_avio_class;
@@ -50,6 +51,11 @@ typedef struct FFIOContext {
      */
     int64_t bytes_read;
 
+    /**
+     * Bytes mapped statistic, not included in bytes_read
+     */
+    int64_t bytes_mapped;
+
     /**
      * Bytes written statistic
      */
@@ -119,6 +125,25 @@ void ffio_init_write_context(FFIOContext *s, uint8_t *buffer, int buffer_size);
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Return the next size bytes as a reference into a memory mapping of the
+ * underlying resource instead of copying them, and skip over them.
+ *
+ * This only works for protocols which keep the whole resource mapped (the
+ * file protocol with the mmap option) and if the data is followed by at
+ * least AV_INPUT_BUFFER_PADDING_SIZE bytes inside the mapping. The padding
+ * is the file data following the requested range and is not zeroed, so this
+ * must only be used for data whose consumers never read beyond its end.
+ * The returned memory is read-only.
+ *
+ * @param buf set to a new reference to the mapping on success
+ * @param data set to the first requested byte on success
+ * @return 0 on success, a negative AVERROR code if the data has to be read
+ *         normally; nothing is consumed in that case
+ */
+int ffio_read_mapped(AVIOContext *s, int size,
+                     AVBufferRef **buf, uint8_t **data);
+
 void ffio_fill(AVIOContext *s, int b, int64_t count);
 
 static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
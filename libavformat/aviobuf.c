@@ -31,6 +31,7 @@
 #include "avio.h"
 #include "avio_internal.h"
 #include "internal.h"
+#include "url.h"
 #include <stdarg.h>
 
 #define IO_BUFFER_SIZE 32768
@@ -681,6 +682,48 @@ int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsig
     }
 }
 
+int ffio_read_mapped(AVIOContext *s, int size,
+                     AVBufferRef **buf, uint8_t **data)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    URLContext *h = ffio_geturlcontext(s);
+    int64_t pos = avio_tell(s);
+    AVBufferRef *map;
+    int ret;
+
+    if (!h || s->write_flag || s->update_checksum || size <= 0 || pos < 0)
+        return AVERROR(ENOSYS);
+
+    ret = ffurl_get_mapping(h, &map);
+    if (ret < 0)
+        return ret;
+    if (pos > map->size ||
+        map->size - pos < (size_t)size + AV_INPUT_BUFFER_PADDING_SIZE) {
+        av_buffer_unref(&map);
+        return AVERROR(ENOSYS);
+    }
+    if (s->buf_end - s->buf_ptr >= size) {
+        s->buf_ptr += size;
+    } else {
+        /* skip without reading the data into the buffer */
+        int64_t res = s->seek(s->opaque, pos + size, SEEK_SET);
+        if (res < 0) {
+            av_buffer_unref(&map);
+            return res;
+        }
+        ctx->seek_count++;
+        s->buf_end = s->buf_ptr = s->buffer;
+        s->pos = pos + size;
+        s->eof_reached = 0;
+    }
+
+    ctx->bytes_mapped += size;
+
+    *buf  = map;
+    *data = map->data + pos;
+    return 0;
+}
+
 int avio_read_partial(AVIOContext *s, unsigned char *buf, int size)
 {
     int len;
@@ -0,0 +1,311 @@
+/*
+ * Compact seek index
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/intmath.h"
+#include "libavutil/mem.h"
+
+#include "compactindex.h"
+
+#define BLOCK_BITS 6
+#define BLOCK_SIZE (1 << BLOCK_BITS)
+
+/* Entry header byte. If bit 7 is set, the low bits are the number of
+ * following fully predicted entries minus one. Otherwise the set bits
+ * tell which of the following fields are coded, in this order. */
+#define CODE_SIZE     0x01 ///< size differs from the previous entry
+#define CODE_DURATION 0x02 ///< timestamp delta differs from the previous one
+#define CODE_POS      0x04 ///< entry does not directly follow the previous one
+#define CODE_DISTANCE 0x08 ///< min_distance is not the predicted one
+#define CODE_DISCARD  0x10 ///< AVINDEX_DISCARD_FRAME, no field coded
+#define CODE_RUN      0x80
+
+/* header byte and up to four 64-bit varints */
+#define MAX_ENTRY_SIZE (1 + 4 * 10)
+
+typedef struct CompactIndexBlock {
+    int64_t  pos;        ///< position of the first entry
+    int64_t  timestamp;  ///< timestamp of the first entry
+    uint64_t keyframes;  ///< bit i is set if entry i is a keyframe
+    unsigned offset;     ///< offset of the coded entries in data
+} CompactIndexBlock;
+
+/* Predictor state, identical in the encoder and the decoder. */
+typedef struct CompactIndexState {
+    AVIndexEntry prev;
+    int64_t duration;
+} CompactIndexState;
+
+struct FFCompactIndex {
+    CompactIndexBlock *blocks;
+    unsigned blocks_allocated;
+    int nb_entries;
+
+    uint8_t *data;
+    unsigned data_size;
+    unsigned data_allocated;
+
+    CompactIndexState state;
+    int run_offset;             ///< offset of the last run byte in data, or -1
+
+    AVIndexEntry cache[BLOCK_SIZE];
+    int cache_block;            ///< block decoded into cache, or -1
+};
+
+static void state_init(CompactIndexState *s, const CompactIndexBlock *blk)
+{
+    s->prev = (AVIndexEntry) {
+        .pos          = blk->pos,
+        .timestamp    = blk->timestamp,
+        .min_distance = -1,
+    };
+    s->duration = 0;
+}
+
+static uint8_t *put_varint(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = v | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static uint64_t get_varint(const uint8_t **pp)
+{
+    const uint8_t *p = *pp;
+    uint64_t v = 0;
+    int shift = 0;
+
+    do {
+        v |= (uint64_t)(*p & 0x7f) << shift;
+        shift += 7;
+    } while (*p++ & 0x80 && shift < 64);
+    *pp = p;
+    return v;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+FFCompactIndex *ff_compact_index_alloc(void)
+{
+    FFCompactIndex *ci = av_mallocz(sizeof(*ci));
+    if (!ci)
+        return NULL;
+    ci->run_offset  = -1;
+    ci->cache_block = -1;
+    return ci;
+}
+
+void ff_compact_index_free(FFCompactIndex **pci)
+{
+    FFCompactIndex *ci = *pci;
+
+    if (!ci)
+        return;
+    av_freep(&ci->blocks);
+    av_freep(&ci->data);
+    av_freep(pci);
+}
+
+int ff_compact_index_append(FFCompactIndex *ci, const AVIndexEntry *e)
+{
+    CompactIndexState *const s = &ci->state;
+    int i = ci->nb_entries & (BLOCK_SIZE - 1);
+    int key = !!(e->flags & AVINDEX_KEYFRAME);
+    CompactIndexBlock *blk;
+    uint8_t buf[MAX_ENTRY_SIZE], *p = buf + 1;
+    int64_t duration, pos_delta;
+    int distance, code = 0;
+
+    if (ci->nb_entries && e->timestamp <= s->prev.timestamp)
+        return AVERROR(EINVAL);
+    if (ci->nb_entries == INT_MAX ||
+        ci->data_size > UINT_MAX - MAX_ENTRY_SIZE)
+        return AVERROR(ENOMEM);
+
+    if (!i) {
+        int nb_blocks = ci->nb_entries >> BLOCK_BITS;
+        blk = av_fast_realloc(ci->blocks, &ci->blocks_allocated,
+                              (nb_blocks + 1) * sizeof(*ci->blocks));
+        if (!blk)
+            return AVERROR(ENOMEM);
+        ci->blocks = blk;
+        blk       += nb_blocks;
+        blk->pos       = e->pos;
+        blk->timestamp = e->timestamp;
+        blk->keyframes = 0;
+        blk->offset    = ci->data_size;
+        state_init(s, blk);
+        ci->run_offset = -1;
+    } else
+        blk = &ci->blocks[ci->nb_entries >> BLOCK_BITS];
+
+    duration  = (uint64_t)e->timestamp - s->prev.timestamp;
+    pos_delta = (uint64_t)e->pos - (s->prev.pos + s->prev.size);
+    distance  = key ? 0 : s->prev.min_distance + 1;
+
+    if (e->size != s->prev.size) {
+        code |= CODE_SIZE;
+        p = put_varint(p, e->size);
+    }
+    if (duration != s->duration) {
+        code |= CODE_DURATION;
+        p = put_varint(p, zigzag(duration));
+    }
+    if (pos_delta) {
+        code |= CODE_POS;
+        p = put_varint(p, zigzag(pos_delta));
+    }
+    if (e->min_distance != distance) {
+        code |= CODE_DISTANCE;
+        p = put_varint(p, zigzag(e->min_distance));
+    }
+    if (e->flags & AVINDEX_DISCARD_FRAME)
+        code |= CODE_DISCARD;
+
+    if (code || ci->run_offset < 0) {
+        uint8_t *data = av_fast_realloc(ci->data, &ci->data_allocated,
+                                        ci->data_size + (p - buf));
+        if (!data)
+            return AVERROR(ENOMEM);
+        ci->data = data;
+        buf[0] = code ? code : CODE_RUN;
+        memcpy(data + ci->data_size, buf, p - buf);
+        ci->run_offset = code ? -1 : ci->data_size;
+        ci->data_size += p - buf;
+    } else {
+        ci->data[ci->run_offset]++;
+    }
+
+    blk->keyframes |= (uint64_t)key << i;
+    s->prev     = *e;
+    s->duration = duration;
+    if (ci->cache_block == ci->nb_entries >> BLOCK_BITS)
+        ci->cache_block = -1;
+    ci->nb_entries++;
+
+    return 0;
+}
+
+int ff_compact_index_nb_entries(const FFCompactIndex *ci)
+{
+    return ci->nb_entries;
+}
+
+static void decode_block(FFCompactIndex *ci, int b)
+{
+    const CompactIndexBlock *blk = &ci->blocks[b];
+    const uint8_t *p = ci->data + blk->offset;
+    int n = FFMIN(ci->nb_entries - (b << BLOCK_BITS), BLOCK_SIZE);
+    CompactIndexState s;
+    int run = 0;
+
+    state_init(&s, blk);
+    for (int i = 0; i < n; i++) {
+        AVIndexEntry *e = &ci->cache[i];
+        int key = blk->keyframes >> i & 1;
+        int code = 0;
+
+        if (run) {
+            run--;
+        } else if (*p & CODE_RUN) {
+            run = *p++ & ~CODE_RUN;
+        } else
+            code = *p++;
+
+        e->size = code & CODE_SIZE ? get_varint(&p) : s.prev.size;
+        if (code & CODE_DURATION)
+            s.duration = unzigzag(get_varint(&p));
+        e->timestamp = s.prev.timestamp + (uint64_t)s.duration;
+        e->pos       = s.prev.pos + s.prev.size;
+        if (code & CODE_POS)
+            e->pos += (uint64_t)unzigzag(get_varint(&p));
+        e->min_distance = code & CODE_DISTANCE ? unzigzag(get_varint(&p))
+                                               : key ? 0 : s.prev.min_distance + 1;
+        e->flags = (key ? AVINDEX_KEYFRAME : 0) |
+                   (code & CODE_DISCARD ? AVINDEX_DISCARD_FRAME : 0);
+        s.prev = *e;
+    }
+    ci->cache_block = b;
+}
+
+AVIndexEntry *ff_compact_index_get(FFCompactIndex *ci, int idx)
+{
+    int b = idx >> BLOCK_BITS;
+
+    if (idx < 0 || idx >= ci->nb_entries)
+        return NULL;
+    if (ci->cache_block != b)
+        decode_block(ci, b);
+    return &ci->cache[idx & (BLOCK_SIZE - 1)];
+}
+
+static int highest_bit(uint64_t v)
+{
+    return v >> 32 ? 32 + av_log2(v >> 32) : av_log2(v);
+}
+
+int ff_compact_index_find_keyframe(const FFCompactIndex *ci, int idx, int backward)
+{
+    int b = idx >> BLOCK_BITS, i = idx & (BLOCK_SIZE - 1);
+    int nb_blocks = (ci->nb_entries + BLOCK_SIZE - 1) >> BLOCK_BITS;
+    uint64_t mask;
+
+    if (idx < 0 || idx >= ci->nb_entries)
+        return -1;
+
+    if (backward) {
+        mask = ci->blocks[b].keyframes & (UINT64_MAX >> (BLOCK_SIZE - 1 - i));
+        while (!mask) {
+            if (--b < 0)
+                return -1;
+            mask = ci->blocks[b].keyframes;
+        }
+        return (b << BLOCK_BITS) + highest_bit(mask);
+    }
+
+    mask = ci->blocks[b].keyframes & (UINT64_MAX << i);
+    while (!mask) {
+        if (++b >= nb_blocks)
+            return -1;
+        mask = ci->blocks[b].keyframes;
+    }
+    return (b << BLOCK_BITS) + ff_ctzll(mask);
+}
+
+size_t ff_compact_index_size(const FFCompactIndex *ci)
+{
+    return sizeof(*ci) + ci->blocks_allocated + ci->data_allocated;
+}
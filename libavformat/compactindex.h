@@ -0,0 +1,75 @@
+/*
+ * Compact seek index
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_COMPACTINDEX_H
+#define AVFORMAT_COMPACTINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "avformat.h"
+
+/**
+ * Append-only index storing AVIndexEntry values in blocks of 64 entries.
+ *
+ * Every entry is predicted from the previous one (contiguous position,
+ * same size, same duration) and only the fields that differ are stored
+ * as variable length deltas, so that runs of constant size and duration
+ * cost a single byte per up to 64 entries. Keyframe flags are kept in a
+ * per-block bitmap. Random access decodes at most one block.
+ */
+typedef struct FFCompactIndex FFCompactIndex;
+
+FFCompactIndex *ff_compact_index_alloc(void);
+
+void ff_compact_index_free(FFCompactIndex **ci);
+
+/**
+ * Append an entry. Its timestamp must be larger than the one of the
+ * last entry.
+ *
+ * @return 0 on success, AVERROR(EINVAL) if the timestamp is not larger
+ *         than the one of the last entry, another negative AVERROR code
+ *         on failure
+ */
+int ff_compact_index_append(FFCompactIndex *ci, const AVIndexEntry *e);
+
+int ff_compact_index_nb_entries(const FFCompactIndex *ci);
+
+/**
+ * Get an entry. The returned pointer is only valid until the next call
+ * to any function using ci.
+ */
+AVIndexEntry *ff_compact_index_get(FFCompactIndex *ci, int idx);
+
+/**
+ * Find the closest keyframe entry at or after idx, or at or before it
+ * when backward is set.
+ *
+ * @return the index of the keyframe, or -1 if there is none
+ */
+int ff_compact_index_find_keyframe(const FFCompactIndex *ci, int idx, int backward);
+
+/**
+ * @return the amount of memory used by ci in bytes
+ */
+size_t ff_compact_index_size(const FFCompactIndex *ci);
+
+#endif /* AVFORMAT_COMPACTINDEX_H */
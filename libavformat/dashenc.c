@@ -42,6 +42,7 @@
 
 #include "libavcodec/avcodec.h"
 
+#include "async_writer.h"
 #include "av1.h"
 #include "avc.h"
 #include "avformat.h"
@@ -204,6 +205,8 @@ typedef struct DASHContext {
     AVRational min_playback_rate;
     AVRational max_playback_rate;
     int64_t update_period;
+    int async_io;
+    FFAsyncWriter *writer;  /* background writer if async_io is set */
 } DASHContext;
 
 static const struct codec_string {
@@ -223,6 +226,8 @@ static int dashenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
     DASHContext *c = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
+    if (c->writer)
+        return ff_async_writer_open(c->writer, pb, filename, options);
     if (!*pb || !http_base_proto || !c->http_persistent) {
         err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
@@ -244,7 +249,10 @@ static void dashenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filenam
     if (!*pb)
         return;
 
-    if (!http_base_proto || !c->http_persistent) {
+    if (c->writer) {
+        /* errors are returned by the next call to the writer */
+        ff_async_writer_close(c->writer, pb);
+    } else if (!http_base_proto || !c->http_persistent) {
         ff_format_io_close(s, pb);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -256,6 +264,16 @@ static void dashenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filenam
     }
 }
 
+static int dashenc_rename(AVFormatContext *s, const char *url_src,
+                          const char *url_dst, void *logctx)
+{
+    DASHContext *c = s->priv_data;
+
+    if (c->writer)
+        return ff_async_writer_rename(c->writer, url_src, url_dst);
+    return ff_rename(url_src, url_dst, logctx);
+}
+
 static const char *get_format_str(SegmentType segment_type)
 {
     switch (segment_type) {
@@ -576,7 +594,7 @@ static void write_hls_media_playlist(OutputStream *os, AVFormatContext *s,
     dashenc_io_close(s, &c->m3u8_out, temp_filename_hls);
 
     if (use_rename)
-        ff_rename(temp_filename_hls, filename_hls, os->ctx);
+        dashenc_rename(s, temp_filename_hls, filename_hls, os->ctx);
 }
 
 static int flush_init_segment(AVFormatContext *s, OutputStream *os)
@@ -611,6 +629,14 @@ static void dash_free(AVFormatContext *s)
         c->nb_as = 0;
     }
 
+    if (c->writer) {
+        /* this also frees the files that were not closed */
+        ff_async_writer_free(&c->writer);
+        c->mpd_out = c->m3u8_out = c->http_delete = NULL;
+        for (i = 0; c->streams && i < s->nb_streams; i++)
+            c->streams[i].out = NULL;
+    }
+
     if (!c->streams)
         return;
     for (i = 0; i < s->nb_streams; i++) {
@@ -1240,7 +1266,7 @@ static int write_manifest(AVFormatContext *s, int final)
     dashenc_io_close(s, &c->mpd_out, temp_filename);
 
     if (use_rename) {
-        if ((ret = ff_rename(temp_filename, s->url, s)) < 0)
+        if ((ret = dashenc_rename(s, temp_filename, s->url, s)) < 0)
             return ret;
     }
 
@@ -1356,7 +1382,7 @@ static int write_manifest(AVFormatContext *s, int final)
 
         dashenc_io_close(s, &c->m3u8_out, temp_filename);
         if (use_rename)
-            if ((ret = ff_rename(temp_filename, filename_hls, s)) < 0)
+            if ((ret = dashenc_rename(s, temp_filename, filename_hls, s)) < 0)
                 return ret;
         c->master_playlist_created = 1;
     }
@@ -1477,6 +1503,15 @@ static int dash_init(AVFormatContext *s)
     if (!c->streams)
         return AVERROR(ENOMEM);
 
+    if (c->async_io && (c->single_file || c->streaming)) {
+        av_log(s, AV_LOG_WARNING, "async_io is not supported with single_file "
+               "or streaming, writing synchronously\n");
+    } else if (c->async_io) {
+        ret = ff_async_writer_alloc(&c->writer, s, c->async_io, c->ignore_io_errors);
+        if (ret < 0)
+            return ret;
+    }
+
     if ((ret = parse_adaptation_sets(s)) < 0)
         return ret;
 
@@ -1583,7 +1618,7 @@ static int dash_init(AVFormatContext *s)
         if (!c->single_file) {
             if ((ret = avio_open_dyn_buf(&ctx->pb)) < 0)
                 return ret;
-            ret = s->io_open(s, &os->out, filename, AVIO_FLAG_WRITE, &opts);
+            ret = dashenc_io_open(s, &os->out, filename, &opts);
         } else {
             ctx->url = av_strdup(filename);
             ret = avio_open2(&ctx->pb, filename, AVIO_FLAG_WRITE, NULL, &opts);
@@ -1862,6 +1897,8 @@ static void dashenc_delete_file(AVFormatContext *s, char *filename) {
 
         //Nothing to write
         dashenc_io_close(s, &c->http_delete, filename);
+    } else if (c->writer) {
+        ff_async_writer_delete(c->writer, filename);
     } else {
         int res = ffurl_delete(filename);
         if (res < 0) {
@@ -1967,7 +2004,7 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
             dashenc_io_close(s, &os->out, os->temp_path);
 
             if (use_rename) {
-                ret = ff_rename(os->temp_path, os->full_path, os->ctx);
+                ret = dashenc_rename(s, os->temp_path, os->full_path, os->ctx);
                 if (ret < 0)
                     break;
             }
@@ -2330,6 +2367,8 @@ static int dash_write_trailer(AVFormatContext *s)
         }
     }
 
+    if (c->writer)
+        return ff_async_writer_flush(c->writer);
     return 0;
 }
 
@@ -2358,6 +2397,7 @@ static int dash_check_bitstream(AVFormatContext *s, AVStream *st,
 #define E AV_OPT_FLAG_ENCODING_PARAM
 static const AVOption options[] = {
     { "adaptation_sets", "Adaptation sets. Syntax: id=0,streams=0,1,2 id=1,streams=3,4 and so on", OFFSET(adaptation_sets), AV_OPT_TYPE_STRING, { 0 }, 0, 0, AV_OPT_FLAG_ENCODING_PARAM },
+    { "async_io", "Write up to this many files in the background, 0 to write them synchronously", OFFSET(async_io), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1024, E },
     { "dash_segment_type", "set dash segment files type", OFFSET(segment_type_option), AV_OPT_TYPE_INT, {.i64 = SEGMENT_TYPE_AUTO }, 0, SEGMENT_TYPE_NB - 1, E, .unit = "segment_type"},
         { "auto", "select segment file format based on codec", 0, AV_OPT_TYPE_CONST, {.i64 = SEGMENT_TYPE_AUTO }, 0, UINT_MAX,   E, .unit = "segment_type"},
         { "mp4", "make segment file in ISOBMFF format", 0, AV_OPT_TYPE_CONST, {.i64 = SEGMENT_TYPE_MP4 }, 0, UINT_MAX,   E, .unit = "segment_type"},
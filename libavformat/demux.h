@@ -249,6 +249,36 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
 
 void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance);
 
+/**
+ * Convert the index of st to a delta coded representation that uses
+ * a fraction of the memory. Afterwards index_entries and nb_index_entries
+ * must not be used anymore, the index has to be accessed with
+ * avformat_index_get_entries_count(), ff_index_get_entry() and
+ * av_index_search_timestamp() instead. Adding entries in timestamp order
+ * keeps the index compact, anything else converts it back.
+ *
+ * Demuxers should call this before adding the first entry, so that the
+ * entries are appended to the compact index directly.
+ *
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int ff_index_compact(AVStream *st);
+
+/**
+ * Convert a compact index back to index_entries, for code that needs to
+ * modify entries in place. Does nothing if the index is not compact.
+ *
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int ff_index_expand(AVStream *st);
+
+/**
+ * Internal version of avformat_index_get_entry() that also works on compact
+ * indexes. With a compact index, the returned entry is only valid until the
+ * next index access on st.
+ */
+AVIndexEntry *ff_index_get_entry(AVStream *st, int idx);
+
 /**
  * Ensure the index uses less memory than the maximum specified in
  * AVFormatContext.max_index_size by discarding entries if it grows
@@ -341,6 +371,24 @@ int ff_generate_avci_extradata(AVStream *st);
  */
 int ff_get_extradata(void *logctx, AVCodecParameters *par, AVIOContext *pb, int size);
 
+/**
+ * Check whether packets of the given codec may reference a memory mapping of
+ * the input, i.e. whether they are passed on unmodified to decoders which
+ * never read the padding. This is true for raw video and PCM.
+ */
+int ff_packet_mappable(enum AVCodecID codec_id);
+
+/**
+ * Like av_get_packet(), but return a reference to a memory mapping of the
+ * input instead of copying the data if possible, see ffio_read_mapped().
+ * The packet data is then read-only, so this may only be used if it is not
+ * modified in place afterwards. Only packets for which ff_packet_mappable()
+ * is true are mapped, all others are copied.
+ *
+ * @param st the stream the packet belongs to
+ */
+int ff_get_packet_mapped(const AVStream *st, AVIOContext *pb, AVPacket *pkt, int size);
+
 /**
  * Find stream index based on format-specific stream ID
  * @return stream index, or < 0 on error
@@ -348,6 +348,31 @@ int ff_get_extradata(void *logctx, AVCodecParameters *par, AVIOContext *pb, int
     return ret;
 }
 
+int ff_packet_mappable(enum AVCodecID codec_id)
+{
+    return codec_id == AV_CODEC_ID_RAWVIDEO ||
+           (codec_id >= AV_CODEC_ID_PCM_S16LE &&
+            codec_id <  AV_CODEC_ID_ADPCM_IMA_QT);
+}
+
+int ff_get_packet_mapped(const AVStream *st, AVIOContext *pb, AVPacket *pkt, int size)
+{
+    int64_t pos = avio_tell(pb);
+    AVBufferRef *buf;
+    uint8_t *data;
+
+    if (!ff_packet_mappable(st->codecpar->codec_id) ||
+        ffio_read_mapped(pb, size, &buf, &data) < 0)
+        return av_get_packet(pb, pkt, size);
+
+    av_packet_unref(pkt);
+    pkt->buf  = buf;
+    pkt->data = data;
+    pkt->size = size;
+    pkt->pos  = pos;
+    return size;
+}
+
 int ff_find_stream_index(const AVFormatContext *s, int id)
 {
     for (unsigned i = 0; i < s->nb_streams; i++)
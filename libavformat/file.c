@@ -19,6 +19,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE     /* Needed for copy_file_range() with glibc */
+
 #include "config_components.h"
 
 #include "libavutil/avstring.h"
@@ -31,6 +33,9 @@
 #include <dirent.h>
 #endif
 #include <fcntl.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #if HAVE_IO_H
 #include <io.h>
 #endif
@@ -96,10 +101,13 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int use_mmap;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
     int64_t initial_pos;
+    AVBufferRef *map;       ///< read-only mapping of the whole file, if mmap is enabled
+    int64_t map_pos;
 } FileContext;
 
 static const AVOption file_options[] = {
@@ -107,6 +115,7 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "Map files opened for reading into memory", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -142,6 +151,14 @@ static int file_read(URLContext *h, unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+    if (c->map) {
+        size = FFMIN(size, FFMAX((int64_t)c->map->size - c->map_pos, 0));
+        if (!size)
+            return AVERROR_EOF;
+        memcpy(buf, c->map->data + c->map_pos, size);
+        c->map_pos += size;
+        return size;
+    }
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -225,6 +242,7 @@ static int file_close(URLContext *h)
     if (c->initial_pos >= 0 && !h->is_streamed)
         lseek(c->fd, c->initial_pos, SEEK_SET);
 
+    av_buffer_unref(&c->map);
     ret = close(c->fd);
     return (ret == -1) ? AVERROR(errno) : 0;
 }
@@ -235,6 +253,20 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+    if (c->map) {
+        if (whence == AVSEEK_SIZE)
+            return c->map->size;
+        if (whence == SEEK_CUR)
+            pos += c->map_pos;
+        else if (whence == SEEK_END)
+            pos += c->map->size;
+        else if (whence != SEEK_SET)
+            return AVERROR(EINVAL);
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        return c->map_pos = pos;
+    }
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
@@ -284,6 +316,13 @@ static int file_move(URLContext *h_src, URLContext *h_dst)
     return 0;
 }
 
+#if HAVE_MMAP
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    munmap(data, (uintptr_t)opaque);
+}
+#endif
+
 static int file_open(URLContext *h, const char *filename, int flags)
 {
     FileContext *c = h->priv_data;
@@ -323,9 +362,93 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+#if HAVE_MMAP
+    /* The mapping has a fixed size, so it cannot be used for following a
+     * growing file. Truncating the file while it is mapped will crash. */
+    if (c->use_mmap && !(flags & AVIO_FLAG_WRITE) && !c->follow &&
+        !fstat(fd, &st) && S_ISREG(st.st_mode) &&
+        st.st_size > 0 && st.st_size <= SIZE_MAX) {
+        void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED) {
+            av_log(h, AV_LOG_VERBOSE, "Could not map file: %s\n",
+                   av_err2str(AVERROR(errno)));
+        } else {
+            c->map = av_buffer_create(ptr, st.st_size, file_unmap,
+                                      (void *)(uintptr_t)st.st_size,
+                                      AV_BUFFER_FLAG_READONLY);
+            if (!c->map) {
+                munmap(ptr, st.st_size);
+                close(fd);
+                return AVERROR(ENOMEM);
+            }
+            c->map_pos = 0;
+        }
+    }
+#endif
+
     return 0;
 }
 
+static int file_get_mapping(URLContext *h, AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+
+    if (!c->map)
+        return AVERROR(ENOSYS);
+    *buf = av_buffer_ref(c->map);
+    return *buf ? 0 : AVERROR(ENOMEM);
+}
+
+#if HAVE_COPY_FILE_RANGE
+static int file_copy_range(URLContext *h, int64_t dst, int64_t src, int64_t size)
+{
+    FileContext *c = h->priv_data;
+    const char *filename = h->filename;
+    int64_t chunk = FFMIN(FFABS(dst - src), size), done = 0;
+    int fd, ret = 0;
+
+    if (!chunk)
+        return 0;
+
+    /* The output is usually opened write-only. */
+    av_strstart(filename, "file:", &filename);
+    fd = avpriv_open(filename, O_RDONLY);
+    if (fd == -1)
+        return AVERROR(ENOSYS);
+
+    /* Overlapping ranges are copied in pieces which do not overlap their
+     * destination, starting from the end when moving data forward. */
+    while (done < size) {
+        int64_t n   = FFMIN(chunk, size - done);
+        int64_t pos = dst > src ? size - done - n : done;
+        off_t off_in = src + pos, off_out = dst + pos;
+
+        if (ff_check_interrupt(&h->interrupt_callback)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        while (n > 0) {
+            ssize_t len = copy_file_range(fd, &off_in, c->fd, &off_out,
+                                          FFMIN(n, 1 << 30), 0);
+            if (len <= 0) {
+                /* Nothing was modified yet, let the caller use another
+                 * method if the file system does not support this. */
+                ret = len < 0 ? AVERROR(errno) : AVERROR_EOF;
+                if (!done)
+                    ret = AVERROR(ENOSYS);
+                goto end;
+            }
+            n    -= len;
+            done += len;
+        }
+    }
+
+end:
+    close(fd);
+    return ret;
+}
+#endif
+
 static int file_open_dir(URLContext *h)
 {
 #if HAVE_LSTAT
@@ -418,6 +541,10 @@ const URLProtocol ff_file_protocol = {
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
+    .url_get_mapping     = file_get_mapping,
+#if HAVE_COPY_FILE_RANGE
+    .url_copy_range      = file_copy_range,
+#endif
     .url_check           = file_check,
     .url_delete          = file_delete,
     .url_move            = file_move,
@@ -995,7 +995,6 @@ static int gxf_compare_field_nb(AVFormatContext *s, const AVPacket *next,
 static int gxf_interleave_packet(AVFormatContext *s, AVPacket *pkt,
                                  int flush, int has_packet)
 {
-    int ret;
     if (has_packet) {
         AVStream *st = s->streams[pkt->stream_index];
         GXFStreamContext *sc = st->priv_data;
@@ -1004,10 +1003,9 @@ static int gxf_interleave_packet(AVFormatContext *s, AVPacket *pkt,
         else
             pkt->pts = pkt->dts = sc->pkt_cnt * GXF_SAMPLES_PER_FRAME;
         sc->pkt_cnt++;
-        if ((ret = ff_interleave_add_packet(s, pkt, gxf_compare_field_nb)) < 0)
-            return ret;
     }
-    return ff_interleave_packet_per_dts(s, pkt, flush, 0);
+    return ff_interleave_packet_sorted(s, pkt, flush, has_packet,
+                                       gxf_compare_field_nb);
 }
 
 const FFOutputFormat ff_gxf_muxer = {
@@ -38,6 +38,7 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "demux.h"
@@ -49,6 +50,7 @@
 #include "hls_sample_encryption.h"
 
 #define INITIAL_BUFFER_SIZE 32768
+#define MAX_INIT_SECTION_SIZE (1024 * 1024)
 
 #define MAX_FIELD_LEN 64
 #define MAX_CHARACTERISTICS_LEN 512
@@ -87,6 +89,44 @@ struct segment {
 };
 
 struct rendition;
+struct playlist;
+
+enum PrefetchState {
+    PREFETCH_QUEUED,
+    PREFETCH_RUNNING,
+    PREFETCH_DONE
+};
+
+/*
+ * A segment that is downloaded into memory ahead of time by one of the
+ * prefetch threads, together with its Media Initialization Section if that
+ * differs from the one of the previous segment. Apart from the fields that
+ * never change after the job is queued, everything is protected by
+ * HLSContext.prefetch_mutex.
+ */
+struct prefetch_job {
+    struct prefetch_job *next;
+    struct playlist *pls;
+    int64_t seq_no;
+    struct segment seg;         /* private copy, url and key are owned */
+    struct segment *init_section;
+    AVDictionary *avio_opts;
+    char *cookies;              /* cookies when queued, to detect updates */
+
+    enum PrefetchState state;
+    int abandoned;              /* dropped by the playlist while running */
+
+    uint8_t *init_data;
+    int init_size;
+    int init_ret;
+    int init_done;
+
+    uint8_t key[16];
+    uint8_t *data;
+    unsigned int data_alloc;
+    int size;
+    int ret;                    /* AVERROR_EOF or an error once done */
+};
 
 enum PlaylistType {
     PLS_TYPE_UNSPECIFIED,
@@ -173,6 +213,21 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* Segments queued for prefetching, starting at cur_seq_no. cur_job is
+     * the first one while it is being read. */
+    struct prefetch_job *prefetch_jobs;
+    int nb_prefetch_jobs;
+    struct prefetch_job *cur_job;
+    char prefetch_key_url[MAX_URL_SIZE];
+    uint8_t prefetch_key[16];
+
+    /* Prefetch statistics: number of segments, bytes, and the time until
+     * the first byte and until the end of the segments, in microseconds */
+    int prefetch_nb_segments;
+    int64_t prefetch_bytes;
+    int64_t prefetch_latency;
+    int64_t prefetch_time;
 };
 
 /*
@@ -230,6 +285,20 @@ typedef struct HLSContext {
     int seg_max_retry;
     AVIOContext *playlist_pb;
     HLSCryptoContext  crypto_ctx;
+
+    int prefetch_segments;
+    int64_t prefetch_buffer_size;
+    int prefetch_inited;
+    int prefetch_exit;
+    int64_t prefetch_size;      /* bytes held by all prefetch jobs */
+    char *prefetch_cookies;     /* set by a job, not yet in avio_opts */
+    AVMutex prefetch_mutex;
+    AVCond prefetch_work_cond;  /* jobs queued, buffer space freed or exit */
+    AVCond prefetch_data_cond;  /* data downloaded or job finished */
+#if HAVE_THREADS
+    pthread_t *prefetch_threads;
+#endif
+    int nb_prefetch_threads;
 } HLSContext;
 
 static void free_segment_dynarray(struct segment **segments, int n_segments)
@@ -1063,6 +1132,26 @@ static struct segment *next_segment(struct playlist *pls)
     return pls->segments[n];
 }
 
+static int prefetch_read(struct playlist *pls, uint8_t *buf, int buf_size)
+{
+    HLSContext *c = pls->parent->priv_data;
+    struct prefetch_job *job = pls->cur_job;
+    int ret;
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    while (job->state != PREFETCH_DONE && job->size <= pls->cur_seg_offset)
+        ff_cond_wait(&c->prefetch_data_cond, &c->prefetch_mutex);
+    if (job->size > pls->cur_seg_offset) {
+        ret = FFMIN(buf_size, job->size - pls->cur_seg_offset);
+        memcpy(buf, job->data + pls->cur_seg_offset, ret);
+    } else {
+        ret = job->ret;
+    }
+    ff_mutex_unlock(&c->prefetch_mutex);
+
+    return ret;
+}
+
 static int read_from_url(struct playlist *pls, struct segment *seg,
                          uint8_t *buf, int buf_size)
 {
@@ -1072,7 +1161,10 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (pls->cur_job)
+        ret = prefetch_read(pls, buf, buf_size);
+    else
+        ret = avio_read(pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1280,62 +1372,69 @@ static void intercept_id3(struct playlist *pls, uint8_t *buf,
         pls->is_id3_timestamped = (pls->id3_mpegts_timestamp != AV_NOPTS_VALUE);
 }
 
-static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg, AVIOContext **in)
+static void set_segment_options(HLSContext *c, struct segment *seg,
+                                AVDictionary **opts)
 {
-    AVDictionary *opts = NULL;
-    int ret;
-    int is_http = 0;
-
     if (c->http_persistent)
-        av_dict_set(&opts, "multiple_requests", "1", 0);
+        av_dict_set(opts, "multiple_requests", "1", 0);
 
     if (seg->size >= 0) {
         /* try to restrict the HTTP request to the part we want
          * (if this is in fact a HTTP request) */
-        av_dict_set_int(&opts, "offset", seg->url_offset, 0);
-        av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
+        av_dict_set_int(opts, "offset", seg->url_offset, 0);
+        av_dict_set_int(opts, "end_offset", seg->url_offset + seg->size, 0);
     }
+}
 
-    av_log(pls->parent, AV_LOG_VERBOSE, "HLS request for url '%s', offset %"PRId64", playlist %d\n",
-           seg->url, seg->url_offset, pls->index);
+static void read_key(struct playlist *pls, const char *url, uint8_t *key,
+                     AVDictionary **avio_opts, AVDictionary *opts)
+{
+    AVIOContext *pb = NULL;
+    int ret;
 
-    if (seg->key_type == KEY_AES_128 || seg->key_type == KEY_SAMPLE_AES) {
-        if (strcmp(seg->key, pls->key_url)) {
-            AVIOContext *pb = NULL;
-            if (open_url(pls->parent, &pb, seg->key, &c->avio_opts, opts, NULL) == 0) {
-                ret = avio_read(pb, pls->key, sizeof(pls->key));
-                if (ret != sizeof(pls->key)) {
-                    av_log(pls->parent, AV_LOG_ERROR, "Unable to read key file %s\n",
-                           seg->key);
-                }
-                ff_format_io_close(pls->parent, &pb);
-            } else {
-                av_log(pls->parent, AV_LOG_ERROR, "Unable to open key file %s\n",
-                       seg->key);
-            }
-            av_strlcpy(pls->key_url, seg->key, sizeof(pls->key_url));
+    if (open_url(pls->parent, &pb, url, avio_opts, opts, NULL) == 0) {
+        ret = avio_read(pb, key, sizeof(pls->key));
+        if (ret != sizeof(pls->key)) {
+            av_log(pls->parent, AV_LOG_ERROR, "Unable to read key file %s\n",
+                   url);
         }
+        ff_format_io_close(pls->parent, &pb);
+    } else {
+        av_log(pls->parent, AV_LOG_ERROR, "Unable to open key file %s\n",
+               url);
     }
+}
+
+/* Open seg, decrypting it with key if it uses AES-128. This is also called
+ * from the prefetch threads, so it must not touch the state of pls. */
+static int open_segment(HLSContext *c, struct playlist *pls, struct segment *seg,
+                        const uint8_t *key, AVDictionary **avio_opts,
+                        AVDictionary **opts, AVIOContext **in)
+{
+    int ret;
+    int is_http = 0;
+
+    av_log(pls->parent, AV_LOG_VERBOSE, "HLS request for url '%s', offset %"PRId64", playlist %d\n",
+           seg->url, seg->url_offset, pls->index);
 
     if (seg->key_type == KEY_AES_128) {
-        char iv[33], key[33], url[MAX_URL_SIZE];
+        char iv[33], key_hex[33], url[MAX_URL_SIZE];
         ff_data_to_hex(iv, seg->iv, sizeof(seg->iv), 0);
-        ff_data_to_hex(key, pls->key, sizeof(pls->key), 0);
+        ff_data_to_hex(key_hex, key, sizeof(pls->key), 0);
         if (strstr(seg->url, "://"))
             snprintf(url, sizeof(url), "crypto+%s", seg->url);
         else
             snprintf(url, sizeof(url), "crypto:%s", seg->url);
 
-        av_dict_set(&opts, "key", key, 0);
-        av_dict_set(&opts, "iv", iv, 0);
+        av_dict_set(opts, "key", key_hex, 0);
+        av_dict_set(opts, "iv", iv, 0);
 
-        ret = open_url(pls->parent, in, url, &c->avio_opts, opts, &is_http);
-        if (ret < 0) {
-            goto cleanup;
-        }
+        ret = open_url(pls->parent, in, url, avio_opts, *opts, &is_http);
+        if (ret < 0)
+            return ret;
         ret = 0;
     } else {
-        ret = open_url(pls->parent, in, seg->url, &c->avio_opts, opts, &is_http);
+        ret = open_url(pls->parent, in, seg->url, avio_opts, *opts, &is_http);
     }
 
     /* Seek to the requested position. If this was a HTTP request, the offset
@@ -1357,16 +1456,527 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
         }
     }
 
-cleanup:
+    return ret;
+}
+
+static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg, AVIOContext **in)
+{
+    AVDictionary *opts = NULL;
+    int ret;
+
+    set_segment_options(c, seg, &opts);
+
+    if (seg->key_type == KEY_AES_128 || seg->key_type == KEY_SAMPLE_AES) {
+        if (strcmp(seg->key, pls->key_url)) {
+            read_key(pls, seg->key, pls->key, &c->avio_opts, opts);
+            av_strlcpy(pls->key_url, seg->key, sizeof(pls->key_url));
+        }
+    }
+
+    ret = open_segment(c, pls, seg, pls->key, &c->avio_opts, &opts, in);
+
     av_dict_free(&opts);
     pls->cur_seg_offset = 0;
     return ret;
 }
 
+/*
+ * Segment prefetching: with prefetch_segments > 0, the next segments of
+ * each playlist are queued as prefetch jobs and downloaded into memory by
+ * as many threads, which also keep their own persistent HTTP connections.
+ * read_data() then reads the segments from memory instead of opening them
+ * itself.
+ */
+
+static void prefetch_job_free(HLSContext *c, struct prefetch_job **pjob)
+{
+    struct prefetch_job *job = *pjob;
+
+    c->prefetch_size -= job->size + job->init_size;
+    av_freep(&job->seg.url);
+    av_freep(&job->seg.key);
+    av_dict_free(&job->avio_opts);
+    av_freep(&job->cookies);
+    av_freep(&job->init_data);
+    av_freep(&job->data);
+    av_freep(pjob);
+}
+
+/* Must be called with prefetch_mutex held. */
+static void prefetch_release(HLSContext *c, struct prefetch_job *job)
+{
+    /* running jobs are freed by their thread once it notices */
+    if (job->state == PREFETCH_RUNNING)
+        job->abandoned = 1;
+    else
+        prefetch_job_free(c, &job);
+}
+
+static void prefetch_flush_locked(HLSContext *c, struct playlist *pls)
+{
+    while (pls->prefetch_jobs) {
+        struct prefetch_job *job = pls->prefetch_jobs;
+        pls->prefetch_jobs = job->next;
+        prefetch_release(c, job);
+    }
+    pls->nb_prefetch_jobs = 0;
+    pls->cur_job = NULL;
+    ff_cond_broadcast(&c->prefetch_work_cond);
+}
+
+static void prefetch_flush(HLSContext *c, struct playlist *pls)
+{
+    if (!pls->prefetch_jobs)
+        return;
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    prefetch_flush_locked(c, pls);
+    ff_mutex_unlock(&c->prefetch_mutex);
+}
+
+/* Queue jobs for the segments following cur_seq_no, up to the prefetch
+ * depth. */
+static int prefetch_fill(HLSContext *c, struct playlist *pls)
+{
+    struct prefetch_job **tail = &pls->prefetch_jobs, *last = NULL;
+    int64_t seq_no = pls->cur_seq_no;
+    int ret = 0;
+
+    ff_mutex_lock(&c->prefetch_mutex);
+
+    /* cookies set by the server for a finished job */
+    if (c->prefetch_cookies) {
+        av_dict_set(&c->avio_opts, "cookies", c->prefetch_cookies,
+                    AV_DICT_DONT_STRDUP_VAL);
+        c->prefetch_cookies = NULL;
+    }
+
+    /* the playlist skipped segments */
+    if (pls->prefetch_jobs && pls->prefetch_jobs->seq_no != pls->cur_seq_no)
+        prefetch_flush_locked(c, pls);
+
+    for (; *tail; tail = &(*tail)->next) {
+        last   = *tail;
+        seq_no = last->seq_no + 1;
+    }
+
+    while (pls->nb_prefetch_jobs < c->prefetch_segments &&
+           seq_no < pls->start_seq_no + pls->n_segments) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+        struct segment *prev_init_section = last ? last->seg.init_section :
+                                                   pls->cur_init_section;
+        struct prefetch_job *job = av_mallocz(sizeof(*job));
+        const AVDictionaryEntry *cookies;
+
+        if (!job) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        job->pls    = pls;
+        job->seq_no = seq_no;
+        job->seg    = *seg;
+        job->seg.url = av_strdup(seg->url);
+        job->seg.key = seg->key ? av_strdup(seg->key) : NULL;
+        if (seg->init_section != prev_init_section)
+            job->init_section = seg->init_section;
+        else
+            job->init_done = 1;
+        if ((cookies = av_dict_get(c->avio_opts, "cookies", NULL, 0)))
+            job->cookies = av_strdup(cookies->value);
+        if (!job->seg.url || (seg->key && !job->seg.key) ||
+            (cookies && !job->cookies) ||
+            av_dict_copy(&job->avio_opts, c->avio_opts, 0) < 0) {
+            prefetch_job_free(c, &job);
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+
+        *tail = job;
+        tail  = &job->next;
+        last  = job;
+        pls->nb_prefetch_jobs++;
+        seq_no++;
+    }
+
+    ff_cond_broadcast(&c->prefetch_work_cond);
+    ff_mutex_unlock(&c->prefetch_mutex);
+
+    return ret;
+}
+
+/* Start reading the current segment from the first prefetch job. */
+static int prefetch_open(HLSContext *c, struct playlist *pls)
+{
+    struct prefetch_job *job = pls->prefetch_jobs;
+    int ret = 0;
+
+    av_assert0(job && job->seq_no == pls->cur_seq_no);
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    while (job->state != PREFETCH_DONE && !job->size)
+        ff_cond_wait(&c->prefetch_data_cond, &c->prefetch_mutex);
+    if (!job->size && job->ret != AVERROR_EOF) {
+        /* the segment could not be opened */
+        ret = job->ret;
+        pls->prefetch_jobs = job->next;
+        pls->nb_prefetch_jobs--;
+        prefetch_job_free(c, &job);
+        ff_cond_broadcast(&c->prefetch_work_cond);
+    } else {
+        pls->cur_job = job;
+    }
+    ff_mutex_unlock(&c->prefetch_mutex);
+
+    if (ret >= 0 && job->seg.key_type != KEY_NONE) {
+        memcpy(pls->key, job->key, sizeof(pls->key));
+        av_strlcpy(pls->key_url, job->seg.key, sizeof(pls->key_url));
+    }
+    pls->cur_seg_offset = 0;
+
+    return ret;
+}
+
+static void prefetch_close(HLSContext *c, struct playlist *pls)
+{
+    struct prefetch_job *job = pls->cur_job;
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    pls->prefetch_jobs = job->next;
+    pls->nb_prefetch_jobs--;
+    pls->cur_job = NULL;
+    prefetch_release(c, job);
+    ff_cond_broadcast(&c->prefetch_work_cond);
+    ff_mutex_unlock(&c->prefetch_mutex);
+}
+
+/* Pick the queued job closest to being read, preferring the playlists'
+ * current segments. Must be called with prefetch_mutex held. */
+static struct prefetch_job *prefetch_next_job(HLSContext *c)
+{
+    for (int depth = 0; depth < c->prefetch_segments; depth++) {
+        /* only the current segments may exceed the buffer size */
+        if (depth && c->prefetch_size >= c->prefetch_buffer_size)
+            break;
+        for (int i = 0; i < c->n_playlists; i++) {
+            struct prefetch_job *job = c->playlists[i]->prefetch_jobs;
+
+            for (int j = 0; job && j < depth; j++)
+                job = job->next;
+            if (job && job->state == PREFETCH_QUEUED)
+                return job;
+        }
+    }
+    return NULL;
+}
+
+static int prefetch_init_section(HLSContext *c, struct prefetch_job *job)
+{
+    struct playlist *pls = job->pls;
+    struct segment *sec = job->init_section;
+    AVDictionary *opts = NULL;
+    AVIOContext *in = NULL;
+    int64_t sec_size;
+    uint8_t *data;
+    int ret;
+
+    set_segment_options(c, sec, &opts);
+    ret = open_segment(c, pls, sec, NULL, &job->avio_opts, &opts, &in);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    if (sec->size >= 0)
+        sec_size = sec->size;
+    else if ((sec_size = avio_size(in)) < 0)
+        sec_size = MAX_INIT_SECTION_SIZE;
+    sec_size = FFMIN(sec_size, MAX_INIT_SECTION_SIZE);
+
+    data = av_malloc(sec_size);
+    if (!data) {
+        ff_format_io_close(pls->parent, &in);
+        return AVERROR(ENOMEM);
+    }
+    ret = avio_read(in, data, sec_size);
+    ff_format_io_close(pls->parent, &in);
+    if (ret < 0) {
+        av_free(data);
+        return ret;
+    }
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    job->init_data = data;
+    job->init_size = ret;
+    c->prefetch_size += ret;
+    ff_mutex_unlock(&c->prefetch_mutex);
+
+    return 0;
+}
+
+/* Download the segment of job into memory, pb is the persistent HTTP
+ * connection of the calling thread, if any. */
+static int prefetch_download(HLSContext *c, struct prefetch_job *job,
+                             AVIOContext **pb)
+{
+    struct playlist *pls = job->pls;
+    struct segment *seg = &job->seg;
+    int keepalive = c->http_persistent && seg->key_type == KEY_NONE &&
+                    av_strstart(seg->url, "http", NULL);
+    int64_t start = av_gettime_relative(), latency = -1;
+    AVDictionary *opts = NULL;
+    int ret;
+
+    if (job->init_section) {
+        ret = prefetch_init_section(c, job);
+        ff_mutex_lock(&c->prefetch_mutex);
+        job->init_ret  = ret;
+        job->init_done = 1;
+        ff_cond_broadcast(&c->prefetch_data_cond);
+        ff_mutex_unlock(&c->prefetch_mutex);
+    }
+
+    if (seg->key_type == KEY_AES_128 || seg->key_type == KEY_SAMPLE_AES) {
+        int have_key;
+
+        ff_mutex_lock(&c->prefetch_mutex);
+        have_key = !strcmp(seg->key, pls->prefetch_key_url);
+        if (have_key)
+            memcpy(job->key, pls->prefetch_key, sizeof(job->key));
+        ff_mutex_unlock(&c->prefetch_mutex);
+
+        if (!have_key) {
+            set_segment_options(c, seg, &opts);
+            read_key(pls, seg->key, job->key, &job->avio_opts, opts);
+            av_dict_free(&opts);
+
+            ff_mutex_lock(&c->prefetch_mutex);
+            memcpy(pls->prefetch_key, job->key, sizeof(job->key));
+            av_strlcpy(pls->prefetch_key_url, seg->key, sizeof(pls->prefetch_key_url));
+            ff_mutex_unlock(&c->prefetch_mutex);
+        }
+    }
+
+    if (!keepalive)
+        ff_format_io_close(pls->parent, pb);
+
+    set_segment_options(c, seg, &opts);
+    ret = open_segment(c, pls, seg, job->key, &job->avio_opts, &opts, pb);
+    av_dict_free(&opts);
+
+    while (ret >= 0) {
+        int size = INITIAL_BUFFER_SIZE;
+        uint8_t *data;
+
+        if (seg->size >= 0)
+            size = FFMIN(size, seg->size - job->size);
+        if (size <= 0) {
+            ret = AVERROR_EOF;
+            break;
+        }
+
+        ff_mutex_lock(&c->prefetch_mutex);
+        if (job->abandoned || c->prefetch_exit) {
+            ff_mutex_unlock(&c->prefetch_mutex);
+            ret = AVERROR_EXIT;
+            break;
+        }
+        data = job->size <= INT_MAX - size ?
+               av_fast_realloc(job->data, &job->data_alloc, job->size + size) : NULL;
+        if (data)
+            job->data = data;
+        ff_mutex_unlock(&c->prefetch_mutex);
+        if (!data) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+
+        /* only this thread touches the data past job->size */
+        ret = avio_read(*pb, data + job->size, size);
+        if (ret <= 0) {
+            ret = ret ? ret : AVERROR_EOF;
+            break;
+        }
+        if (latency < 0)
+            latency = av_gettime_relative() - start;
+
+        ff_mutex_lock(&c->prefetch_mutex);
+        job->size        += ret;
+        c->prefetch_size += ret;
+        ff_cond_broadcast(&c->prefetch_data_cond);
+        ff_mutex_unlock(&c->prefetch_mutex);
+    }
+
+    if (ret != AVERROR_EOF || !keepalive)
+        ff_format_io_close(pls->parent, pb);
+
+    if (ret == AVERROR_EOF) {
+        int64_t elapsed = av_gettime_relative() - start;
+
+        av_log(pls->parent, AV_LOG_DEBUG,
+               "Prefetched segment %"PRId64" of playlist %d: %d bytes, "
+               "latency %"PRId64" ms, %"PRId64" kbit/s\n",
+               job->seq_no, pls->index, job->size, FFMAX(latency, 0) / 1000,
+               job->size * INT64_C(8000) / FFMAX(elapsed, 1));
+
+        ff_mutex_lock(&c->prefetch_mutex);
+        pls->prefetch_nb_segments++;
+        pls->prefetch_bytes   += job->size;
+        pls->prefetch_latency += FFMAX(latency, 0);
+        pls->prefetch_time    += elapsed;
+        ff_mutex_unlock(&c->prefetch_mutex);
+    } else if (ret != AVERROR_EXIT) {
+        av_log(pls->parent, AV_LOG_WARNING,
+               "Failed to prefetch segment %"PRId64" of playlist %d: %s\n",
+               job->seq_no, pls->index, av_err2str(ret));
+    }
+
+    return ret;
+}
+
+/* Keep the cookies the server set while job was downloaded for the jobs
+ * queued later. The demuxer thread accesses avio_opts without holding
+ * prefetch_mutex, so they are merged into it by prefetch_fill(). Must be
+ * called with prefetch_mutex held. */
+static void prefetch_save_cookies(HLSContext *c, struct prefetch_job *job)
+{
+    const AVDictionaryEntry *e = av_dict_get(job->avio_opts, "cookies", NULL, 0);
+    char *cookies;
+
+    if (!e || (job->cookies && !strcmp(e->value, job->cookies)))
+        return;
+
+    cookies = av_strdup(e->value);
+    if (!cookies)
+        return;
+    av_free(c->prefetch_cookies);
+    c->prefetch_cookies = cookies;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    HLSContext *c = arg;
+    AVIOContext *pb = NULL;
+
+    ff_thread_setname("hls-prefetch");
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    while (!c->prefetch_exit) {
+        struct prefetch_job *job = prefetch_next_job(c);
+        int ret;
+
+        if (!job) {
+            ff_cond_wait(&c->prefetch_work_cond, &c->prefetch_mutex);
+            continue;
+        }
+
+        job->state = PREFETCH_RUNNING;
+        ff_mutex_unlock(&c->prefetch_mutex);
+
+        ret = prefetch_download(c, job, &pb);
+
+        ff_mutex_lock(&c->prefetch_mutex);
+        job->ret   = ret;
+        job->state = PREFETCH_DONE;
+        prefetch_save_cookies(c, job);
+        if (job->abandoned)
+            prefetch_job_free(c, &job);
+        ff_cond_broadcast(&c->prefetch_data_cond);
+    }
+    ff_mutex_unlock(&c->prefetch_mutex);
+
+    ff_format_io_close(c->ctx, &pb);
+
+    return NULL;
+}
+
+static void prefetch_uninit(HLSContext *c)
+{
+    if (!c->prefetch_inited)
+        return;
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    c->prefetch_exit = 1;
+    ff_cond_broadcast(&c->prefetch_work_cond);
+    ff_mutex_unlock(&c->prefetch_mutex);
+
+#if HAVE_THREADS
+    for (int i = 0; i < c->nb_prefetch_threads; i++)
+        pthread_join(c->prefetch_threads[i], NULL);
+    av_freep(&c->prefetch_threads);
+#endif
+    c->nb_prefetch_threads = 0;
+
+    for (int i = 0; i < c->n_playlists; i++) {
+        struct playlist *pls = c->playlists[i];
+
+        prefetch_flush(c, pls);
+        if (pls->prefetch_nb_segments)
+            av_log(c->ctx, AV_LOG_VERBOSE,
+                   "Playlist %d: prefetched %d segments, %"PRId64" bytes, "
+                   "average latency %"PRId64" ms, %"PRId64" kbit/s\n",
+                   pls->index, pls->prefetch_nb_segments, pls->prefetch_bytes,
+                   pls->prefetch_latency / pls->prefetch_nb_segments / 1000,
+                   pls->prefetch_bytes * 8000 / FFMAX(pls->prefetch_time, 1));
+    }
+
+    av_freep(&c->prefetch_cookies);
+    ff_cond_destroy(&c->prefetch_data_cond);
+    ff_cond_destroy(&c->prefetch_work_cond);
+    ff_mutex_destroy(&c->prefetch_mutex);
+    c->prefetch_inited = 0;
+}
+
+static int prefetch_init(AVFormatContext *s)
+{
+    HLSContext *c = s->priv_data;
+#if HAVE_THREADS
+    int ret;
+
+    if ((ret = ff_mutex_init(&c->prefetch_mutex, NULL)))
+        return AVERROR(ret);
+    if ((ret = ff_cond_init(&c->prefetch_work_cond, NULL))) {
+        ff_mutex_destroy(&c->prefetch_mutex);
+        return AVERROR(ret);
+    }
+    if ((ret = ff_cond_init(&c->prefetch_data_cond, NULL))) {
+        ff_cond_destroy(&c->prefetch_work_cond);
+        ff_mutex_destroy(&c->prefetch_mutex);
+        return AVERROR(ret);
+    }
+    c->prefetch_inited = 1;
+
+    c->prefetch_threads = av_calloc(c->prefetch_segments, sizeof(*c->prefetch_threads));
+    if (!c->prefetch_threads)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < c->prefetch_segments; i++) {
+        ret = pthread_create(&c->prefetch_threads[i], NULL, prefetch_thread, c);
+        if (ret) {
+            av_log(s, AV_LOG_ERROR, "pthread_create failed: %s\n", av_err2str(AVERROR(ret)));
+            return AVERROR(ret);
+        }
+        c->nb_prefetch_threads++;
+    }
+#else
+    av_log(s, AV_LOG_WARNING, "Segment prefetching requires threads, disabling it\n");
+    c->prefetch_segments = 0;
+#endif
+
+    return 0;
+}
+
+static void close_input(HLSContext *c, struct playlist *pls)
+{
+    ff_format_io_close(pls->parent, &pls->input);
+    pls->input_read_done = 0;
+    ff_format_io_close(pls->parent, &pls->input_next);
+    pls->input_next_requested = 0;
+    prefetch_flush(c, pls);
+}
+
 static int update_init_section(struct playlist *pls, struct segment *seg)
 {
-    static const int max_init_section_size = 1024*1024;
     HLSContext *c = pls->parent->priv_data;
+    struct prefetch_job *job = pls->prefetch_jobs;
     int64_t sec_size;
     int64_t urlsize;
     int ret;
@@ -1379,35 +1989,56 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     if (!seg->init_section)
         return 0;
 
-    ret = open_input(c, pls, seg->init_section, &pls->input);
-    if (ret < 0) {
-        av_log(pls->parent, AV_LOG_WARNING,
-               "Failed to open an initialization section in playlist %d\n",
-               pls->index);
-        return ret;
-    }
+    if (job && job->seq_no == pls->cur_seq_no &&
+        job->init_section == seg->init_section) {
+        ff_mutex_lock(&c->prefetch_mutex);
+        while (!job->init_done)
+            ff_cond_wait(&c->prefetch_data_cond, &c->prefetch_mutex);
+        ff_mutex_unlock(&c->prefetch_mutex);
+
+        if (job->init_ret < 0) {
+            av_log(pls->parent, AV_LOG_WARNING,
+                   "Failed to open an initialization section in playlist %d\n",
+                   pls->index);
+            return job->init_ret;
+        }
 
-    if (seg->init_section->size >= 0)
-        sec_size = seg->init_section->size;
-    else if ((urlsize = avio_size(pls->input)) >= 0)
-        sec_size = urlsize;
-    else
-        sec_size = max_init_section_size;
+        av_fast_malloc(&pls->init_sec_buf, &pls->init_sec_buf_size, job->init_size);
+        if (!pls->init_sec_buf)
+            return AVERROR(ENOMEM);
+        memcpy(pls->init_sec_buf, job->init_data, job->init_size);
+        ret = job->init_size;
+    } else {
+        ret = open_input(c, pls, seg->init_section, &pls->input);
+        if (ret < 0) {
+            av_log(pls->parent, AV_LOG_WARNING,
+                   "Failed to open an initialization section in playlist %d\n",
+                   pls->index);
+            return ret;
+        }
 
-    av_log(pls->parent, AV_LOG_DEBUG,
-           "Downloading an initialization section of size %"PRId64"\n",
-           sec_size);
+        if (seg->init_section->size >= 0)
+            sec_size = seg->init_section->size;
+        else if ((urlsize = avio_size(pls->input)) >= 0)
+            sec_size = urlsize;
+        else
+            sec_size = MAX_INIT_SECTION_SIZE;
 
-    sec_size = FFMIN(sec_size, max_init_section_size);
+        av_log(pls->parent, AV_LOG_DEBUG,
+               "Downloading an initialization section of size %"PRId64"\n",
+               sec_size);
 
-    av_fast_malloc(&pls->init_sec_buf, &pls->init_sec_buf_size, sec_size);
+        sec_size = FFMIN(sec_size, MAX_INIT_SECTION_SIZE);
 
-    ret = read_from_url(pls, seg->init_section, pls->init_sec_buf,
-                        pls->init_sec_buf_size);
-    ff_format_io_close(pls->parent, &pls->input);
+        av_fast_malloc(&pls->init_sec_buf, &pls->init_sec_buf_size, sec_size);
 
-    if (ret < 0)
-        return ret;
+        ret = read_from_url(pls, seg->init_section, pls->init_sec_buf,
+                            pls->init_sec_buf_size);
+        ff_format_io_close(pls->parent, &pls->input);
+
+        if (ret < 0)
+            return ret;
+    }
 
     pls->cur_init_section = seg->init_section;
     pls->init_sec_data_len = ret;
@@ -1487,7 +2118,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if ((!v->input && !v->cur_job) || (c->http_persistent && v->input_read_done)) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1553,12 +2184,20 @@ reload:
         v->input_read_done = 0;
         seg = current_segment(v);
 
+        if (c->prefetch_segments > 0) {
+            ret = prefetch_fill(c, v);
+            if (ret < 0)
+                return ret;
+        }
+
         /* load/update Media Initialization Section, if any */
         ret = update_init_section(v, seg);
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (c->prefetch_segments > 0) {
+            ret = prefetch_open(c, v);
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1587,7 +2226,7 @@ reload:
         just_opened = 1;
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1597,7 +2236,7 @@ reload:
     }
 
     seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    if (c->http_multiple == 1 && v->input && !v->input_next_requested &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1630,7 +2269,9 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (v->cur_job) {
+        prefetch_close(c, v);
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
@@ -1914,6 +2555,7 @@ static int hls_close(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
 
+    prefetch_uninit(c);
     free_playlist_list(c);
     free_variant_list(c);
     free_rendition_list(c);
@@ -2021,6 +2663,9 @@ static int hls_read_header(AVFormatContext *s)
         highest_cur_seq_no = FFMAX(highest_cur_seq_no, pls->cur_seq_no);
     }
 
+    if (c->prefetch_segments > 0 && (ret = prefetch_init(s)) < 0)
+        return ret;
+
     /* Open the demuxer for each playlist */
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
@@ -2079,12 +2724,7 @@ static int hls_read_header(AVFormatContext *s)
             }
             ret = 0;
             /* Reset reading */
-            ff_format_io_close(pls->parent, &pls->input);
-            pls->input = NULL;
-            pls->input_read_done = 0;
-            ff_format_io_close(pls->parent, &pls->input_next);
-            pls->input_next = NULL;
-            pls->input_next_requested = 0;
+            close_input(c, pls);
             pls->cur_seg_offset = 0;
             pls->cur_init_section = NULL;
             /* Reset EOF flag */
@@ -2235,10 +2875,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %"PRId64"\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
-            ff_format_io_close(pls->parent, &pls->input);
-            pls->input_read_done = 0;
-            ff_format_io_close(pls->parent, &pls->input_next);
-            pls->input_next_requested = 0;
+            close_input(c, pls);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -2491,10 +3128,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
         AVIOContext *const pb = &pls->pb.pub;
-        ff_format_io_close(pls->parent, &pls->input);
-        pls->input_read_done = 0;
-        ff_format_io_close(pls->parent, &pls->input_next);
-        pls->input_next_requested = 0;
+        close_input(c, pls);
         av_packet_unref(pls->pkt);
         pb->eof_reached = 0;
         /* Clear any buffered data */
@@ -2587,6 +3221,10 @@ static const AVOption hls_options[] = {
         OFFSET(seg_format_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, FLAGS},
     {"seg_max_retry", "Maximum number of times to reload a segment on error.",
      OFFSET(seg_max_retry), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    {"prefetch_segments", "Number of segments to download ahead of time in parallel, 0 = disable",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_buffer_size", "Amount of memory used for prefetching further segments than the current ones",
+        OFFSET(prefetch_buffer_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
@@ -42,6 +42,7 @@
 
 #include "libavcodec/defs.h"
 
+#include "async_writer.h"
 #include "avformat.h"
 #include "avio_internal.h"
 #include "avc.h"
@@ -254,6 +255,8 @@ typedef struct HLSContext {
     int64_t timeout;
     int ignore_io_errors;
     char *headers;
+    int async_io;
+    FFAsyncWriter *writer; /* background writer if async_io is set */
     int has_default_key; /* has DEFAULT field of var_stream_map */
     int has_video_m3u8; /* has video stream m3u8 list */
 } HLSContext;
@@ -287,6 +290,8 @@ static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, const char *file
     HLSContext *hls = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
+    if (hls->writer)
+        return ff_async_writer_open(hls->writer, pb, filename, options);
     if (!*pb || !http_base_proto || !hls->http_persistent) {
         err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
@@ -309,6 +314,8 @@ static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
     int ret = 0;
     if (!*pb)
         return ret;
+    if (hls->writer)
+        return ff_async_writer_close(hls->writer, pb);
     if (!http_base_proto || !hls->http_persistent || hls->key_info_file || hls->encrypt) {
         ff_format_io_close(s, pb);
 #if CONFIG_HTTP_PROTOCOL
@@ -322,6 +329,15 @@ static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
     return ret;
 }
 
+static int hlsenc_rename(AVFormatContext *s, const char *url_src, const char *url_dst)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (hls->writer)
+        return ff_async_writer_rename(hls->writer, url_src, url_dst);
+    return ff_rename(url_src, url_dst, s);
+}
+
 static void set_http_options(AVFormatContext *s, AVDictionary **options, HLSContext *c)
 {
     int http_base_proto = ff_is_http_proto(s->url);
@@ -587,6 +603,8 @@ static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
 
         //Nothing to write
         hlsenc_io_close(avf, &hls->http_delete, path);
+    } else if (hls->writer) {
+        return ff_async_writer_delete(hls->writer, path);
     } else if (unlink(path) < 0) {
         av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
                path, strerror(errno));
@@ -1044,10 +1062,12 @@ static int sls_flag_check_duration_size(HLSContext *hls, VariantStream *vs)
     return ret;
 }
 
-static void sls_flag_file_rename(HLSContext *hls, VariantStream *vs, char *old_filename) {
+static void sls_flag_file_rename(AVFormatContext *s, VariantStream *vs, char *old_filename) {
+    HLSContext *hls = s->priv_data;
+
     if ((hls->flags & (HLS_SECOND_LEVEL_SEGMENT_SIZE | HLS_SECOND_LEVEL_SEGMENT_DURATION)) &&
         strlen(vs->current_segment_final_filename_fmt)) {
-        ff_rename(old_filename, vs->avf->url, hls);
+        hlsenc_rename(s, old_filename, vs->avf->url);
     }
 }
 
@@ -1317,7 +1337,7 @@ static int hls_rename_temp_file(AVFormatContext *s, AVFormatContext *oc)
     if (!final_filename)
         return AVERROR(ENOMEM);
     final_filename[len-4] = '\0';
-    ret = ff_rename(oc->url, final_filename, s);
+    ret = hlsenc_rename(s, oc->url, final_filename);
     oc->url[len-4] = '\0';
     av_freep(&final_filename);
     return ret;
@@ -1527,7 +1547,7 @@ fail:
         hls->master_m3u8_created = 1;
     hlsenc_io_close(s, &hls->m3u8_out, temp_filename);
     if (use_temp_file)
-        ff_rename(temp_filename, hls->master_m3u8_url, s);
+        hlsenc_rename(s, temp_filename, hls->master_m3u8_url);
 
     return ret;
 }
@@ -1669,9 +1689,9 @@ fail:
     }
     hlsenc_io_close(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name);
     if (use_temp_file) {
-        ff_rename(temp_filename, vs->m3u8_name, s);
+        hlsenc_rename(s, temp_filename, vs->m3u8_name);
         if (vs->vtt_m3u8_name)
-            ff_rename(temp_vtt_filename, vs->vtt_m3u8_name, s);
+            hlsenc_rename(s, temp_vtt_filename, vs->vtt_m3u8_name);
     }
     if (ret >= 0 && hls->master_pl_name)
         if (create_master_playlist(s, vs) < 0)
@@ -2590,7 +2610,13 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
                     return ret;
                 }
                 ret = hlsenc_io_close(s, &vs->out, filename);
-                if (ret < 0) {
+                if (ret < 0 && hls->writer) {
+                    /* a failed background write is not retried */
+                    av_dict_free(&options);
+                    av_freep(&vs->temp_buffer);
+                    av_freep(&filename);
+                    return ret;
+                } else if (ret < 0) {
                     av_log(s, AV_LOG_WARNING, "upload segment failed,"
                            " will retry with a new http session.\n");
                     ff_format_io_close(s, &vs->out);
@@ -2653,7 +2679,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         } else if (hls->max_seg_size > 0) {
             if (vs->size + vs->start_pos >= hls->max_seg_size) {
                 vs->sequence++;
-                sls_flag_file_rename(hls, vs, old_filename);
+                sls_flag_file_rename(s, vs, old_filename);
                 ret = hls_start(s, vs);
                 vs->start_pos = 0;
                 /* When split segment by byte, the duration is short than hls_time,
@@ -2663,7 +2689,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             }
         } else {
             vs->start_pos = new_start_pos;
-            sls_flag_file_rename(hls, vs, old_filename);
+            sls_flag_file_rename(s, vs, old_filename);
             ret = hls_start(s, vs);
         }
         vs->number++;
@@ -2715,6 +2741,11 @@ static void hls_deinit(AVFormatContext *s)
         av_freep(&vs->streams);
     }
 
+    if (hls->writer) {
+        /* this also frees the files that were not closed */
+        ff_async_writer_free(&hls->writer);
+        hls->m3u8_out = hls->sub_m3u8_out = hls->http_delete = NULL;
+    }
     ff_format_io_close(s, &hls->m3u8_out);
     ff_format_io_close(s, &hls->sub_m3u8_out);
     ff_format_io_close(s, &hls->http_delete);
@@ -2776,7 +2807,8 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 vs->start_pos = range_length;
                 byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
                 if (!byterange_mode) {
-                    ff_format_io_close(s, &vs->out);
+                    if (!hls->writer)
+                        ff_format_io_close(s, &vs->out);
                     hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
                 }
             }
@@ -2797,7 +2829,7 @@ static int hls_write_trailer(struct AVFormatContext *s)
 
         vs->size = range_length;
         ret = hlsenc_io_close(s, &vs->out, filename);
-        if (ret < 0) {
+        if (ret < 0 && !hls->writer) {
             av_log(s, AV_LOG_WARNING, "upload segment failed, will retry with a new http session.\n");
             ff_format_io_close(s, &vs->out);
             ret = hlsenc_io_open(s, &vs->out, filename, &options);
@@ -2840,13 +2872,16 @@ failed:
         /* after av_write_trailer, then duration + 1 duration per packet */
         hls_append_segment(s, hls, vs, vs->duration + vs->dpp, vs->start_pos, vs->size);
 
-        sls_flag_file_rename(hls, vs, old_filename);
+        sls_flag_file_rename(s, vs, old_filename);
 
         if (vtt_oc) {
             if (vtt_oc->pb)
                 av_write_trailer(vtt_oc);
             vs->size = avio_tell(vs->vtt_avf->pb) - vs->start_pos;
-            ff_format_io_close(s, &vtt_oc->pb);
+            if (hls->writer)
+                hlsenc_io_close(s, &vtt_oc->pb, vtt_oc->url);
+            else
+                ff_format_io_close(s, &vtt_oc->pb);
         }
         ret = hls_window(s, 1, vs);
         if (ret < 0) {
@@ -2859,6 +2894,8 @@ failed:
         av_free(old_filename);
     }
 
+    if (hls->writer)
+        return ff_async_writer_flush(hls->writer);
     return 0;
 }
 
@@ -2898,6 +2935,15 @@ static int hls_init(AVFormatContext *s)
         av_log(hls, AV_LOG_WARNING, "No HTTP method set, hls muxer defaulting to method PUT.\n");
     }
 
+    if (hls->async_io && (hls->flags & HLS_SINGLE_FILE)) {
+        av_log(s, AV_LOG_WARNING, "async_io is not supported with single_file, "
+               "writing synchronously.\n");
+    } else if (hls->async_io) {
+        ret = ff_async_writer_alloc(&hls->writer, s, hls->async_io, hls->ignore_io_errors);
+        if (ret < 0)
+            return ret;
+    }
+
     ret = validate_name(hls->nb_varstreams, s->url);
     if (ret < 0)
         return ret;
@@ -3175,6 +3221,7 @@ static const AVOption options[] = {
     {"timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
     {"ignore_io_errors", "Ignore IO errors for stable long-duration runs with network output", OFFSET(ignore_io_errors), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     {"headers", "set custom HTTP headers, can override built in default headers", OFFSET(headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
+    {"async_io", "write up to this many files in the background, 0 to write them synchronously", OFFSET(async_io), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1024, E },
     { NULL },
 };
 
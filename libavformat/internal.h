@@ -97,6 +97,33 @@ typedef struct FFFormatContext {
      */
     PacketList packet_buffer;
 
+    /**
+     * Streams with packets in their interleave_queue, as a binary heap
+     * ordered by the first packet of each queue. Muxing only.
+     */
+    struct FFStream **interleave_heap;
+    int nb_interleave_heap;
+    unsigned interleave_heap_size;
+    /**
+     * Number of streams whose lack of buffered packets does not prevent
+     * max_interleave_delta from forcing output, and how many of them
+     * currently are in interleave_heap.
+     */
+    int nb_skippable_streams;
+    int nb_skippable_buffered;
+    /**
+     * Largest dts in AV_TIME_BASE_Q of the last buffered packet of the
+     * non-subtitle streams, only up to date if interleave_max_dts_valid
+     * is set.
+     */
+    int64_t interleave_max_dts;
+    int interleave_max_dts_valid;
+    /**
+     * Counter used to order streams whose first buffered packet continues
+     * a chunk, see FFStream.interleave_run.
+     */
+    uint64_t interleave_run;
+
     /* av_seek_frame() support */
     int64_t data_offset; /**< offset of the first packet */
 
@@ -250,6 +277,11 @@ typedef struct FFStream {
                                     support seeking natively. */
     int nb_index_entries;
     unsigned int index_entries_allocated_size;
+    /**
+     * Compact version of the index, see ff_index_compact().
+     * If set, index_entries is unused.
+     */
+    struct FFCompactIndex *compact_index;
 
     int64_t interleaver_chunk_size;
     int64_t interleaver_chunk_duration;
@@ -374,6 +406,19 @@ typedef struct FFStream {
      */
     PacketListEntry *last_in_packet_buffer;
 
+    /**
+     * Packets of this stream buffered by the interleaver and the position
+     * of the stream in FFFormatContext.interleave_heap. Muxing only.
+     */
+    PacketList interleave_queue;
+    int interleave_heap_index;
+    /**
+     * When interleaving in chunks, the value of FFFormatContext.interleave_run
+     * when the first packet of interleave_queue became the next one to be
+     * muxed for this stream while continuing a chunk.
+     */
+    uint64_t interleave_run;
+
     int64_t last_IP_pts;
     int last_IP_duration;
 
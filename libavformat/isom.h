@@ -164,6 +164,31 @@ typedef struct MOVIndexRange {
     int64_t end;
 } MOVIndexRange;
 
+/**
+ * Position of the sample table walk that adds samples to the index,
+ * see mov_build_index().
+ */
+typedef struct MOVIndexBuilder {
+    int lazy;                  ///< the walk is resumed while reading packets
+    int done;
+    unsigned int chunk;        ///< current chunk
+    unsigned int chunk_sample; ///< next sample in the current chunk
+    unsigned int current_sample;
+    unsigned int stsc_index;
+    unsigned int stts_index;
+    unsigned int stts_sample;
+    unsigned int stss_index;
+    unsigned int stps_index;
+    unsigned int rap_group_index;
+    unsigned int rap_group_sample;
+    unsigned int distance;
+    int key_off;
+    int64_t current_offset;
+    int64_t current_dts;
+    int64_t last_key_dts;      ///< timestamp of the last keyframe added
+    uint64_t stream_size;
+} MOVIndexBuilder;
+
 typedef struct MOVStreamContext {
     AVIOContext *pb;
     int refcount;
@@ -203,6 +228,7 @@ typedef struct MOVStreamContext {
     int current_sample;
     int64_t current_index;
     MOVIndexRange* index_ranges;
+    MOVIndexBuilder index_builder;
     MOVIndexRange* current_index_range;
     unsigned int bytes_per_frame;
     unsigned int samples_per_frame;
@@ -356,6 +382,8 @@ typedef struct MOVContext {
     int thmb_item_id;
     int64_t idat_offset;
     int interleaved_read;
+    int compact_index;
+    int lazy_index;
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
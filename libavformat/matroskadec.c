@@ -433,6 +433,8 @@ typedef struct MatroskaDemuxContext {
 
     /* Bandwidth value for WebM DASH Manifest */
     int bandwidth;
+
+    int compact_index;
 } MatroskaDemuxContext;
 
 #define CHILD_OF(parent) { .def = { .n = parent } }
@@ -1250,6 +1252,50 @@ static MatroskaLevel1Element *matroska_find_level1_elem(MatroskaDemuxContext *ma
     return elem;
 }
 
+/*
+ * Read the data of a block. Blocks of tracks whose packets are passed on
+ * unmodified to decoders that never read the padding, i.e. raw video and
+ * PCM, may reference the mapping of the input file directly; the padding
+ * is the following file data then.
+ */
+static int matroska_read_block_data(MatroskaDemuxContext *matroska,
+                                    AVIOContext *pb, int length,
+                                    int64_t pos, EbmlBin *bin)
+{
+    const MatroskaTrack *tracks = matroska->tracks.elem;
+    const uint8_t *p = pb->buf_ptr;
+    int avail = FFMIN(pb->buf_end - pb->buf_ptr, length);
+    AVBufferRef *buf;
+    uint8_t *data;
+    uint64_t num;
+    int n, i;
+
+    /* The block starts with the track number as EBML number; it is only
+     * looked at if it has already been read into the buffer. */
+    n = avail > 0 && p[0] ? 8 - ff_log2_tab[p[0]] : 0;
+    if (!n || n > avail)
+        return ebml_read_binary(pb, length, pos, bin);
+    num = p[0] ^ (1 << ff_log2_tab[p[0]]);
+    for (i = 1; i < n; i++)
+        num = (num << 8) | p[i];
+
+    for (i = 0; i < matroska->tracks.nb_elem; i++)
+        if (tracks[i].num == num)
+            break;
+    if (i == matroska->tracks.nb_elem || !tracks[i].stream ||
+        !ff_packet_mappable(tracks[i].stream->codecpar->codec_id) ||
+        ffio_read_mapped(pb, length, &buf, &data) < 0)
+        return ebml_read_binary(pb, length, pos, bin);
+
+    av_buffer_unref(&bin->buf);
+    bin->buf  = buf;
+    bin->data = data;
+    bin->size = length;
+    bin->pos  = pos;
+
+    return 0;
+}
+
 static int ebml_parse(MatroskaDemuxContext *matroska,
                       EbmlSyntax *syntax, void *data)
 {
@@ -1478,7 +1524,10 @@ static int ebml_parse(MatroskaDemuxContext *matroska,
         res = ebml_read_ascii(pb, length, syntax->def.s, data);
         break;
     case EBML_BIN:
-        res = ebml_read_binary(pb, length, pos_alt, data);
+        if (id == MATROSKA_ID_BLOCK || id == MATROSKA_ID_SIMPLEBLOCK)
+            res = matroska_read_block_data(matroska, pb, length, pos_alt, data);
+        else
+            res = ebml_read_binary(pb, length, pos_alt, data);
         break;
     case EBML_LEVEL1:
     case EBML_NEST:
@@ -3345,6 +3394,14 @@ static int matroska_read_header(AVFormatContext *s)
     if (res < 0)
         return res;
 
+    /* Cues and clusters append to the compact index directly. */
+    if (matroska->compact_index) {
+        for (i = 0; i < s->nb_streams; i++) {
+            if ((res = ff_index_compact(s->streams[i])) < 0)
+                return res;
+        }
+    }
+
     attachments = attachments_list->elem;
     for (j = 0; j < attachments_list->nb_elem; j++) {
         if (!(attachments[j].filename && attachments[j].mime &&
@@ -4283,7 +4340,8 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     MatroskaTrack *tracks = NULL;
     AVStream *st = s->streams[stream_index];
     FFStream *const sti = ffstream(st);
-    int i, index;
+    const AVIndexEntry *ie;
+    int i, index, nb_index_entries;
 
     /* Parse the CUES now since we need the index data to seek. */
     if (matroska->cues_parsing_deferred > 0) {
@@ -4291,15 +4349,16 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
         matroska_parse_cues(matroska);
     }
 
-    if (!sti->nb_index_entries)
+    nb_index_entries = avformat_index_get_entries_count(st);
+    if (!nb_index_entries)
         goto err;
-    timestamp = FFMAX(timestamp, sti->index_entries[0].timestamp);
+    timestamp = FFMAX(timestamp, ff_index_get_entry(st, 0)->timestamp);
 
     if ((index = av_index_search_timestamp(st, timestamp, flags)) < 0 ||
-         index == sti->nb_index_entries - 1) {
-        matroska_reset_status(matroska, 0, sti->index_entries[sti->nb_index_entries - 1].pos);
+         index == nb_index_entries - 1) {
+        matroska_reset_status(matroska, 0, ff_index_get_entry(st, nb_index_entries - 1)->pos);
         while ((index = av_index_search_timestamp(st, timestamp, flags)) < 0 ||
-               index == sti->nb_index_entries - 1) {
+               index == avformat_index_get_entries_count(st) - 1) {
             matroska_clear_queue(matroska);
             if (matroska_parse_cluster(matroska) < 0)
                 break;
@@ -4308,7 +4367,7 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
 
     matroska_clear_queue(matroska);
     if (index < 0 || (matroska->cues_parsing_deferred < 0 &&
-                      index == sti->nb_index_entries - 1))
+                      index == avformat_index_get_entries_count(st) - 1))
         goto err;
 
     tracks = matroska->tracks.elem;
@@ -4320,17 +4379,18 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     }
 
     /* We seek to a level 1 element, so set the appropriate status. */
-    matroska_reset_status(matroska, 0, sti->index_entries[index].pos);
+    ie = ff_index_get_entry(st, index);
+    matroska_reset_status(matroska, 0, ie->pos);
     if (flags & AVSEEK_FLAG_ANY) {
         sti->skip_to_keyframe = 0;
         matroska->skip_to_timecode = timestamp;
     } else {
         sti->skip_to_keyframe = 1;
-        matroska->skip_to_timecode = sti->index_entries[index].timestamp;
+        matroska->skip_to_timecode = ie->timestamp;
     }
     matroska->skip_to_keyframe = 1;
     matroska->done             = 0;
-    avpriv_update_cur_dts(s, st, sti->index_entries[index].timestamp);
+    avpriv_update_cur_dts(s, st, ie->timestamp);
     return 0;
 err:
     // slightly hackish but allows proper fallback to
@@ -4804,11 +4864,24 @@ const FFInputFormat ff_webm_dash_manifest_demuxer = {
 };
 #endif
 
+static const AVOption matroska_options[] = {
+    { "compact_index", "Keep the index in a compact representation", offsetof(MatroskaDemuxContext, compact_index), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "matroska,webm demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 const FFInputFormat ff_matroska_demuxer = {
     .p.name         = "matroska,webm",
     .p.long_name    = NULL_IF_CONFIG_SMALL("Matroska / WebM"),
     .p.extensions   = "mkv,mk3d,mka,mks,webm",
     .p.mime_type    = "audio/webm,audio/x-matroska,video/webm,video/x-matroska",
+    .p.priv_class   = &matroska_class,
     .priv_data_size = sizeof(MatroskaDemuxContext),
     .flags_internal = FF_INFMT_FLAG_INIT_CLEANUP,
     .read_probe     = matroska_probe,
@@ -58,6 +58,7 @@
 #include "avformat.h"
 #include "internal.h"
 #include "avio_internal.h"
+#include "compactindex.h"
 #include "demux.h"
 #include "iamf_parse.h"
 #include "iamf_reader.h"
@@ -3892,12 +3893,18 @@ static int64_t add_ctts_entry(MOVCtts** ctts_data, unsigned int* ctts_count, uns
 static void mov_estimate_video_delay(MOVContext *c, AVStream* st)
 {
     MOVStreamContext *msc = st->priv_data;
-    FFStream *const sti = ffstream(st);
     int ctts_ind = 0;
     int ctts_sample = 0;
     int64_t pts_buf[MAX_REORDER_DELAY + 1]; // Circular buffer to sort pts.
     int buf_start = 0;
     int j, r, num_swaps;
+    // A lazily built index only holds the first samples, so walk the
+    // sample tables instead. The start dts does not matter for the delay.
+    int lazy = msc->index_builder.lazy;
+    int nb_samples = !lazy ? avformat_index_get_entries_count(st) :
+                     msc->stts_count ? msc->sample_count : 0;
+    unsigned int stts_ind = 0, stts_sample = 0;
+    int64_t dts = 0;
 
     for (j = 0; j < MAX_REORDER_DELAY + 1; j++)
         pts_buf[j] = INT64_MIN;
@@ -3905,14 +3912,22 @@ static void mov_estimate_video_delay(MOVContext *c, AVStream* st)
     if (st->codecpar->video_delay <= 0 && msc->ctts_data &&
         st->codecpar->codec_id == AV_CODEC_ID_H264) {
         st->codecpar->video_delay = 0;
-        for (int ind = 0; ind < sti->nb_index_entries && ctts_ind < msc->ctts_count; ++ind) {
+        for (int ind = 0; ind < nb_samples && ctts_ind < msc->ctts_count; ++ind) {
             // Point j to the last elem of the buffer and insert the current pts there.
             j = buf_start;
             buf_start = (buf_start + 1);
             if (buf_start == MAX_REORDER_DELAY + 1)
                 buf_start = 0;
 
-            pts_buf[j] = sti->index_entries[ind].timestamp + msc->ctts_data[ctts_ind].duration;
+            if (lazy) {
+                pts_buf[j] = dts + msc->ctts_data[ctts_ind].duration;
+                dts += msc->stts_data[stts_ind].duration;
+                if (stts_ind + 1 < msc->stts_count && ++stts_sample == msc->stts_data[stts_ind].count) {
+                    stts_ind++;
+                    stts_sample = 0;
+                }
+            } else
+                pts_buf[j] = ff_index_get_entry(st, ind)->timestamp + msc->ctts_data[ctts_ind].duration;
 
             // The timestamps that are already in the sorted buffer, and are greater than the
             // current pts, are exactly the timestamps that need to be buffered to output PTS
@@ -4373,21 +4388,221 @@ static int build_open_gop_key_points(AVStream *st)
     return 0;
 }
 
+/**
+ * Expand ctts entries such that we have a 1-1 mapping with samples.
+ */
+static int mov_expand_ctts(MOVStreamContext *sc)
+{
+    MOVCtts *ctts_data_old = sc->ctts_data;
+    unsigned int ctts_count_old = sc->ctts_count;
+
+    if (!ctts_data_old)
+        return 0;
+
+    if (sc->sample_count >= UINT_MAX / sizeof(*sc->ctts_data))
+        return AVERROR(ENOMEM);
+    sc->ctts_count = 0;
+    sc->ctts_allocated_size = 0;
+    sc->ctts_data = av_fast_realloc(NULL, &sc->ctts_allocated_size,
+                            sc->sample_count * sizeof(*sc->ctts_data));
+    if (!sc->ctts_data) {
+        av_free(ctts_data_old);
+        return AVERROR(ENOMEM);
+    }
+
+    memset((uint8_t*)(sc->ctts_data), 0, sc->ctts_allocated_size);
+
+    for (unsigned i = 0; i < ctts_count_old &&
+                         sc->ctts_count < sc->sample_count; i++)
+        for (unsigned j = 0; j < ctts_data_old[i].count &&
+                             sc->ctts_count < sc->sample_count; j++)
+            add_ctts_entry(&sc->ctts_data, &sc->ctts_count,
+                           &sc->ctts_allocated_size, 1,
+                           ctts_data_old[i].duration);
+    av_free(ctts_data_old);
+
+    return 0;
+}
+
+/* number of entries added at once to a lazily built index */
+#define MOV_LAZY_INDEX_BATCH 1024
+
+/**
+ * Append an entry to the end of the index, which may be compact.
+ */
+static int mov_append_index_entry(AVStream *st, const AVIndexEntry *e)
+{
+    FFStream *const sti = ffstream(st);
+    AVIndexEntry *entries;
+    int ret;
+
+    if (sti->compact_index) {
+        ret = ff_compact_index_append(sti->compact_index, e);
+        /* Samples with non-increasing timestamps need the regular index. */
+        if (ret != AVERROR(EINVAL))
+            return ret;
+        if ((ret = ff_index_expand(st)) < 0)
+            return ret;
+    }
+
+    if (sti->nb_index_entries >= UINT_MAX / sizeof(*entries) - 1)
+        return AVERROR(ENOMEM);
+    entries = av_fast_realloc(sti->index_entries,
+                              &sti->index_entries_allocated_size,
+                              (sti->nb_index_entries + 1) * sizeof(*entries));
+    if (!entries)
+        return AVERROR(ENOMEM);
+    sti->index_entries = entries;
+    entries[sti->nb_index_entries++] = *e;
+
+    return 0;
+}
+
+/**
+ * Add index entries for the samples described by the sample tables,
+ * continuing where the previous call stopped. Stop once at least
+ * nb_entries entries exist and, unless min_ts is INT64_MIN, a keyframe
+ * with a timestamp larger than min_ts has been added.
+ *
+ * @return 0 if the requested entries are available or all samples have
+ *         been added, a negative AVERROR code on broken sample tables
+ */
+static int mov_index_extend(MOVContext *mov, AVStream *st, int nb_entries, int64_t min_ts)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVIndexBuilder *b = &sc->index_builder;
+    int rap_group_present = sc->rap_group_count && sc->rap_group;
+    int ret = 0;
+
+    while (!b->done) {
+        int keyframe = 0;
+        unsigned int sample_size;
+
+        if (avformat_index_get_entries_count(st) >= nb_entries &&
+            (min_ts == INT64_MIN || b->last_key_dts > min_ts))
+            return 0;
+
+        if (!b->chunk_sample) {
+            int64_t next_offset;
+
+            if (b->chunk >= sc->chunk_count)
+                break;
+
+            next_offset = b->chunk + 1 < sc->chunk_count ? sc->chunk_offsets[b->chunk + 1] : INT64_MAX;
+            b->current_offset = sc->chunk_offsets[b->chunk];
+            while (mov_stsc_index_valid(b->stsc_index, sc->stsc_count) &&
+                b->chunk + 1 == sc->stsc_data[b->stsc_index + 1].first)
+                b->stsc_index++;
+
+            if (next_offset > b->current_offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
+                sc->stsc_data[b->stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - b->current_offset) {
+                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
+                sc->stsz_sample_size = sc->sample_size;
+            }
+            if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size) {
+                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
+                sc->stsz_sample_size = sc->sample_size;
+            }
+        }
+
+        if (b->chunk_sample >= sc->stsc_data[b->stsc_index].count) {
+            b->chunk++;
+            b->chunk_sample = 0;
+            continue;
+        }
+
+        if (b->current_sample >= sc->sample_count) {
+            av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
+            ret = AVERROR_INVALIDDATA;
+            break;
+        }
+
+        if (!sc->keyframe_absent && (!sc->keyframe_count || b->current_sample+b->key_off == sc->keyframes[b->stss_index])) {
+            keyframe = 1;
+            if (b->stss_index + 1 < sc->keyframe_count)
+                b->stss_index++;
+        } else if (sc->stps_count && b->current_sample+b->key_off == sc->stps_data[b->stps_index]) {
+            keyframe = 1;
+            if (b->stps_index + 1 < sc->stps_count)
+                b->stps_index++;
+        }
+        if (rap_group_present && b->rap_group_index < sc->rap_group_count) {
+            if (sc->rap_group[b->rap_group_index].index > 0)
+                keyframe = 1;
+            if (++b->rap_group_sample == sc->rap_group[b->rap_group_index].count) {
+                b->rap_group_sample = 0;
+                b->rap_group_index++;
+            }
+        }
+        if (sc->keyframe_absent
+            && !sc->stps_count
+            && !rap_group_present
+            && (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO || (b->chunk==0 && b->chunk_sample==0)))
+             keyframe = 1;
+        if (keyframe)
+            b->distance = 0;
+        sample_size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[b->current_sample];
+        if (b->current_offset > INT64_MAX - sample_size) {
+            av_log(mov->fc, AV_LOG_ERROR, "Current offset %"PRId64" or sample size %u is too large\n",
+                   b->current_offset,
+                   sample_size);
+            ret = AVERROR_INVALIDDATA;
+            break;
+        }
+
+        if (sc->pseudo_stream_id == -1 ||
+           sc->stsc_data[b->stsc_index].id - 1 == sc->pseudo_stream_id) {
+            AVIndexEntry e = {
+                .pos          = b->current_offset,
+                .timestamp    = b->current_dts,
+                .size         = sample_size,
+                .min_distance = b->distance,
+                .flags        = keyframe ? AVINDEX_KEYFRAME : 0,
+            };
+            if (sample_size > 0x3FFFFFFF) {
+                av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", sample_size);
+                ret = AVERROR_INVALIDDATA;
+                break;
+            }
+            if ((ret = mov_append_index_entry(st, &e)) < 0)
+                break;
+            if (keyframe)
+                b->last_key_dts = b->current_dts;
+            av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
+                    "size %u, distance %u, keyframe %d\n", st->index, b->current_sample,
+                    b->current_offset, b->current_dts, sample_size, b->distance, keyframe);
+            if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && avformat_index_get_entries_count(st) < 100)
+                ff_rfps_add_frame(mov->fc, st, b->current_dts);
+        }
+
+        b->current_offset += sample_size;
+        b->stream_size += sample_size;
+
+        b->current_dts += sc->stts_data[b->stts_index].duration;
+
+        b->distance++;
+        b->stts_sample++;
+        b->current_sample++;
+        b->chunk_sample++;
+        if (b->stts_index + 1 < sc->stts_count && b->stts_sample == sc->stts_data[b->stts_index].count) {
+            b->stts_sample = 0;
+            b->stts_index++;
+        }
+    }
+    b->done = 1;
+
+    return ret;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
     FFStream *const sti = ffstream(st);
     int64_t current_offset;
     int64_t current_dts = 0;
-    unsigned int stts_index = 0;
     unsigned int stsc_index = 0;
-    unsigned int stss_index = 0;
-    unsigned int stps_index = 0;
-    unsigned int i, j;
+    unsigned int i;
     uint64_t stream_size = 0;
-    MOVCtts *ctts_data_old = sc->ctts_data;
-    unsigned int ctts_count_old = sc->ctts_count;
-
     int ret = build_open_gop_key_points(st);
     if (ret < 0)
         return;
@@ -4440,149 +4655,69 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             sc->start_pad = start_time;
     }
 
+    /* Indexes that are rewritten according to the edit list, or that
+     * fragments are added to, need the regular representation. */
+    if (mov->compact_index && !mov->trex_count && !sc->iamf &&
+        (!sc->elst_count || mov->ignore_editlist || !mov->advanced_editlist) &&
+        !avformat_index_get_entries_count(st)) {
+        if (ff_index_compact(st) < 0)
+            return;
+    }
+
     /* only use old uncompressed audio chunk demuxing when stts specifies it */
     if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
           sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
-        unsigned int current_sample = 0;
-        unsigned int stts_sample = 0;
-        unsigned int sample_size;
-        unsigned int distance = 0;
-        unsigned int rap_group_index = 0;
-        unsigned int rap_group_sample = 0;
-        int rap_group_present = sc->rap_group_count && sc->rap_group;
-        int key_off = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
+        MOVIndexBuilder *b = &sc->index_builder;
 
         current_dts -= sc->dts_shift;
 
-        if (!sc->sample_count || sti->nb_index_entries)
-            return;
-        if (sc->sample_count >= UINT_MAX / sizeof(*sti->index_entries) - sti->nb_index_entries)
-            return;
-        if (av_reallocp_array(&sti->index_entries,
-                              sti->nb_index_entries + sc->sample_count,
-                              sizeof(*sti->index_entries)) < 0) {
-            sti->nb_index_entries = 0;
+        if (!sc->sample_count || avformat_index_get_entries_count(st))
             return;
-        }
-        sti->index_entries_allocated_size = (sti->nb_index_entries + sc->sample_count) * sizeof(*sti->index_entries);
-
-        if (ctts_data_old) {
-            // Expand ctts entries such that we have a 1-1 mapping with samples
-            if (sc->sample_count >= UINT_MAX / sizeof(*sc->ctts_data))
-                return;
-            sc->ctts_count = 0;
-            sc->ctts_allocated_size = 0;
-            sc->ctts_data = av_fast_realloc(NULL, &sc->ctts_allocated_size,
-                                    sc->sample_count * sizeof(*sc->ctts_data));
-            if (!sc->ctts_data) {
-                av_free(ctts_data_old);
-                return;
-            }
-
-            memset((uint8_t*)(sc->ctts_data), 0, sc->ctts_allocated_size);
-
-            for (i = 0; i < ctts_count_old &&
-                        sc->ctts_count < sc->sample_count; i++)
-                for (j = 0; j < ctts_data_old[i].count &&
-                            sc->ctts_count < sc->sample_count; j++)
-                    add_ctts_entry(&sc->ctts_data, &sc->ctts_count,
-                                   &sc->ctts_allocated_size, 1,
-                                   ctts_data_old[i].duration);
-            av_free(ctts_data_old);
-        }
-
-        for (i = 0; i < sc->chunk_count; i++) {
-            int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
-            current_offset = sc->chunk_offsets[i];
-            while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
-                i + 1 == sc->stsc_data[stsc_index + 1].first)
-                stsc_index++;
 
-            if (next_offset > current_offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
-                sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - current_offset) {
-                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
-                sc->stsz_sample_size = sc->sample_size;
-            }
-            if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size) {
-                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
-                sc->stsz_sample_size = sc->sample_size;
-            }
+        *b = (MOVIndexBuilder) {
+            .key_off      = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0),
+            .current_dts  = current_dts,
+            .last_key_dts = INT64_MIN,
+        };
+
+        /* Streams whose index is rewritten according to the edit list, and
+         * fragmented files, need all entries from the start. */
+        b->lazy = mov->lazy_index && !mov->trex_count && !sc->iamf &&
+                  (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ||
+                   st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) &&
+                  (!sc->elst_count || mov->ignore_editlist || !mov->advanced_editlist);
+        if (b->lazy) {
+            if (sc->stsz_sample_size > 0)
+                stream_size = (uint64_t)sc->stsz_sample_size * sc->sample_count;
+            else
+                for (i = 0; i < sc->sample_count; i++)
+                    stream_size += sc->sample_sizes[i];
+            if (st->duration > 0)
+                st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
 
-            for (j = 0; j < sc->stsc_data[stsc_index].count; j++) {
-                int keyframe = 0;
-                if (current_sample >= sc->sample_count) {
-                    av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
+            if (mov_index_extend(mov, st, MOV_LAZY_INDEX_BATCH, INT64_MIN) < 0)
+                return;
+        } else {
+            if (!sti->compact_index) {
+                if (sc->sample_count >= UINT_MAX / sizeof(*sti->index_entries) - sti->nb_index_entries)
                     return;
-                }
-
-                if (!sc->keyframe_absent && (!sc->keyframe_count || current_sample+key_off == sc->keyframes[stss_index])) {
-                    keyframe = 1;
-                    if (stss_index + 1 < sc->keyframe_count)
-                        stss_index++;
-                } else if (sc->stps_count && current_sample+key_off == sc->stps_data[stps_index]) {
-                    keyframe = 1;
-                    if (stps_index + 1 < sc->stps_count)
-                        stps_index++;
-                }
-                if (rap_group_present && rap_group_index < sc->rap_group_count) {
-                    if (sc->rap_group[rap_group_index].index > 0)
-                        keyframe = 1;
-                    if (++rap_group_sample == sc->rap_group[rap_group_index].count) {
-                        rap_group_sample = 0;
-                        rap_group_index++;
-                    }
-                }
-                if (sc->keyframe_absent
-                    && !sc->stps_count
-                    && !rap_group_present
-                    && (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO || (i==0 && j==0)))
-                     keyframe = 1;
-                if (keyframe)
-                    distance = 0;
-                sample_size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[current_sample];
-                if (current_offset > INT64_MAX - sample_size) {
-                    av_log(mov->fc, AV_LOG_ERROR, "Current offset %"PRId64" or sample size %u is too large\n",
-                           current_offset,
-                           sample_size);
+                if (av_reallocp_array(&sti->index_entries,
+                                      sti->nb_index_entries + sc->sample_count,
+                                      sizeof(*sti->index_entries)) < 0) {
+                    sti->nb_index_entries = 0;
                     return;
                 }
+                sti->index_entries_allocated_size = (sti->nb_index_entries + sc->sample_count) * sizeof(*sti->index_entries);
+            }
 
-                if (sc->pseudo_stream_id == -1 ||
-                   sc->stsc_data[stsc_index].id - 1 == sc->pseudo_stream_id) {
-                    AVIndexEntry *e;
-                    if (sample_size > 0x3FFFFFFF) {
-                        av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", sample_size);
-                        return;
-                    }
-                    e = &sti->index_entries[sti->nb_index_entries++];
-                    e->pos = current_offset;
-                    e->timestamp = current_dts;
-                    e->size = sample_size;
-                    e->min_distance = distance;
-                    e->flags = keyframe ? AVINDEX_KEYFRAME : 0;
-                    av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
-                            "size %u, distance %u, keyframe %d\n", st->index, current_sample,
-                            current_offset, current_dts, sample_size, distance, keyframe);
-                    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && sti->nb_index_entries < 100)
-                        ff_rfps_add_frame(mov->fc, st, current_dts);
-                }
-
-                current_offset += sample_size;
-                stream_size += sample_size;
-
-                current_dts += sc->stts_data[stts_index].duration;
+            if (mov_expand_ctts(sc) < 0)
+                return;
 
-                distance++;
-                stts_sample++;
-                current_sample++;
-                if (stts_index + 1 < sc->stts_count && stts_sample == sc->stts_data[stts_index].count) {
-                    stts_sample = 0;
-                    stts_index++;
-                }
-            }
+            if (mov_index_extend(mov, st, INT_MAX, INT64_MIN) < 0)
+                return;
+            if (st->duration > 0)
+                st->codecpar->bit_rate = b->stream_size*8*sc->time_scale/st->duration;
         }
-        if (st->duration > 0)
-            st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
     } else {
         unsigned chunk_samples, total = 0;
 
@@ -4617,15 +4752,17 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         }
 
         av_log(mov->fc, AV_LOG_TRACE, "chunk count %u\n", total);
-        if (total >= UINT_MAX / sizeof(*sti->index_entries) - sti->nb_index_entries)
-            return;
-        if (av_reallocp_array(&sti->index_entries,
-                              sti->nb_index_entries + total,
-                              sizeof(*sti->index_entries)) < 0) {
-            sti->nb_index_entries = 0;
-            return;
+        if (!sti->compact_index) {
+            if (total >= UINT_MAX / sizeof(*sti->index_entries) - sti->nb_index_entries)
+                return;
+            if (av_reallocp_array(&sti->index_entries,
+                                  sti->nb_index_entries + total,
+                                  sizeof(*sti->index_entries)) < 0) {
+                sti->nb_index_entries = 0;
+                return;
+            }
+            sti->index_entries_allocated_size = (sti->nb_index_entries + total) * sizeof(*sti->index_entries);
         }
-        sti->index_entries_allocated_size = (sti->nb_index_entries + total) * sizeof(*sti->index_entries);
 
         // populate index
         for (i = 0; i < sc->chunk_count; i++) {
@@ -4636,7 +4773,7 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             chunk_samples = sc->stsc_data[stsc_index].count;
 
             while (chunk_samples > 0) {
-                AVIndexEntry *e;
+                AVIndexEntry e;
                 unsigned size, samples;
 
                 if (sc->samples_per_frame > 1 && !sc->bytes_per_frame) {
@@ -4660,7 +4797,7 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                     }
                 }
 
-                if (sti->nb_index_entries >= total) {
+                if (avformat_index_get_entries_count(st) >= total) {
                     av_log(mov->fc, AV_LOG_ERROR, "wrong chunk count %u\n", total);
                     return;
                 }
@@ -4668,12 +4805,13 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                     av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", size);
                     return;
                 }
-                e = &sti->index_entries[sti->nb_index_entries++];
-                e->pos = current_offset;
-                e->timestamp = current_dts;
-                e->size = size;
-                e->min_distance = 0;
-                e->flags = AVINDEX_KEYFRAME;
+                e.pos = current_offset;
+                e.timestamp = current_dts;
+                e.size = size;
+                e.min_distance = 0;
+                e.flags = AVINDEX_KEYFRAME;
+                if (mov_append_index_entry(st, &e) < 0)
+                    return;
                 av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, chunk %u, offset %"PRIx64", dts %"PRId64", "
                        "size %u, duration %u\n", st->index, i, current_offset, current_dts,
                        size, samples);
@@ -4691,8 +4829,9 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     }
 
     // Update start time of the stream.
-    if (st->start_time == AV_NOPTS_VALUE && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && sti->nb_index_entries > 0) {
-        st->start_time = sti->index_entries[0].timestamp + sc->dts_shift;
+    if (st->start_time == AV_NOPTS_VALUE && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO &&
+        avformat_index_get_entries_count(st) > 0) {
+        st->start_time = ff_index_get_entry(st, 0)->timestamp + sc->dts_shift;
         if (sc->ctts_data) {
             st->start_time += sc->ctts_data[0].duration;
         }
@@ -4998,13 +5137,15 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
             ffstream(st)->need_parsing = AVSTREAM_PARSE_FULL;
     }
     /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
+    if (!sc->index_builder.lazy) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+        av_freep(&sc->stps_data);
+        av_freep(&sc->rap_group);
+    }
     av_freep(&sc->elst_data);
-    av_freep(&sc->rap_group);
     av_freep(&sc->sync_group);
     av_freep(&sc->sgpd_sync);
 
@@ -5426,6 +5567,21 @@ static int mov_read_trex(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     trex->duration = avio_rb32(pb);
     trex->size     = avio_rb32(pb);
     trex->flags    = avio_rb32(pb);
+
+    /* Fragments are added to the index, so it has to be complete and
+     * modifiable in place. */
+    for (int i = 0; i < c->fc->nb_streams; i++) {
+        AVStream *st = c->fc->streams[i];
+        MOVStreamContext *sc = st->priv_data;
+        if (sc->index_builder.lazy) {
+            sc->index_builder.lazy = 0;
+            if ((err = mov_expand_ctts(sc)) < 0 ||
+                (err = mov_index_extend(c, st, INT_MAX, INT64_MIN)) < 0)
+                return err;
+        }
+        if ((err = ff_index_expand(st)) < 0)
+            return err;
+    }
     return 0;
 }
 
@@ -7713,6 +7869,9 @@ static int cenc_filter(MOVContext *mov, AVStream* st, MOVStreamContext *sc, AVPa
         }
 
         if (mov->decryption_key) {
+            ret = av_packet_make_writable(pkt);
+            if (ret < 0)
+                return ret;
             return cenc_decrypt(mov, sc, encrypted_sample, pkt->data, pkt->size);
         } else {
             size_t size;
@@ -9728,6 +9887,8 @@ static int mov_read_header(AVFormatContext *s)
             break;
         }
     }
+    /* For lazily built indexes this only sees the first entries, so the
+     * buffer is sized from the interleaving at the start of the file. */
     ff_configure_buffers_for_index(s, AV_TIME_BASE);
 
     for (i = 0; i < mov->frag_index.nb_items; i++)
@@ -9737,19 +9898,33 @@ static int mov_read_header(AVFormatContext *s)
     return 0;
 }
 
-static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
+/**
+ * Find the sample to be read next.
+ *
+ * @param[out] psample the sample, or NULL if all samples have been read
+ * @return 0 on success, a negative AVERROR code if extending a lazily
+ *         built index failed
+ */
+static int mov_find_next_sample(AVFormatContext *s, AVStream **st,
+                                AVIndexEntry **psample)
 {
     AVIndexEntry *sample = NULL;
     int64_t best_dts = INT64_MAX;
-    int i;
+    int i, ret;
     MOVContext *mov = s->priv_data;
     int no_interleave = !mov->interleaved_read || !(s->pb->seekable & AVIO_SEEKABLE_NORMAL);
+
+    *psample = NULL;
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
-        FFStream *const avsti = ffstream(avst);
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avsti->nb_index_entries) {
-            AVIndexEntry *current_sample = &avsti->index_entries[msc->current_sample];
+        /* also make the entry after the current one available for its duration */
+        if (msc->index_builder.lazy &&
+            msc->current_sample + 1 >= avformat_index_get_entries_count(avst) &&
+            (ret = mov_index_extend(mov, avst, msc->current_sample + MOV_LAZY_INDEX_BATCH, INT64_MIN)) < 0)
+            return ret;
+        if (msc->pb && msc->current_sample < avformat_index_get_entries_count(avst)) {
+            AVIndexEntry *current_sample = ff_index_get_entry(avst, msc->current_sample);
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             uint64_t dtsdiff = best_dts > dts ? best_dts - (uint64_t)dts : ((uint64_t)dts - best_dts);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
@@ -9764,7 +9939,8 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
             }
         }
     }
-    return sample;
+    *psample = sample;
+    return 0;
 }
 
 static int should_retry(AVIOContext *pb, int error_code) {
@@ -9875,8 +10051,8 @@ static int mov_finalize_packet(AVFormatContext *s, AVStream *st, AVIndexEntry *s
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < ffstream(st)->nb_index_entries) ?
-            ffstream(st)->index_entries[sc->current_sample].timestamp : st->duration;
+        int64_t next_dts = (sc->current_sample < avformat_index_get_entries_count(st)) ?
+            ff_index_get_entry(st, sc->current_sample)->timestamp : st->duration;
 
         if (next_dts >= pkt->dts)
             pkt->duration = next_dts - pkt->dts;
@@ -9917,13 +10093,14 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
     MOVStreamContext *sc;
-    AVIndexEntry *sample;
+    AVIndexEntry *sample, compact_sample;
     AVStream *st = NULL;
     int64_t current_index;
     int ret;
     mov->fc = s;
  retry:
-    sample = mov_find_next_sample(s, &st);
+    if ((ret = mov_find_next_sample(s, &st, &sample)) < 0)
+        return ret;
     if (!sample || (mov->next_root_atom && sample->pos > mov->next_root_atom)) {
         if (!mov->next_root_atom)
             return AVERROR_EOF;
@@ -9931,6 +10108,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             return ret;
         goto retry;
     }
+    /* Entries of a compact index do not survive further index accesses. */
+    if (ffstream(st)->compact_index) {
+        compact_sample = *sample;
+        sample         = &compact_sample;
+    }
     sc = st->priv_data;
     /* must be done just before reading, to avoid infinite loop on sample */
     current_index = sc->current_index;
@@ -9987,7 +10169,7 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         }
 #endif
         else
-            ret = av_get_packet(sc->pb, pkt, sample->size);
+            ret = ff_get_packet_mapped(st, sc->pb, pkt, sample->size);
         if (ret < 0) {
             if (should_retry(sc->pb, ret)) {
                 mov_current_sample_dec(sc);
@@ -10029,8 +10211,12 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
     if (st->discard == AVDISCARD_ALL)
         goto retry;
 
-    if (mov->aax_mode)
+    if (mov->aax_mode) {
+        ret = av_packet_make_writable(pkt);
+        if (ret < 0)
+            return ret;
         aax_filter(pkt->data, pkt->size, mov);
+    }
 
     ret = cenc_filter(mov, st, sc, pkt, current_index);
     if (ret < 0) {
@@ -10079,7 +10265,6 @@ static int is_open_key_sample(const MOVStreamContext *sc, int sample)
 static int can_seek_to_key_sample(AVStream *st, int sample, int64_t requested_pts)
 {
     MOVStreamContext *sc = st->priv_data;
-    FFStream *const sti = ffstream(st);
     int64_t key_sample_dts, key_sample_pts;
 
     if (st->codecpar->codec_id != AV_CODEC_ID_HEVC)
@@ -10088,7 +10273,7 @@ static int can_seek_to_key_sample(AVStream *st, int sample, int64_t requested_pt
     if (sample >= sc->sample_offsets_count)
         return 1;
 
-    key_sample_dts = sti->index_entries[sample].timestamp;
+    key_sample_dts = ff_index_get_entry(st, sample)->timestamp;
     key_sample_pts = key_sample_dts + sc->sample_offsets[sample] + sc->dts_shift;
 
     /*
@@ -10105,7 +10290,6 @@ static int can_seek_to_key_sample(AVStream *st, int sample, int64_t requested_pt
 static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp, int flags)
 {
     MOVStreamContext *sc = st->priv_data;
-    FFStream *const sti = ffstream(st);
     int sample, time_sample, ret;
     unsigned int i;
 
@@ -10117,10 +10301,15 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
+    if (sc->index_builder.lazy &&
+        (ret = mov_index_extend(s->priv_data, st, 0, timestamp)) < 0)
+        return ret;
+
     for (;;) {
         sample = av_index_search_timestamp(st, timestamp, flags);
         av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-        if (sample < 0 && sti->nb_index_entries && timestamp < sti->index_entries[0].timestamp)
+        if (sample < 0 && avformat_index_get_entries_count(st) &&
+            timestamp < ff_index_get_entry(st, 0)->timestamp)
             sample = 0;
         if (sample < 0) /* not sure what to do */
             return AVERROR_INVALIDDATA;
@@ -10167,9 +10356,8 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
 static int64_t mov_get_skip_samples(AVStream *st, int sample)
 {
     MOVStreamContext *sc = st->priv_data;
-    FFStream *const sti = ffstream(st);
-    int64_t first_ts = sti->index_entries[0].timestamp;
-    int64_t ts = sti->index_entries[sample].timestamp;
+    int64_t first_ts = ff_index_get_entry(st, 0)->timestamp;
+    int64_t ts = ff_index_get_entry(st, sample)->timestamp;
     int64_t off;
 
     if (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
@@ -10187,7 +10375,7 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
     AVStream *st;
     FFStream *sti;
     int sample;
-    int i;
+    int i, ret;
 
     if (stream_index >= s->nb_streams)
         return AVERROR_INVALIDDATA;
@@ -10200,7 +10388,7 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = sti->index_entries[sample].timestamp;
+        int64_t seek_timestamp = ff_index_get_entry(st, sample)->timestamp;
         sti->skip_samples = mov_get_skip_samples(st, sample);
 
         for (i = 0; i < s->nb_streams; i++) {
@@ -10225,7 +10413,9 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
         }
         while (1) {
             MOVStreamContext *sc;
-            AVIndexEntry *entry = mov_find_next_sample(s, &st);
+            AVIndexEntry *entry;
+            if ((ret = mov_find_next_sample(s, &st, &entry)) < 0)
+                return ret;
             if (!entry)
                 return AVERROR_INVALIDDATA;
             sc = st->priv_data;
@@ -10288,6 +10478,8 @@ static const AVOption mov_options[] = {
         {.i64 = 0}, 0, 1, FLAGS },
     { "max_stts_delta", "treat offsets above this value as invalid", OFFSET(max_stts_delta), AV_OPT_TYPE_INT, {.i64 = UINT_MAX-48000*10 }, 0, UINT_MAX, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "interleaved_read", "Interleave packets from multiple tracks at demuxer level", OFFSET(interleaved_read), AV_OPT_TYPE_BOOL, {.i64 = 1 }, 0, 1, .flags = AV_OPT_FLAG_DECODING_PARAM },
+    { "compact_index", "Keep the sample index in a compact representation", OFFSET(compact_index), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, .flags = AV_OPT_FLAG_DECODING_PARAM },
+    { "lazy_index", "Build the sample index incrementally while reading packets", OFFSET(lazy_index), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, .flags = AV_OPT_FLAG_DECODING_PARAM },
 
     { NULL },
 };
@@ -72,6 +72,11 @@
 #include "vpcc.h"
 #include "vvc.h"
 
+/* alignment of the media data after a reserved moov atom */
+#define MOV_RESERVE_ALIGN 4096
+/* granularity of the growth of a reserved moov atom which is too small */
+#define MOV_SHIFT_ALIGN   (1 << 20)
+
 static const AVOption options[] = {
     { "brand",    "Override major brand", offsetof(MOVMuxContext, major_brand),   AV_OPT_TYPE_STRING, {.str = NULL}, .flags = AV_OPT_FLAG_ENCODING_PARAM },
     { "empty_hdlr_name", "write zero-length name string in hdlr atoms within mdia and minf atoms", offsetof(MOVMuxContext, empty_hdlr_name), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
@@ -114,6 +119,7 @@ static const AVOption options[] = {
     { "mov_gamma", "gamma value for gama atom", offsetof(MOVMuxContext, gamma), AV_OPT_TYPE_FLOAT, {.dbl = 0.0 }, 0.0, 10, AV_OPT_FLAG_ENCODING_PARAM},
     { "movie_timescale", "set movie timescale", offsetof(MOVMuxContext, movie_timescale), AV_OPT_TYPE_INT, {.i64 = MOV_TIMESCALE}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
     FF_RTP_FLAG_OPTS(MOVMuxContext, rtp_flags),
+    { "reserve_moov", "Reserve space for the moov atom at the beginning of the file based on an estimate of its size", offsetof(MOVMuxContext, reserve_moov), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { "skip_iods", "Skip writing iods atom.", offsetof(MOVMuxContext, iods_skip), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { "use_editlist", "use edit list", offsetof(MOVMuxContext, use_editlist), AV_OPT_TYPE_BOOL, {.i64 = -1}, -1, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { "use_stream_ids_as_track_ids", "use stream ids as track ids", offsetof(MOVMuxContext, use_stream_ids_as_track_ids), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
@@ -7724,6 +7730,64 @@ static int mov_init(AVFormatContext *s)
     return 0;
 }
 
+/*
+ * Estimate the size of the moov atom from the duration and packet rate of
+ * the streams. The sample tables are assumed not to compress, i.e. one
+ * chunk per sample and variable durations and sizes. Return 0 if the
+ * duration of a stream cannot be estimated.
+ */
+static int64_t estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    /* mvhd, udta and metadata, and the tracks created for chapters,
+     * timecodes and hinting, which are not set up yet */
+    int64_t size = 16384 + 4096 * (mov->nb_tracks - mov->nb_streams);
+
+    for (int i = 0; i < mov->nb_streams; i++) {
+        MOVTrack *track = &mov->tracks[i];
+        AVStream *st = track->st;
+        AVRational rate;
+        int64_t duration = INT64_MAX;
+        int entry_size;
+
+        size += 4096 + track->par->extradata_size;
+        if (st->duration > 0)
+            duration = av_rescale_q(st->duration, st->time_base, AV_TIME_BASE_Q);
+        if (s->duration > 0)
+            duration = FFMIN(duration, s->duration);
+        if (duration == INT64_MAX)
+            return 0;
+
+        switch (track->par->codec_type) {
+        case AVMEDIA_TYPE_VIDEO:
+            rate = st->avg_frame_rate.num > 0 ? st->avg_frame_rate : st->r_frame_rate;
+            if (rate.num <= 0 || rate.den <= 0)
+                return 0;
+            /* stsz, co64, stts, ctts and stss */
+            entry_size = 4 + 8 + 8 + 8 + 4;
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            rate = (AVRational){ track->par->sample_rate,
+                                 track->par->frame_size > 0 ? track->par->frame_size : 1024 };
+            if (rate.num <= 0)
+                return 0;
+            /* stsz, co64 and stsc for every other chunk */
+            entry_size = 4 + 8 + 6;
+            break;
+        default:
+            rate       = (AVRational){ 1, 1 };
+            entry_size = 4 + 8 + 8;
+            break;
+        }
+        size += av_rescale(duration, (int64_t)rate.num * entry_size,
+                           (int64_t)rate.den * AV_TIME_BASE);
+        if (size > INT_MAX / 2)
+            return 0;
+    }
+
+    return size;
+}
+
 static int mov_write_header(AVFormatContext *s)
 {
     AVIOContext *pb = s->pb;
@@ -7804,6 +7868,24 @@ static int mov_write_header(AVFormatContext *s)
             return ret;
     }
 
+    if (mov->reserve_moov && mov->reserved_moov_size <= 0 &&
+        !(mov->flags & FF_MOV_FLAG_FRAGMENT) && mov->mode != MODE_AVIF) {
+        int64_t size = estimate_moov_size(s);
+        if (size > 0) {
+            /* Start the media data on a block boundary, so that the file
+             * system can move it without copying if the space is short. */
+            mov->reserved_moov_size = FFALIGN(avio_tell(pb) + size, MOV_RESERVE_ALIGN) - avio_tell(pb);
+            mov->flags &= ~FF_MOV_FLAG_FASTSTART;
+            av_log(s, AV_LOG_VERBOSE, "Reserving %d bytes for the moov atom\n",
+                   mov->reserved_moov_size);
+        } else {
+            av_log(s, AV_LOG_VERBOSE, "Cannot estimate the moov atom size, "
+                   "falling back to faststart\n");
+            mov->reserved_moov_size = -1;
+            mov->flags |= FF_MOV_FLAG_FASTSTART;
+        }
+    }
+
     if (mov->reserved_moov_size){
         mov->reserved_header_pos = avio_tell(pb);
         if (mov->reserved_moov_size > 0)
@@ -7937,6 +8019,47 @@ static int compute_moov_size(AVFormatContext *s)
     return moov_size2;
 }
 
+/*
+ * Make sure the space reserved for the moov atom, and a free atom after it,
+ * is large enough by moving the data following it if necessary. The data
+ * is moved by a multiple of MOV_SHIFT_ALIGN to keep it aligned, and to
+ * move it in large pieces. Return the amount of bytes it was moved by.
+ */
+static int grow_reserved_moov(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int64_t shift = 0;
+    int moov_size, ret;
+
+    for (;;) {
+        int64_t missing;
+
+        moov_size = get_moov_size(s);
+        if (moov_size < 0)
+            return moov_size;
+        missing = moov_size + 8LL - mov->reserved_moov_size - shift;
+        if (missing <= 0)
+            break;
+        missing = FFALIGN(missing, MOV_SHIFT_ALIGN);
+        if (missing > INT_MAX - mov->reserved_moov_size - shift)
+            return AVERROR(ERANGE);
+        for (int i = 0; i < mov->nb_tracks; i++)
+            mov->tracks[i].data_offset += missing;
+        shift += missing;
+    }
+    if (!shift)
+        return 0;
+
+    av_log(s, AV_LOG_INFO, "Reserved space for the moov atom is too small, "
+           "moving the media data by %"PRId64" bytes\n", shift);
+    ret = ff_format_shift_data(s, mov->reserved_header_pos + mov->reserved_moov_size, shift);
+    if (ret < 0)
+        return ret;
+    mov->reserved_moov_size += shift;
+
+    return shift;
+}
+
 static int compute_sidx_size(AVFormatContext *s)
 {
     int i, sidx_size;
@@ -8036,6 +8159,13 @@ static int mov_write_trailer(AVFormatContext *s)
             ffio_wfourcc(pb, "mdat");
             avio_wb64(pb, mov->mdat_size + 16);
         }
+        if (mov->reserve_moov && mov->reserved_moov_size > 0) {
+            avio_seek(pb, moov_pos, SEEK_SET);
+            res = grow_reserved_moov(s);
+            if (res < 0)
+                return res;
+            moov_pos += res;
+        }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
         if (mov->flags & FF_MOV_FLAG_FASTSTART) {
@@ -221,6 +221,7 @@ typedef struct MOVMuxContext {
 
     int reserved_moov_size; ///< 0 for disabled, -1 for automatic, size otherwise
     int64_t reserved_header_pos;
+    int reserve_moov;       ///< estimate reserved_moov_size, grow it if needed
 
     char *major_brand;
 
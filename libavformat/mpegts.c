@@ -179,6 +179,13 @@ struct MpegTSContext {
     MpegTSFilter *pids[NB_PID_MAX];
     int current_pid;
 
+    /** 1 for the pids which are only part of programs with AVDISCARD_ALL */
+    uint8_t discard_map[NB_PID_MAX];
+    /** discard value of every AVProgram when discard_map was built */
+    enum AVDiscard *prg_discard;
+    int nb_prg_discard;
+    int discard_map_valid;
+
     AVStream *epg_stream;
     AVBufferPool* pools[32];
 };
@@ -371,6 +378,42 @@ static void update_av_program_info(AVFormatContext *s, unsigned int programid,
     }
 }
 
+static void update_discard_map(MpegTSContext *ts)
+{
+    AVFormatContext *s = ts->stream;
+    enum AVDiscard *prg_discard;
+    int i, j, k, discarded = 0;
+
+    prg_discard = av_realloc_array(ts->prg_discard, FFMAX(s->nb_programs, 1),
+                                   sizeof(*prg_discard));
+    if (!prg_discard)
+        return;
+    ts->prg_discard    = prg_discard;
+    ts->nb_prg_discard = s->nb_programs;
+    for (k = 0; k < s->nb_programs; k++) {
+        prg_discard[k] = s->programs[k]->discard;
+        discarded     |= prg_discard[k] == AVDISCARD_ALL;
+    }
+
+    /* bit 0: part of a discarded program, bit 1: part of a used program */
+    memset(ts->discard_map, 0, sizeof(ts->discard_map));
+    if (discarded) {
+        for (i = 0; i < ts->nb_prg; i++) {
+            const struct Program *p = &ts->prg[i];
+            for (k = 0; k < s->nb_programs; k++) {
+                if (s->programs[k]->id != p->id)
+                    continue;
+                for (j = 0; j < p->nb_pids; j++)
+                    ts->discard_map[p->pids[j]] |= prg_discard[k] == AVDISCARD_ALL ? 1 : 2;
+            }
+        }
+        for (i = 0; i < NB_PID_MAX; i++)
+            ts->discard_map[i] = ts->discard_map[i] == 1;
+        ts->discard_map[PAT_PID] = 0;
+    }
+    ts->discard_map_valid = 1;
+}
+
 /**
  * @brief discard_pid() decides if the pid is to be discarded according
  *                      to caller's programs selection
@@ -381,39 +424,26 @@ static void update_av_program_info(AVFormatContext *s, unsigned int programid,
  */
 static int discard_pid(MpegTSContext *ts, unsigned int pid)
 {
-    int i, j, k;
-    int used = 0, discarded = 0;
-    struct Program *p;
-
-    if (pid == PAT_PID)
-        return 0;
-
-    /* If none of the programs have .discard=AVDISCARD_ALL then there's
-     * no way we have to discard this packet */
-    for (k = 0; k < ts->stream->nb_programs; k++)
-        if (ts->stream->programs[k]->discard == AVDISCARD_ALL)
-            break;
-    if (k == ts->stream->nb_programs)
-        return 0;
+    AVFormatContext *s = ts->stream;
+    int k;
 
-    for (i = 0; i < ts->nb_prg; i++) {
-        p = &ts->prg[i];
-        for (j = 0; j < p->nb_pids; j++) {
-            if (p->pids[j] != pid)
-                continue;
-            // is program with id p->id set to be discarded?
-            for (k = 0; k < ts->stream->nb_programs; k++) {
-                if (ts->stream->programs[k]->id == p->id) {
-                    if (ts->stream->programs[k]->discard == AVDISCARD_ALL)
-                        discarded++;
-                    else
-                        used++;
-                }
-            }
-        }
+    /* the map is invalidated when the PAT or a PMT changes, and the
+     * caller can change the discard value of the programs at any time */
+    if (ts->discard_map_valid && ts->nb_prg_discard == s->nb_programs) {
+        for (k = 0; k < s->nb_programs; k++)
+            if (s->programs[k]->discard != ts->prg_discard[k])
+                break;
+        if (k < s->nb_programs)
+            ts->discard_map_valid = 0;
+    } else
+        ts->discard_map_valid = 0;
+
+    if (!ts->discard_map_valid) {
+        update_discard_map(ts);
+        if (!ts->discard_map_valid)
+            return 0;
     }
-
-    return !used && discarded;
+    return ts->discard_map[pid];
 }
 
 /**
@@ -2364,6 +2394,7 @@ static void pmt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
         return;
     if (!ts->skip_clear)
         clear_avprogram(ts, h->id);
+    ts->discard_map_valid = 0;
     clear_program(prg);
     add_pid_to_program(prg, ts->current_pid);
 
@@ -2560,6 +2591,7 @@ static void pat_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
     if (skip_identical(h, tssf))
         return;
     ts->id = h->id;
+    ts->discard_map_valid = 0;
 
     for (;;) {
         sid = get16(&p, p_end);
@@ -2915,7 +2947,15 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
         c = avio_r8(pb);
         if (avio_feof(pb))
             return AVERROR_EOF;
-        if (c == 0x47) {
+        if (c != 0x47) {
+            /* look for the sync byte in the rest of the buffer at once */
+            int len = FFMIN(pb->buf_end - pb->buf_ptr, ts->resync_size - i - 1);
+            const uint8_t *sync = memchr(pb->buf_ptr, 0x47, len);
+            if (sync)
+                len = sync - pb->buf_ptr;
+            avio_skip(pb, len);
+            i += len;
+        } else {
             int new_packet_size, ret;
             avio_seek(pb, -1, SEEK_CUR);
             pos = avio_tell(pb);
@@ -2963,6 +3003,43 @@ static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size,
     return 0;
 }
 
+/**
+ * Skip the packets at the current position which handle_packet() would
+ * ignore, i.e. those of pids without filter and of discarded programs,
+ * as long as they are in the I/O buffer. This avoids reading and parsing
+ * them one by one, so that the unselected programs of a multi program
+ * transport stream cost next to nothing.
+ *
+ * @return number of packets skipped
+ */
+static int skip_ignored_packets(MpegTSContext *ts, int max_packets)
+{
+    AVIOContext *pb = ts->stream->pb;
+    const uint8_t *p = pb->buf_ptr;
+    int nb_packets = 0;
+
+    while (nb_packets < max_packets &&
+           pb->buf_end - p >= ts->raw_packet_size &&
+           p[0] == 0x47) {
+        int pid      = AV_RB16(p + 1) & 0x1fff;
+        int is_start = p[1] & 0x40;
+        MpegTSFilter *tss = ts->pids[pid];
+
+        if (tss) {
+            if (is_start)
+                tss->discard = discard_pid(ts, pid);
+            if (!tss->discard)
+                break;
+        } else if (ts->auto_guess && is_start)
+            break;
+        p += ts->raw_packet_size;
+        nb_packets++;
+    }
+    if (nb_packets)
+        avio_skip(pb, p - pb->buf_ptr);
+    return nb_packets;
+}
+
 static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
 {
     AVIOContext *pb = s->pb;
@@ -2977,7 +3054,7 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
     uint8_t packet[TS_PACKET_SIZE + AV_INPUT_BUFFER_PADDING_SIZE];
     const uint8_t *data;
     int64_t packet_num;
-    int ret = 0;
+    int ret = 0, skipped;
 
     if (avio_tell(s->pb) != ts->last_pos) {
         int i;
@@ -3012,6 +3089,13 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        skipped = skip_ignored_packets(ts, nb_packets ? FFMIN(nb_packets - packet_num, INT_MAX)
+                                                      : INT_MAX);
+        if (skipped) {
+            packet_num += skipped - 1;
+            continue;
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
@@ -3287,6 +3371,7 @@ static void mpegts_free(MpegTSContext *ts)
     int i;
 
     clear_programs(ts);
+    av_freep(&ts->prg_discard);
 
     for (i = 0; i < FF_ARRAY_ELEMS(ts->pools); i++)
         av_buffer_pool_uninit(&ts->pools[i]);
@@ -182,6 +182,17 @@ static int validate_codec_tag(const AVFormatContext *s, const AVStream *st)
     return 1;
 }
 
+/**
+ * Whether max_interleave_delta may force output while no packet
+ * of a stream with these parameters is buffered.
+ */
+static int interleave_skippable(const AVCodecParameters *par)
+{
+    return par->codec_type != AVMEDIA_TYPE_ATTACHMENT &&
+           par->codec_id != AV_CODEC_ID_VP8 &&
+           par->codec_id != AV_CODEC_ID_VP9 &&
+           par->codec_id != AV_CODEC_ID_SMPTE_2038;
+}
 
 static int init_muxer(AVFormatContext *s, AVDictionary **options)
 {
@@ -347,6 +358,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
         if (par->codec_type != AVMEDIA_TYPE_ATTACHMENT &&
             par->codec_id != AV_CODEC_ID_SMPTE_2038)
             si->nb_interleaved_streams++;
+        if (interleave_skippable(par))
+            si->nb_skippable_streams++;
     }
     si->interleave_packet = of->interleave_packet;
     if (!si->interleave_packet)
@@ -653,6 +666,24 @@ static void guess_pkt_duration(AVFormatContext *s, AVStream *st, AVPacket *pkt)
     }
 }
 
+static void lowest_queued_ts(AVFormatContext *s, const PacketListEntry *pktl,
+                             int use_pts, int64_t *ts, AVRational *tb)
+{
+    for (; pktl; pktl = pktl->next) {
+        AVRational cmp_tb = s->streams[pktl->pkt.stream_index]->time_base;
+        int64_t cmp_ts = use_pts ? pktl->pkt.pts : pktl->pkt.dts;
+        if (cmp_ts == AV_NOPTS_VALUE)
+            continue;
+        cmp_ts -= ffstream(s->streams[pktl->pkt.stream_index])->lowest_ts_allowed;
+        if (s->output_ts_offset)
+            cmp_ts += av_rescale_q(s->output_ts_offset, AV_TIME_BASE_Q, cmp_tb);
+        if (av_compare_ts(cmp_ts, cmp_tb, *ts, *tb) < 0) {
+            *ts = cmp_ts;
+            *tb = cmp_tb;
+        }
+    }
+}
+
 static void handle_avoid_negative_ts(FFFormatContext *si, FFStream *sti,
                                      AVPacket *pkt)
 {
@@ -674,20 +705,10 @@ static void handle_avoid_negative_ts(FFFormatContext *si, FFStream *sti,
 
         /* Peek into the muxing queue to improve our estimate
          * of the lowest timestamp if av_interleaved_write_frame() is used. */
-        for (const PacketListEntry *pktl = si->packet_buffer.head;
-             pktl; pktl = pktl->next) {
-            AVRational cmp_tb = s->streams[pktl->pkt.stream_index]->time_base;
-            int64_t cmp_ts = use_pts ? pktl->pkt.pts : pktl->pkt.dts;
-            if (cmp_ts == AV_NOPTS_VALUE)
-                continue;
-            cmp_ts -= ffstream(s->streams[pktl->pkt.stream_index])->lowest_ts_allowed;
-            if (s->output_ts_offset)
-                cmp_ts += av_rescale_q(s->output_ts_offset, AV_TIME_BASE_Q, cmp_tb);
-            if (av_compare_ts(cmp_ts, cmp_tb, ts, tb) < 0) {
-                ts = cmp_ts;
-                tb = cmp_tb;
-            }
-        }
+        lowest_queued_ts(s, si->packet_buffer.head, use_pts, &ts, &tb);
+        for (int i = 0; i < si->nb_interleave_heap; i++)
+            lowest_queued_ts(s, si->interleave_heap[i]->interleave_queue.head,
+                             use_pts, &ts, &tb);
 
         if (ts < 0 ||
             ts > 0 && s->avoid_negative_ts == AVFMT_AVOID_NEG_TS_MAKE_ZERO) {
@@ -852,6 +873,31 @@ static int prepare_input_packet(AVFormatContext *s, AVStream *st, AVPacket *pkt)
 
 #define CHUNK_START 0x1000
 
+/**
+ * Update the chunking state of the stream of pkt and flag pkt
+ * if it starts a new chunk.
+ */
+static void interleave_chunk(AVFormatContext *s, AVStream *st, AVPacket *pkt)
+{
+    FFStream *const sti = ffstream(st);
+    uint64_t max= av_rescale_q_rnd(s->max_chunk_duration, AV_TIME_BASE_Q, st->time_base, AV_ROUND_UP);
+
+    sti->interleaver_chunk_size     += pkt->size;
+    sti->interleaver_chunk_duration += pkt->duration;
+    if (   (s->max_chunk_size && sti->interleaver_chunk_size > s->max_chunk_size)
+        || (max && sti->interleaver_chunk_duration           > max)) {
+        sti->interleaver_chunk_size = 0;
+        pkt->flags |= CHUNK_START;
+        if (max && sti->interleaver_chunk_duration > max) {
+            int64_t syncoffset = (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)*max/2;
+            int64_t syncto = av_rescale(pkt->dts + syncoffset, 1, max)*max - syncoffset;
+
+            sti->interleaver_chunk_duration += (pkt->dts - syncto)/8 - max;
+        } else
+            sti->interleaver_chunk_duration  = 0;
+    }
+}
+
 int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
                              int (*compare)(AVFormatContext *, const AVPacket *, const AVPacket *))
 {
@@ -882,23 +928,8 @@ int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
         next_point = &si->packet_buffer.head;
     }
 
-    if (chunked) {
-        uint64_t max= av_rescale_q_rnd(s->max_chunk_duration, AV_TIME_BASE_Q, st->time_base, AV_ROUND_UP);
-        sti->interleaver_chunk_size     += pkt->size;
-        sti->interleaver_chunk_duration += pkt->duration;
-        if (   (s->max_chunk_size && sti->interleaver_chunk_size > s->max_chunk_size)
-            || (max && sti->interleaver_chunk_duration           > max)) {
-            sti->interleaver_chunk_size = 0;
-            pkt->flags |= CHUNK_START;
-            if (max && sti->interleaver_chunk_duration > max) {
-                int64_t syncoffset = (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)*max/2;
-                int64_t syncto = av_rescale(pkt->dts + syncoffset, 1, max)*max - syncoffset;
-
-                sti->interleaver_chunk_duration += (pkt->dts - syncto)/8 - max;
-            } else
-                sti->interleaver_chunk_duration  = 0;
-        }
-    }
+    if (chunked)
+        interleave_chunk(s, st, pkt);
     if (*next_point) {
         if (chunked && !(pkt->flags & CHUNK_START))
             goto next_non_null;
@@ -926,6 +957,177 @@ next_non_null:
     return 0;
 }
 
+/*
+ * ff_interleave_packet_sorted() keeps the packets of every stream in a queue
+ * of their own and the streams with buffered packets in a binary heap ordered
+ * by the first packet of their queue. This yields the same order as inserting
+ * all packets into a single sorted list with ff_interleave_add_packet(), but
+ * only costs O(log(number of streams)) per packet. When interleaving in
+ * chunks, a packet that does not start a chunk is muxed right after the
+ * previous packet of its stream; if several streams are in this situation,
+ * the one in which it happened last goes first, like in the list.
+ */
+
+static int64_t interleave_dts(const AVPacket *pkt, const FFStream *sti)
+{
+    return av_rescale_q(pkt->dts, sti->pub.time_base, AV_TIME_BASE_Q);
+}
+
+/* Whether the next packet of a is to be muxed before the one of b. */
+static int interleave_heap_before(AVFormatContext *s,
+                                  const FFStream *a, const FFStream *b,
+                                  int (*compare)(AVFormatContext *, const AVPacket *, const AVPacket *))
+{
+    const AVPacket *pkt_a = &a->interleave_queue.head->pkt;
+    const AVPacket *pkt_b = &b->interleave_queue.head->pkt;
+
+    if (s->max_chunk_size || s->max_chunk_duration) {
+        int cont_a = !(pkt_a->flags & CHUNK_START);
+        int cont_b = !(pkt_b->flags & CHUNK_START);
+        if (cont_a || cont_b)
+            return cont_a && (!cont_b || a->interleave_run > b->interleave_run);
+    }
+    return compare(s, pkt_b, pkt_a);
+}
+
+static void interleave_heap_set(FFFormatContext *si, int i, FFStream *sti)
+{
+    si->interleave_heap[i]     = sti;
+    sti->interleave_heap_index = i;
+}
+
+static void interleave_heap_up(AVFormatContext *s, int i,
+                               int (*compare)(AVFormatContext *, const AVPacket *, const AVPacket *))
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    FFStream *const sti = si->interleave_heap[i];
+
+    while (i > 0) {
+        int parent = (i - 1) >> 1;
+        if (!interleave_heap_before(s, sti, si->interleave_heap[parent], compare))
+            break;
+        interleave_heap_set(si, i, si->interleave_heap[parent]);
+        i = parent;
+    }
+    interleave_heap_set(si, i, sti);
+}
+
+static void interleave_heap_down(AVFormatContext *s, int i,
+                                 int (*compare)(AVFormatContext *, const AVPacket *, const AVPacket *))
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    FFStream *const sti = si->interleave_heap[i];
+
+    while (2 * i + 1 < si->nb_interleave_heap) {
+        int child = 2 * i + 1;
+        if (child + 1 < si->nb_interleave_heap &&
+            interleave_heap_before(s, si->interleave_heap[child + 1],
+                                   si->interleave_heap[child], compare))
+            child++;
+        if (!interleave_heap_before(s, si->interleave_heap[child], sti, compare))
+            break;
+        interleave_heap_set(si, i, si->interleave_heap[child]);
+        i = child;
+    }
+    interleave_heap_set(si, i, sti);
+}
+
+static int interleave_queue_add(AVFormatContext *s, AVPacket *pkt,
+                                int (*compare)(AVFormatContext *, const AVPacket *, const AVPacket *))
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    AVStream *const st = s->streams[pkt->stream_index];
+    FFStream *const sti = ffstream(st);
+    const PacketListEntry *const last = sti->interleave_queue.tail;
+    int64_t dts;
+    int ret;
+
+    if (!last && si->nb_interleave_heap * sizeof(*si->interleave_heap) >= si->interleave_heap_size) {
+        FFStream **heap = av_fast_realloc(si->interleave_heap, &si->interleave_heap_size,
+                                          (si->nb_interleave_heap + 1) * sizeof(*heap));
+        if (!heap) {
+            av_packet_unref(pkt);
+            return AVERROR(ENOMEM);
+        }
+        si->interleave_heap = heap;
+    }
+
+    if (s->max_chunk_size || s->max_chunk_duration)
+        interleave_chunk(s, st, pkt);
+
+    ret = avpriv_packet_list_put(&sti->interleave_queue, pkt, NULL, 0);
+    if (ret < 0) {
+        av_packet_unref(pkt);
+        return ret;
+    }
+    pkt = &sti->interleave_queue.tail->pkt;
+
+    if (st->codecpar->codec_type != AVMEDIA_TYPE_SUBTITLE &&
+        si->interleave_max_dts_valid) {
+        dts = interleave_dts(pkt, sti);
+        if (last && dts < si->interleave_max_dts &&
+            interleave_dts(&last->pkt, sti) == si->interleave_max_dts)
+            si->interleave_max_dts_valid = 0;
+        else
+            si->interleave_max_dts = FFMAX(si->interleave_max_dts, dts);
+    }
+
+    if (!last) {
+        if (!(pkt->flags & CHUNK_START))
+            sti->interleave_run = ++si->interleave_run;
+        si->nb_skippable_buffered += interleave_skippable(st->codecpar);
+        interleave_heap_set(si, si->nb_interleave_heap++, sti);
+        interleave_heap_up(s, si->nb_interleave_heap - 1, compare);
+    }
+
+    return 0;
+}
+
+/* Remove the next packet to be muxed from the interleaving queues. */
+static void interleave_queue_get(AVFormatContext *s, AVPacket *pkt,
+                                 int (*compare)(AVFormatContext *, const AVPacket *, const AVPacket *))
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    FFStream *const sti = si->interleave_heap[0];
+    const AVStream *const st = &sti->pub;
+
+    avpriv_packet_list_get(&sti->interleave_queue, pkt);
+
+    if (sti->interleave_queue.head) {
+        if (!(sti->interleave_queue.head->pkt.flags & CHUNK_START))
+            sti->interleave_run = ++si->interleave_run;
+        interleave_heap_down(s, 0, compare);
+        return;
+    }
+
+    if (st->codecpar->codec_type != AVMEDIA_TYPE_SUBTITLE &&
+        interleave_dts(pkt, sti) == si->interleave_max_dts)
+        si->interleave_max_dts_valid = 0;
+    si->nb_skippable_buffered -= interleave_skippable(st->codecpar);
+    if (--si->nb_interleave_heap) {
+        interleave_heap_set(si, 0, si->interleave_heap[si->nb_interleave_heap]);
+        interleave_heap_down(s, 0, compare);
+    }
+}
+
+static int64_t interleave_max_dts(AVFormatContext *s)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+
+    if (!si->interleave_max_dts_valid) {
+        si->interleave_max_dts = INT64_MIN;
+        for (int i = 0; i < si->nb_interleave_heap; i++) {
+            const FFStream *const sti = si->interleave_heap[i];
+            if (sti->pub.codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE)
+                continue;
+            si->interleave_max_dts = FFMAX(si->interleave_max_dts,
+                                           interleave_dts(&sti->interleave_queue.tail->pkt, sti));
+        }
+        si->interleave_max_dts_valid = 1;
+    }
+    return si->interleave_max_dts;
+}
+
 static int interleave_compare_dts(AVFormatContext *s, const AVPacket *next,
                                                       const AVPacket *pkt)
 {
@@ -956,63 +1158,36 @@ static int interleave_compare_dts(AVFormatContext *s, const AVPacket *next,
     return comp > 0;
 }
 
-int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *pkt,
-                                 int flush, int has_packet)
+int ff_interleave_packet_sorted(AVFormatContext *s, AVPacket *pkt,
+                                int flush, int has_packet,
+                                int (*compare)(AVFormatContext *, const AVPacket *, const AVPacket *))
 {
     FFFormatContext *const si = ffformatcontext(s);
-    int stream_count = 0;
-    int noninterleaved_count = 0;
+    int stream_count, noninterleaved_count;
     int ret;
     int eof = flush;
 
     if (has_packet) {
-        if ((ret = ff_interleave_add_packet(s, pkt, interleave_compare_dts)) < 0)
+        if ((ret = interleave_queue_add(s, pkt, compare)) < 0)
             return ret;
     }
 
-    for (unsigned i = 0; i < s->nb_streams; i++) {
-        const AVStream *const st  = s->streams[i];
-        const FFStream *const sti = cffstream(st);
-        const AVCodecParameters *const par = st->codecpar;
-        if (sti->last_in_packet_buffer) {
-            ++stream_count;
-        } else if (par->codec_type != AVMEDIA_TYPE_ATTACHMENT &&
-                   par->codec_id != AV_CODEC_ID_VP8 &&
-                   par->codec_id != AV_CODEC_ID_VP9 &&
-                   par->codec_id != AV_CODEC_ID_SMPTE_2038) {
-            ++noninterleaved_count;
-        }
-    }
+    stream_count         = si->nb_interleave_heap;
+    noninterleaved_count = si->nb_skippable_streams - si->nb_skippable_buffered;
 
     if (si->nb_interleaved_streams == stream_count)
         flush = 1;
 
     if (s->max_interleave_delta > 0 &&
-        si->packet_buffer.head &&
-        si->packet_buffer.head->pkt.dts != AV_NOPTS_VALUE &&
+        stream_count &&
+        si->interleave_heap[0]->interleave_queue.head->pkt.dts != AV_NOPTS_VALUE &&
         !flush &&
         si->nb_interleaved_streams == stream_count+noninterleaved_count
     ) {
-        AVPacket *const top_pkt = &si->packet_buffer.head->pkt;
-        int64_t delta_dts = INT64_MIN;
-        int64_t top_dts = av_rescale_q(top_pkt->dts,
-                                       s->streams[top_pkt->stream_index]->time_base,
-                                       AV_TIME_BASE_Q);
-
-        for (unsigned i = 0; i < s->nb_streams; i++) {
-            const AVStream *const st  = s->streams[i];
-            const FFStream *const sti = cffstream(st);
-            const PacketListEntry *const last = sti->last_in_packet_buffer;
-            int64_t last_dts;
-
-            if (!last || st->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE)
-                continue;
-
-            last_dts = av_rescale_q(last->pkt.dts,
-                                    st->time_base,
-                                    AV_TIME_BASE_Q);
-            delta_dts = FFMAX(delta_dts, last_dts - top_dts);
-        }
+        const FFStream *const top_sti = si->interleave_heap[0];
+        int64_t top_dts = interleave_dts(&top_sti->interleave_queue.head->pkt, top_sti);
+        int64_t max_dts = interleave_max_dts(s);
+        int64_t delta_dts = max_dts == INT64_MIN ? INT64_MIN : max_dts - top_dts;
 
         if (delta_dts > s->max_interleave_delta) {
             av_log(s, AV_LOG_DEBUG,
@@ -1024,58 +1199,47 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *pkt,
     }
 
 #if FF_API_LAVF_SHORTEST
-    if (si->packet_buffer.head &&
+    if (stream_count &&
         eof &&
         (s->flags & AVFMT_FLAG_SHORTEST) &&
         si->shortest_end == AV_NOPTS_VALUE) {
-        AVPacket *const top_pkt = &si->packet_buffer.head->pkt;
+        const FFStream *const top_sti = si->interleave_heap[0];
 
-        si->shortest_end = av_rescale_q(top_pkt->dts,
-                                       s->streams[top_pkt->stream_index]->time_base,
-                                       AV_TIME_BASE_Q);
+        si->shortest_end = interleave_dts(&top_sti->interleave_queue.head->pkt,
+                                          top_sti);
     }
 
     if (si->shortest_end != AV_NOPTS_VALUE) {
-        while (si->packet_buffer.head) {
-            PacketListEntry *pktl = si->packet_buffer.head;
-            AVPacket *const top_pkt = &pktl->pkt;
-            AVStream *const st = s->streams[top_pkt->stream_index];
-            FFStream *const sti = ffstream(st);
-            int64_t top_dts = av_rescale_q(top_pkt->dts, st->time_base,
-                                        AV_TIME_BASE_Q);
+        while (si->nb_interleave_heap) {
+            const FFStream *const top_sti = si->interleave_heap[0];
+            int64_t top_dts = interleave_dts(&top_sti->interleave_queue.head->pkt,
+                                             top_sti);
 
             if (si->shortest_end + 1 >= top_dts)
                 break;
 
-            si->packet_buffer.head = pktl->next;
-            if (!si->packet_buffer.head)
-                si->packet_buffer.tail = NULL;
-
-            if (sti->last_in_packet_buffer == pktl)
-                sti->last_in_packet_buffer = NULL;
-
-            av_packet_unref(&pktl->pkt);
-            av_freep(&pktl);
+            interleave_queue_get(s, pkt, compare);
+            av_packet_unref(pkt);
             flush = 0;
         }
     }
 #endif
 
     if (stream_count && flush) {
-        PacketListEntry *pktl = si->packet_buffer.head;
-        AVStream *const st = s->streams[pktl->pkt.stream_index];
-        FFStream *const sti = ffstream(st);
-
-        if (sti->last_in_packet_buffer == pktl)
-            sti->last_in_packet_buffer = NULL;
-        avpriv_packet_list_get(&si->packet_buffer, pkt);
-
+        interleave_queue_get(s, pkt, compare);
         return 1;
     } else {
         return 0;
     }
 }
 
+int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *pkt,
+                                 int flush, int has_packet)
+{
+    return ff_interleave_packet_sorted(s, pkt, flush, has_packet,
+                                       interleave_compare_dts);
+}
+
 int ff_interleave_packet_passthrough(AVFormatContext *s, AVPacket *pkt,
                                      int flush, int has_packet)
 {
@@ -1101,7 +1265,11 @@ int ff_get_muxer_ts_offset(AVFormatContext *s, int stream_index, int64_t *offset
 const AVPacket *ff_interleaved_peek(AVFormatContext *s, int stream)
 {
     FFFormatContext *const si = ffformatcontext(s);
+    const FFStream *const sti = ffstream(s->streams[stream]);
     PacketListEntry *pktl = si->packet_buffer.head;
+
+    if (sti->interleave_queue.head)
+        return &sti->interleave_queue.head->pkt;
     while (pktl) {
         if (pktl->pkt.stream_index == stream) {
             return &pktl->pkt;
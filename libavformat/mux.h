@@ -177,6 +177,16 @@ static inline const FFOutputFormat *ffofmt(const AVOutputFormat *fmt)
 int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
                              int (*compare)(AVFormatContext *, const AVPacket *, const AVPacket *));
 
+/**
+ * Interleave packets in the order given by compare(), which has the same
+ * semantics as for ff_interleave_add_packet(). Packets of the same stream
+ * are always muxed in the order in which they are added.
+ * See the documentation of AVOutputFormat.interleave_packet for details.
+ */
+int ff_interleave_packet_sorted(AVFormatContext *s, AVPacket *pkt,
+                                int flush, int has_packet,
+                                int (*compare)(AVFormatContext *, const AVPacket *, const AVPacket *));
+
 /**
  * Interleave an AVPacket per dts so it can be muxed.
  * See the documentation of AVOutputFormat.interleave_packet for details.
@@ -243,7 +253,8 @@ enum AVWriteUncodedFrameFlags {
 /**
  * Make shift_size amount of space at read_start by shifting data in the output
  * at read_start until the current IO position. The underlying IO context must
- * be seekable.
+ * be seekable. Protocols which support it move the data without reading it
+ * back, see ffurl_copy_range().
  */
 int ff_format_shift_data(AVFormatContext *s, int64_t read_start, int shift_size);
 
@@ -21,14 +21,17 @@
 
 #include "libavutil/dict.h"
 #include "libavutil/dict_internal.h"
+#include "libavutil/error.h"
 #include "libavutil/internal.h"
 #include "libavutil/log.h"
 #include "libavutil/mem.h"
 #include "libavutil/parseutils.h"
 #include "avformat.h"
 #include "avio.h"
+#include "avio_internal.h"
 #include "internal.h"
 #include "mux.h"
+#include "url.h"
 
 int avformat_query_codec(const AVOutputFormat *ofmt, enum AVCodecID codec_id,
                          int std_compliance)
@@ -77,6 +80,27 @@ int ff_format_shift_data(AVFormatContext *s, int64_t read_start, int shift_size)
     int read_buf_id = 0;
     int read_size[2];
     AVIOContext *read_pb;
+    URLContext *h = ffio_geturlcontext(s->pb);
+
+    /* Let the protocol move the data by itself if it can, e.g. with
+     * in-kernel copies for local files. This has to be done in pieces
+     * of at most shift_size bytes, so small shifts are left to the
+     * buffered copy below. */
+    if (h && shift_size >= 256 * 1024) {
+        avio_flush(s->pb);
+        pos_end = avio_tell(s->pb);
+        ret = ffurl_copy_range(h, read_start + shift_size, read_start,
+                               pos_end - read_start);
+        if (ret != AVERROR(ENOSYS)) {
+            if (ret < 0) {
+                av_log(s, AV_LOG_ERROR, "Unable to shift data in %s: %s\n",
+                       s->url, av_err2str(ret));
+                return ret;
+            }
+            avio_seek(s->pb, pos_end + shift_size, SEEK_SET);
+            return 0;
+        }
+    }
 
     buf = av_malloc_array(shift_size, 2);
     if (!buf)
@@ -1111,6 +1111,13 @@ static int decode_frame(NUTContext *nut, AVPacket *pkt, int frame_code)
         return 1;
     }
 
+    if (!nut->header_len[header_idx] && !(stc->last_flags & FLAG_SM_DATA) && size > 0) {
+        ret = ff_get_packet_mapped(s->streams[stream_id], bc, pkt, size);
+        if (ret < 0)
+            return ret;
+        goto done;
+    }
+
     ret = av_new_packet(pkt, size + nut->header_len[header_idx]);
     if (ret < 0)
         return ret;
@@ -1138,6 +1145,7 @@ static int decode_frame(NUTContext *nut, AVPacket *pkt, int frame_code)
     }
     av_shrink_packet(pkt, nut->header_len[header_idx] + ret);
 
+done:
     pkt->stream_index = stream_id;
     if (stc->last_flags & FLAG_KEY)
         pkt->flags |= AV_PKT_FLAG_KEY;
@@ -21,6 +21,7 @@
 
 #include "libavutil/mathematics.h"
 #include "avformat.h"
+#include "demux.h"
 #include "internal.h"
 #include "pcm.h"
 
@@ -62,7 +63,7 @@ int ff_pcm_read_packet(AVFormatContext *s, AVPacket *pkt)
     if (size < 0)
         return size;
 
-    ret = av_get_packet(s->pb, pkt, size);
+    ret = ff_get_packet_mapped(s->streams[0], s->pb, pkt, size);
 
     pkt->flags &= ~AV_PKT_FLAG_CORRUPT;
     pkt->stream_index = 0;
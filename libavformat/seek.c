@@ -30,6 +30,7 @@
 
 #include "avformat.h"
 #include "avio_internal.h"
+#include "compactindex.h"
 #include "demux.h"
 #include "internal.h"
 
@@ -52,6 +53,9 @@ void ff_reduce_index(AVFormatContext *s, int stream_index)
     FFStream *const sti = ffstream(st);
     unsigned int max_entries = s->max_index_size / sizeof(AVIndexEntry);
 
+    if (sti->compact_index)
+        return;
+
     if ((unsigned) sti->nb_index_entries >= max_entries) {
         int i;
         for (i = 0; 2 * i < sti->nb_index_entries; i++)
@@ -118,18 +122,144 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
     return index;
 }
 
+int ff_index_compact(AVStream *st)
+{
+    FFStream *const sti = ffstream(st);
+    FFCompactIndex *ci;
+    int ret;
+
+    if (sti->compact_index)
+        return 0;
+
+    ci = ff_compact_index_alloc();
+    if (!ci)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < sti->nb_index_entries; i++) {
+        ret = ff_compact_index_append(ci, &sti->index_entries[i]);
+        if (ret < 0) {
+            ff_compact_index_free(&ci);
+            return ret;
+        }
+    }
+
+    av_freep(&sti->index_entries);
+    sti->index_entries_allocated_size = 0;
+    sti->nb_index_entries   = 0;
+    sti->compact_index      = ci;
+
+    return 0;
+}
+
+int ff_index_expand(AVStream *st)
+{
+    FFStream *const sti = ffstream(st);
+    FFCompactIndex *ci = sti->compact_index;
+    int nb_entries;
+    AVIndexEntry *entries;
+
+    if (!ci)
+        return 0;
+
+    nb_entries = ff_compact_index_nb_entries(ci);
+    entries    = av_malloc_array(nb_entries + 1, sizeof(*entries));
+    if (!entries)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < nb_entries; i++)
+        entries[i] = *ff_compact_index_get(ci, i);
+
+    ff_compact_index_free(&sti->compact_index);
+    sti->index_entries                = entries;
+    sti->nb_index_entries             = nb_entries;
+    sti->index_entries_allocated_size = (nb_entries + 1) * sizeof(*entries);
+
+    return 0;
+}
+
+static int compact_index_search_timestamp(FFCompactIndex *ci,
+                                          int64_t wanted_timestamp, int flags);
+
+static int compact_add_index_entry(FFStream *sti, int64_t pos,
+                                   int64_t timestamp, int size,
+                                   int distance, int flags)
+{
+    FFCompactIndex *ci = sti->compact_index;
+    int nb_entries = ff_compact_index_nb_entries(ci);
+    AVIndexEntry e = {
+        .pos          = pos,
+        .timestamp    = timestamp,
+        .flags        = flags,
+        .size         = size,
+        .min_distance = distance,
+    };
+    int index, ret;
+
+    if (timestamp == AV_NOPTS_VALUE || is_relative(timestamp) ||
+        size < 0 || size > 0x3FFFFFFF)
+        return AVERROR(EAGAIN);
+
+    ret = ff_compact_index_append(ci, &e);
+    if (ret >= 0)
+        return nb_entries;
+    if (ret != AVERROR(EINVAL))
+        return -1;
+
+    // Entries already present, e.g. added again during playback, do not
+    // require any change.
+    index = compact_index_search_timestamp(ci, timestamp, AVSEEK_FLAG_ANY);
+    if (index >= 0) {
+        const AVIndexEntry *ie = ff_compact_index_get(ci, index);
+        if (ie->timestamp == timestamp && ie->pos == pos &&
+            ie->size == size && ie->flags == flags &&
+            distance <= ie->min_distance)
+            return index;
+    }
+
+    return AVERROR(EAGAIN);
+}
+
 int av_add_index_entry(AVStream *st, int64_t pos, int64_t timestamp,
                        int size, int distance, int flags)
 {
     FFStream *const sti = ffstream(st);
     timestamp = ff_wrap_timestamp(st, timestamp);
+
+    if (sti->compact_index) {
+        int ret = compact_add_index_entry(sti, pos, timestamp, size,
+                                          distance, flags);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+        if (ff_index_expand(st) < 0)
+            return -1;
+    }
+
     return ff_add_index_entry(&sti->index_entries, &sti->nb_index_entries,
                               &sti->index_entries_allocated_size, pos,
                               timestamp, size, distance, flags);
 }
 
-int ff_index_search_timestamp(const AVIndexEntry *entries, int nb_entries,
-                              int64_t wanted_timestamp, int flags)
+static const AVIndexEntry *array_entry(void *index, int idx)
+{
+    return &((const AVIndexEntry *)index)[idx];
+}
+
+static const AVIndexEntry *compact_entry(void *index, int idx)
+{
+    return ff_compact_index_get(index, idx);
+}
+
+/**
+ * Binary search ignoring the keyframe flags.
+ *
+ * @return the index of the last entry with a timestamp not larger than
+ *         wanted_timestamp if AVSEEK_FLAG_BACKWARD is set, the index of the
+ *         first entry with a timestamp not smaller than it otherwise,
+ *         -1 or nb_entries if there is no such entry
+ */
+static av_always_inline int index_search_any(void *index, int nb_entries,
+                                             const AVIndexEntry *(*get_entry)(void *index, int idx),
+                                             int64_t wanted_timestamp, int flags)
 {
     int a, b, m;
     int64_t timestamp;
@@ -138,28 +268,36 @@ int ff_index_search_timestamp(const AVIndexEntry *entries, int nb_entries,
     b = nb_entries;
 
     // Optimize appending index entries at the end.
-    if (b && entries[b - 1].timestamp < wanted_timestamp)
+    if (b && get_entry(index, b - 1)->timestamp < wanted_timestamp)
         a = b - 1;
 
     while (b - a > 1) {
         m         = (a + b) >> 1;
 
         // Search for the next non-discarded packet.
-        while ((entries[m].flags & AVINDEX_DISCARD_FRAME) && m < b && m < nb_entries - 1) {
+        while ((get_entry(index, m)->flags & AVINDEX_DISCARD_FRAME) && m < b && m < nb_entries - 1) {
             m++;
-            if (m == b && entries[m].timestamp >= wanted_timestamp) {
+            if (m == b && get_entry(index, m)->timestamp >= wanted_timestamp) {
                 m = b - 1;
                 break;
             }
         }
 
-        timestamp = entries[m].timestamp;
+        timestamp = get_entry(index, m)->timestamp;
         if (timestamp >= wanted_timestamp)
             b = m;
         if (timestamp <= wanted_timestamp)
             a = m;
     }
-    m = (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+
+    return (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+}
+
+int ff_index_search_timestamp(const AVIndexEntry *entries, int nb_entries,
+                              int64_t wanted_timestamp, int flags)
+{
+    int m = index_search_any((void *)entries, nb_entries, array_entry,
+                             wanted_timestamp, flags);
 
     if (!(flags & AVSEEK_FLAG_ANY))
         while (m >= 0 && m < nb_entries &&
@@ -171,6 +309,21 @@ int ff_index_search_timestamp(const AVIndexEntry *entries, int nb_entries,
     return m;
 }
 
+static int compact_index_search_timestamp(FFCompactIndex *ci,
+                                          int64_t wanted_timestamp, int flags)
+{
+    int nb_entries = ff_compact_index_nb_entries(ci);
+    int m = index_search_any(ci, nb_entries, compact_entry,
+                             wanted_timestamp, flags);
+
+    if (!(flags & AVSEEK_FLAG_ANY) && m >= 0 && m < nb_entries)
+        m = ff_compact_index_find_keyframe(ci, m, flags & AVSEEK_FLAG_BACKWARD);
+
+    if (m == nb_entries)
+        return -1;
+    return m;
+}
+
 void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
 {
     int64_t pos_delta = 0;
@@ -192,24 +345,24 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
         return;
 
     for (unsigned ist1 = 0; ist1 < s->nb_streams; ist1++) {
-        AVStream *const st1  = s->streams[ist1];
-        FFStream *const sti1 = ffstream(st1);
+        AVStream *const st1 = s->streams[ist1];
+        int nb_entries1     = avformat_index_get_entries_count(st1);
         for (unsigned ist2 = 0; ist2 < s->nb_streams; ist2++) {
-            AVStream *const st2  = s->streams[ist2];
-            FFStream *const sti2 = ffstream(st2);
+            AVStream *const st2 = s->streams[ist2];
+            int nb_entries2     = avformat_index_get_entries_count(st2);
 
             if (ist1 == ist2)
                 continue;
 
-            for (int i1 = 0, i2 = 0; i1 < sti1->nb_index_entries; i1++) {
-                const AVIndexEntry *const e1 = &sti1->index_entries[i1];
+            for (int i1 = 0, i2 = 0; i1 < nb_entries1; i1++) {
+                const AVIndexEntry *const e1 = ff_index_get_entry(st1, i1);
                 int64_t e1_pts = av_rescale_q(e1->timestamp, st1->time_base, AV_TIME_BASE_Q);
 
                 if (e1->size < (1 << 23))
                     skip = FFMAX(skip, e1->size);
 
-                for (; i2 < sti2->nb_index_entries; i2++) {
-                    const AVIndexEntry *const e2 = &sti2->index_entries[i2];
+                for (; i2 < nb_entries2; i2++) {
+                    const AVIndexEntry *const e2 = ff_index_get_entry(st2, i2);
                     int64_t e2_pts = av_rescale_q(e2->timestamp, st2->time_base, AV_TIME_BASE_Q);
                     int64_t cur_delta;
                     if (e2_pts < e1_pts || e2_pts - (uint64_t)e1_pts < time_tolerance)
@@ -244,37 +397,47 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
 int av_index_search_timestamp(AVStream *st, int64_t wanted_timestamp, int flags)
 {
     const FFStream *const sti = ffstream(st);
+    if (sti->compact_index)
+        return compact_index_search_timestamp(sti->compact_index,
+                                              wanted_timestamp, flags);
     return ff_index_search_timestamp(sti->index_entries, sti->nb_index_entries,
                                      wanted_timestamp, flags);
 }
 
+AVIndexEntry *ff_index_get_entry(AVStream *st, int idx)
+{
+    FFStream *const sti = ffstream(st);
+    if (sti->compact_index)
+        return ff_compact_index_get(sti->compact_index, idx);
+    if (idx < 0 || idx >= sti->nb_index_entries)
+        return NULL;
+
+    return &sti->index_entries[idx];
+}
+
 int avformat_index_get_entries_count(const AVStream *st)
 {
-    return cffstream(st)->nb_index_entries;
+    const FFStream *const sti = cffstream(st);
+    if (sti->compact_index)
+        return ff_compact_index_nb_entries(sti->compact_index);
+    return sti->nb_index_entries;
 }
 
 const AVIndexEntry *avformat_index_get_entry(AVStream *st, int idx)
 {
-    const FFStream *const sti = ffstream(st);
-    if (idx < 0 || idx >= sti->nb_index_entries)
-        return NULL;
-
-    return &sti->index_entries[idx];
+    return ff_index_get_entry(st, idx);
 }
 
 const AVIndexEntry *avformat_index_get_entry_from_timestamp(AVStream *st,
                                                             int64_t wanted_timestamp,
                                                             int flags)
 {
-    const FFStream *const sti = ffstream(st);
-    int idx = ff_index_search_timestamp(sti->index_entries,
-                                        sti->nb_index_entries,
-                                        wanted_timestamp, flags);
+    int idx = av_index_search_timestamp(st, wanted_timestamp, flags);
 
     if (idx < 0)
         return NULL;
 
-    return &sti->index_entries[idx];
+    return ff_index_get_entry(st, idx);
 }
 
 static int64_t read_timestamp(AVFormatContext *s, int stream_index, int64_t *ppos, int64_t pos_limit,
@@ -295,7 +458,6 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
     int index;
     int64_t ret;
     AVStream *st;
-    FFStream *sti;
 
     if (stream_index < 0)
         return -1;
@@ -306,9 +468,8 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
     ts_min = AV_NOPTS_VALUE;
     pos_limit = -1; // GCC falsely says it may be uninitialized.
 
-    st  = s->streams[stream_index];
-    sti = ffstream(st);
-    if (sti->index_entries) {
+    st = s->streams[stream_index];
+    if (avformat_index_get_entries_count(st)) {
         const AVIndexEntry *e;
 
         /* FIXME: Whole function must be checked for non-keyframe entries in
@@ -316,7 +477,7 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
         index = av_index_search_timestamp(st, target_ts,
                                           flags | AVSEEK_FLAG_BACKWARD);
         index = FFMAX(index, 0);
-        e     = &sti->index_entries[index];
+        e     = ff_index_get_entry(st, index);
 
         if (e->timestamp <= target_ts || e->pos == e->min_distance) {
             pos_min = e->pos;
@@ -329,9 +490,9 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
 
         index = av_index_search_timestamp(st, target_ts,
                                           flags & ~AVSEEK_FLAG_BACKWARD);
-        av_assert0(index < sti->nb_index_entries);
+        av_assert0(index < avformat_index_get_entries_count(st));
         if (index >= 0) {
-            e = &sti->index_entries[index];
+            e = ff_index_get_entry(st, index);
             av_assert1(e->timestamp >= target_ts);
             pos_max   = e->pos;
             ts_max    = e->timestamp;
@@ -527,24 +688,24 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
 {
     FFFormatContext *const si = ffformatcontext(s);
     AVStream *const st  = s->streams[stream_index];
-    FFStream *const sti = ffstream(st);
+    int nb_index_entries = avformat_index_get_entries_count(st);
     const AVIndexEntry *ie;
     int index;
     int64_t ret;
 
     index = av_index_search_timestamp(st, timestamp, flags);
 
-    if (index < 0 && sti->nb_index_entries &&
-        timestamp < sti->index_entries[0].timestamp)
+    if (index < 0 && nb_index_entries &&
+        timestamp < ff_index_get_entry(st, 0)->timestamp)
         return -1;
 
-    if (index < 0 || index == sti->nb_index_entries - 1) {
+    if (index < 0 || index == nb_index_entries - 1) {
         AVPacket *const pkt = si->pkt;
         int nonkey = 0;
 
-        if (sti->nb_index_entries) {
-            av_assert0(sti->index_entries);
-            ie = &sti->index_entries[sti->nb_index_entries - 1];
+        if (nb_index_entries) {
+            ie = ff_index_get_entry(st, nb_index_entries - 1);
+            av_assert0(ie);
             if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
                 return ret;
             s->io_repositioned = 1;
@@ -584,7 +745,7 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
     if (ffifmt(s->iformat)->read_seek)
         if (ffifmt(s->iformat)->read_seek(s, stream_index, timestamp, flags) >= 0)
             return 0;
-    ie = &sti->index_entries[index];
+    ie = ff_index_get_entry(st, index);
     if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
         return ret;
     s->io_repositioned = 1;
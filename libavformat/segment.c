@@ -28,6 +28,7 @@
 
 #include <time.h>
 
+#include "async_writer.h"
 #include "avformat.h"
 #include "internal.h"
 #include "mux.h"
@@ -124,6 +125,9 @@ typedef struct SegmentContext {
     int use_rename;
     char temp_list_filename[1024];
 
+    int async_io;
+    FFAsyncWriter *writer; ///< background writer if async_io is set
+
     SegmentListEntry cur_entry;
     SegmentListEntry *segment_list_entries;
     SegmentListEntry *segment_list_entries_end;
@@ -229,6 +233,28 @@ static int set_segment_filename(AVFormatContext *s)
     return 0;
 }
 
+/* Open a segment or a rewritten list for writing, in the background if
+ * async_io is set, otherwise with the io_open callback of ctx. */
+static int seg_io_open(AVFormatContext *s, AVFormatContext *ctx,
+                       AVIOContext **pb, const char *url)
+{
+    SegmentContext *seg = s->priv_data;
+
+    if (seg->writer)
+        return ff_async_writer_open(seg->writer, pb, url, NULL);
+    return ctx->io_open(ctx, pb, url, AVIO_FLAG_WRITE, NULL);
+}
+
+static int seg_io_close(AVFormatContext *s, AVFormatContext *ctx,
+                        AVIOContext **pb)
+{
+    SegmentContext *seg = s->priv_data;
+
+    if (seg->writer)
+        return *pb ? ff_async_writer_close(seg->writer, pb) : 0;
+    return ff_format_io_close(ctx, pb);
+}
+
 static int segment_start(AVFormatContext *s, int write_header)
 {
     SegmentContext *seg = s->priv_data;
@@ -250,7 +276,7 @@ static int segment_start(AVFormatContext *s, int write_header)
     if ((err = set_segment_filename(s)) < 0)
         return err;
 
-    if ((err = s->io_open(s, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0) {
+    if ((err = seg_io_open(s, s, &oc->pb, oc->url)) < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->url);
         return err;
     }
@@ -280,7 +306,12 @@ static int segment_list_open(AVFormatContext *s)
     int ret;
 
     snprintf(seg->temp_list_filename, sizeof(seg->temp_list_filename), seg->use_rename ? "%s.tmp" : "%s", seg->list);
-    ret = s->io_open(s, &seg->list_pb, seg->temp_list_filename, AVIO_FLAG_WRITE, NULL);
+    /* only the lists that are rewritten after each segment are written in
+     * the background, the others are kept open */
+    if (seg->list_size || seg->list_type == LIST_TYPE_M3U8)
+        ret = seg_io_open(s, s, &seg->list_pb, seg->temp_list_filename);
+    else
+        ret = s->io_open(s, &seg->list_pb, seg->temp_list_filename, AVIO_FLAG_WRITE, NULL);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment list '%s'\n", seg->list);
         return ret;
@@ -309,6 +340,24 @@ static int segment_list_open(AVFormatContext *s)
     return ret;
 }
 
+static int segment_list_close(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    int ret;
+
+    if (!seg->writer) {
+        ff_format_io_close(s, &seg->list_pb);
+        if (seg->use_rename)
+            ff_rename(seg->temp_list_filename, seg->list, s);
+        return 0;
+    }
+
+    ret = ff_async_writer_close(seg->writer, &seg->list_pb);
+    if (ret >= 0 && seg->use_rename)
+        ret = ff_async_writer_rename(seg->writer, seg->temp_list_filename, seg->list);
+    return ret;
+}
+
 static void segment_list_print_entry(AVIOContext      *list_ioctx,
                                      ListType          list_type,
                                      const SegmentListEntry *list_entry,
@@ -367,6 +416,10 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
         av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
                oc->url);
 
+    /* close the segment before it is referenced by the list */
+    if ((err = seg_io_close(s, oc, &oc->pb)) < 0 && seg->writer && ret >= 0)
+        ret = err;
+
     if (seg->list) {
         if (seg->list_size || seg->list_type == LIST_TYPE_M3U8) {
             SegmentListEntry *entry = av_mallocz(sizeof(*entry));
@@ -398,10 +451,14 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
                 segment_list_print_entry(seg->list_pb, seg->list_type, entry, s);
             if (seg->list_type == LIST_TYPE_M3U8 && is_last)
                 avio_printf(seg->list_pb, "#EXT-X-ENDLIST\n");
-            ff_format_io_close(s, &seg->list_pb);
-            if (seg->use_rename)
-                ff_rename(seg->temp_list_filename, seg->list, s);
+            if ((err = segment_list_close(s)) < 0 && ret >= 0)
+                ret = err;
         } else {
+            /* the list is appended to directly, wait for the segment */
+            if (seg->writer && (err = ff_async_writer_flush(seg->writer)) < 0) {
+                ret = err;
+                goto end;
+            }
             segment_list_print_entry(seg->list_pb, seg->list_type, &seg->cur_entry, s);
             avio_flush(seg->list_pb);
         }
@@ -451,7 +508,7 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
     }
 
 end:
-    ff_format_io_close(oc, &oc->pb);
+    seg_io_close(s, oc, &oc->pb);
 
     return ret;
 }
@@ -647,6 +704,14 @@ static void seg_free(AVFormatContext *s)
     SegmentContext *seg = s->priv_data;
     SegmentListEntry *cur;
 
+    if (seg->writer) {
+        /* this also frees the files that were not closed */
+        ff_async_writer_free(&seg->writer);
+        if (seg->list_size || seg->list_type == LIST_TYPE_M3U8)
+            seg->list_pb = NULL;
+        if (seg->avf && !seg->is_nullctx)
+            seg->avf->pb = NULL;
+    }
     ff_format_io_close(s, &seg->list_pb);
     if (seg->avf) {
         if (seg->is_nullctx)
@@ -766,10 +831,15 @@ static int seg_init(AVFormatContext *s)
         return ret;
     oc = seg->avf;
 
+    if (seg->async_io) {
+        ret = ff_async_writer_alloc(&seg->writer, s, seg->async_io, 0);
+        if (ret < 0)
+            return ret;
+    }
+
     if (seg->write_header_trailer) {
-        if ((ret = s->io_open(s, &oc->pb,
-                              seg->header_filename ? seg->header_filename : oc->url,
-                              AVIO_FLAG_WRITE, NULL)) < 0) {
+        if ((ret = seg_io_open(s, s, &oc->pb,
+                               seg->header_filename ? seg->header_filename : oc->url)) < 0) {
             av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->url);
             return ret;
         }
@@ -832,12 +902,12 @@ static int seg_write_header(AVFormatContext *s)
     if (!seg->write_header_trailer || seg->header_filename) {
         if (seg->header_filename) {
             av_write_frame(oc, NULL);
-            ff_format_io_close(oc, &oc->pb);
+            seg_io_close(s, oc, &oc->pb);
         } else {
             close_null_ctxp(&oc->pb);
             seg->is_nullctx = 0;
         }
-        if ((ret = oc->io_open(oc, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0)
+        if ((ret = seg_io_open(s, oc, &oc->pb, oc->url)) < 0)
             return ret;
         if (!seg->individual_header_trailer)
             oc->pb->seekable = 0;
@@ -1009,6 +1079,8 @@ static int seg_write_trailer(struct AVFormatContext *s)
     } else {
         ret = segment_end(s, 1, 1);
     }
+    if (ret >= 0 && seg->writer)
+        ret = ff_async_writer_flush(seg->writer);
     return ret;
 }
 
@@ -1075,6 +1147,7 @@ static const AVOption options[] = {
     { "reset_timestamps", "reset timestamps at the beginning of each segment", OFFSET(reset_timestamps), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { "initial_offset", "set initial timestamp offset", OFFSET(initial_offset), AV_OPT_TYPE_DURATION, {.i64 = 0}, -INT64_MAX, INT64_MAX, E },
     { "write_empty_segments", "allow writing empty 'filler' segments", OFFSET(write_empty), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
+    { "async_io", "write up to this many files in the background, 0 to write them synchronously", OFFSET(async_io), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1024, E },
     { NULL },
 };
 
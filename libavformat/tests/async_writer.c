@@ -0,0 +1,140 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Queue files, renames and deletions with the background writer, using
+ * io_open callbacks that are slow for some files and fail for others,
+ * and print the operations in the order the writer performed them.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "libavformat/async_writer.h"
+#include "libavformat/avformat.h"
+#include "libavformat/avio.h"
+
+static int io_open(AVFormatContext *s, AVIOContext **pb, const char *url,
+                   int flags, AVDictionary **options)
+{
+    AVDictionaryEntry *e = options ? av_dict_get(*options, "delay", NULL, 0) : NULL;
+
+    if (e)
+        av_usleep(atoi(e->value));
+    if (!strncmp(url, "fail", 4)) {
+        printf("open %s: failed\n", url);
+        return AVERROR(EIO);
+    }
+    printf("open %s\n", url);
+    return avio_open_dyn_buf(pb);
+}
+
+static int io_close2(AVFormatContext *s, AVIOContext *pb)
+{
+    uint8_t *data;
+    int size = avio_close_dyn_buf(pb, &data);
+
+    printf("close: %d bytes '%.*s'\n", size, size, data);
+    av_free(data);
+    return 0;
+}
+
+static int write_file(FFAsyncWriter *w, const char *url, int delay)
+{
+    AVDictionary *options = NULL;
+    AVIOContext *pb;
+    int ret;
+
+    if (delay)
+        av_dict_set_int(&options, "delay", delay, 0);
+    ret = ff_async_writer_open(w, &pb, url, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+        return ret;
+    avio_printf(pb, "data of %s", url);
+    return ff_async_writer_close(w, &pb);
+}
+
+static void test(AVFormatContext *s, const char *name, int max_pending,
+                 int ignore_errors)
+{
+    FFAsyncWriter *w;
+    AVIOContext *pb;
+    int ret;
+
+    printf("%s:\n", name);
+    ret = ff_async_writer_alloc(&w, s, max_pending, ignore_errors);
+    if (ret < 0) {
+        printf("alloc: %s\n", av_err2str(ret));
+        return;
+    }
+
+    /* a file left open is discarded */
+    ret = ff_async_writer_open(w, &pb, "discarded", NULL);
+    if (ret >= 0)
+        avio_printf(pb, "never written");
+
+    for (int i = 0; i < 4 && ret >= 0; i++) {
+        char url[32];
+
+        snprintf(url, sizeof(url), "segment%d", i);
+        /* the writes must still complete in order when the first are slow */
+        ret = write_file(w, url, (4 - i) * 5000);
+        if (ret >= 0 && i == 1)
+            ret = write_file(w, "fail", 0);
+        if (ret >= 0)
+            ret = write_file(w, "playlist", 0);
+    }
+    if (ret >= 0)
+        ret = ff_async_writer_delete(w, "async_writer-nonexistent");
+    if (ret >= 0)
+        ret = ff_async_writer_rename(w, "async_writer-nonexistent",
+                                     "async_writer-nonexistent2");
+    if (ret >= 0)
+        ret = write_file(w, "last", 0);
+    if (ret < 0)
+        printf("queueing: %s\n", av_err2str(ret));
+
+    ret = ff_async_writer_flush(w);
+    printf("flush: %s\n", ret < 0 ? av_err2str(ret) : "ok");
+    ff_async_writer_free(&w);
+}
+
+int main(void)
+{
+    AVFormatContext *s = avformat_alloc_context();
+
+    if (!s)
+        return 1;
+    s->io_open   = io_open;
+    s->io_close2 = io_close2;
+
+    av_log_set_level(AV_LOG_QUIET);
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    test(s, "stop at the first error", 2, 0);
+    test(s, "ignore errors", 1, 1);
+    test(s, "large queue", 64, 1);
+
+    avformat_free_context(s);
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Send datagrams over the loopback interface with the various batching
+ * modes of the UDP protocol and check that they are received unchanged
+ * and in order. Offloads that are not supported by the system fall back
+ * to plain batching, so the output does not depend on them.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+
+#include "libavformat/url.h"
+
+#define ROUNDS      16
+#define ROUND_SIZE  128
+#define MAX_SIZE    1316
+
+static int datagram_size(int n)
+{
+    /* mostly full TS datagrams, with some shorter ones */
+    return n % 11 == 10 ? 188 * (1 + n % 6) : MAX_SIZE;
+}
+
+static void fill_datagram(uint8_t *buf, int n, int size)
+{
+    AV_WB32(buf, n);
+    for (int i = 4; i < size; i++)
+        buf[i] = n + i;
+}
+
+static int test(const char *in_opts, const char *out_opts)
+{
+    URLContext *in = NULL, *out = NULL;
+    uint8_t buf[MAX_SIZE + 1], ref[MAX_SIZE];
+    char url[256];
+    int ret, received = 0;
+
+    snprintf(url, sizeof(url), "udp://:0?localaddr=127.0.0.1&timeout=2000000&%s", in_opts);
+    ret = ffurl_open_whitelist(&in, url, AVIO_FLAG_READ,
+                               NULL, NULL, NULL, NULL, NULL);
+    if (ret < 0)
+        goto end;
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d?pkt_size=%d&%s",
+             ff_udp_get_local_port(in), MAX_SIZE, out_opts);
+    ret = ffurl_open_whitelist(&out, url, AVIO_FLAG_WRITE,
+                               NULL, NULL, NULL, NULL, NULL);
+    if (ret < 0)
+        goto end;
+
+    /* send in rounds to stay below the socket receive buffer size */
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < ROUND_SIZE; i++) {
+            int n = round * ROUND_SIZE + i;
+            fill_datagram(ref, n, datagram_size(n));
+            ret = ffurl_write(out, ref, datagram_size(n));
+            if (ret < 0)
+                goto end;
+        }
+        for (int i = 0; i < ROUND_SIZE; i++, received++) {
+            int size = datagram_size(received);
+            ret = ffurl_read(in, buf, sizeof(buf));
+            if (ret < 0)
+                goto end;
+            fill_datagram(ref, received, size);
+            if (ret != size || memcmp(buf, ref, size)) {
+                printf("datagram %d: got %d bytes (#%d), expected %d bytes\n",
+                       received, ret, ret >= 4 ? (int)AV_RB32(buf) : -1, size);
+                ret = AVERROR_INVALIDDATA;
+                goto end;
+            }
+        }
+    }
+    ret = 0;
+
+end:
+    printf("receiver %s, sender %s: ", in_opts, out_opts);
+    if (ret < 0)
+        printf("error after %d datagrams: %s\n", received, av_err2str(ret));
+    else
+        printf("%d datagrams\n", received);
+    ffurl_closep(&out);
+    ffurl_closep(&in);
+    return ret;
+}
+
+int main(void)
+{
+    static const char *const modes[][2] = {
+        { "batch=1",                     "batch=1"        },
+        { "batch=16",                    "batch=16"       },
+        { "batch=64&gro=1&timestamps=1", "batch=64&gso=1" },
+        { "fifo_size=0",                 "batch=8&gso=1"  },
+        /* paced sender thread */
+        { "batch=8", "batch=32&gso=1&bitrate=1000000000&fifo_size=8192" },
+    };
+    int ret = 0;
+
+    av_log_set_level(AV_LOG_ERROR);
+    for (int i = 0; i < FF_ARRAY_ELEMS(modes); i++)
+        if (test(modes[i][0], modes[i][1]) < 0)
+            ret = 1;
+    return ret;
+}
@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() with glibc */
 
 #include "avformat.h"
 #include "libavutil/avassert.h"
@@ -59,6 +60,10 @@
 #define IPPROTO_UDPLITE                                  136
 #endif
 
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+#include <netinet/udp.h>
+#endif
+
 #if HAVE_W32THREADS
 #undef HAVE_PTHREAD_CANCEL
 #define HAVE_PTHREAD_CANCEL 1
@@ -77,6 +82,27 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_MAX_BATCH 64
+/* UDP segmentation offload limits: the whole message must fit in an
+ * IP packet, and the kernel accepts at most 64 segments */
+#define UDP_MAX_GSO_SIZE (65535 - 40 - UDP_HEADER_SIZE)
+#define UDP_MAX_GSO_SEGMENTS 64
+
+/**
+ * Datagrams received or sent with a single system call.
+ */
+typedef struct UDPBatch {
+    uint8_t *buf;                   ///< nb_slots buffers of slot_size bytes
+    int slot_size;
+    int nb_slots;
+    int nb;                         ///< number of datagrams in the batch
+    int sent;                       ///< number of datagrams already sent
+    const uint8_t *data[UDP_MAX_BATCH];
+    int len[UDP_MAX_BATCH];
+    int seg_size[UDP_MAX_BATCH];    ///< GRO segment size of received data, or 0
+    int64_t time[UDP_MAX_BATCH];    ///< kernel arrival time in ns, or 0
+    struct sockaddr_storage addr[UDP_MAX_BATCH];
+} UDPBatch;
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -101,6 +127,18 @@ typedef struct UDPContext {
     int64_t bitrate; /* number of bits to send per second */
     int64_t burst_bits;
     int close_req;
+    int batch;
+    int gso;
+    int gro;
+    int timestamps;
+    UDPBatch queue;
+    /* receive statistics */
+    int64_t rx_calls;
+    int64_t rx_datagrams;
+    int64_t rx_last_time;       ///< arrival time of the last datagram in ns
+    int64_t rx_last_interval;
+    int64_t rx_max_interval;
+    double  rx_jitter;          ///< smoothed interarrival interval variation in ns
 #if HAVE_PTHREAD_CANCEL
     pthread_t circular_buffer_thread;
     pthread_mutex_t mutex;
@@ -139,6 +177,10 @@ static const AVOption options[] = {
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "batch",          "Max number of datagrams per system call",         OFFSET(batch),          AV_OPT_TYPE_INT,    { .i64 = 1 },      1, UDP_MAX_BATCH, .flags = D|E },
+    { "gso",            "Use UDP segmentation offload for batches",        OFFSET(gso),            AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       E },
+    { "gro",            "Use UDP receive offload (only with fifo)",        OFFSET(gro),            AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       D },
+    { "timestamps",     "Measure the interarrival jitter (only with fifo)", OFFSET(timestamps),    AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       D },
     { NULL }
 };
 
@@ -406,6 +448,165 @@ static int udp_port(struct sockaddr_storage *addr, int addr_len)
 }
 
 
+static int udp_batch_alloc(UDPBatch *b, int nb_slots, int slot_size)
+{
+    b->buf = av_malloc_array(nb_slots, slot_size);
+    if (!b->buf)
+        return AVERROR(ENOMEM);
+    b->nb_slots  = nb_slots;
+    b->slot_size = slot_size;
+    b->nb = b->sent = 0;
+    return 0;
+}
+
+static uint8_t *udp_batch_slot(UDPBatch *b, int i)
+{
+    return b->buf + (size_t)i * b->slot_size;
+}
+
+/**
+ * Send the datagrams of the batch which have not been sent yet, with as
+ * few system calls as possible. With GSO, consecutive datagrams of the
+ * same size (the last one may be shorter) are sent as a single message.
+ *
+ * @return 0 if everything was sent, a negative error code otherwise; the
+ *         datagrams that could not be sent are kept in the batch
+ */
+static int udp_send_batch(UDPContext *s, UDPBatch *b)
+{
+    int ret = 0;
+#if HAVE_SENDMMSG
+    struct mmsghdr msgs[UDP_MAX_BATCH];
+    struct iovec iov[UDP_MAX_BATCH];
+    union {
+        struct cmsghdr align;
+        uint8_t buf[CMSG_SPACE(sizeof(uint16_t))];
+    } control[UDP_MAX_BATCH];
+    int first[UDP_MAX_BATCH + 1];
+    int nb_msgs = 0, done = 0;
+
+    for (int i = b->sent; i < b->nb;) {
+        struct msghdr *msg = &msgs[nb_msgs].msg_hdr;
+        int j = i + 1;
+
+        iov[i] = (struct iovec){ (void *)b->data[i], b->len[i] };
+#ifdef UDP_SEGMENT
+        if (s->gso && b->len[i] > 0) {
+            int total = b->len[i];
+            while (j < b->nb && j - i < UDP_MAX_GSO_SEGMENTS &&
+                   b->len[j] > 0 && b->len[j] <= b->len[i] &&
+                   total + b->len[j] <= UDP_MAX_GSO_SIZE) {
+                iov[j] = (struct iovec){ (void *)b->data[j], b->len[j] };
+                total += b->len[j];
+                /* only the last segment may be shorter */
+                if (b->len[j++] < b->len[i])
+                    break;
+            }
+        }
+#endif
+        *msg = (struct msghdr){
+            .msg_name    = s->is_connected ? NULL : &s->dest_addr,
+            .msg_namelen = s->is_connected ? 0    : s->dest_addr_len,
+            .msg_iov     = &iov[i],
+            .msg_iovlen  = j - i,
+        };
+#ifdef UDP_SEGMENT
+        if (j - i > 1) {
+            struct cmsghdr *cmsg;
+            uint16_t seg_size = b->len[i];
+
+            msg->msg_control    = control[nb_msgs].buf;
+            msg->msg_controllen = sizeof(control[nb_msgs].buf);
+            cmsg = CMSG_FIRSTHDR(msg);
+            cmsg->cmsg_level = IPPROTO_UDP;
+            cmsg->cmsg_type  = UDP_SEGMENT;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(seg_size));
+            memcpy(CMSG_DATA(cmsg), &seg_size, sizeof(seg_size));
+        }
+#endif
+        first[nb_msgs++] = i;
+        i = j;
+    }
+    first[nb_msgs] = b->nb;
+
+    while (done < nb_msgs) {
+        int n = sendmmsg(s->udp_fd, msgs + done, nb_msgs - done, 0);
+        if (n < 0) {
+            ret = ff_neterrno();
+            if (ret == AVERROR(EINTR)) {
+                ret = 0;
+                continue;
+            }
+            /* like a failed send(), drop the message causing the error */
+            if (ret != AVERROR(EAGAIN))
+                done++;
+            break;
+        }
+        done += n;
+    }
+    b->sent = first[done];
+#else
+    while (b->sent < b->nb) {
+        const uint8_t *data = b->data[b->sent];
+        int len = b->len[b->sent];
+
+        if (!s->is_connected) {
+            ret = sendto (s->udp_fd, data, len, 0,
+                          (struct sockaddr *) &s->dest_addr,
+                          s->dest_addr_len);
+        } else
+            ret = send(s->udp_fd, data, len, 0);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret == AVERROR(EINTR))
+                continue;
+            if (ret != AVERROR(EAGAIN))
+                b->sent++;
+            break;
+        }
+        ret = 0;
+        b->sent++;
+    }
+#endif
+    if (b->sent == b->nb)
+        b->nb = b->sent = 0;
+    return ret;
+}
+
+/**
+ * Send the datagrams queued by udp_write().
+ */
+static int udp_flush_queue(UDPContext *s, int nonblock)
+{
+    int ret;
+
+    while (s->queue.nb) {
+        if (!nonblock) {
+            ret = ff_network_wait_fd(s->udp_fd, 1);
+            if (ret < 0)
+                return ret;
+        }
+        ret = udp_send_batch(s, &s->queue);
+        if (ret < 0 && (ret != AVERROR(EAGAIN) || nonblock))
+            return ret;
+    }
+    return 0;
+}
+
+static void udp_set_gso(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+    int val;
+    socklen_t len = sizeof(val);
+
+    if (getsockopt(s->udp_fd, IPPROTO_UDP, UDP_SEGMENT, &val, &len) >= 0)
+        return;
+#endif
+    av_log(h, AV_LOG_WARNING, "UDP segmentation offload is not supported\n");
+    s->gso = 0;
+}
+
 /**
  * If no filename is given to av_open_input_file because you want to
  * get the local port first, then you must call this function to set
@@ -426,9 +627,13 @@ int ff_udp_set_remote_url(URLContext *h, const char *uri)
 {
     UDPContext *s = h->priv_data;
     char hostname[256], buf[10];
-    int port;
+    int port, ret;
     const char *p;
 
+    /* datagrams queued for batching go to the previous destination */
+    if ((ret = udp_flush_queue(s, h->flags & AVIO_FLAG_NONBLOCK)) < 0)
+        return ret;
+
     av_url_split(NULL, 0, NULL, 0, hostname, sizeof(hostname), &port, NULL, 0, uri);
 
     /* set the destination address */
@@ -479,6 +684,111 @@ static int udp_get_file_handle(URLContext *h)
 }
 
 #if HAVE_PTHREAD_CANCEL
+static void udp_set_rx_options(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int gro = 0;
+#if HAVE_RECVMMSG
+    int one = 1;
+
+#ifdef UDP_GRO
+    if (s->gro)
+        gro = setsockopt(s->udp_fd, IPPROTO_UDP, UDP_GRO, &one, sizeof(one)) >= 0;
+#endif
+#ifdef SO_TIMESTAMPNS
+    /* without kernel timestamps, the time of the system call is used */
+    if (s->timestamps &&
+        setsockopt(s->udp_fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) < 0)
+        ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(SO_TIMESTAMPNS)");
+#endif
+#endif
+    if (s->gro && !gro) {
+        av_log(h, AV_LOG_WARNING, "UDP receive offload is not supported\n");
+        s->gro = 0;
+    }
+}
+
+/**
+ * Receive up to nb_slots datagrams, waiting until at least one is available.
+ *
+ * @return the number of datagrams received or a negative error code
+ */
+static int udp_recv_batch(UDPContext *s, UDPBatch *b)
+{
+#if HAVE_RECVMMSG
+    struct mmsghdr msgs[UDP_MAX_BATCH];
+    struct iovec iov[UDP_MAX_BATCH];
+    union {
+        struct cmsghdr align;
+        uint8_t buf[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(struct timespec))];
+    } control[UDP_MAX_BATCH];
+    int n;
+
+    for (int i = 0; i < b->nb_slots; i++) {
+        iov[i] = (struct iovec){ udp_batch_slot(b, i), b->slot_size };
+        msgs[i].msg_hdr = (struct msghdr){
+            .msg_name       = &b->addr[i],
+            .msg_namelen    = sizeof(b->addr[i]),
+            .msg_iov        = &iov[i],
+            .msg_iovlen     = 1,
+            .msg_control    = control[i].buf,
+            .msg_controllen = sizeof(control[i].buf),
+        };
+    }
+    n = recvmmsg(s->udp_fd, msgs, b->nb_slots, MSG_WAITFORONE, NULL);
+    if (n < 0)
+        return ff_neterrno();
+
+    for (int i = 0; i < n; i++) {
+        struct msghdr *msg = &msgs[i].msg_hdr;
+
+        b->data[i]     = udp_batch_slot(b, i);
+        b->len[i]      = msgs[i].msg_len;
+        b->seg_size[i] = 0;
+        b->time[i]     = 0;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+#ifdef UDP_GRO
+            if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO)
+                memcpy(&b->seg_size[i], CMSG_DATA(cmsg), sizeof(int));
+#endif
+#ifdef SCM_TIMESTAMPNS
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec ts;
+                memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                b->time[i] = ts.tv_sec * INT64_C(1000000000) + ts.tv_nsec;
+            }
+#endif
+        }
+    }
+#else
+    socklen_t addr_len = sizeof(b->addr[0]);
+    int n = recvfrom(s->udp_fd, b->buf, b->slot_size, 0,
+                     (struct sockaddr *)&b->addr[0], &addr_len);
+    if (n < 0)
+        return ff_neterrno();
+    b->data[0]     = b->buf;
+    b->len[0]      = n;
+    b->seg_size[0] = 0;
+    b->time[0]     = 0;
+    n = 1;
+#endif
+    b->nb = n;
+    return n;
+}
+
+static void udp_update_jitter(UDPContext *s, int64_t time)
+{
+    if (s->rx_last_time) {
+        int64_t interval = time - s->rx_last_time;
+        /* interarrival jitter estimate as in RFC 3550 */
+        if (s->rx_last_interval >= 0)
+            s->rx_jitter += (FFABS(interval - s->rx_last_interval) - s->rx_jitter) / 16;
+        s->rx_last_interval = interval;
+        s->rx_max_interval  = FFMAX(s->rx_max_interval, interval);
+    }
+    s->rx_last_time = time;
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -495,44 +805,66 @@ static void *circular_buffer_task_rx( void *_URLContext)
         goto end;
     }
     while(1) {
-        int len;
-        struct sockaddr_storage addr;
-        socklen_t addr_len = sizeof(addr);
+        UDPBatch *b = &s->queue;
+        int64_t now = 0;
+        int n;
 
         pthread_mutex_unlock(&s->mutex);
         /* Blocking operations are always cancellation points;
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+        n = udp_recv_batch(s, b);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
+        if (s->timestamps)
+            now = av_gettime() * 1000;
         pthread_mutex_lock(&s->mutex);
-        if (len < 0) {
-            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = ff_neterrno();
+        if (n < 0) {
+            if (n != AVERROR(EAGAIN) && n != AVERROR(EINTR)) {
+                s->circular_buffer_error = n;
                 goto end;
             }
             continue;
         }
-        if (ff_ip_check_source_lists(&addr, &s->filters))
-            continue;
-        AV_WL32(s->tmp, len);
+        s->rx_calls++;
+
+        for (int i = 0; i < n; i++) {
+            const uint8_t *data = b->data[i];
+            int left     = b->len[i];
+            int seg_size = b->seg_size[i] > 0 ? b->seg_size[i] : left;
 
-        if (av_fifo_can_write(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
+            if (ff_ip_check_source_lists(&b->addr[i], &s->filters))
                 continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
-            }
+            if (s->timestamps)
+                udp_update_jitter(s, b->time[i] ? b->time[i] : now);
+
+            /* a message coalesced by GRO holds several datagrams */
+            do {
+                int len = FFMIN(left, seg_size);
+                uint8_t hdr[4];
+
+                data += len;
+                left -= len;
+                s->rx_datagrams++;
+                if (av_fifo_can_write(s->fifo) < len + 4) {
+                    /* No Space left */
+                    if (s->overrun_nonfatal) {
+                        av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                                "Surviving due to overrun_nonfatal option\n");
+                        continue;
+                    } else {
+                        av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                                "To avoid, increase fifo_size URL option. "
+                                "To survive in such case, use overrun_nonfatal option\n");
+                        s->circular_buffer_error = AVERROR(EIO);
+                        goto end;
+                    }
+                }
+                AV_WL32(hdr, len);
+                av_fifo_write(s->fifo, hdr, 4);
+                av_fifo_write(s->fifo, data - len, len);
+            } while (left > 0);
         }
-        av_fifo_write(s->fifo, s->tmp, len + 4);
         pthread_cond_signal(&s->cond);
     }
 
@@ -550,7 +882,7 @@ static void *circular_buffer_task_tx( void *_URLContext)
     int64_t start_timestamp = av_gettime_relative();
     int64_t sent_bits = 0;
     int64_t burst_interval = s->bitrate ? (s->burst_bits * 1000000 / s->bitrate) : 0;
-    int64_t max_delay = s->bitrate ?  ((int64_t)h->max_packet_size * 8 * 1000000 / s->bitrate + 1) : 0;
+    int64_t max_delay = s->bitrate ?  ((int64_t)h->max_packet_size * s->queue.nb_slots * 8 * 1000000 / s->bitrate + 1) : 0;
 
     ff_thread_setname("udp-tx");
 
@@ -563,8 +895,8 @@ static void *circular_buffer_task_tx( void *_URLContext)
     }
 
     for(;;) {
+        UDPBatch *b = &s->queue;
         int len;
-        const uint8_t *p;
         uint8_t tmp[4];
         int64_t timestamp;
 
@@ -577,13 +909,31 @@ static void *circular_buffer_task_tx( void *_URLContext)
             len = av_fifo_can_read(s->fifo);
         }
 
-        av_fifo_read(s->fifo, tmp, 4);
-        len = AV_RL32(tmp);
+        /* take as many datagrams as the batch can hold */
+        len = 0;
+        while (b->nb < b->nb_slots && av_fifo_can_read(s->fifo) >= 4) {
+            int size;
 
-        av_assert0(len >= 0);
-        av_assert0(len <= sizeof(s->tmp));
+            av_fifo_peek(s->fifo, tmp, 4, 0);
+            size = AV_RL32(tmp);
 
-        av_fifo_read(s->fifo, s->tmp, len);
+            av_assert0(size >= 0);
+            av_assert0(size <= sizeof(s->tmp));
+
+            if (size > b->slot_size) {
+                /* larger than pkt_size, sent on its own */
+                if (b->nb)
+                    break;
+                b->data[0] = s->tmp;
+            } else
+                b->data[b->nb] = udp_batch_slot(b, b->nb);
+            av_fifo_drain2(s->fifo, 4);
+            av_fifo_read(s->fifo, (uint8_t *)b->data[b->nb], size);
+            b->len[b->nb++] = size;
+            len += size;
+            if (b->data[0] == s->tmp)
+                break;
+        }
 
         pthread_mutex_unlock(&s->mutex);
 
@@ -607,27 +957,13 @@ static void *circular_buffer_task_tx( void *_URLContext)
             target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
-        p = s->tmp;
-        while (len) {
-            int ret;
-            av_assert0(len > 0);
-            if (!s->is_connected) {
-                ret = sendto (s->udp_fd, p, len, 0,
-                            (struct sockaddr *) &s->dest_addr,
-                            s->dest_addr_len);
-            } else
-                ret = send(s->udp_fd, p, len, 0);
-            if (ret >= 0) {
-                len -= ret;
-                p   += ret;
-            } else {
-                ret = ff_neterrno();
-                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
-                    pthread_mutex_lock(&s->mutex);
-                    s->circular_buffer_error = ret;
-                    pthread_mutex_unlock(&s->mutex);
-                    return NULL;
-                }
+        while (b->nb) {
+            int ret = udp_send_batch(s, b);
+            if (ret < 0 && ret != AVERROR(EAGAIN)) {
+                pthread_mutex_lock(&s->mutex);
+                s->circular_buffer_error = ret;
+                pthread_mutex_unlock(&s->mutex);
+                return NULL;
             }
         }
 
@@ -755,6 +1091,14 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             s->timeout = strtol(buf, NULL, 10);
         if (is_output && av_find_info_tag(buf, sizeof(buf), "broadcast", p))
             s->is_broadcast = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "batch", p))
+            s->batch = av_clip(strtol(buf, NULL, 10), 1, UDP_MAX_BATCH);
+        if (is_output && av_find_info_tag(buf, sizeof(buf), "gso", p))
+            s->gso = strtol(buf, NULL, 10);
+        if (!is_output && av_find_info_tag(buf, sizeof(buf), "gro", p))
+            s->gro = strtol(buf, NULL, 10);
+        if (!is_output && av_find_info_tag(buf, sizeof(buf), "timestamps", p))
+            s->timestamps = strtol(buf, NULL, 10);
     }
     /* handling needed to support options picking from both AVOption and URL */
     s->circular_buffer_size *= 188;
@@ -921,6 +1265,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     s->udp_fd = udp_fd;
 
+    if (is_output && s->gso)
+        udp_set_gso(h);
+
 #if HAVE_PTHREAD_CANCEL
     /*
       Create thread in case of:
@@ -940,6 +1287,15 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             ret = AVERROR(ENOMEM);
             goto fail;
         }
+        ret = udp_batch_alloc(&s->queue, s->batch, is_output ?
+                              av_clip(h->max_packet_size, 1, UDP_MAX_PKT_SIZE) :
+                              UDP_MAX_PKT_SIZE);
+        if (ret < 0)
+            goto fail;
+        if (!is_output) {
+            s->rx_last_interval = -1;
+            udp_set_rx_options(h);
+        }
         ret = pthread_mutex_init(&s->mutex, NULL);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", strerror(ret));
@@ -962,6 +1318,14 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     }
 #endif
 
+    /* without the thread, udp_write() queues the datagrams itself */
+    if (is_output && !s->fifo && s->batch > 1) {
+        ret = udp_batch_alloc(&s->queue, s->batch,
+                              av_clip(h->max_packet_size, 1, UDP_MAX_PKT_SIZE));
+        if (ret < 0)
+            goto fail;
+    }
+
     return 0;
 #if HAVE_PTHREAD_CANCEL
  thread_fail:
@@ -973,6 +1337,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep2(&s->fifo);
+    av_freep(&s->queue.buf);
     ff_ip_reset_filters(&s->filters);
     return ret;
 }
@@ -1085,6 +1450,32 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
         return size;
     }
 #endif
+    if (s->queue.buf && size <= s->queue.slot_size) {
+        UDPBatch *b = &s->queue;
+        uint8_t *slot;
+
+        if (b->nb == b->nb_slots) {
+            ret = udp_flush_queue(s, h->flags & AVIO_FLAG_NONBLOCK);
+            if (ret < 0)
+                return ret;
+        }
+        slot = udp_batch_slot(b, b->nb);
+        memcpy(slot, buf, size);
+        b->data[b->nb]  = slot;
+        b->len[b->nb++] = size;
+        /* errors are reported for the datagram completing the batch */
+        if (b->nb == b->nb_slots) {
+            ret = udp_flush_queue(s, h->flags & AVIO_FLAG_NONBLOCK);
+            if (ret < 0 && ret != AVERROR(EAGAIN))
+                return ret;
+        }
+        return size;
+    }
+    /* keep the datagrams in order */
+    ret = udp_flush_queue(s, h->flags & AVIO_FLAG_NONBLOCK);
+    if (ret < 0)
+        return ret;
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 1);
         if (ret < 0)
@@ -1104,6 +1495,10 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
 static int udp_close(URLContext *h)
 {
     UDPContext *s = h->priv_data;
+    int err;
+
+    if (!s->fifo && (err = udp_flush_queue(s, 0)) < 0)
+        av_log(h, AV_LOG_ERROR, "Failed to send the queued datagrams: %s\n", av_err2str(err));
 
 #if HAVE_PTHREAD_CANCEL
     // Request close once writing is finished
@@ -1140,8 +1535,15 @@ static int udp_close(URLContext *h)
         pthread_cond_destroy(&s->cond);
     }
 #endif
+    if (s->rx_calls)
+        av_log(h, AV_LOG_VERBOSE, "%"PRId64" datagrams received in %"PRId64" system calls\n",
+               s->rx_datagrams, s->rx_calls);
+    if (s->timestamps && s->rx_calls && s->rx_last_interval >= 0)
+        av_log(h, AV_LOG_VERBOSE, "Interarrival jitter %.1f us, longest interval %.1f us\n",
+               s->rx_jitter / 1000, s->rx_max_interval / 1000.0);
     closesocket(s->udp_fd);
     av_fifo_freep2(&s->fifo);
+    av_freep(&s->queue.buf);
     ff_ip_reset_filters(&s->filters);
     return 0;
 }
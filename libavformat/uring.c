@@ -0,0 +1,655 @@
+/*
+ * io_uring based file protocol
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Local file access through io_uring.
+ *
+ * Reads are served from a small queue of blocks. As long as the caller reads
+ * sequentially, up to queue_depth blocks are kept in flight ahead of the
+ * current position; a read elsewhere drops the queue and starts over with a
+ * single block. Writes are copied into a free block and submitted without
+ * waiting for them to complete, optionally followed by an fsync every
+ * fsync_interval bytes.
+ *
+ * The ring is driven through the raw system calls, so no external library is
+ * needed. If it cannot be set up, plain read()/write() are used instead.
+ *
+ * Requests are tied to the task that submitted them, and the kernel fails
+ * those still queued with EFAULT or ECANCELED when that thread exits, which
+ * callers like ffmpeg do after handing the context to another thread. The
+ * ring is therefore created with a kernel submission thread where possible,
+ * which lives as long as the ring itself.
+ */
+
+/* needed for syscall() and MAP_POPULATE */
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/file_open.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "avio.h"
+#include "os_support.h"
+#include "url.h"
+
+#define FSYNC_USER_DATA UINT64_MAX
+#define SQ_THREAD_IDLE  10      ///< ms the submission thread polls before sleeping
+
+enum UringBufferState {
+    BUF_FREE,
+    BUF_PENDING,
+    BUF_DONE,
+};
+
+typedef struct UringBuffer {
+    uint8_t *data;
+    int64_t pos;        ///< file offset of data[0]
+    int size;           ///< read: result of the request, write: bytes to write
+    int done;           ///< write: bytes already written
+    int retried;
+    enum UringBufferState state;
+} UringBuffer;
+
+typedef struct UringContext {
+    const AVClass *class;
+    int fd;
+    int trunc;
+    int queue_depth;
+    int block_size;
+    int64_t fsync_interval;
+
+    int ring_fd;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size, sqes_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array, *sq_flags;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    int sqpoll;
+
+    UringBuffer *bufs;
+    int nb_inflight;
+    int write;
+
+    int64_t pos;        ///< logical position of the caller
+    int64_t next_read;  ///< file offset of the next readahead block
+    int sequential;     ///< the last read continued where the one before ended
+    int64_t last_end;
+
+    int64_t unsynced;   ///< bytes written since the last fsync was queued
+    int sync_pending;
+    int sync_retried;
+    int error;          ///< first error returned by an asynchronous write
+} UringContext;
+
+static int uring_setup(UringContext *c)
+{
+    struct io_uring_params p = {
+        .flags          = IORING_SETUP_SQPOLL,
+        .sq_thread_idle = SQ_THREAD_IDLE,
+    };
+    int ret;
+
+    c->ring_fd = syscall(__NR_io_uring_setup, c->queue_depth + 1, &p);
+    if (c->ring_fd < 0) {
+        /* unprivileged SQPOLL rings need Linux 5.11 */
+        memset(&p, 0, sizeof(p));
+        c->ring_fd = syscall(__NR_io_uring_setup, c->queue_depth + 1, &p);
+    }
+    if (c->ring_fd < 0)
+        return AVERROR(errno);
+    c->sqpoll = !!(p.flags & IORING_SETUP_SQPOLL);
+
+    /* IORING_OP_READ/WRITE were added in the same release */
+    if (!(p.features & IORING_FEAT_RW_CUR_POS))
+        return AVERROR(ENOSYS);
+
+    c->sq_size   = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    c->cq_size   = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    c->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        c->sq_size = c->cq_size = FFMAX(c->sq_size, c->cq_size);
+
+    c->sq_ptr = mmap(NULL, c->sq_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, c->ring_fd, IORING_OFF_SQ_RING);
+    if (c->sq_ptr == MAP_FAILED)
+        goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        c->cq_ptr = c->sq_ptr;
+    } else {
+        c->cq_ptr = mmap(NULL, c->cq_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, c->ring_fd, IORING_OFF_CQ_RING);
+        if (c->cq_ptr == MAP_FAILED)
+            goto fail;
+    }
+    c->sqes = mmap(NULL, c->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, c->ring_fd, IORING_OFF_SQES);
+    if (c->sqes == MAP_FAILED)
+        goto fail;
+
+    c->sq_head  = (unsigned *)((uint8_t *)c->sq_ptr + p.sq_off.head);
+    c->sq_tail  = (unsigned *)((uint8_t *)c->sq_ptr + p.sq_off.tail);
+    c->sq_mask  = (unsigned *)((uint8_t *)c->sq_ptr + p.sq_off.ring_mask);
+    c->sq_array = (unsigned *)((uint8_t *)c->sq_ptr + p.sq_off.array);
+    c->sq_flags = (unsigned *)((uint8_t *)c->sq_ptr + p.sq_off.flags);
+    c->cq_head  = (unsigned *)((uint8_t *)c->cq_ptr + p.cq_off.head);
+    c->cq_tail  = (unsigned *)((uint8_t *)c->cq_ptr + p.cq_off.tail);
+    c->cq_mask  = (unsigned *)((uint8_t *)c->cq_ptr + p.cq_off.ring_mask);
+    c->cqes     = (struct io_uring_cqe *)((uint8_t *)c->cq_ptr + p.cq_off.cqes);
+
+    return 0;
+fail:
+    ret = AVERROR(errno);
+    if (c->sq_ptr == MAP_FAILED)
+        c->sq_ptr = NULL;
+    if (c->cq_ptr == MAP_FAILED)
+        c->cq_ptr = NULL;
+    if (c->sqes == MAP_FAILED)
+        c->sqes = NULL;
+    return ret;
+}
+
+static void uring_teardown(UringContext *c)
+{
+    if (c->sqes)
+        munmap(c->sqes, c->sqes_size);
+    if (c->cq_ptr && c->cq_ptr != c->sq_ptr)
+        munmap(c->cq_ptr, c->cq_size);
+    if (c->sq_ptr)
+        munmap(c->sq_ptr, c->sq_size);
+    c->sqes   = NULL;
+    c->sq_ptr = c->cq_ptr = NULL;
+    if (c->ring_fd >= 0)
+        close(c->ring_fd);
+    c->ring_fd = -1;
+}
+
+static int uring_enter(UringContext *c, unsigned to_submit, unsigned min_complete)
+{
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+
+    if (c->sqpoll) {
+        /* the new tail must be visible before the flags are checked */
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit((_Atomic unsigned *)c->sq_flags,
+                                 memory_order_relaxed) & IORING_SQ_NEED_WAKEUP)
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        else if (!min_complete)
+            return 0;
+    }
+
+    do {
+        ret = syscall(__NR_io_uring_enter, c->ring_fd, to_submit,
+                      min_complete, flags, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+
+    return ret < 0 ? AVERROR(errno) : 0;
+}
+
+/* The ring never holds more than queue_depth + 1 requests, which is its
+ * size, so there is always a free submission entry. */
+static int submit(UringContext *c, int opcode, unsigned flags,
+                  uint64_t user_data, void *data, unsigned len, int64_t offset)
+{
+    unsigned tail = *c->sq_tail;
+    unsigned idx  = tail & *c->sq_mask;
+    struct io_uring_sqe *sqe = &c->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = opcode;
+    sqe->flags     = flags;
+    sqe->fd        = c->fd;
+    sqe->off       = offset;
+    sqe->addr      = (uintptr_t)data;
+    sqe->len       = len;
+    sqe->user_data = user_data;
+    c->sq_array[idx] = idx;
+    atomic_store_explicit((_Atomic unsigned *)c->sq_tail, tail + 1,
+                          memory_order_release);
+
+    c->nb_inflight++;
+    return uring_enter(c, 1, 0);
+}
+
+static int submit_buffer(UringContext *c, int idx)
+{
+    UringBuffer *b = &c->bufs[idx];
+
+    b->state = BUF_PENDING;
+    if (c->write)
+        return submit(c, IORING_OP_WRITE, 0, idx, b->data + b->done,
+                      b->size - b->done, b->pos + b->done);
+    return submit(c, IORING_OP_READ, 0, idx, b->data, c->block_size, b->pos);
+}
+
+/* Without a submission thread, requests that the kernel cancelled because
+ * the thread that submitted them exited are queued once more from the thread
+ * that sees the completion. Any other error, EFAULT included, is reported. */
+static int submitter_exited(int res, int *retried)
+{
+    if (res != -ECANCELED || *retried)
+        return 0;
+    *retried = 1;
+    return 1;
+}
+
+static int submit_fsync(UringContext *c)
+{
+    /* IOSQE_IO_DRAIN orders the fsync after all writes queued before it */
+    int ret = submit(c, IORING_OP_FSYNC, IOSQE_IO_DRAIN, FSYNC_USER_DATA, NULL, 0, 0);
+    c->sync_pending = ret >= 0;
+    return ret;
+}
+
+static int reap(UringContext *c)
+{
+    unsigned head = *c->cq_head;
+    unsigned tail = atomic_load_explicit((_Atomic unsigned *)c->cq_tail,
+                                         memory_order_acquire);
+    int ret = 0;
+
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &c->cqes[head & *c->cq_mask];
+        int res = cqe->res;
+
+        c->nb_inflight--;
+        if (cqe->user_data == FSYNC_USER_DATA) {
+            c->sync_pending = 0;
+            if (submitter_exited(res, &c->sync_retried))
+                ret = FFMIN(ret, submit_fsync(c));
+            else if (res < 0 && !c->error)
+                c->error = AVERROR(-res);
+        } else if (c->write) {
+            UringBuffer *b = &c->bufs[cqe->user_data];
+
+            if (submitter_exited(res, &b->retried)) {
+                ret = FFMIN(ret, submit_buffer(c, cqe->user_data));
+            } else if (res <= 0) {
+                if (!c->error)
+                    c->error = res ? AVERROR(-res) : AVERROR(EIO);
+                b->state = BUF_FREE;
+            } else if ((b->done += res) < b->size) {
+                ret = FFMIN(ret, submit_buffer(c, cqe->user_data));
+            } else {
+                b->state = BUF_FREE;
+            }
+        } else {
+            UringBuffer *b = &c->bufs[cqe->user_data];
+
+            if (submitter_exited(res, &b->retried)) {
+                ret = FFMIN(ret, submit_buffer(c, cqe->user_data));
+            } else {
+                b->size  = res;
+                b->state = BUF_DONE;
+            }
+        }
+    }
+    atomic_store_explicit((_Atomic unsigned *)c->cq_head, head,
+                          memory_order_release);
+
+    return ret;
+}
+
+static int wait_one(UringContext *c)
+{
+    int ret = uring_enter(c, 0, 1);
+    if (ret < 0)
+        return ret;
+    return reap(c);
+}
+
+static int drain(UringContext *c)
+{
+    int ret = 0;
+
+    while (c->nb_inflight && ret >= 0)
+        ret = wait_one(c);
+    return ret;
+}
+
+static int find_buffer(UringContext *c, int state)
+{
+    for (int i = 0; i < c->queue_depth; i++)
+        if (c->bufs[i].state == state)
+            return i;
+    return -1;
+}
+
+/* Returns the buffer holding the byte at pos, including an empty or failed
+ * read starting exactly at pos. */
+static int lookup(UringContext *c, int64_t pos)
+{
+    for (int i = 0; i < c->queue_depth; i++) {
+        const UringBuffer *b = &c->bufs[i];
+        int64_t end = b->pos + (b->state == BUF_DONE ? FFMAX(b->size, 1) : c->block_size);
+
+        if (b->state != BUF_FREE && pos >= b->pos && pos < end)
+            return i;
+    }
+    return -1;
+}
+
+static int fill_queue(UringContext *c)
+{
+    int target = c->sequential ? c->queue_depth : 1;
+    int used = 0, idx, ret;
+
+    for (int i = 0; i < c->queue_depth; i++) {
+        UringBuffer *b = &c->bufs[i];
+        /* drop what the caller has skipped over */
+        if (b->state == BUF_DONE && b->size > 0 && b->pos + b->size <= c->pos)
+            b->state = BUF_FREE;
+        used += b->state != BUF_FREE;
+    }
+
+    while (used < target && (idx = find_buffer(c, BUF_FREE)) >= 0) {
+        c->bufs[idx].pos     = c->next_read;
+        c->bufs[idx].retried = 0;
+        ret = submit_buffer(c, idx);
+        if (ret < 0)
+            return ret;
+        c->next_read += c->block_size;
+        used++;
+    }
+    return 0;
+}
+
+static int uring_read(URLContext *h, unsigned char *buf, int size)
+{
+    UringContext *c = h->priv_data;
+    UringBuffer *b;
+    int idx, ret;
+
+    if (c->ring_fd < 0) {
+        ret = read(c->fd, buf, size);
+        if (ret == 0)
+            return AVERROR_EOF;
+        return ret < 0 ? AVERROR(errno) : ret;
+    }
+
+    c->sequential = c->pos == c->last_end;
+
+    idx = lookup(c, c->pos);
+    if (idx < 0) {
+        /* random access: the readahead is of no use, start over here */
+        ret = drain(c);
+        if (ret < 0)
+            return ret;
+        for (int i = 0; i < c->queue_depth; i++)
+            c->bufs[i].state = BUF_FREE;
+        c->next_read = c->pos;
+    }
+    ret = fill_queue(c);
+    if (ret < 0)
+        return ret;
+    if (idx < 0)
+        idx = lookup(c, c->pos);
+
+    b = &c->bufs[idx];
+    while (b->state == BUF_PENDING) {
+        ret = wait_one(c);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (b->size < 0) {
+        b->state = BUF_FREE;
+        return AVERROR(-b->size);
+    }
+    size = FFMIN(size, b->pos + b->size - c->pos);
+    if (size <= 0)
+        return AVERROR_EOF;
+
+    memcpy(buf, b->data + c->pos - b->pos, size);
+    c->pos     += size;
+    c->last_end = c->pos;
+
+    ret = fill_queue(c);
+    return ret < 0 ? ret : size;
+}
+
+static int uring_write(URLContext *h, const unsigned char *buf, int size)
+{
+    UringContext *c = h->priv_data;
+    UringBuffer *b;
+    int idx, ret;
+
+    if (c->ring_fd < 0) {
+        ret = write(c->fd, buf, size);
+        return ret < 0 ? AVERROR(errno) : ret;
+    }
+
+    while ((idx = find_buffer(c, BUF_FREE)) < 0) {
+        ret = wait_one(c);
+        if (ret < 0)
+            return ret;
+    }
+    if (c->error)
+        return c->error;
+
+    size = FFMIN(size, c->block_size);
+    b = &c->bufs[idx];
+    memcpy(b->data, buf, size);
+    b->pos  = c->pos;
+    b->size    = size;
+    b->done    = 0;
+    b->retried = 0;
+    ret = submit_buffer(c, idx);
+    if (ret < 0)
+        return ret;
+    c->pos += size;
+
+    c->unsynced += size;
+    if (c->fsync_interval && c->unsynced >= c->fsync_interval && !c->sync_pending) {
+        c->sync_retried = 0;
+        c->unsynced     = 0;
+        ret = submit_fsync(c);
+        if (ret < 0)
+            return ret;
+    }
+
+    return size;
+}
+
+static int64_t uring_seek(URLContext *h, int64_t pos, int whence)
+{
+    UringContext *c = h->priv_data;
+    struct stat st;
+    int ret;
+
+    if (c->ring_fd < 0) {
+        if (whence == AVSEEK_SIZE)
+            return fstat(c->fd, &st) < 0 ? AVERROR(errno) : st.st_size;
+        pos = lseek(c->fd, pos, whence);
+        return pos < 0 ? AVERROR(errno) : pos;
+    }
+
+    /* writes to overlapping ranges must not be in flight at the same time,
+     * and the file size is only known once everything has been written */
+    if (c->write && (whence != SEEK_SET || pos != c->pos)) {
+        ret = drain(c);
+        if (ret < 0)
+            return ret;
+        if (c->error)
+            return c->error;
+    }
+
+    if (whence == AVSEEK_SIZE || whence == SEEK_END) {
+        if (fstat(c->fd, &st) < 0)
+            return AVERROR(errno);
+        if (whence == AVSEEK_SIZE)
+            return st.st_size;
+        pos += st.st_size;
+    } else if (whence == SEEK_CUR) {
+        pos += c->pos;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    return c->pos = pos;
+}
+
+static int uring_get_short_seek(URLContext *h)
+{
+    UringContext *c = h->priv_data;
+
+    /* skipping ahead by reading is cheap as long as it stays in the readahead */
+    if (c->ring_fd < 0 || c->write)
+        return 0;
+    return c->queue_depth * c->block_size;
+}
+
+static int uring_get_handle(URLContext *h)
+{
+    UringContext *c = h->priv_data;
+    return c->fd;
+}
+
+static int uring_close(URLContext *h)
+{
+    UringContext *c = h->priv_data;
+    int ret = 0;
+
+    if (c->ring_fd >= 0) {
+        ret = drain(c);
+        if (ret >= 0 && c->error)
+            ret = c->error;
+        if (ret >= 0 && c->write && c->fsync_interval && fsync(c->fd) < 0)
+            ret = AVERROR(errno);
+        uring_teardown(c);
+    }
+    if (c->bufs) {
+        for (int i = 0; i < c->queue_depth; i++)
+            av_freep(&c->bufs[i].data);
+        av_freep(&c->bufs);
+    }
+    if (c->fd >= 0 && close(c->fd) < 0 && ret >= 0)
+        ret = AVERROR(errno);
+    c->fd = -1;
+
+    return ret;
+}
+
+static int uring_open(URLContext *h, const char *filename, int flags)
+{
+    UringContext *c = h->priv_data;
+    struct stat st;
+    int access, ret;
+
+    av_strstart(filename, "uring:", &filename);
+    av_strstart(filename, "file:", &filename);
+
+    c->ring_fd = -1;
+    if (flags & AVIO_FLAG_WRITE && flags & AVIO_FLAG_READ) {
+        access = O_CREAT | O_RDWR;
+        if (c->trunc)
+            access |= O_TRUNC;
+    } else if (flags & AVIO_FLAG_WRITE) {
+        access = O_CREAT | O_WRONLY;
+        if (c->trunc)
+            access |= O_TRUNC;
+    } else {
+        access = O_RDONLY;
+    }
+    c->fd = avpriv_open(filename, access, 0666);
+    if (c->fd == -1)
+        return AVERROR(errno);
+
+    h->is_streamed = !fstat(c->fd, &st) && S_ISFIFO(st.st_mode);
+
+    if (!h->is_streamed && flags & AVIO_FLAG_WRITE)
+        h->min_packet_size = h->max_packet_size = c->block_size;
+
+    /* Reads and writes are both queued, but against separate positions;
+     * mixing them on one context is left to the plain code path. */
+    if (h->is_streamed || (flags & AVIO_FLAG_READ && flags & AVIO_FLAG_WRITE))
+        return 0;
+
+    c->write = !!(flags & AVIO_FLAG_WRITE);
+
+    ret = uring_setup(c);
+    if (ret < 0) {
+        av_log(h, AV_LOG_VERBOSE, "io_uring not available (%s), "
+               "using blocking I/O\n", av_err2str(ret));
+        uring_teardown(c);
+        return 0;
+    }
+
+    c->bufs = av_calloc(c->queue_depth, sizeof(*c->bufs));
+    if (!c->bufs)
+        goto fail;
+    for (int i = 0; i < c->queue_depth; i++) {
+        c->bufs[i].data = av_malloc(c->block_size);
+        if (!c->bufs[i].data)
+            goto fail;
+    }
+
+    return 0;
+fail:
+    uring_close(h);
+    return AVERROR(ENOMEM);
+}
+
+#define OFFSET(x) offsetof(UringContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+#define E AV_OPT_FLAG_ENCODING_PARAM
+
+static const AVOption options[] = {
+    { "truncate",       "truncate existing files on write",                OFFSET(trunc),          AV_OPT_TYPE_BOOL,  { .i64 = 1 },            0,         1, E },
+    { "queue_depth",    "maximum number of requests in flight",            OFFSET(queue_depth),    AV_OPT_TYPE_INT,   { .i64 = 8 },            1,        64, D|E },
+    { "block_size",     "size of a single read or write request",          OFFSET(block_size),     AV_OPT_TYPE_INT,   { .i64 = 262144 },    4096, 1 << 26, D|E },
+    { "fsync_interval", "fsync after this many bytes were written, 0 disables syncing",
+                                                                           OFFSET(fsync_interval), AV_OPT_TYPE_INT64, { .i64 = 0 },            0, INT64_MAX, E },
+    { NULL }
+};
+
+static const AVClass uring_class = {
+    .class_name = "uring",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const URLProtocol ff_uring_protocol = {
+    .name                = "uring",
+    .url_open            = uring_open,
+    .url_read            = uring_read,
+    .url_write           = uring_write,
+    .url_seek            = uring_seek,
+    .url_close           = uring_close,
+    .url_get_file_handle = uring_get_handle,
+    .url_get_short_seek  = uring_get_short_seek,
+    .priv_data_size      = sizeof(UringContext),
+    .priv_data_class     = &uring_class,
+    .default_whitelist   = "file,uring,crypto,data",
+};
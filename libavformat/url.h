@@ -26,6 +26,7 @@
 
 #include "avio.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -83,6 +84,16 @@ typedef struct URLProtocol {
     int (*url_get_multi_file_handle)(URLContext *h, int **handles,
                                      int *numhandles);
     int (*url_get_short_seek)(URLContext *h);
+    /**
+     * Return a new reference to a read-only memory mapping of the whole
+     * resource in *buf, where buf->data corresponds to offset 0.
+     */
+    int (*url_get_mapping)(URLContext *h, AVBufferRef **buf);
+    /**
+     * Copy size bytes from offset src to offset dst within the resource
+     * without going through user space. The ranges may overlap.
+     */
+    int (*url_copy_range)(URLContext *h, int64_t dst, int64_t src, int64_t size);
     int (*url_shutdown)(URLContext *h, int flags);
     const AVClass *priv_data_class;
     int priv_data_size;
@@ -263,6 +274,23 @@ int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles);
  */
 int ffurl_get_short_seek(void *urlcontext);
 
+/**
+ * Return a new reference to a read-only memory mapping of the whole resource.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if the resource is not mapped
+ */
+int ffurl_get_mapping(URLContext *h, AVBufferRef **buf);
+
+/**
+ * Copy size bytes from offset src to offset dst within the resource, like
+ * memmove() does. The current position is not changed.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if the copy is not supported, in
+ *         which case the resource is left unchanged, or another negative
+ *         AVERROR code on failure
+ */
+int ffurl_copy_range(URLContext *h, int64_t dst, int64_t src, int64_t size);
+
 /**
  * Signal the URLContext that we are done reading or writing the stream.
  *
@@ -18,6 +18,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <math.h>
 #include <string.h>
 
 #include "libavutil/mem_internal.h"
@@ -60,6 +61,44 @@ static void test_abs_pow34(AACEncDSPContext *s)
     report("abs_pow34");
 }
 
+static void test_quant_bands(AACEncDSPContext *s)
+{
+    /* Band sizes are multiples of 4, cover the vector tails too */
+    static const int sizes[] = { 4, 12, 16, 28, 32, 60, BUF_SIZE };
+    int maxval = rnd() & 0xFF;
+    float q34 = (float)rnd() / (UINT_MAX / 4);
+    const float rounding = (rnd() & 1) ? 0.4054f : 0.1054f;
+    LOCAL_ALIGNED_32(float, in, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(float, scaled, [BUF_SIZE]);
+
+    declare_func(void, int *, const float *, const float *, int, int, int,
+                 const float, const float);
+
+    randomize_float(in, BUF_SIZE);
+    randomize_float(scaled, BUF_SIZE);
+    for (int i = 0; i < BUF_SIZE; i++)
+        scaled[i] = fabsf(scaled[i]);
+
+    for (int sign = 0; sign <= 1; sign++) {
+        if (check_func(s->quant_bands, "quant_bands_%s",
+                       sign ? "signed" : "unsigned")) {
+            LOCAL_ALIGNED_32(int, out, [BUF_SIZE]);
+            LOCAL_ALIGNED_32(int, out2, [BUF_SIZE]);
+
+            for (int i = 0; i < FF_ARRAY_ELEMS(sizes); i++) {
+                call_ref(out,  in, scaled, sizes[i], sign, maxval, q34, rounding);
+                call_new(out2, in, scaled, sizes[i], sign, maxval, q34, rounding);
+                if (memcmp(out, out2, sizes[i] * sizeof(*out)))
+                    fail();
+            }
+
+            bench_new(out, in, scaled, BUF_SIZE, sign, maxval, q34, rounding);
+        }
+    }
+
+    report("quant_bands");
+}
+
 
 void checkasm_check_aacencdsp(void)
 {
@@ -67,4 +106,5 @@ void checkasm_check_aacencdsp(void)
     ff_aacenc_dsp_init(&s);
 
     test_abs_pow34(&s);
+    test_quant_bands(&s);
 }
@@ -143,6 +143,9 @@ static const struct {
     #if CONFIG_JPEG2000_DECODER
         { "jpeg2000dsp", checkasm_check_jpeg2000dsp },
     #endif
+    #if CONFIG_JPEG2000_ENCODER
+        { "jpeg2000dwt", checkasm_check_jpeg2000dwt },
+    #endif
     #if CONFIG_LLAUDDSP
         { "llauddsp", checkasm_check_llauddsp },
     #endif
@@ -170,6 +173,9 @@ static const struct {
     #if CONFIG_SVQ1_ENCODER
         { "svq1enc", checkasm_check_svq1enc },
     #endif
+    #if CONFIG_STARTCODE
+        { "startcode", checkasm_check_startcode },
+    #endif
     #if CONFIG_TAK_DECODER
         { "takdsp", checkasm_check_takdsp },
     #endif
@@ -89,6 +89,30 @@ static void check_ict_float(void)
     bench_new(new0, new1, new2, BUF_SIZE);
 }
 
+static void check_ht_sign_mag(void)
+{
+    LOCAL_ALIGNED_32(int32_t, src, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int32_t, ref, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int32_t, new, [BUF_SIZE]);
+
+    declare_func(void, int32_t *dst, const int32_t *src, int len, int shift);
+
+    for (int shift = 0; shift < 31; shift += 5) {
+        int len = 8 + ((rnd() % (BUF_SIZE - 16)) & ~7);
+
+        for (int i = 0; i < BUF_SIZE; i++)
+            src[i] = rnd();
+        memset(ref, 0, BUF_SIZE * sizeof(*ref));
+        memset(new, 0, BUF_SIZE * sizeof(*new));
+        /* unaligned, as rows of a code-block are */
+        call_ref(ref + 1, src + 3, len, shift);
+        call_new(new + 1, src + 3, len, shift);
+        if (memcmp(ref, new, BUF_SIZE * sizeof(*ref)))
+            fail();
+    }
+    bench_new(new, src, BUF_SIZE, 5);
+}
+
 void checkasm_check_jpeg2000dsp(void)
 {
     Jpeg2000DSPContext h;
@@ -101,4 +125,9 @@ void checkasm_check_jpeg2000dsp(void)
         check_ict_float();
 
     report("mct_decode");
+
+    if (check_func(h.ht_sign_mag, "jpeg2000_ht_sign_mag"))
+        check_ht_sign_mag();
+
+    report("ht_sign_mag");
 }
@@ -0,0 +1,106 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavcodec/jpeg2000dwt.h"
+#include "libavutil/mem_internal.h"
+
+#define BUF_SIZE FF_DWT_STRIP
+
+/* keep a + b within the range seen by the transform */
+#define randomize_buffers(range)                        \
+    do {                                                \
+        for (int i = 0; i < BUF_SIZE; i++) {            \
+            a[i]   = (int32_t)rnd() >> (32 - (range));  \
+            b[i]   = (int32_t)rnd() >> (32 - (range));  \
+            src[i] = (int32_t)rnd() >> (32 - (range));  \
+        }                                               \
+    } while (0)
+
+static const int lift97_coefs[] = { 103949, 3472, 57862, 29066 };
+
+static void check_lift53(void (*func)(int32_t *, const int32_t *, const int32_t *, int),
+                         const char *name)
+{
+    LOCAL_ALIGNED_32(int32_t, a,   [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int32_t, b,   [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int32_t, src, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int32_t, ref, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int32_t, new, [BUF_SIZE]);
+
+    declare_func(void, int32_t *dst, const int32_t *a, const int32_t *b, int len);
+
+    if (check_func(func, "jpeg2000_%s", name)) {
+        for (int len = 1; len <= BUF_SIZE; len += 7) {
+            randomize_buffers(24);
+            memcpy(ref, src, BUF_SIZE * sizeof(*src));
+            memcpy(new, src, BUF_SIZE * sizeof(*src));
+            call_ref(ref, a, b, len);
+            call_new(new, a, b, len);
+            if (memcmp(ref, new, len * sizeof(*ref)))
+                fail();
+        }
+        bench_new(new, a, b, BUF_SIZE);
+    }
+}
+
+static void check_lift97_int(void (*func)(int32_t *, const int32_t *, const int32_t *, int, int),
+                             const char *name)
+{
+    LOCAL_ALIGNED_32(int32_t, a,   [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int32_t, b,   [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int32_t, src, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int32_t, ref, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int32_t, new, [BUF_SIZE]);
+
+    declare_func(void, int32_t *dst, const int32_t *a, const int32_t *b,
+                 int len, int coef);
+
+    if (check_func(func, "jpeg2000_%s", name)) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(lift97_coefs); i++) {
+            int len = 1 + rnd() % BUF_SIZE;
+
+            randomize_buffers(28);
+            memcpy(ref, src, BUF_SIZE * sizeof(*src));
+            memcpy(new, src, BUF_SIZE * sizeof(*src));
+            call_ref(ref, a, b, len, lift97_coefs[i]);
+            call_new(new, a, b, len, lift97_coefs[i]);
+            if (memcmp(ref, new, len * sizeof(*ref)))
+                fail();
+        }
+        bench_new(new, a, b, BUF_SIZE, lift97_coefs[0]);
+    }
+}
+
+void checkasm_check_jpeg2000dwt(void)
+{
+    int border[2][2] = { { 0, BUF_SIZE }, { 0, BUF_SIZE } };
+    DWTContext s = { 0 };
+
+    if (ff_jpeg2000_dwt_init(&s, border, 1, FF_DWT53) < 0)
+        return;
+    check_lift53(s.lift53_sub, "lift53_sub");
+    check_lift53(s.lift53_add, "lift53_add");
+    check_lift97_int(s.lift97_int_sub, "lift97_int_sub");
+    check_lift97_int(s.lift97_int_add, "lift97_int_add");
+    ff_dwt_destroy(&s);
+
+    report("dwt_lift");
+}
@@ -35,9 +35,13 @@
             buf[i] = rnd(); \
     } while (0)
 
+#define BUF_SIZE 2048 // multiple of 16
+
+/* filter orders used by the APE decoder, plus a non power of two length */
+static const int orders[] = { 16, 32, 256, 1024, 1088, BUF_SIZE };
+
 static void check_scalarproduct_and_madd_int16(LLAudDSPContext *c)
 {
-#define BUF_SIZE 1088 // multiple of 16
     LOCAL_ALIGNED_16(int16_t, v1, [BUF_SIZE]);
     LOCAL_ALIGNED_16(int16_t, v2, [BUF_SIZE]);
     LOCAL_ALIGNED_16(int16_t, v3, [BUF_SIZE]);
@@ -57,12 +61,16 @@ static void check_scalarproduct_and_madd_int16(LLAudDSPContext *c)
         LOCAL_ALIGNED_16(int16_t, dst1, [BUF_SIZE]);
         int ref, val;
 
-        memcpy(dst0, v1, sizeof (*dst0) * BUF_SIZE);
-        memcpy(dst1, v1, sizeof (*dst1) * BUF_SIZE);
-        ref = call_ref(dst0, v2, v3, BUF_SIZE, mul);
-        val = call_new(dst1, v2, v3, BUF_SIZE, mul);
-        if (memcmp(dst0, dst1, sizeof (*dst0) * BUF_SIZE) != 0 || ref != val)
-            fail();
+        for (int i = 0; i < FF_ARRAY_ELEMS(orders); i++) {
+            int order = orders[i];
+
+            memcpy(dst0, v1, sizeof (*dst0) * BUF_SIZE);
+            memcpy(dst1, v1, sizeof (*dst1) * BUF_SIZE);
+            ref = call_ref(dst0, v2, v3, order, mul);
+            val = call_new(dst1, v2, v3, order, mul);
+            if (memcmp(dst0, dst1, sizeof (*dst0) * BUF_SIZE) != 0 || ref != val)
+                fail();
+        }
 
         bench_new(v1, v2, v3, BUF_SIZE, mul);
     }
@@ -72,7 +80,6 @@ static void check_scalarproduct_and_madd_int16(LLAudDSPContext *c)
 
 static void check_scalarproduct_and_madd_int32(LLAudDSPContext *c)
 {
-#define BUF_SIZE 1088 // multiple of 16
     LOCAL_ALIGNED_16(int16_t, v1, [BUF_SIZE]);
     LOCAL_ALIGNED_16(int32_t, v2, [BUF_SIZE]);
     LOCAL_ALIGNED_16(int16_t, v3, [BUF_SIZE]);
@@ -92,12 +99,16 @@ static void check_scalarproduct_and_madd_int32(LLAudDSPContext *c)
         LOCAL_ALIGNED_16(int16_t, dst1, [BUF_SIZE]);
         int ref, val;
 
-        memcpy(dst0, v1, sizeof (*dst0) * BUF_SIZE);
-        memcpy(dst1, v1, sizeof (*dst1) * BUF_SIZE);
-        ref = call_ref(dst0, v2, v3, BUF_SIZE, mul);
-        val = call_new(dst1, v2, v3, BUF_SIZE, mul);
-        if (memcmp(dst0, dst1, sizeof (*dst0) * BUF_SIZE) != 0 || ref != val)
-            fail();
+        for (int i = 0; i < FF_ARRAY_ELEMS(orders); i++) {
+            int order = orders[i];
+
+            memcpy(dst0, v1, sizeof (*dst0) * BUF_SIZE);
+            memcpy(dst1, v1, sizeof (*dst1) * BUF_SIZE);
+            ref = call_ref(dst0, v2, v3, order, mul);
+            val = call_new(dst1, v2, v3, order, mul);
+            if (memcmp(dst0, dst1, sizeof (*dst0) * BUF_SIZE) != 0 || ref != val)
+                fail();
+        }
 
         bench_new(v1, v2, v3, BUF_SIZE, mul);
     }
@@ -87,6 +87,48 @@ static void test_motion(const char *name, me_cmp_func test_func)
     }
 }
 
+static void test_motion_x4(const char *name, me_cmp_x4_func test_func, int w)
+{
+    static const int look_ahead = 17;
+    LOCAL_ALIGNED_16(uint8_t, img1, [WIDTH * HEIGHT]);
+    LOCAL_ALIGNED_16(uint8_t, img2, [WIDTH * HEIGHT]);
+    const uint8_t *ref[4];
+    int scores_ref[4], scores_new[4], h;
+
+    declare_func(void, struct MpegEncContext *c, const uint8_t *blk1,
+                 const uint8_t *const ref[4], ptrdiff_t stride, int h,
+                 int scores[4]);
+
+    fill_random(img1, WIDTH * HEIGHT);
+    fill_random(img2, WIDTH * HEIGHT);
+
+    if (check_func(test_func, "%s", name)) {
+        for (int i = 0; i < ITERATIONS; i++) {
+            h = w == 16 && i & 1 ? 8 : w;
+            for (int j = 0; j < 4; j++) {
+                int x = rnd() % (WIDTH - look_ahead);
+                int y = rnd() % (HEIGHT - look_ahead);
+                ref[j] = img2 + y * WIDTH + x;
+            }
+
+            call_ref(NULL, img1, ref, WIDTH, h, scores_ref);
+            call_new(NULL, img1, ref, WIDTH, h, scores_new);
+
+            if (memcmp(scores_ref, scores_new, sizeof(scores_ref))) {
+                fail();
+                printf("func: %s, h=%d, asm={%d,%d,%d,%d} c={%d,%d,%d,%d}\n",
+                       name, h, scores_new[0], scores_new[1], scores_new[2],
+                       scores_new[3], scores_ref[0], scores_ref[1],
+                       scores_ref[2], scores_ref[3]);
+                break;
+            }
+        }
+        for (int j = 0; j < 4; j++)
+            ref[j] = img2 + (2 + (j & 1)) * WIDTH + 3 + (j >> 1);
+        bench_new(NULL, img1, ref, WIDTH, w, scores_new);
+    }
+}
+
 #define ME_CMP_1D_ARRAYS(XX)                                                   \
     XX(sad)                                                                    \
     XX(sse)                                                                    \
@@ -141,6 +183,11 @@ static void check_motion(void)
     }
     ME_CMP_1D_ARRAYS(XX)
 #undef XX
+
+    /* sad_x4[] has no C version in the context, test against the reference
+     * versions where no optimized one is set. */
+    test_motion_x4("sad_x4_0", me_ctx.sad_x4[0] ? me_ctx.sad_x4[0] : ff_sad16_x4_c, 16);
+    test_motion_x4("sad_x4_1", me_ctx.sad_x4[1] ? me_ctx.sad_x4[1] : ff_sad8_x4_c,  8);
 }
 
 void checkasm_check_motion(void)
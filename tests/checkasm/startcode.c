@@ -0,0 +1,101 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavcodec/defs.h"
+#include "libavcodec/startcode.h"
+#include "libavutil/mem_internal.h"
+
+#define BUF_SIZE 1024
+
+/* Mostly nonzero bytes, with sparse zeros and small values so that start
+ * codes and escapes show up at random positions, including the padding. */
+static void randomize_buffer(uint8_t *buf, int size, int density)
+{
+    for (int i = 0; i < size; i++) {
+        unsigned r = rnd();
+        buf[i] = r % density ? (r >> 8) | 4 : (r >> 8) & 3;
+        if (!(r % (density * 8)))
+            buf[i] = 0;
+    }
+}
+
+static void check_find(int (*func)(const uint8_t *, int), const char *name)
+{
+    LOCAL_ALIGNED_32(uint8_t, buf, [BUF_SIZE + AV_INPUT_BUFFER_PADDING_SIZE + 32]);
+    declare_func(int, const uint8_t *buf, int size);
+
+    if (check_func(func, "%s", name)) {
+        static const int densities[] = { 2, 16, 256, 1 << 16 };
+
+        for (int d = 0; d < FF_ARRAY_ELEMS(densities); d++) {
+            for (int i = 0; i < 32; i++) {
+                int offset = rnd() & 31;
+                int size   = rnd() % (BUF_SIZE + 1);
+                int ref, new;
+
+                randomize_buffer(buf, BUF_SIZE + AV_INPUT_BUFFER_PADDING_SIZE + 32,
+                                 densities[d]);
+                ref = call_ref(buf + offset, size);
+                new = call_new(buf + offset, size);
+                if (ref != new) {
+                    fail();
+                    fprintf(stderr, "%s: size %d, offset %d: %d != %d\n",
+                            name, size, offset, ref, new);
+                    return;
+                }
+            }
+        }
+        /* a single escape just before, across and after the end of the buffer */
+        for (int pos = 0; pos < 80; pos++) {
+            memset(buf, 0xff, BUF_SIZE + AV_INPUT_BUFFER_PADDING_SIZE);
+            buf[pos]     = 0;
+            buf[pos + 1] = 0;
+            buf[pos + 2] = 3;
+            for (int size = pos; size <= pos + 3; size++) {
+                int ref, new;
+
+                ref = call_ref(buf, size);
+                new = call_new(buf, size);
+                if (ref != new) {
+                    fail();
+                    fprintf(stderr, "%s: escape at %d, size %d: %d != %d\n",
+                            name, pos, size, ref, new);
+                    return;
+                }
+            }
+        }
+        memset(buf, 0xff, BUF_SIZE + AV_INPUT_BUFFER_PADDING_SIZE);
+        bench_new(buf, BUF_SIZE);
+    }
+}
+
+void checkasm_check_startcode(void)
+{
+    StartcodeDSPContext c;
+
+    ff_startcode_dsp_init(&c);
+
+    check_find(c.find_candidate, "startcode_find_candidate");
+    report("find_candidate");
+
+    check_find(c.find_escape, "startcode_find_escape");
+    report("find_escape");
+}
@@ -306,6 +306,34 @@ stream_remux(){
         run ffprobe${PROGSUF}${EXECSUF} -bitexact $ffprobe_opts $tencfile || return
 }
 
+uring_copy(){
+    srcfile=$1
+    src_opts=$2
+    enc_opts=$3
+    copyfile="${outdir}/${test}.yuv"
+    test $keep -ge 1 || cleanfiles="$cleanfiles $copyfile"
+    tsrcfile=$(target_path $srcfile)
+    tcopyfile=$(target_path $copyfile)
+    ffmpeg -f rawvideo -s 352x288 $src_opts -i uring:$tsrcfile -c copy \
+           -f rawvideo $enc_opts -y uring:$tcopyfile || return
+    do_md5sum $copyfile | cut -d " " -f 1
+}
+
+mmap_read(){
+    enc_fmt=$1
+    shift
+    encfile="${outdir}/${test}.${enc_fmt}"
+    crcfile="${outdir}/${test}.framecrc"
+    logfile="${outdir}/${test}.log"
+    test $keep -ge 1 || cleanfiles="$cleanfiles $encfile $crcfile $logfile"
+    tencfile=$(target_path $encfile)
+    ffmpeg "$@" -bitexact -f $enc_fmt -y $tencfile || return
+    framecrc -i $tencfile -map 0 > $crcfile || return
+    framecrc -v verbose -mmap 1 -i $tencfile -map 0 2> $logfile | diff -u $crcfile - || return
+    grep -q "bytes mapped" $logfile || { echo "No packets were mapped"; return 1; }
+    cat $crcfile
+}
+
 # this function is for testing external encoders,
 # where the precise output is not controlled by us
 # we can still test e.g. that the output can be decoded correctly
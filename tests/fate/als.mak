@@ -11,5 +11,12 @@ FATE_ALS += fate-mpeg4-als-conformance-09
 
 fate-mpeg4-als-conformance-09: CMD = crc -i $(TARGET_SAMPLES)/lossless-audio/als_09_512ch2k16b.mp4
 
+# frame threading must give the same output as serial decoding
+FATE_ALS += fate-mpeg4-als-conformance-00-frame-threads
+
+fate-mpeg4-als-conformance-00-frame-threads: CMD = crc -i $(TARGET_SAMPLES)/lossless-audio/als_00_2ch48k16b.mp4
+fate-mpeg4-als-conformance-00-frame-threads: THREADS = 4
+fate-mpeg4-als-conformance-00-frame-threads: THREAD_TYPE = frame
+
 FATE_SAMPLES_AVCONV-$(call DEMDEC, MOV, ALS) += $(FATE_ALS)
 fate-als: $(FATE_ALS)
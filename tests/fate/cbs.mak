@@ -1,22 +1,36 @@
 # Read/write tests: By default, this uses the codec metadata filters - with no
-# arguments, it decomposes the stream fully and then recomposes it
-# without making any changes.
+# arguments, it decomposes the units the filter needs and then recomposes the
+# stream without making any changes. The -full variants decompose all units
+# with decompose_all=1 and must give the same output.
 
 fate-cbs: fate-cbs-av1 fate-cbs-h264 fate-cbs-hevc fate-cbs-mpeg2 fate-cbs-vp9 fate-cbs-vvc
 
 FATE_CBS_DEPS = $(call ALLYES, $(1)_DEMUXER $(2)_PARSER $(3)_METADATA_BSF $(4)_DECODER $(5)_MUXER)
 FATE_CBS_NO_DEC_DEPS = $(call ALLYES, $(1)_DEMUXER $(2)_PARSER $(3)_METADATA_BSF $(4)_MUXER)
 
+# vp9_metadata always decomposes everything
+FATE_CBS_FULL_CODECS = av1 h264 hevc mpeg2 vvc
+
 define FATE_CBS_TEST
 # (codec, test_name, sample_file, output_format)
 FATE_CBS_$(1) += fate-cbs-$(1)-$(2)
 fate-cbs-$(1)-$(2): CMD = md5 -c:v $(3) -i $(TARGET_SAMPLES)/$(4) -c:v copy -y -bsf:v $(1)_metadata -f $(5)
+ifneq ($(filter $(1),$(FATE_CBS_FULL_CODECS)),)
+FATE_CBS_$(1) += fate-cbs-$(1)-$(2)-full
+fate-cbs-$(1)-$(2)-full: CMD = md5 -c:v $(3) -i $(TARGET_SAMPLES)/$(4) -c:v copy -y -bsf:v $(1)_metadata=decompose_all=1 -f $(5)
+fate-cbs-$(1)-$(2)-full: REF = $(SRC_PATH)/tests/ref/fate/cbs-$(1)-$(2)
+endif
 endef
 
 define FATE_CBS_NO_DEC_TEST
 # (codec, test_name, sample_file, output_format)
 FATE_CBS_$(1) += fate-cbs-$(1)-$(2)
 fate-cbs-$(1)-$(2): CMD = md5 -i $(TARGET_SAMPLES)/$(3) -c:v copy -y -bsf:v $(1)_metadata -f $(4)
+ifneq ($(filter $(1),$(FATE_CBS_FULL_CODECS)),)
+FATE_CBS_$(1) += fate-cbs-$(1)-$(2)-full
+fate-cbs-$(1)-$(2)-full: CMD = md5 -i $(TARGET_SAMPLES)/$(3) -c:v copy -y -bsf:v $(1)_metadata=decompose_all=1 -f $(4)
+fate-cbs-$(1)-$(2)-full: REF = $(SRC_PATH)/tests/ref/fate/cbs-$(1)-$(2)
+endif
 endef
 
 define FATE_CBS_DISCARD_TEST
@@ -257,6 +257,35 @@ fate-ffmpeg-streamcopy-t: CMD = ffmpeg
     -c copy -f null -t 1 -
 FATE_FFMPEG-$(call REMUX, RAWVIDEO) += fate-ffmpeg-streamcopy-t
 
+# Test a byte exact copy through the uring protocol, reading and writing
+# several requests in flight with a file size that is not a multiple of
+# the block size. The protocol falls back to blocking I/O if io_uring does not
+# work, so this only runs if configure found it working.
+fate-ffmpeg-uring-copy: tests/data/vsynth1.yuv
+fate-ffmpeg-uring-copy: CMD = uring_copy tests/data/vsynth1.yuv \
+    "-block_size 65536 -queue_depth 4" "-block_size 65536 -queue_depth 4 -fsync_interval 1000000"
+FATE_FFMPEG_URING-$(call REMUX, RAWVIDEO, URING_PROTOCOL) += fate-ffmpeg-uring-copy
+FATE_FFMPEG-$(HAVE_IO_URING_RUNTIME) += $(FATE_FFMPEG_URING-yes)
+
+# Test that decoding packets read from a memory mapped file gives the same
+# result as reading them normally, for raw streams, which keep referencing
+# the mapping, and for a compressed one, which is always copied. Also check
+# that some packets were actually mapped.
+FATE_FFMPEG_MMAP = fate-ffmpeg-mmap-nut fate-ffmpeg-mmap-mkv fate-ffmpeg-mmap-mov
+$(FATE_FFMPEG_MMAP): tests/data/vsynth1.yuv tests/data/asynth-44100-2.wav
+$(FATE_FFMPEG_MMAP): CMD = mmap_read $(FMT) \
+    -f rawvideo -s 352x432 -pix_fmt gray -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+    -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav -t 1 -map 0:v -map 0:v -map 1:a \
+    -c:v:0 rawvideo -c:v:1 ffv1 -c:a pcm_s16le
+fate-ffmpeg-mmap-nut: FMT = nut
+fate-ffmpeg-mmap-mkv: FMT = matroska
+fate-ffmpeg-mmap-mov: FMT = mov
+MMAP_DEPS = RAWVIDEO_DEMUXER WAV_DEMUXER RAWVIDEO_ENCODER FFV1_ENCODER PCM_S16LE_ENCODER \
+            FILE_PROTOCOL PIPE_PROTOCOL FRAMECRC_MUXER
+FATE_FFMPEG-$(call ALLYES, $(MMAP_DEPS) NUT_MUXER NUT_DEMUXER) += fate-ffmpeg-mmap-nut
+FATE_FFMPEG-$(call ALLYES, $(MMAP_DEPS) MATROSKA_MUXER MATROSKA_DEMUXER) += fate-ffmpeg-mmap-mkv
+FATE_FFMPEG-$(call ALLYES, $(MMAP_DEPS) MOV_MUXER MOV_DEMUXER) += fate-ffmpeg-mmap-mov
+
 # Test loopback decoding and passing the output to a complex graph.
 fate-ffmpeg-loopback-decoding: tests/data/vsynth1.yuv
 fate-ffmpeg-loopback-decoding: CMD = transcode \
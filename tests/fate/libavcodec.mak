@@ -90,6 +90,11 @@ fate-mathops: libavcodec/tests/mathops$(EXESUF)
 fate-mathops: CMD = run libavcodec/tests/mathops$(EXESUF)
 fate-mathops: CMP = null
 
+FATE_LIBAVCODEC-$(HAVE_THREADS) += fate-refstruct
+fate-refstruct: libavcodec/tests/refstruct$(EXESUF)
+fate-refstruct: CMD = run libavcodec/tests/refstruct$(EXESUF)
+fate-refstruct: CMP = null
+
 FATE_LIBAVCODEC-$(CONFIG_JPEG2000_ENCODER) += fate-j2k-dwt
 fate-j2k-dwt: libavcodec/tests/jpeg2000dwt$(EXESUF)
 fate-j2k-dwt: CMD = run libavcodec/tests/jpeg2000dwt$(EXESUF)
@@ -150,6 +150,22 @@ FATE_SEEK_LAVF_CONTAINER := $(FATE_SEEK_LAVF_CONTAINER:%=fate-seek-lavf-%)
 FATE_SEEK_LAVF_CONTAINER := $(filter $(subst fate-,fate-seek-,$(FATE_LAVF_CONTAINER)), $(FATE_SEEK_LAVF_CONTAINER))
 FATE_SEEK += $(FATE_SEEK_LAVF_CONTAINER)
 
+# fate-lavf-container files with a compact index
+
+FATE_SEEK_LAVF_COMPACT_INDEX += mkv mov
+
+FATE_SEEK_LAVF_COMPACT_INDEX := $(FATE_SEEK_LAVF_COMPACT_INDEX:%=fate-seek-lavf-%-compact_index)
+FATE_SEEK_LAVF_COMPACT_INDEX := $(filter $(FATE_SEEK_LAVF_CONTAINER:%=%-compact_index), $(FATE_SEEK_LAVF_COMPACT_INDEX))
+$(FATE_SEEK_LAVF_COMPACT_INDEX): fate-seek-lavf-%-compact_index: fate-lavf-% libavformat/tests/seek$(EXESUF)
+$(FATE_SEEK_LAVF_COMPACT_INDEX): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.$(@:fate-seek-lavf-%-compact_index=%) -compact_index 1
+
+# fate-lavf-container files with a lazily built index
+
+FATE_SEEK_LAVF_LAZY_INDEX-$(call ALLYES, MOV_MUXER MOV_DEMUXER) += fate-seek-lavf-mov-lazy_index
+FATE_SEEK_LAVF_LAZY_INDEX = $(filter $(FATE_SEEK_LAVF_CONTAINER:%=%-lazy_index), $(FATE_SEEK_LAVF_LAZY_INDEX-yes))
+fate-seek-lavf-mov-lazy_index: fate-lavf-mov libavformat/tests/seek$(EXESUF)
+fate-seek-lavf-mov-lazy_index: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.mov -lazy_index 1
+
 # files from fate-lavf-video
 
 FATE_SEEK_LAVF_VIDEO += gif y4m
@@ -205,6 +221,6 @@ $(FATE_SEEK) $(FATE_SAMPLES_SEEK): fate-seek-%: fate-%
 $(subst fate-seek-,fate-,$(FATE_SAMPLES_SEEK) $(FATE_SEEK)): KEEP_FILES ?= 1
 fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
-FATE_AVCONV += $(FATE_SEEK)
+FATE_AVCONV += $(FATE_SEEK) $(FATE_SEEK_LAVF_COMPACT_INDEX) $(FATE_SEEK_LAVF_LAZY_INDEX)
 FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
-fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_LAVF_COMPACT_INDEX) $(FATE_SEEK_LAVF_LAZY_INDEX)
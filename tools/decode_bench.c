@@ -0,0 +1,212 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the throughput of a decoder on a given input, e.g. a FATE sample.
+ * All packets of the selected stream are read into memory first, so only
+ * the time spent in the decoder is measured. The input is decoded several
+ * times and the fastest run is reported, which makes it easy to compare
+ * two builds of the same decoder.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "libavformat/avformat.h"
+
+#include "libavcodec/avcodec.h"
+
+static int read_packets(const char *filename, int stream_idx,
+                        AVCodecParameters **par, AVPacket ***pkts,
+                        int *nb_pkts, int64_t *size)
+{
+    AVFormatContext *s = NULL;
+    AVPacket *pkt;
+    int ret;
+
+    ret = avformat_open_input(&s, filename, NULL, NULL);
+    if (ret < 0) {
+        fprintf(stderr, "Error opening input file: %s\n", av_err2str(ret));
+        return ret;
+    }
+
+    ret = avformat_find_stream_info(s, NULL);
+    if (ret < 0)
+        goto end;
+
+    if (stream_idx < 0 || stream_idx >= s->nb_streams) {
+        fprintf(stderr, "Invalid stream index %d\n", stream_idx);
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+
+    *par = avcodec_parameters_alloc();
+    if (!*par) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ret = avcodec_parameters_copy(*par, s->streams[stream_idx]->codecpar);
+    if (ret < 0)
+        goto end;
+
+    while (1) {
+        pkt = av_packet_alloc();
+        if (!pkt) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+
+        ret = av_read_frame(s, pkt);
+        if (ret < 0 || pkt->stream_index != stream_idx) {
+            av_packet_free(&pkt);
+            if (ret == AVERROR_EOF)
+                break;
+            if (ret < 0)
+                goto end;
+            continue;
+        }
+
+        ret = av_dynarray_add_nofree(pkts, nb_pkts, pkt);
+        if (ret < 0) {
+            av_packet_free(&pkt);
+            goto end;
+        }
+        *size += pkt->size;
+    }
+    ret = 0;
+
+end:
+    avformat_close_input(&s);
+    return ret;
+}
+
+static int decode_all(AVCodecContext *dec, AVFrame *frame,
+                      AVPacket **pkts, int nb_pkts, int *nb_frames)
+{
+    int ret;
+
+    *nb_frames = 0;
+    for (int i = 0; i <= nb_pkts; i++) {
+        ret = avcodec_send_packet(dec, i < nb_pkts ? pkts[i] : NULL);
+        if (ret < 0 && ret != AVERROR_INVALIDDATA)
+            return ret;
+
+        while ((ret = avcodec_receive_frame(dec, frame)) >= 0) {
+            (*nb_frames)++;
+            av_frame_unref(frame);
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF &&
+            ret != AVERROR_INVALIDDATA)
+            return ret;
+    }
+    avcodec_flush_buffers(dec);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    AVCodecParameters *par = NULL;
+    AVCodecContext *dec = NULL;
+    AVDictionary *opts = NULL;
+    AVFrame *frame = NULL;
+    AVPacket **pkts = NULL;
+    const AVCodec *codec;
+    const char *filename, *threads = "1";
+    int stream_idx, runs, nb_pkts = 0, nb_frames = 0;
+    int64_t size = 0, best = INT64_MAX;
+    int ret;
+
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s <input file> <stream index> <runs> [<thread count>]\n",
+                argv[0]);
+        return 0;
+    }
+
+    filename   = argv[1];
+    stream_idx = strtol(argv[2], NULL, 0);
+    runs       = strtol(argv[3], NULL, 0);
+    if (argc > 4)
+        threads = argv[4];
+
+    ret = read_packets(filename, stream_idx, &par, &pkts, &nb_pkts, &size);
+    if (ret < 0)
+        goto end;
+
+    codec = avcodec_find_decoder(par->codec_id);
+    if (!codec) {
+        fprintf(stderr, "No decoder found for %s\n",
+                avcodec_get_name(par->codec_id));
+        ret = AVERROR_DECODER_NOT_FOUND;
+        goto end;
+    }
+
+    dec   = avcodec_alloc_context3(codec);
+    frame = av_frame_alloc();
+    if (!dec || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = avcodec_parameters_to_context(dec, par);
+    if (ret < 0)
+        goto end;
+
+    ret = av_dict_set(&opts, "threads", threads, 0);
+    if (ret < 0)
+        goto end;
+
+    ret = avcodec_open2(dec, codec, &opts);
+    if (ret < 0) {
+        fprintf(stderr, "Error opening decoder: %s\n", av_err2str(ret));
+        goto end;
+    }
+
+    for (int i = 0; i < FFMAX(runs, 1); i++) {
+        int64_t t = av_gettime_relative();
+
+        ret = decode_all(dec, frame, pkts, nb_pkts, &nb_frames);
+        if (ret < 0) {
+            fprintf(stderr, "Error decoding: %s\n", av_err2str(ret));
+            goto end;
+        }
+        best = FFMIN(best, av_gettime_relative() - t);
+    }
+    best = FFMAX(best, 1);
+
+    printf("%s: %d packets, %"PRId64" bytes, %d frames\n",
+           codec->name, nb_pkts, size, nb_frames);
+    printf("best of %d: %"PRId64" us, %.2f fps, %.2f MB/s\n", FFMAX(runs, 1),
+           best, nb_frames * 1e6 / best, size / (double)best);
+
+end:
+    for (int i = 0; i < nb_pkts; i++)
+        av_packet_free(&pkts[i]);
+    av_freep(&pkts);
+    av_dict_free(&opts);
+    av_frame_free(&frame);
+    avcodec_free_context(&dec);
+    avcodec_parameters_free(&par);
+    return ret < 0;
+}
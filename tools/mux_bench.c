@@ -0,0 +1,149 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the cost of interleaving many streams in the muxer. Synthetic
+ * audio packets are written with av_interleaved_write_frame() to a muxer
+ * whose output is discarded. Like most demuxers do for non-interleaved
+ * input, every stream is fed a chunk of packets at a time, so that the
+ * muxer has to reorder them. Streams listed as sparse never receive any
+ * packet, which makes the muxer buffer up to max_interleave_delta.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "libavformat/avformat.h"
+
+#define PACKET_SIZE 384
+
+static int discard_packet(void *opaque, const uint8_t *buf, int size)
+{
+    return size;
+}
+
+int main(int argc, char **argv)
+{
+    AVFormatContext *s = NULL;
+    AVPacket *pkt = NULL;
+    uint8_t *iobuf = NULL;
+    const char *format;
+    int nb_streams, nb_packets, chunk = 32, nb_sparse = 0;
+    int64_t t, written = 0;
+    int ret;
+
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s <format> <stream count> <packets per stream> "
+                        "[<chunk size> [<sparse stream count>]]\n", argv[0]);
+        return 0;
+    }
+
+    format     = argv[1];
+    nb_streams = strtol(argv[2], NULL, 0);
+    nb_packets = strtol(argv[3], NULL, 0);
+    if (argc > 4)
+        chunk     = FFMAX(strtol(argv[4], NULL, 0), 1);
+    if (argc > 5)
+        nb_sparse = strtol(argv[5], NULL, 0);
+
+    ret = avformat_alloc_output_context2(&s, NULL, format, NULL);
+    if (ret < 0) {
+        fprintf(stderr, "Error allocating the muxer: %s\n", av_err2str(ret));
+        return 1;
+    }
+
+    iobuf = av_malloc(32768);
+    pkt   = av_packet_alloc();
+    if (!iobuf || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    s->pb = avio_alloc_context(iobuf, 32768, 1, NULL, NULL, discard_packet, NULL);
+    if (!s->pb) {
+        av_free(iobuf);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    for (int i = 0; i < nb_streams + nb_sparse; i++) {
+        AVStream *st = avformat_new_stream(s, NULL);
+        if (!st) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        st->time_base = (AVRational){ 1, 48000 };
+        st->codecpar->codec_type  = AVMEDIA_TYPE_AUDIO;
+        st->codecpar->codec_id    = AV_CODEC_ID_MP2;
+        st->codecpar->sample_rate = 48000;
+        st->codecpar->frame_size  = 1152;
+        st->codecpar->bit_rate    = 128000;
+        av_channel_layout_default(&st->codecpar->ch_layout, 2);
+    }
+
+    ret = avformat_write_header(s, NULL);
+    if (ret < 0) {
+        fprintf(stderr, "Error writing the header: %s\n", av_err2str(ret));
+        goto end;
+    }
+
+    t = av_gettime_relative();
+    for (int start = 0; start < nb_packets; start += chunk) {
+        for (int i = 0; i < nb_streams; i++) {
+            for (int n = start; n < FFMIN(start + chunk, nb_packets); n++) {
+                ret = av_new_packet(pkt, PACKET_SIZE);
+                if (ret < 0)
+                    goto end;
+                memset(pkt->data, 0, PACKET_SIZE);
+                pkt->stream_index = i;
+                pkt->duration     = 1152;
+                /* offset the streams a bit so that they do not all compare equal */
+                pkt->pts = pkt->dts = n * 1152LL + i * 7;
+                pkt->flags        = AV_PKT_FLAG_KEY;
+
+                ret = av_interleaved_write_frame(s, pkt);
+                if (ret < 0) {
+                    fprintf(stderr, "Error writing a packet: %s\n", av_err2str(ret));
+                    goto end;
+                }
+                written++;
+            }
+        }
+    }
+    ret = av_write_trailer(s);
+    if (ret < 0)
+        goto end;
+    t = FFMAX(av_gettime_relative() - t, 1);
+
+    printf("%s: %d streams (%d sparse), %"PRId64" packets, chunks of %d\n",
+           format, nb_streams + nb_sparse, nb_sparse, written, chunk);
+    printf("%"PRId64" us, %.0f packets/s\n", t, written * 1e6 / t);
+
+end:
+    if (s && s->pb) {
+        av_freep(&s->pb->buffer);
+        avio_context_free(&s->pb);
+    }
+    avformat_free_context(s);
+    av_packet_free(&pkt);
+    return ret < 0;
+}